@@ -0,0 +1,42 @@
+#ifndef ABSTRACTPOLLHANDLER_H
+#define ABSTRACTPOLLHANDLER_H
+
+/*
+   AbstractPollHandler.h - additional file descriptor polled while serving
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "RefCounted.h"
+
+// SIOManager::DoServing adds the file descriptors of the poll handlers
+// to the set of descriptors it waits on and calls ProcessPollEvent
+// (between SIO commands) when one becomes readable.
+
+class AbstractPollHandler : public RefCounted {
+public:
+	AbstractPollHandler() {}
+	virtual ~AbstractPollHandler() {}
+
+	// return -1 if there's nothing to poll
+	virtual int GetFileDescriptor() const = 0;
+
+	// return true to make DoServing return to its caller
+	virtual bool ProcessPollEvent() = 0;
+};
+
+#endif
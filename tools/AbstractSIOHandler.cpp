@@ -20,6 +20,7 @@
 */
 
 #include "AbstractSIOHandler.h"
+#include "SIOTransferMonitor.h"
 
 AbstractSIOHandler::AbstractSIOHandler()
 : fIsActive(true)
@@ -48,3 +49,7 @@ bool AbstractSIOHandler::IsRemoteControlHandler() const
 void  AbstractSIOHandler::ProcessDelayedTasks(bool /*isForced*/)
 {
 }
+
+void AbstractSIOHandler::SetTransferMonitor(const RCPtr<SIOTransferMonitor>& /*monitor*/)
+{
+}
@@ -26,11 +26,14 @@
 #include <stdint.h>
 #include "../driver/atarisio.h"
 #include "SIOWrapper.h"
+#include "SIOScratchArena.h"
 #include "DiskImage.h"
 
 #include "RefCounted.h"
 #include "RCPtr.h"
 
+class SIOTransferMonitor;
+
 class AbstractSIOHandler : public RefCounted {
 public:
 	AbstractSIOHandler();
@@ -47,9 +50,11 @@ public:
 		eAtpWrongSpeed = 7,
 		eExecError = 8,
 		eWritePrinterError = 9,
-		eRemoteControlError = 10
+		eRemoteControlError = 10,
+		ePrinterBusy = 11,
+		eScratchExhausted = 12
 	};
-	virtual int ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper) = 0;
+	virtual int ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper, SIOScratchArena& scratch) = 0;
 	// returns:
 	// something defined in ECommandStatus or other = internal error
 
@@ -59,6 +64,10 @@ public:
 	virtual bool EnableXF551Mode(bool on) = 0;
 	virtual bool EnableStrictFormatChecking(bool on) = 0;
 
+	// disk handlers report processed commands to the monitor,
+	// a NULL pointer removes it
+	virtual void SetTransferMonitor(const RCPtr<SIOTransferMonitor>& monitor);
+
 	virtual bool IsAtrSIOHandler() const;
 	virtual bool IsAtpSIOHandler() const;
 	virtual bool IsPrinterHandler() const;
@@ -23,7 +23,7 @@
 
 #include "RefCounted.h"
 
-class AbstractTracer : public RefCounted {
+class AbstractTracer : public ThreadSafeRefCounted {
 public:
 	AbstractTracer()
 		: fTraceLineStarted(false)
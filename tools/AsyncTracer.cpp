@@ -0,0 +1,252 @@
+/*
+   AsyncTracer.cpp - forward trace output to a normal priority thread
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include "AsyncTracer.h"
+#include "MiscUtils.h"
+#include "Error.h"
+
+AsyncTracer::AsyncTracer(const RCPtr<AbstractTracer>& tracer)
+	: fRealTracer(tracer),
+	  fDroppedMessages(0),
+	  fTerminate(false),
+	  fThreadRunning(false)
+{
+	if (fRealTracer.IsNull()) {
+		throw ErrorObject("AsyncTracer needs a tracer");
+	}
+	if (sem_init(&fSemaphore, 0, 0)) {
+		throw ErrorObject("AsyncTracer: cannot create semaphore");
+	}
+	// if we can't start the thread, trace output is passed on directly
+	fThreadRunning = MiscUtils::create_normal_priority_thread(fThread, ThreadFunc, this, 256*1024);
+}
+
+AsyncTracer::~AsyncTracer()
+{
+	if (fThreadRunning) {
+		fTerminate.store(true);
+		sem_post(&fSemaphore);
+		pthread_join(fThread, NULL);
+	}
+	sem_destroy(&fSemaphore);
+}
+
+void* AsyncTracer::ThreadFunc(void* arg)
+{
+	static_cast<AsyncTracer*>(arg)->Run();
+	return NULL;
+}
+
+void AsyncTracer::Run()
+{
+	Message* msg;
+	while (true) {
+		while (sem_wait(&fSemaphore) && errno == EINTR) {
+		}
+
+		while ((msg = fQueue.GetReadSlot()) != 0) {
+			ProcessMessage(*msg);
+			fQueue.CommitRead();
+		}
+
+		unsigned int dropped = fDroppedMessages.exchange(0);
+		if (dropped) {
+			char buf[80];
+			snprintf(buf, sizeof(buf), "[tracer] dropped %u messages", dropped);
+			fRealTracer->EndTraceLine();
+			fRealTracer->StartTraceLine();
+			fRealTracer->AddWarningString(buf);
+			fRealTracer->EndTraceLine();
+			fRealTracer->FlushOutput();
+		}
+
+		if (fTerminate.load() && fQueue.IsEmpty()) {
+			break;
+		}
+	}
+	fRealTracer->FlushOutput();
+}
+
+void AsyncTracer::ProcessMessage(const Message& msg)
+{
+	switch (msg.fType) {
+	case eString:
+		fRealTracer->AddString(msg.fString); break;
+	case eHighlightString:
+		fRealTracer->AddHighlightString(msg.fString); break;
+	case eOKString:
+		fRealTracer->AddOKString(msg.fString); break;
+	case eDebugString:
+		fRealTracer->AddDebugString(msg.fString); break;
+	case eWarningString:
+		fRealTracer->AddWarningString(msg.fString); break;
+	case eErrorString:
+		fRealTracer->AddErrorString(msg.fString); break;
+	case eStartLine:
+		fRealTracer->StartTraceLine(); break;
+	case eEndLine:
+		fRealTracer->EndTraceLine(); break;
+	case eFlush:
+		fRealTracer->FlushOutput(); break;
+	case eDriveChanged:
+		fRealTracer->IndicateDriveChanged(msg.fArg); break;
+	case eDriveFormatted:
+		fRealTracer->IndicateDriveFormatted(msg.fArg); break;
+	case eCwdChanged:
+		fRealTracer->IndicateCwdChanged(); break;
+	case ePrinterChanged:
+		fRealTracer->IndicatePrinterChanged(); break;
+	case eCasStateChanged:
+		fRealTracer->IndicateCasStateChanged(); break;
+	case eCasBlockChanged:
+		fRealTracer->IndicateCasBlockChanged(); break;
+	}
+}
+
+void AsyncTracer::QueueMessage(EMessageType type, int arg)
+{
+	Message local;
+	Message* msg = fThreadRunning ? fQueue.GetWriteSlot() : &local;
+	if (!msg) {
+		fDroppedMessages++;
+		return;
+	}
+	msg->fType = type;
+	msg->fArg = arg;
+	msg->fString[0] = 0;
+	if (fThreadRunning) {
+		fQueue.CommitWrite();
+		sem_post(&fSemaphore);
+	} else {
+		ProcessMessage(local);
+	}
+}
+
+void AsyncTracer::QueueString(EMessageType type, const char* string)
+{
+	bool queued = false;
+	// long strings are split into multiple chunks
+	do {
+		Message local;
+		Message* msg = fThreadRunning ? fQueue.GetWriteSlot() : &local;
+		if (!msg) {
+			fDroppedMessages++;
+			break;
+		}
+		size_t len = strlen(string);
+		if (len > eMaxChunkLength) {
+			len = eMaxChunkLength;
+		}
+		msg->fType = type;
+		msg->fArg = 0;
+		memcpy(msg->fString, string, len);
+		msg->fString[len] = 0;
+		if (fThreadRunning) {
+			fQueue.CommitWrite();
+			queued = true;
+		} else {
+			ProcessMessage(local);
+		}
+		string += len;
+	} while (*string);
+
+	if (queued) {
+		sem_post(&fSemaphore);
+	}
+}
+
+void AsyncTracer::AddString(const char* string)
+{
+	QueueString(eString, string);
+}
+
+void AsyncTracer::AddHighlightString(const char* string)
+{
+	QueueString(eHighlightString, string);
+}
+
+void AsyncTracer::AddOKString(const char* string)
+{
+	QueueString(eOKString, string);
+}
+
+void AsyncTracer::AddDebugString(const char* string)
+{
+	QueueString(eDebugString, string);
+}
+
+void AsyncTracer::AddWarningString(const char* string)
+{
+	QueueString(eWarningString, string);
+}
+
+void AsyncTracer::AddErrorString(const char* string)
+{
+	QueueString(eErrorString, string);
+}
+
+void AsyncTracer::FlushOutput()
+{
+	QueueMessage(eFlush);
+}
+
+void AsyncTracer::IndicateDriveChanged(int driveno)
+{
+	QueueMessage(eDriveChanged, driveno);
+}
+
+void AsyncTracer::IndicateDriveFormatted(int driveno)
+{
+	QueueMessage(eDriveFormatted, driveno);
+}
+
+void AsyncTracer::IndicateCwdChanged()
+{
+	QueueMessage(eCwdChanged);
+}
+
+void AsyncTracer::IndicatePrinterChanged()
+{
+	QueueMessage(ePrinterChanged);
+}
+
+void AsyncTracer::IndicateCasStateChanged()
+{
+	QueueMessage(eCasStateChanged);
+}
+
+void AsyncTracer::IndicateCasBlockChanged()
+{
+	QueueMessage(eCasBlockChanged);
+}
+
+void AsyncTracer::ReallyStartTraceLine()
+{
+	QueueMessage(eStartLine);
+}
+
+void AsyncTracer::ReallyEndTraceLine()
+{
+	QueueMessage(eEndLine);
+}
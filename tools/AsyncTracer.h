@@ -0,0 +1,113 @@
+#ifndef ASYNCTRACER_H
+#define ASYNCTRACER_H
+
+/*
+   AsyncTracer.h - forward trace output to a normal priority thread
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <atomic>
+
+#include "AbstractTracer.h"
+#include "RCPtr.h"
+#include "LockFreeQueue.h"
+
+// Wraps a (possibly slow) tracer, eg a FileTracer, so that the realtime
+// SIO thread only has to copy the trace output into a lock-free queue.
+// The wrapped tracer is driven from a normal priority worker thread.
+// If the queue overflows trace output is dropped instead of blocking
+// the SIO thread, the number of dropped messages is reported later.
+
+class AsyncTracer : public AbstractTracer {
+public:
+	AsyncTracer(const RCPtr<AbstractTracer>& tracer);
+	virtual ~AsyncTracer();
+
+	virtual void AddString(const char* string);
+	virtual void AddHighlightString(const char* string);
+	virtual void AddOKString(const char* string);
+	virtual void AddDebugString(const char* string);
+	virtual void AddWarningString(const char* string);
+	virtual void AddErrorString(const char* string);
+
+	virtual void FlushOutput();
+
+	virtual void IndicateDriveChanged(int driveno);
+	virtual void IndicateDriveFormatted(int driveno);
+	virtual void IndicateCwdChanged();
+	virtual void IndicatePrinterChanged();
+
+	virtual void IndicateCasStateChanged();
+	virtual void IndicateCasBlockChanged();
+
+protected:
+	virtual void ReallyStartTraceLine();
+	virtual void ReallyEndTraceLine();
+
+private:
+	enum EMessageType {
+		eString,
+		eHighlightString,
+		eOKString,
+		eDebugString,
+		eWarningString,
+		eErrorString,
+		eStartLine,
+		eEndLine,
+		eFlush,
+		eDriveChanged,
+		eDriveFormatted,
+		eCwdChanged,
+		ePrinterChanged,
+		eCasStateChanged,
+		eCasBlockChanged
+	};
+
+	enum { eMaxChunkLength = 120 };
+
+	struct Message {
+		EMessageType fType;
+		int fArg;
+		char fString[eMaxChunkLength + 1];
+	};
+
+	enum { eQueueSize = 4096 };
+
+	void QueueMessage(EMessageType type, int arg = 0);
+	void QueueString(EMessageType type, const char* string);
+
+	void ProcessMessage(const Message& msg);
+
+	static void* ThreadFunc(void* arg);
+	void Run();
+
+	RCPtr<AbstractTracer> fRealTracer;
+
+	LockFreeQueue<Message, eQueueSize> fQueue;
+
+	std::atomic<unsigned int> fDroppedMessages;
+	std::atomic<bool> fTerminate;
+
+	sem_t fSemaphore;
+	pthread_t fThread;
+	bool fThreadRunning;
+};
+
+#endif
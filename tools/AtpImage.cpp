@@ -116,6 +116,17 @@ bool AtpImage::GetSector(uint8_t trackno,
 	}
 }
 
+AtpSector* AtpImage::FindSector(uint8_t trackno,
+		uint8_t sectorID,
+		unsigned int current_time) const
+{
+	if (trackno < fNumberOfTracks) {
+		return fTracks[trackno].FindSector(sectorID, current_time);
+	} else {
+		return 0;
+	}
+}
+
 void AtpImage::Dump(std::ostream& os, unsigned int indentlevel)
 {
 	using std::endl;
@@ -145,20 +156,19 @@ void AtpImage::Dump(std::ostream& os, unsigned int indentlevel)
 	;
 }
 
-RCPtr<ChunkWriter> AtpImage::BuildHeaderChunk() const
+void AtpImage::AppendHeaderChunk(const RCPtr<ChunkWriter>& writer) const
 {
-	RCPtr<ChunkWriter> headerChunk(new ChunkWriter("INFO"));
+	writer->BeginChunk("INFO");
 
-	headerChunk->AppendDword(fNumberOfTracks);
+	writer->AppendDword(fNumberOfTracks);
 	
 	if (IsWriteProtected()) {
-		headerChunk->AppendDword(1);
+		writer->AppendDword(1);
 	} else {
-		headerChunk->AppendDword(0);
+		writer->AppendDword(0);
 	}
 
-	headerChunk->CloseChunk();
-	return headerChunk;
+	writer->EndChunk();
 }
 
 bool AtpImage::InitFromHeaderChunk(RCPtr<ChunkReader> chunk)
@@ -217,43 +227,56 @@ bool AtpImage::WriteImageToFile(const char* filename) const
 		return false;
 	}
 
+	// all chunks are written directly into the buffer of the
+	// file chunk, only the length fields are filled in later
 	RCPtr<ChunkWriter> fileChunk(new ChunkWriter("FORM"));
+	{
+		// SECT chunk with 128 data bytes plus timing info per sector
+		size_t size = 64;
+		for (unsigned int i=0; i<fNumberOfTracks;i++) {
+			size += 48 + fTracks[i].GetNumberOfSectors() * (8 + 9 + 128 + 8);
+		}
+		if (!fileChunk->Reserve(size)) {
+			AERROR("cannot allocate memory for atp image");
+			fileio->Close();
+			return false;
+		}
+	}
 
 	{
-		RCPtr<ChunkWriter> atpChunk(new ChunkWriter("ATP1"));
+		fileChunk->BeginChunk("ATP1");
 
 		// write image information and sector data
-		atpChunk->AppendChunk(BuildHeaderChunk());
+		AppendHeaderChunk(fileChunk);
 
 		for (unsigned int i=0; i<fNumberOfTracks;i++) {
-			atpChunk->AppendChunk(fTracks[i].BuildTrackChunk());
+			fTracks[i].AppendTrackChunk(fileChunk);
 		}
 
-		atpChunk->CloseChunk();
-
-		fileChunk->AppendChunk(atpChunk);
+		fileChunk->EndChunk();
 
 		// write CRC32 checksum
-		unsigned int checksum = atpChunk->CalculateCRC32();
+		unsigned int checksum = fileChunk->CalculateLastChunkCRC32();
 
-		RCPtr<ChunkWriter> crcChunk(new ChunkWriter("CRC1"));
-		crcChunk->AppendDword(checksum);
-		crcChunk->CloseChunk();
-	
-		fileChunk->AppendChunk(crcChunk);
+		fileChunk->BeginChunk("CRC1");
+		fileChunk->AppendDword(checksum);
+		fileChunk->EndChunk();
 
 		// write timing information
-		RCPtr<ChunkWriter> timingChunk(new ChunkWriter("TIM1"));
-		timingChunk->AppendDword(fNumberOfTracks);
+		fileChunk->BeginChunk("TIM1");
+		fileChunk->AppendDword(fNumberOfTracks);
 
 		for (unsigned int i=0; i<fNumberOfTracks;i++) {
-			timingChunk->AppendChunk(fTracks[i].BuildTrackTimingChunk());
+			fTracks[i].AppendTrackTimingChunk(fileChunk);
 		}
-		timingChunk->CloseChunk();
-		fileChunk->AppendChunk(timingChunk);
+		fileChunk->EndChunk();
 	}
 
-	fileChunk->CloseChunk();
+	if (!fileChunk->CloseChunk()) {
+		AERROR("creating atp image failed!");
+		fileio->Close();
+		return false;
+	}
 
 	if (!fileChunk->WriteToFile(fileio)) {
 		AERROR("writing atp image failed!");
@@ -267,31 +290,19 @@ bool AtpImage::WriteImageToFile(const char* filename) const
 
 bool AtpImage::ReadImageFromFile(const char* filename, bool beQuiet)
 {
-	RCPtr<FileIO> fileio;
-
 	FreeData();
 
-#ifdef USE_ZLIB 
-	fileio = new GZFileIO();
-#else   
-	fileio = new StdFileIO();
-#endif  
-
-	if (!fileio->OpenRead(filename)) {
-		if (!beQuiet) {
-			AERROR("cannot open \"%s\" for reading",filename);
-		}
-		return false;
-	}
-
-	RCPtr<ChunkReader> fileChunk(ChunkReader::OpenChunkFile(fileio));
+	RCPtr<ChunkReader> fileChunk(ChunkReader::OpenChunkFile(filename));
 	RCPtr<ChunkReader> formChunk;
 	RCPtr<ChunkReader> atpChunk;
 	RCPtr<ChunkReader> crcChunk;
 	RCPtr<ChunkReader> timingChunk;
 
 	if (!fileChunk) {
-		goto error;
+		if (!beQuiet) {
+			AERROR("cannot open \"%s\" for reading",filename);
+		}
+		return false;
 	}
 	
 	do {
@@ -443,11 +454,9 @@ bool AtpImage::ReadImageFromFile(const char* filename, bool beQuiet)
 		}
 	}
 
-	fileio->Close();
 	SetChanged(false);
 	return true;
 error:
-	fileio->Close();
 	return false;
 
 }
@@ -530,14 +539,14 @@ bool AtpImage::ReadSector(unsigned int sector, uint8_t* buffer, unsigned int buf
 		return false;
 	}
 
-	RCPtr<AtpSector> sec;
+	AtpSector* sec;
 
 	switch (GetDensity()) {
 	case Atari1050Model::eDensityFM:
 		if (sector > 720) {
 			return false;
 		}
-		if (!GetSector( (sector - 1) / 18, ( ( sector - 1) % 18 ) + 1, sec)) {
+		if (!(sec = FindSector( (sector - 1) / 18, ( ( sector - 1) % 18 ) + 1))) {
 			return false;
 		}
 		break;
@@ -545,7 +554,7 @@ bool AtpImage::ReadSector(unsigned int sector, uint8_t* buffer, unsigned int buf
 		if (sector > 1040) {
 			return false;
 		}
-		if (!GetSector( (sector - 1) / 26, ( ( sector - 1) % 26 ) + 1, sec)) {
+		if (!(sec = FindSector( (sector - 1) / 26, ( ( sector - 1) % 26 ) + 1))) {
 			return false;
 		}
 		break;
@@ -568,14 +577,14 @@ bool AtpImage::WriteSector(unsigned int sector, const uint8_t* buffer, unsigned
 		return false;
 	}
 
-	RCPtr<AtpSector> sec;
+	AtpSector* sec;
 
 	switch (GetDensity()) {
 	case Atari1050Model::eDensityFM:
 		if (sector > 720) {
 			return false;
 		}
-		if (!GetSector( (sector - 1) / 18, ( ( sector - 1) % 18 ) + 1, sec)) {
+		if (!(sec = FindSector( (sector - 1) / 18, ( ( sector - 1) % 18 ) + 1))) {
 			return false;
 		}
 		break;
@@ -583,7 +592,7 @@ bool AtpImage::WriteSector(unsigned int sector, const uint8_t* buffer, unsigned
 		if (sector > 1040) {
 			return false;
 		}
-		if (!GetSector( (sector - 1) / 26, ( ( sector - 1) % 26 ) + 1, sec)) {
+		if (!(sec = FindSector( (sector - 1) / 26, ( ( sector - 1) % 26 ) + 1))) {
 			return false;
 		}
 		break;
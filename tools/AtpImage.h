@@ -43,6 +43,11 @@ public:
 	// delete previous data and allocate 'tracks' empty tracks.
 	void SetNumberOfTracks(uint8_t tracks);
 
+	inline uint8_t GetNumberOfTracks() const;
+
+	// get the given track, NULL if the track number is out of range
+	inline AtpTrack* GetTrack(uint8_t trackno);
+
 	// add an AtpSector to the specified track.
 	// internally the sectors are sorted by their (absolute)
 	// position value
@@ -60,6 +65,12 @@ public:
 			RCPtr<AtpSector>& sector,
 			unsigned int current_time = 0) const;
 
+	// same as GetSector, but returns a pointer to the sector
+	// (owned by the image) or NULL if it wasn't found.
+	AtpSector* FindSector(uint8_t trackno,
+			uint8_t sectorID,
+			unsigned int current_time = 0) const;
+
 	// DiskImage methods
 
 	virtual inline ESectorLength GetSectorLength() const;
@@ -90,7 +101,7 @@ private:
 	void AllocData();
 	void FreeData();
 
-	RCPtr<ChunkWriter> BuildHeaderChunk() const;
+	void AppendHeaderChunk(const RCPtr<ChunkWriter>& writer) const;
 
 	bool InitFromHeaderChunk(RCPtr<ChunkReader> chunk);
 
@@ -100,6 +111,20 @@ private:
 
 };
 
+inline uint8_t AtpImage::GetNumberOfTracks() const
+{
+	return fNumberOfTracks;
+}
+
+inline AtpTrack* AtpImage::GetTrack(uint8_t trackno)
+{
+	if (trackno < fNumberOfTracks) {
+		return &fTracks[trackno];
+	} else {
+		return 0;
+	}
+}
+
 inline ESectorLength AtpImage::GetSectorLength() const
 {
 	return e128BytesPerSector;
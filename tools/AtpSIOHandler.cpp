@@ -44,7 +44,7 @@ AtpSIOHandler::~AtpSIOHandler()
 {
 }
 
-int AtpSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper)
+int AtpSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper, SIOScratchArena& scratch)
 {
 	int ret=0, ret2;
 
@@ -74,14 +74,23 @@ int AtpSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 			break;
 		}
 
+		unsigned int buflen = 4;
+		uint8_t* buf = scratch.Allocate(buflen);
+		if (!buf) {
+			if (wrapper->SendCommandNAK()) {
+				LOG_SIO_CMD_NAK_FAILED();
+			}
+			ret = AbstractSIOHandler::eScratchExhausted;
+			fTracer->TraceCommandError(ret);
+			break;
+		}
+
 		if ((ret=wrapper->SendCommandACK())) {
 			fTracer->TraceCommandError(ret);
 			LOG_SIO_CMD_ACK_FAILED();
 			break;
 		}
 
-		unsigned int buflen = 4;
-		uint8_t buf[buflen];
 		const char* description = "[ get status ]";
 
 		if (currentTime < fLastDiskAccessTimestamp +
@@ -144,14 +153,23 @@ int AtpSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 			break;
 		}
 
+		unsigned int buflen = 128;
+		uint8_t* buf = scratch.Allocate(buflen);
+		if (!buf) {
+			if (wrapper->SendCommandNAK()) {
+				LOG_SIO_CMD_NAK_FAILED();
+			}
+			ret = AbstractSIOHandler::eScratchExhausted;
+			fTracer->TraceCommandError(ret);
+			break;
+		}
+
 		if ((ret=wrapper->SendCommandACK())) {
 			fTracer->TraceCommandError(ret);
 			LOG_SIO_CMD_ACK_FAILED();
 			break;
 		}
 
-                unsigned int buflen = 128;
-		uint8_t buf[buflen];
 		const char* description = "[ read sector ]";
 
 		unsigned int delay = 0;
@@ -159,12 +177,12 @@ int AtpSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 		delay += SpinUpMotor(currentTime);
 		delay += SeekToTrack(track);
 
-		RCPtr<AtpSector> sector;
+		AtpSector* sector = 0;
 
 		unsigned int currentPos = (currentTime + delay) % Atari1050Model::eDiskRotationTime;
 
 		if ( fImage->GetDensity(track) == fCurrentDensity &&
-		     fImage->GetSector(track, secid, sector, currentPos)) {
+		     (sector = fImage->FindSector(track, secid, currentPos))) {
 			delay +=
 				( (sector->GetPosition() + Atari1050Model::eDiskRotationTime - currentPos)
 				  % Atari1050Model::eDiskRotationTime)
@@ -250,14 +268,23 @@ int AtpSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 			break;
 		}
 
+		unsigned int buflen = 128;
+		uint8_t* buf = scratch.Allocate(buflen);
+		if (!buf) {
+			if (wrapper->SendCommandNAK()) {
+				LOG_SIO_CMD_NAK_FAILED();
+			}
+			ret = AbstractSIOHandler::eScratchExhausted;
+			fTracer->TraceCommandError(ret);
+			break;
+		}
+
 		if ((ret=wrapper->SendCommandACK())) {
 			fTracer->TraceCommandError(ret);
 			LOG_SIO_CMD_ACK_FAILED();
 			break;
 		}
 
-		unsigned int buflen = 128;
-		uint8_t buf[buflen];
 		const char* description;
 
 		if (frame.command == 0x50) {
@@ -283,12 +310,12 @@ int AtpSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 			ret = AbstractSIOHandler::eWriteProtected;
 			fLastFDCStatus = 0xbf;
 		} else {
-			RCPtr<AtpSector> sector;
+			AtpSector* sector = 0;
 
 			unsigned int currentPos = (currentTime + delay) % Atari1050Model::eDiskRotationTime;
 
 			if ( fImage->GetDensity(track) == fCurrentDensity &&
-			     fImage->GetSector(track, secid, sector, currentPos)) {
+			     (sector = fImage->FindSector(track, secid, currentPos))) {
 				delay +=
 					( (sector->GetPosition() + Atari1050Model::eDiskRotationTime - currentPos)
 					  % Atari1050Model::eDiskRotationTime)
@@ -367,14 +394,23 @@ int AtpSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 			break;
 		}
 
+		unsigned int buflen = 128;
+		uint8_t* buf = scratch.Allocate(buflen);
+		if (!buf) {
+			if (wrapper->SendCommandNAK()) {
+				LOG_SIO_CMD_NAK_FAILED();
+			}
+			ret = AbstractSIOHandler::eScratchExhausted;
+			fTracer->TraceCommandError(ret);
+			break;
+		}
+
 		if ((ret=wrapper->SendCommandACK())) {
 			fTracer->TraceCommandError(ret);
 			LOG_SIO_CMD_ACK_FAILED();
 			break;
 		}
 
-		unsigned int buflen = 128;
-		uint8_t buf[buflen];
 		const char* description;
 
 		if (frame.command == 0x21) {
@@ -36,7 +36,7 @@ public:
 	 * image in the destructor!
 	 */
 	virtual ~AtpSIOHandler();
-	virtual int ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper);
+	virtual int ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper, SIOScratchArena& scratch);
 
 	virtual bool EnableHighSpeed(bool on);
 	virtual bool SetHighSpeedParameters(unsigned int pokeyDivisor, unsigned int baudrate);
@@ -108,18 +108,16 @@ void AtpSector::Dump(std::ostream& os, unsigned int indentlevel) const
 	os.setf(std::ios::dec, std::ios::basefield);
 }
 
-RCPtr<ChunkWriter> AtpSector::BuildSectorChunk() const
+void AtpSector::AppendSectorChunk(const RCPtr<ChunkWriter>& writer) const
 {
-	RCPtr<ChunkWriter> chunk(new ChunkWriter("SECT"));
+	writer->BeginChunk("SECT");
 
-	chunk->AppendDword(fID);
-	chunk->AppendDword(fDataLength);
-	chunk->AppendByte(fSectorStatus);
-	chunk->AppendBlock(fSectorData, fDataLength);
+	writer->AppendDword(fID);
+	writer->AppendDword(fDataLength);
+	writer->AppendByte(fSectorStatus);
+	writer->AppendBlock(fSectorData, fDataLength);
 
-	chunk->CloseChunk();
-
-	return chunk;
+	writer->EndChunk();
 }
 
 bool AtpSector::InitFromSectorChunk(RCPtr<ChunkReader> chunk, bool beQuiet)
@@ -68,8 +68,8 @@ public:
 	
 	void Dump(std::ostream& os, unsigned int indentlevel=0) const;
 
-	// create ATP "SECT" chunk from internal data
-	RCPtr<ChunkWriter> BuildSectorChunk() const;
+	// append ATP "SECT" chunk with internal data to the writer
+	void AppendSectorChunk(const RCPtr<ChunkWriter>& writer) const;
 
 	// set internal data from ATP "SECT" chunk
 	bool InitFromSectorChunk(RCPtr<ChunkReader> chunk, bool beQuiet);
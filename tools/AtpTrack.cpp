@@ -19,12 +19,13 @@
 */
 
 #include <string.h>
+#include <algorithm>
 #include "AtpTrack.h"
 #include "Indent.h"
 #include "SIOTracer.h"
 #include "AtariDebug.h"
 
-using std::list;
+using std::vector;
 
 AtpTrack::AtpTrack()
 	: fNumberOfSectors(0),
@@ -37,56 +38,78 @@ AtpTrack::~AtpTrack()
 
 void AtpTrack::AddSector(const RCPtr<AtpSector>& sec)
 {
-	list< RCPtr<AtpSector> >::iterator end(fSectors.end());
-	list< RCPtr<AtpSector> >::iterator iter(fSectors.begin());
+	vector< RCPtr<AtpSector> >::iterator end(fSectors.end());
+	vector< RCPtr<AtpSector> >::iterator iter(fSectors.begin());
 
 	while	( (iter != end) &&
 		  ( (*iter)->GetPosition() <= sec->GetPosition() )
 		) {
 		iter++;
 	}
+	unsigned int slot = iter - fSectors.begin();
 	fSectors.insert(iter, sec);
 	fNumberOfSectors++;
+
+	// update the index in place, sectors behind the new one
+	// move up one slot
+	for (unsigned int i = 0; i < fIndex.size(); i++) {
+		if (fIndex[i].fSlot >= slot) {
+			fIndex[i].fSlot++;
+		}
+	}
+	IndexEntry entry;
+	entry.fID = sec->GetID();
+	entry.fPosition = sec->GetPosition();
+	entry.fSlot = slot;
+	fIndex.insert(std::upper_bound(fIndex.begin(), fIndex.end(), entry), entry);
+}
+
+void AtpTrack::BuildIndex()
+{
+	fIndex.resize(fNumberOfSectors);
+	for (unsigned int i = 0; i < fNumberOfSectors; i++) {
+		fIndex[i].fID = fSectors[i]->GetID();
+		fIndex[i].fPosition = fSectors[i]->GetPosition();
+		fIndex[i].fSlot = i;
+	}
+	std::sort(fIndex.begin(), fIndex.end());
 }
 
 bool AtpTrack::GetSector(unsigned int id,
 		RCPtr<AtpSector>& sector,
 		unsigned int current_time)
 {
-	list< RCPtr<AtpSector> >::const_iterator end(fSectors.end());
-	list< RCPtr<AtpSector> >::const_iterator current(fSectors.begin());
-
-	sector = RCPtr<AtpSector>();
-	if (fSectors.empty()) {
-		return false;
-	}
-
-	// "seek" to current time position
+	sector = FindSector(id, current_time);
+	return sector.IsNotNull();
+}
 
-	while	( (current != end) &&
-		  ( (*current)->GetPosition() < current_time )
-		) {
-		current++;
+AtpSector* AtpTrack::FindSector(unsigned int id,
+		unsigned int current_time) const
+{
+	// all sectors with this ID
+	IndexEntry key;
+	key.fID = id;
+	key.fPosition = 0;
+	key.fSlot = 0;
+	vector<IndexEntry>::const_iterator first =
+		std::lower_bound(fIndex.begin(), fIndex.end(), key);
+	if (first == fIndex.end() || first->fID != id) {
+		return 0;
 	}
-
-	// ensure that current always points to a real sector
-	if (current == end) {
-		current = fSectors.begin();
+	key.fID = id + 1;
+	vector<IndexEntry>::const_iterator last =
+		std::lower_bound(first, fIndex.end(), key);
+
+	// the next one at or after the current position, or the
+	// first one on the next rotation
+	key.fID = id;
+	key.fPosition = current_time;
+	vector<IndexEntry>::const_iterator iter =
+		std::lower_bound(first, last, key);
+	if (iter == last) {
+		iter = first;
 	}
-
-	list< RCPtr<AtpSector> >::const_iterator iter(current);
-	do {
-		if ((*iter)->GetID() == id) {
-			sector = *iter;
-			return true;
-		}
-		iter++;
-		if (iter == end) {
-			iter = fSectors.begin();
-		}
-	} while (iter!=current);
-
-	return false;
+	return fSectors[iter->fSlot].GetRealPointer();
 }
 
 bool AtpTrack::InternalGetSector(unsigned int internalNumber, RCPtr<AtpSector>& sector)
@@ -95,11 +118,7 @@ bool AtpTrack::InternalGetSector(unsigned int internalNumber, RCPtr<AtpSector>&
 		sector = RCPtr<AtpSector>();
 		return false;
 	} else {
-		list< RCPtr<AtpSector> >::const_iterator iter(fSectors.begin());
-		for (unsigned int i=0;i<internalNumber;i++) {
-			iter++;
-		}
-		sector = *iter;
+		sector = fSectors[internalNumber];
 		return true;
 	}
 }
@@ -140,8 +159,8 @@ void AtpTrack::Dump(std::ostream& os, unsigned int indentlevel) const
 		   << "begin sectors {"
 		   << endl
 		;
-		list< RCPtr<AtpSector> >::const_iterator end(fSectors.end());
-		list< RCPtr<AtpSector> >::const_iterator iter(fSectors.begin());
+		vector< RCPtr<AtpSector> >::const_iterator end(fSectors.end());
+		vector< RCPtr<AtpSector> >::const_iterator iter(fSectors.begin());
 
 		while (iter != end) {
 			(*iter)->Dump(os, indentlevel+2);
@@ -164,50 +183,41 @@ void AtpTrack::SetTrackNumber(unsigned int trackno)
 	fTrackNumber = trackno;
 }
 
-RCPtr<ChunkWriter> AtpTrack::BuildTrackChunk() const
+void AtpTrack::AppendTrackChunk(const RCPtr<ChunkWriter>& writer) const
 {
-	RCPtr<ChunkWriter> chunk(new ChunkWriter("TRAK"));
+	writer->BeginChunk("TRAK");
 
-	chunk->AppendDword(fTrackNumber);
-	chunk->AppendDword(fNumberOfSectors);
+	writer->AppendDword(fTrackNumber);
+	writer->AppendDword(fNumberOfSectors);
 
 	switch (fDensity) {
 	case Atari1050Model::eDensityFM:
-		chunk->AppendDword(0);
+		writer->AppendDword(0);
 		break;
 	case Atari1050Model::eDensityMFM:
-		chunk->AppendDword(1);
+		writer->AppendDword(1);
 		break;
 	default:
 		std::cerr << "unknown track density!" << std::endl;
-		chunk->AppendDword(0);
+		writer->AppendDword(0);
 		break;
 	}
 	
-	list< RCPtr<AtpSector> >::const_iterator end(fSectors.end());
-	list< RCPtr<AtpSector> >::const_iterator iter(fSectors.begin());
+	vector< RCPtr<AtpSector> >::const_iterator end(fSectors.end());
+	vector< RCPtr<AtpSector> >::const_iterator iter(fSectors.begin());
 	
-	/*
-	unsigned int last_position=0;
-	unsigned int current_position;
-	*/
 	while (iter != end) {
-		RCPtr<AtpSector> sec(*iter);
-
-		RCPtr<ChunkWriter> sect_chunk = sec->BuildSectorChunk();
-		chunk->AppendChunk(sect_chunk);
-
+		(*iter)->AppendSectorChunk(writer);
 		iter++;
 	}
 
-	chunk->CloseChunk();
-
-	return chunk;
+	writer->EndChunk();
 }
 
 bool AtpTrack::InitFromTRAKChunk(RCPtr<ChunkReader> chunk, bool beQuiet)
 {
 	fSectors.clear();
+	fIndex.clear();
 	fNumberOfSectors = 0;
 
 	if (!chunk || strcmp(chunk->GetChunkName(),"TRAK")) {
@@ -265,28 +275,24 @@ bool AtpTrack::InitFromTRAKChunk(RCPtr<ChunkReader> chunk, bool beQuiet)
 	return true;
 }
 
-RCPtr<ChunkWriter> AtpTrack::BuildTrackTimingChunk() const
+void AtpTrack::AppendTrackTimingChunk(const RCPtr<ChunkWriter>& writer) const
 {
-	RCPtr<ChunkWriter> chunk(new ChunkWriter("TTI1"));
+	writer->BeginChunk("TTI1");
 
-	chunk->AppendDword(fTrackNumber);
-	chunk->AppendDword(fNumberOfSectors);
+	writer->AppendDword(fTrackNumber);
+	writer->AppendDword(fNumberOfSectors);
 
-	list< RCPtr<AtpSector> >::const_iterator end(fSectors.end());
-	list< RCPtr<AtpSector> >::const_iterator iter(fSectors.begin());
+	vector< RCPtr<AtpSector> >::const_iterator end(fSectors.end());
+	vector< RCPtr<AtpSector> >::const_iterator iter(fSectors.begin());
 	
 	while (iter != end) {
-		RCPtr<AtpSector> sec(*iter);
-
-		chunk->AppendDword((*iter)->GetPosition());
-		chunk->AppendDword((*iter)->GetTimeLength());
+		writer->AppendDword((*iter)->GetPosition());
+		writer->AppendDword((*iter)->GetTimeLength());
 
 		iter++;
 	}
 
-	chunk->CloseChunk();
-
-	return chunk;
+	writer->EndChunk();
 }
 
 bool AtpTrack::SetTimingInformationFromTTI1Chunk(RCPtr<ChunkReader> chunk, bool beQuiet)
@@ -322,8 +328,8 @@ bool AtpTrack::SetTimingInformationFromTTI1Chunk(RCPtr<ChunkReader> chunk, bool
 	unsigned int current_position;
 	unsigned int current_length;
 
-	list< RCPtr<AtpSector> >::const_iterator end(fSectors.end());
-	list< RCPtr<AtpSector> >::const_iterator iter(fSectors.begin());
+	vector< RCPtr<AtpSector> >::const_iterator end(fSectors.end());
+	vector< RCPtr<AtpSector> >::const_iterator iter(fSectors.begin());
 	
 	while (iter != end) {
 		if (!chunk->ReadDword(current_position)) return false;
@@ -351,6 +357,7 @@ bool AtpTrack::SetTimingInformationFromTTI1Chunk(RCPtr<ChunkReader> chunk, bool
 
 		iter++;
 	}
+	BuildIndex();
 	return true;
 }
 
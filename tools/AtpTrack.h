@@ -21,7 +21,7 @@
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
-#include <list>
+#include <vector>
 
 #include "AtpSector.h"
 #include "Atari1050Model.h"
@@ -41,7 +41,8 @@ public:
 
 	// add an AtpSector to the track
 	// internally the sectors are sorted by their (absolute)
-	// position value
+	// position value. Sectors with the same position keep the
+	// order in which they were added.
 	void AddSector(const RCPtr<AtpSector>& sec);
 
 	// try to find a sector with specified ID value starting
@@ -54,12 +55,19 @@ public:
 			RCPtr<AtpSector>& sector,
 			unsigned int current_time = 0);
 
+	// same as GetSector, but returns a pointer to the sector
+	// which is owned by the track, or NULL if the sector wasn't
+	// found. This avoids reference counting in the command path.
+	// The lookup is a binary search in the sector ID index.
+	AtpSector* FindSector(unsigned int id,
+			unsigned int current_time = 0) const;
+
 	
-	// create ATP "TRAK" chunk from internal data
-	RCPtr<ChunkWriter> BuildTrackChunk() const;
+	// append ATP "TRAK" chunk with internal data to the writer
+	void AppendTrackChunk(const RCPtr<ChunkWriter>& writer) const;
 
-	// create ATP "TTI1" chunk from internal data
-	RCPtr<ChunkWriter> BuildTrackTimingChunk() const;
+	// append ATP "TTI1" chunk with internal data to the writer
+	void AppendTrackTimingChunk(const RCPtr<ChunkWriter>& writer) const;
 
 	// set internal data from ATP "TRAK" chunk
 	bool InitFromTRAKChunk(RCPtr<ChunkReader> chunk, bool beQuiet);
@@ -82,8 +90,24 @@ private:
 
 	bool SetTimingInformationFromTTI1Chunk(RCPtr<ChunkReader> chunk, bool beQuiet);
 
+	// must be called after sectors were added or moved
+	void BuildIndex();
+
+	// index entries are sorted by sector ID, then by position
+	// and then by slot number, so all candidates for an ID are
+	// adjacent and in the order they pass the drive head.
+	struct IndexEntry {
+		unsigned int fID;
+		unsigned int fPosition;
+		unsigned int fSlot;
+
+		inline bool operator<(const IndexEntry& other) const;
+	};
+
 private:
-	std::list< RCPtr<AtpSector> > fSectors;
+	// sorted by position
+	std::vector< RCPtr<AtpSector> > fSectors;
+	std::vector<IndexEntry> fIndex;
 	unsigned int fNumberOfSectors;
 	unsigned int fTrackNumber;
 	Atari1050Model::EDiskDensity fDensity;
@@ -109,4 +133,15 @@ inline unsigned int AtpTrack::GetTrackNumber() const
 	return fTrackNumber;
 }
 
+inline bool AtpTrack::IndexEntry::operator<(const IndexEntry& other) const
+{
+	if (fID != other.fID) {
+		return fID < other.fID;
+	}
+	if (fPosition != other.fPosition) {
+		return fPosition < other.fPosition;
+	}
+	return fSlot < other.fSlot;
+}
+
 #endif
@@ -25,10 +25,79 @@
 
 using namespace Atari1050Model;
 
+// sector IDs and positions of a 1050 formatted track,
+// sorted by position
+struct TrackTemplate {
+	enum { eMaxSectors = 26 };
+	unsigned int fNumberOfSectors;
+	unsigned int fTimeLength;
+	unsigned int fID[eMaxSectors];
+	unsigned int fPosition[eMaxSectors];
+};
+
+static TrackTemplate sSDTemplates[40];
+static TrackTemplate sEDTemplates[40];
+static bool sTemplatesInitialized = false;
+
+static void init_template(TrackTemplate& t, unsigned int track, unsigned int sectors,
+	unsigned int timeLength, unsigned int (*calcPosition)(unsigned int, unsigned int))
+{
+	t.fNumberOfSectors = sectors;
+	t.fTimeLength = timeLength;
+	for (unsigned int i = 0; i < sectors; i++) {
+		unsigned int id = i + 1;
+		unsigned int position = calcPosition(track, id);
+		// insertion sort, stable for equal positions
+		unsigned int j = i;
+		while (j > 0 && t.fPosition[j-1] > position) {
+			t.fID[j] = t.fID[j-1];
+			t.fPosition[j] = t.fPosition[j-1];
+			j--;
+		}
+		t.fID[j] = id;
+		t.fPosition[j] = position;
+	}
+}
+
+void AtpUtils::InitTrackTemplates()
+{
+	if (sTemplatesInitialized) {
+		return;
+	}
+	for (unsigned int track = 0; track < 40; track++) {
+		init_template(sSDTemplates[track], track, 18, eSDSectorTimeLength,
+			CalculatePositionOfSDSector);
+		init_template(sEDTemplates[track], track, 26, eEDSectorTimeLength,
+			CalculatePositionOfEDSector);
+	}
+	sTemplatesInitialized = true;
+}
+
+static bool fill_track(RCPtr<AtpImage>& atpImage, const RCPtr<AtrImage>& atrImage,
+	unsigned int track, const TrackTemplate& t)
+{
+	uint8_t buf[128];
+	for (unsigned int i = 0; i < t.fNumberOfSectors; i++) {
+		unsigned int sector = t.fID[i];
+		if (!atrImage->ReadSector(track*t.fNumberOfSectors+sector,buf,128)) {
+			DPRINTF("error accessing internal ATR image!");
+			return false;
+		}
+		// sectors are added in position order, so they are
+		// appended at the end of the track
+		atpImage->AddSector(track, new AtpSector(
+			sector, 128, buf, t.fPosition[i],
+			t.fTimeLength));
+	}
+	return true;
+}
+
 RCPtr<AtpImage> AtpUtils::CreateAtpImageFromAtrImage(RCPtr<AtrImage> atrImage)
 {
 	EDiskFormat format = atrImage->GetDiskFormat();
 
+	InitTrackTemplates();
+
 	switch (format) {
 	case e90kDisk: {
 		RCPtr<AtpImage> atpImage = new AtpImage;
@@ -36,17 +105,8 @@ RCPtr<AtpImage> AtpUtils::CreateAtpImageFromAtrImage(RCPtr<AtrImage> atrImage)
 		atpImage->SetDensity(eDensityFM);
 
 		for (unsigned int track=0;track<40;track++) {
-			for (unsigned int sector=1;sector<=18;sector++) {
-				unsigned int position = CalculatePositionOfSDSector(
-					track, sector);
-				uint8_t buf[128];
-				if (!atrImage->ReadSector(track*18+sector,buf,128)) {
-					DPRINTF("error accessing internal ATR image!");
-					return RCPtr<AtpImage>();
-				}
-				atpImage->AddSector(track, new AtpSector(
-					sector, 128, buf, position,
-					eSDSectorTimeLength));
+			if (!fill_track(atpImage, atrImage, track, sSDTemplates[track])) {
+				return RCPtr<AtpImage>();
 			}
 		}
 		return atpImage;
@@ -57,17 +117,8 @@ RCPtr<AtpImage> AtpUtils::CreateAtpImageFromAtrImage(RCPtr<AtrImage> atrImage)
 		atpImage->SetDensity(eDensityMFM);
 
 		for (unsigned int track=0;track<40;track++) {
-			for (unsigned int sector=1;sector<=26;sector++) {
-				unsigned int position = CalculatePositionOfEDSector(
-					track, sector);
-				uint8_t buf[128];
-				if (!atrImage->ReadSector(track*26+sector,buf,128)) {
-					DPRINTF("error accessing internal ATR image!");
-					return RCPtr<AtpImage>();
-				}
-				atpImage->AddSector(track, new AtpSector(
-					sector, 128, buf, position,
-					eEDSectorTimeLength));
+			if (!fill_track(atpImage, atrImage, track, sEDTemplates[track])) {
+				return RCPtr<AtpImage>();
 			}
 		}
 		return atpImage;
@@ -77,4 +128,3 @@ RCPtr<AtpImage> AtpUtils::CreateAtpImageFromAtrImage(RCPtr<AtrImage> atrImage)
 		return RCPtr<AtpImage>();
 	}
 }
-
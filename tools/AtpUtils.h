@@ -30,6 +30,11 @@ namespace AtpUtils {
 
 	RCPtr<AtpImage> CreateAtpImageFromAtrImage(RCPtr<AtrImage> atrImage);
 
+	// precalculate the layout of standard SD and ED tracks used by
+	// CreateAtpImageFromAtrImage. This is done on the first
+	// conversion, call it before converting images in several threads.
+	void InitTrackTemplates();
+
 };
 
 #endif
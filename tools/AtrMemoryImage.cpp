@@ -24,6 +24,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <vector>
 
 #ifdef USE_ZLIB
 #include <zlib.h>
@@ -39,8 +40,85 @@
 
 #include "winver.h"
 
+// sector offsets of a DI image, checksums are verified when a
+// sector is decoded
+class AtrMemoryImage::DiSectorSource : public LazySectorSource {
+public:
+	DiSectorSource(const RCPtr<FileIO>& fileio, unsigned int numberOfSectors)
+		: fFileIO(fileio),
+		  fOffset(numberOfSectors + 1, 0),
+		  fChecksum(numberOfSectors + 1, 0)
+	{ }
+
+	virtual ~DiSectorSource()
+	{
+		fFileIO->Close();
+	}
+
+	virtual bool DecodeSector(unsigned int sector, uint8_t* buffer, unsigned int len)
+	{
+		if (sector == 0 || sector >= fChecksum.size()) {
+			return false;
+		}
+		if (fChecksum[sector] == 0) {
+			memset(buffer, 0, len);
+			return true;
+		}
+		if (!fFileIO->Seek(fOffset[sector]) || fFileIO->ReadBlock(buffer, len) != len) {
+			AERROR("error reading sector %d from DI file", sector);
+			memset(buffer, 0, len);
+			return false;
+		}
+		if (CalculateDiSectorChecksum(buffer, len) != fChecksum[sector]) {
+			AERROR("checksum error in DI image at sector %d", sector);
+			return false;
+		}
+		return true;
+	}
+
+	RCPtr<FileIO> fFileIO;
+	std::vector<off_t> fOffset;
+	std::vector<uint8_t> fChecksum;
+};
+
+// sectors of an uncompressed (or gzipped) ATR or XFD image, read
+// with pread (resp. the GZFileIO index) when they are accessed
+class AtrMemoryImage::FileSectorSource : public LazySectorSource {
+public:
+	FileSectorSource(const RCPtr<FileIO>& fileio, off_t dataOffset, const AtrMemoryImage* image)
+		: fFileIO(fileio),
+		  fDataOffset(dataOffset),
+		  fImage(image)
+	{ }
+
+	virtual ~FileSectorSource()
+	{
+		fFileIO->Close();
+	}
+
+	virtual bool DecodeSector(unsigned int sector, uint8_t* buffer, unsigned int len)
+	{
+		ssize_t offset = fImage->CalculateOffset(sector);
+		if (offset < 0) {
+			return false;
+		}
+		unsigned int got = fFileIO->ReadBlockAt(fDataOffset + offset, buffer, len);
+		if (got < len) {
+			// truncated image file, same as when loading it completely
+			memset(buffer + got, 0, len - got);
+		}
+		return true;
+	}
+
+	RCPtr<FileIO> fFileIO;
+	off_t fDataOffset;
+	const AtrMemoryImage* fImage;
+};
+
 AtrMemoryImage::AtrMemoryImage()
-	: fData(0)
+	: fData(0),
+	  fSectorCache(0),
+	  fLazyLoading(false)
 {
 }
 
@@ -55,9 +133,25 @@ void AtrMemoryImage::FreeImageData()
 		delete[] fData;
 		fData=0;
 	}
+	fLazySource.SetToNull();
+	if (fSectorCache) {
+		delete fSectorCache;
+		fSectorCache = 0;
+	}
+	FreeWrittenSectors();
 	SetFormat(eNoDisk);
 }
 
+void AtrMemoryImage::FreeWrittenSectors()
+{
+	for (unsigned int i = 0; i < fWrittenSector.size(); i++) {
+		if (fWrittenSector[i]) {
+			delete[] fWrittenSector[i];
+		}
+	}
+	fWrittenSector.clear();
+}
+
 bool AtrMemoryImage::CreateImage(EDiskFormat format)
 {
 	size_t imgSize;
@@ -244,6 +338,11 @@ bool AtrMemoryImage::WriteImageToFile(const char* filename) const
 	bool ret;
 	EImageType imageType = DetermineImageTypeFromFilename(filename);
 
+	// we might be about to overwrite the file we decode from
+	if (!const_cast<AtrMemoryImage*>(this)->DecodeLazyImage()) {
+		return false;
+	}
+
 	if (imageType == eUnknownImageType) {
 		AWARN("cannot determine image type from filename - using ATR format");
 		imageType = eAtrImageType;
@@ -330,6 +429,13 @@ bool AtrMemoryImage::ReadImageFromAtrFile(const char* filename, bool beQuiet)
 		}
 		goto failure;
 	}
+
+	if (UseLazyDecoding(DetermineImageTypeFromFilename(filename))) {
+		SetLazySource(new FileSectorSource(fileio, 16, this));
+		SetChanged(false);
+		return true;
+	}
+
 	fData = new uint8_t[imgSize];
 	memset(fData, 0, imgSize);
 
@@ -460,6 +566,13 @@ bool AtrMemoryImage::ReadImageFromXfdFile(const char* filename, bool beQuiet)
 		}
 		goto failure;
 	}
+
+	if (UseLazyDecoding(DetermineImageTypeFromFilename(filename))) {
+		SetLazySource(new FileSectorSource(fileio, 0, this));
+		SetChanged(false);
+		return true;
+	}
+
 	fData = new uint8_t[imgSize];
 	memset(fData, 0, imgSize);
 
@@ -542,12 +655,24 @@ bool AtrMemoryImage::ReadImageFromDcmFile(const char* filename, bool beQuiet)
 #else
 	fileio = new StdFileIO();
 #endif
-       	dcmcodec = new DCMCodec(fileio, this);
-
 	FreeImageData();
 
 	bool ret;
 
+	if (UseLazyDecoding(DetermineImageTypeFromFilename(filename))) {
+		RCPtr<DCMCodec> codec = new DCMCodec(fileio, this);
+		if ((ret=codec->LoadIndex(filename, beQuiet))) {
+			SetWriteProtect(false);
+			SetLazySource(codec);
+			SetChanged(false);
+		} else {
+			FreeImageData();
+		}
+		return ret;
+	}
+
+       	dcmcodec = new DCMCodec(fileio, this);
+
 	if ((ret=dcmcodec->Load(filename, beQuiet))) {
 		SetChanged(false);
 	}
@@ -583,7 +708,7 @@ bool AtrMemoryImage::WriteImageToDcmFile(const char* filename, bool useGz) const
 	return ret;
 }
 
-uint8_t AtrMemoryImage::CalculateDiSectorChecksum(uint8_t* buf, unsigned int len) const
+uint8_t AtrMemoryImage::CalculateDiSectorChecksum(const uint8_t* buf, unsigned int len)
 {
 	uint16_t chksum = 0;
 	unsigned int i;
@@ -612,6 +737,8 @@ bool AtrMemoryImage::ReadImageFromDiFile(const char* filename, bool beQuiet)
 
 	RCPtr<FileIO> fileio;
 
+	bool lazy = UseLazyDecoding(DetermineImageTypeFromFilename(filename));
+
 #ifdef USE_ZLIB
 	fileio = new GZFileIO();
 #else
@@ -717,7 +844,13 @@ bool AtrMemoryImage::ReadImageFromDiFile(const char* filename, bool beQuiet)
 		goto failure;
 	}
 
-	if (!CreateImage(density, sectorsPerTrack, tracksPerSide, sides)) {
+	if (lazy) {
+		// only set the format, sector data stays in the file
+		if (!SetFormat(density, sectorsPerTrack, tracksPerSide, sides)) {
+			goto failure;
+		}
+		SetWriteProtect(false);
+	} else if (!CreateImage(density, sectorsPerTrack, tracksPerSide, sides)) {
 		goto failure;
 	}
 
@@ -729,6 +862,25 @@ bool AtrMemoryImage::ReadImageFromDiFile(const char* filename, bool beQuiet)
 		goto failure_eof;
 	}
 
+	if (lazy) {
+		RCPtr<DiSectorSource> source = new DiSectorSource(fileio, totalSectors);
+		off_t offset = fileio->Tell();
+		for (sector=1; sector <= totalSectors; sector++) {
+			source->fChecksum[sector] = map[sector-1];
+			if (map[sector-1]) {
+				source->fOffset[sector] = offset;
+				offset += GetSectorLength(sector);
+			}
+		}
+		delete [] map;
+		if (offset > fileio->GetFileLength()) {
+			goto failure_eof;
+		}
+		SetLazySource(source);
+		SetChanged(false);
+		return true;
+	}
+
 	for (sector=1; sector <= totalSectors; sector++) {
 		uint8_t checksum = map[sector-1];
 
@@ -910,7 +1062,11 @@ bool AtrMemoryImage::ReadSector(unsigned int sector,uint8_t* buffer,unsigned int
 		ret = false;
 	}
 
-	memcpy(buffer, fData+offset, len);
+	if (fData) {
+		memcpy(buffer, fData+offset, len);
+	} else if (!ReadLazySector(sector, buffer, len)) {
+		ret = false;
+	}
 
 	return ret;
 }
@@ -937,6 +1093,10 @@ bool AtrMemoryImage::WriteSector(unsigned int sector, const uint8_t* buffer, uns
 		return false;
 	}
 
+	if (!fData) {
+		return WriteLazySector(sector, buffer, len);
+	}
+
 	SetChanged(true);
 	memcpy(fData+offset, buffer, len);
 
@@ -956,7 +1116,151 @@ void AtrMemoryImage::SetWriteProtect(bool on)
 	super::SetWriteProtect(on);
 }
 
-AtrMemoryImage::EImageType AtrMemoryImage::DetermineImageTypeFromFilename(const char* filename) const
+bool AtrMemoryImage::CreateLazyImage(ESectorLength density, unsigned int sectors,
+	const RCPtr<LazySectorSource>& source)
+{
+	FreeImageData();
+	SetChanged(true);
+	if (!SetFormat(density, sectors)) {
+		DPRINTF("SetFormat failed");
+		return false;
+	}
+	SetWriteProtect(false);
+	SetLazySource(source);
+	return true;
+}
+
+bool AtrMemoryImage::IsLazyImage() const
+{
+	return fLazySource.IsNotNull();
+}
+
+bool AtrMemoryImage::UseLazyDecoding(EImageType imageType) const
+{
+	switch (imageType) {
+	case eDcmImageType:
+	case eDiImageType:
+		return true;
+	case eAtrImageType:
+	case eXfdImageType:
+		return fLazyLoading;
+#ifdef USE_ZLIB
+	// the access point index of GZFileIO makes seeking cheap
+	case eDcmGzImageType:
+	case eDiGzImageType:
+		return true;
+	case eAtrGzImageType:
+	case eXfdGzImageType:
+		return fLazyLoading;
+#endif
+	default:
+		return false;
+	}
+}
+
+void AtrMemoryImage::SetLazySource(const RCPtr<LazySectorSource>& source)
+{
+	Assert(fData == 0);
+	fLazySource = source;
+	if (fSectorCache) {
+		delete fSectorCache;
+	}
+	fSectorCache = new SectorCache(GetNumberOfSectors(), GetSectorLength(GetNumberOfSectors()));
+	FreeWrittenSectors();
+	fWrittenSector.resize(GetNumberOfSectors() + 1, 0);
+}
+
+bool AtrMemoryImage::ReadLazySector(unsigned int sector, uint8_t* buffer, unsigned int len) const
+{
+	if (fLazySource.IsNull()) {
+		DPRINTF("no image data");
+		return false;
+	}
+	if (fWrittenSector[sector]) {
+		memcpy(buffer, fWrittenSector[sector], len);
+		return true;
+	}
+	const uint8_t* data = fSectorCache->Lookup(sector);
+	if (!data) {
+		uint8_t* slot = fSectorCache->Insert(sector);
+		if (!fLazySource->DecodeSector(sector, slot, GetSectorLength(sector))) {
+			fSectorCache->Remove(sector);
+			memset(buffer, 0, len);
+			return false;
+		}
+		data = slot;
+	}
+	memcpy(buffer, data, len);
+	return true;
+}
+
+bool AtrMemoryImage::WriteLazySector(unsigned int sector, const uint8_t* buffer, unsigned int len)
+{
+	if (fLazySource.IsNull()) {
+		DPRINTF("no image data");
+		return false;
+	}
+	if (!fWrittenSector[sector]) {
+		fWrittenSector[sector] = new uint8_t[len];
+		fSectorCache->Remove(sector);
+	}
+	SetChanged(true);
+	memcpy(fWrittenSector[sector], buffer, len);
+	return true;
+}
+
+void AtrMemoryImage::DiscardLazySector(unsigned int sector)
+{
+	if (fLazySource.IsNull() || sector == 0 || sector > GetNumberOfSectors()) {
+		return;
+	}
+	if (fWrittenSector[sector]) {
+		delete[] fWrittenSector[sector];
+		fWrittenSector[sector] = 0;
+	}
+	fSectorCache->Remove(sector);
+}
+
+bool AtrMemoryImage::DecodeLazyImage()
+{
+	if (fData || fLazySource.IsNull()) {
+		return true;
+	}
+
+	size_t imgSize = GetImageSize();
+	uint8_t* data = new uint8_t[imgSize];
+	memset(data, 0, imgSize);
+
+	unsigned int numSectors = GetNumberOfSectors();
+	for (unsigned int sector = 1; sector <= numSectors; sector++) {
+		unsigned int len = GetSectorLength(sector);
+		const uint8_t* cached = fWrittenSector[sector];
+		if (!cached) {
+			cached = fSectorCache->Lookup(sector);
+		}
+		if (cached) {
+			memcpy(data + CalculateOffset(sector), cached, len);
+		} else if (!fLazySource->DecodeSector(sector, data + CalculateOffset(sector), len)) {
+			AERROR("decoding sector %d of image failed", sector);
+			delete[] data;
+			return false;
+		}
+	}
+
+	fData = data;
+	fLazySource.SetToNull();
+	delete fSectorCache;
+	fSectorCache = 0;
+	FreeWrittenSectors();
+	return true;
+}
+
+bool AtrMemoryImage::IsImageFilename(const char* filename)
+{
+	return DetermineImageTypeFromFilename(filename) != eUnknownImageType;
+}
+
+AtrMemoryImage::EImageType AtrMemoryImage::DetermineImageTypeFromFilename(const char* filename)
 {
 	size_t len = strlen(filename);
 
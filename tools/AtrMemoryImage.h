@@ -21,7 +21,11 @@
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
+#include <vector>
+
 #include "AtrImage.h"
+#include "LazySectorSource.h"
+#include "SectorCache.h"
 
 class AtrMemoryImage : public AtrImage {
 public:
@@ -51,6 +55,29 @@ public:
 	virtual bool IsAtrMemoryImage() const;
 	virtual void SetWriteProtect(bool on);
 
+	// create an image whose sectors are read from source on demand.
+	// Written sectors are kept in memory.
+	bool CreateLazyImage(ESectorLength density, unsigned int sectors,
+		const RCPtr<LazySectorSource>& source);
+
+	// true if sectors are decoded on demand from the image file
+	bool IsLazyImage() const;
+
+	// also read ATR and XFD images on demand instead of loading the
+	// whole file. Meant for tools which only look at a few sectors.
+	void SetLazyLoading(bool on) { fLazyLoading = on; }
+
+	// true if filename has the extension of a supported image file.
+	// ReadImageFromFile puts other files into a new MyPicoDos image.
+	static bool IsImageFilename(const char* filename);
+
+	// decode all sectors into memory and close the image file
+	bool DecodeLazyImage();
+
+	// drop the written and cached data of a lazy sector so it's
+	// read from the source again, needed after the source remapped it
+	void DiscardLazySector(unsigned int sector);
+
 	friend class DCMCodec;
 
 protected:
@@ -69,7 +96,7 @@ private:
 		eUnknownImageType=99
 	};
 
-	EImageType DetermineImageTypeFromFilename(const char* filename) const;
+	static EImageType DetermineImageTypeFromFilename(const char* filename);
 
 	bool ReadImageFromAtrFile(const char* filename, bool beQuiet);
 	bool WriteImageToAtrFile(const char* filename, const bool useGz) const;
@@ -83,14 +110,31 @@ private:
 	bool ReadImageFromDiFile(const char* filename, bool beQuiet);
 	bool WriteImageToDiFile(const char* filename, const bool useGz) const;
 
-	uint8_t CalculateDiSectorChecksum(uint8_t* buf, unsigned int len) const;
+	static uint8_t CalculateDiSectorChecksum(const uint8_t* buf, unsigned int len);
 
 	bool SetSectorInUse(unsigned int sector, bool inUse);
 
+	// DCM and DI images (also gzipped) are decoded lazily
+	bool UseLazyDecoding(EImageType imageType) const;
+	void SetLazySource(const RCPtr<LazySectorSource>& source);
+	bool ReadLazySector(unsigned int sector, uint8_t* buffer, unsigned int len) const;
+	bool WriteLazySector(unsigned int sector, const uint8_t* buffer, unsigned int len);
+	void FreeWrittenSectors();
+
+	class DiSectorSource;
+	class FileSectorSource;
+
 	typedef AtrImage super;
 
 	uint8_t *fData;
 
+	RCPtr<LazySectorSource> fLazySource;
+	SectorCache* fSectorCache;
+	bool fLazyLoading;
+
+	// sectors written to a lazy image, indexed by sector number
+	std::vector<uint8_t*> fWrittenSector;
+
 };
 
 #endif
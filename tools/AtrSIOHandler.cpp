@@ -59,8 +59,6 @@
 #define SPEED_BYTE_70892 5
 #define SPEED_BYTE_76800 4
 
-uint8_t AtrSIOHandler::fBuffer[AtrSIOHandler::eBufferSize];
-
 AtrSIOHandler::AtrSIOHandler(const RCPtr<AtrImage>& image)
 	: fImage(image),
 	  fEnableHighSpeed(false),
@@ -79,6 +77,9 @@ AtrSIOHandler::AtrSIOHandler(const RCPtr<AtrImage>& image)
 //	  fSpeedByte(SPEED_BYTE_87771),
 //	  fHighSpeedBaudrate(87771),
 
+	  fCurrentSpeedByte(SPEED_BYTE_57600),
+	  fSpeedChangePending(false),
+	  fSpeedMonitor(new SIOTransferMonitor),
 	  fLastFDCStatus(0xff)
 {
 	if (fImage) {
@@ -92,7 +93,7 @@ AtrSIOHandler::~AtrSIOHandler()
 {
 }
 
-int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper)
+int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper, SIOScratchArena& scratch)
 {
 	int ret=0, ret2;
 	bool reset_baudrate = false;
@@ -104,9 +105,23 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 
 	fTracer->TraceCommandFrame(frame);
 
+	// temporary (sector-) buffer
+	uint8_t* buffer = scratch.Allocate(eBufferSize);
+	if (!buffer) {
+		if (wrapper->SendCommandNAK()) {
+			LOG_SIO_CMD_NAK_FAILED();
+		}
+		ret = AbstractSIOHandler::eScratchExhausted;
+		fTracer->TraceCommandError(ret);
+		return ret;
+	}
+
 	uint8_t myDriveNo = frame.device_id - 0x30;
 	bool hi_cmd = (frame.command & 0x80) == 0x80;
 
+	bool highspeed = hi_cmd ||
+		wrapper->GetCommandFrameBaudrate() != wrapper->GetStandardBaudrate();
+
 	switch (frame.command) {
 	case 0xd3:
 	case 0x53: {
@@ -143,32 +158,32 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 		case 0xd3: description = "[ get status XF551 ]"; break;
 		}
 
-		fBuffer[0] = 0x10; // motor on
+		buffer[0] = 0x10; // motor on
 		if (fFormatConfig.fSectorLength == e128BytesPerSector) {
 			if (fFormatConfig.fNumberOfSectors==1040) {
-				fBuffer[0] |= 0x80; /* enhanced density */
+				buffer[0] |= 0x80; /* enhanced density */
 			}
 		} else {
-			fBuffer[0] |= 0x20; /* double density */
+			buffer[0] |= 0x20; /* double density */
 			if (fFormatConfig.fNumberOfSectors == 1440) {
-				fBuffer[0] |= 0x40; /* XF551 QD sets both DD bit and bit 6 (?) */
+				buffer[0] |= 0x40; /* XF551 QD sets both DD bit and bit 6 (?) */
 			}
 		}
-		fBuffer[1] = fLastFDCStatus;
+		buffer[1] = fLastFDCStatus;
 		if (fEnableXF551Mode) {
-			fBuffer[2] = 0xfe;
+			buffer[2] = 0xfe;
 		} else {
-			fBuffer[2] = 0xe0;
+			buffer[2] = 0xe0;
 		}
-		fBuffer[3] = 0;
+		buffer[3] = 0;
 
 		if (fImage->IsWriteProtected()) {
-			fBuffer[0] |= 0x08;
+			buffer[0] |= 0x08;
 		}
 
 		fTracer->TraceCommandOK();
 		fTracer->TraceGetStatus(myDriveNo, hi_cmd);
-		fTracer->TraceDataBlock(fBuffer, buflen, description);
+		fTracer->TraceDataBlock(buffer, buflen, description);
 
 		if ((ret=wrapper->SendComplete())) {
 			LOG_SIO_COMPLETE_FAILED();
@@ -176,10 +191,10 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 		}
 
 		if (hi_cmd) {
-			ret = wrapper->SendDataFrameXF551(fBuffer, 4);
+			ret = wrapper->SendDataFrameXF551(buffer, 4);
 			reset_baudrate = false;
 		} else {
-			ret = wrapper->SendDataFrame(fBuffer, 4);
+			ret = wrapper->SendDataFrame(buffer, 4);
 		}
 		if (ret) {
 			LOG_SIO_SEND_DATA_FAILED();
@@ -236,13 +251,13 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 		case 0xd2: description = "[ read sector XF551 ]"; break;
 		}
 
-		if (!fImage->ReadSector(sec, fBuffer, buflen)) {
+		if (!fImage->ReadSector(sec, buffer, buflen)) {
 			fLastFDCStatus = 0xef; // record not found;
 			ret = AbstractSIOHandler::eImageError;
 
 			fTracer->TraceCommandError(ret);
 			fTracer->TraceReadSector(myDriveNo, sec, hi_cmd);
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 
 			if (wrapper->SendError()) {
 				LOG_SIO_ERROR_FAILED();
@@ -253,7 +268,7 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 
 			fTracer->TraceCommandOK();
 			fTracer->TraceReadSector(myDriveNo, sec, hi_cmd);
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 
 			if ((ret=wrapper->SendComplete())) {
 				LOG_SIO_COMPLETE_FAILED();
@@ -262,10 +277,10 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 		}
 
 		if (hi_cmd) {
-			ret2 = wrapper->SendDataFrameXF551(fBuffer, buflen);
+			ret2 = wrapper->SendDataFrameXF551(buffer, buflen);
 			reset_baudrate = false;
 		} else {
-			ret2 = wrapper->SendDataFrame(fBuffer, buflen);
+			ret2 = wrapper->SendDataFrame(buffer, buflen);
 		}
 		if (ret2) {
 			LOG_SIO_SEND_DATA_FAILED();
@@ -325,7 +340,7 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 		case 0xd7: description = "[ write sector XF551 ]"; break;
 		}
 
-		if ((ret=wrapper->ReceiveDataFrame(fBuffer, buflen))) {
+		if ((ret=wrapper->ReceiveDataFrame(buffer, buflen))) {
 			fTracer->TraceCommandError(ret);
 			LOG_SIO_RECEIVE_DATA_FAILED();
 			break;
@@ -343,7 +358,7 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 			} else {
 				fTracer->TraceWriteSectorVerify(myDriveNo, sec, hi_cmd);
 			}
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 
 			if (wrapper->SendError()) {
 				LOG_SIO_ERROR_FAILED();
@@ -354,7 +369,7 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 			if (fVirtualImageObserver) {
 				fVirtualImageObserver->IndicateBeforeSectorWrite(sec);
 			}
-			if (!fImage->WriteSector(sec, fBuffer, buflen)) {
+			if (!fImage->WriteSector(sec, buffer, buflen)) {
 				fLastFDCStatus = 0xb0; // write protected
 				ret = AbstractSIOHandler::eImageError;
 
@@ -364,7 +379,7 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 				} else {
 					fTracer->TraceWriteSectorVerify(myDriveNo, sec, hi_cmd);
 				}
-				fTracer->TraceDataBlock(fBuffer, buflen, description);
+				fTracer->TraceDataBlock(buffer, buflen, description);
 
 				if (wrapper->SendError()) {
 					LOG_SIO_ERROR_FAILED();
@@ -383,10 +398,10 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 				} else {
 					fTracer->TraceWriteSectorVerify(myDriveNo, sec, hi_cmd);
 				}
-				fTracer->TraceDataBlock(fBuffer, buflen, description);
+				fTracer->TraceDataBlock(buffer, buflen, description);
 
 				if (fVirtualImageObserver) {
-					fVirtualImageObserver->IndicateAfterSectorWrite(sec);
+					fVirtualImageObserver->IndicateAfterSectorWrite(sec, buffer);
 				}
 				if (hi_cmd) {
 					ret = wrapper->SendCompleteXF551();
@@ -438,31 +453,31 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 		case 0xce: description = "[ percom get XF551 ]"; break;
 		}
 
-		fBuffer[0] = fFormatConfig.fTracksPerSide;
-		fBuffer[1] = 0;
-		fBuffer[2] = fFormatConfig.fSectorsPerTrack >> 8;
-		fBuffer[3] = fFormatConfig.fSectorsPerTrack & 0xff;
+		buffer[0] = fFormatConfig.fTracksPerSide;
+		buffer[1] = 0;
+		buffer[2] = fFormatConfig.fSectorsPerTrack >> 8;
+		buffer[3] = fFormatConfig.fSectorsPerTrack & 0xff;
 		if (fFormatConfig.fSides) {
-			fBuffer[4] = fFormatConfig.fSides - 1;
+			buffer[4] = fFormatConfig.fSides - 1;
 		} else {
-			fBuffer[4] = 0;
+			buffer[4] = 0;
 		}
 		if (fFormatConfig.fDiskFormat == e90kDisk) {
-			fBuffer[5] = 0;
+			buffer[5] = 0;
 		} else {
-			fBuffer[5] = 4;
+			buffer[5] = 4;
 		}
 		seclen = fFormatConfig.GetSectorLength();
-		fBuffer[6] = seclen >> 8;
-		fBuffer[7] = seclen & 0xff;
-		fBuffer[8] = 1;
-		fBuffer[9] = 1;
-		fBuffer[10] = 0;
-		fBuffer[11] = 0;
+		buffer[6] = seclen >> 8;
+		buffer[7] = seclen & 0xff;
+		buffer[8] = 1;
+		buffer[9] = 1;
+		buffer[10] = 0;
+		buffer[11] = 0;
 
 		fTracer->TraceCommandOK();
-		fTracer->TraceDecodedPercomBlock(myDriveNo, fBuffer, true, hi_cmd);
-		fTracer->TraceDataBlock(fBuffer, buflen, description);
+		fTracer->TraceDecodedPercomBlock(myDriveNo, buffer, true, hi_cmd);
+		fTracer->TraceDataBlock(buffer, buflen, description);
 
 		if ((ret=wrapper->SendComplete())) {
 			LOG_SIO_COMPLETE_FAILED();
@@ -470,10 +485,10 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 		}
 
 		if (hi_cmd) {
-			ret = wrapper->SendDataFrameXF551(fBuffer, 12);
+			ret = wrapper->SendDataFrameXF551(buffer, 12);
 			reset_baudrate = false;
 		} else {
-			ret = wrapper->SendDataFrame(fBuffer, 12);
+			ret = wrapper->SendDataFrame(buffer, 12);
 		}
 		if (ret) {
 			LOG_SIO_SEND_DATA_FAILED();
@@ -516,7 +531,7 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 		case 0xcf: description = "[ percom put XF551 ]"; break;
 		}
 
-		if ((ret=wrapper->ReceiveDataFrame(fBuffer, 12)) ) {
+		if ((ret=wrapper->ReceiveDataFrame(buffer, 12)) ) {
 			fTracer->TraceCommandError(ret);
 			LOG_SIO_RECEIVE_DATA_FAILED();
 			break;
@@ -526,10 +541,10 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 		uint16_t sec, secLen;
 		uint32_t total;
 
-		tracks = fBuffer[0];
-		sec = fBuffer[3] + (fBuffer[2] << 8);
-		sides = fBuffer[4] + 1;
-		secLen = fBuffer[7] + (fBuffer[6]<<8);
+		tracks = buffer[0];
+		sec = buffer[3] + (buffer[2] << 8);
+		sides = buffer[4] + 1;
+		secLen = buffer[7] + (buffer[6]<<8);
 
 		total = tracks * sec * sides;
 		if (VerifyPercomFormat(tracks, sides, sec, secLen, total)) {
@@ -553,8 +568,8 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 			fFormatConfig.DetermineDiskFormatFromLayout();
 
 			fTracer->TraceCommandOK();
-			fTracer->TraceDecodedPercomBlock(myDriveNo, fBuffer, false, hi_cmd);
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDecodedPercomBlock(myDriveNo, buffer, false, hi_cmd);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 
 			if (hi_cmd) {
 				ret = wrapper->SendCompleteXF551();
@@ -571,8 +586,8 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 
 			fTracer->TraceCommandError(ret);
 			LOG_SIO_MISC("invalid config: %d sectors, %d bytes per sector",total,secLen);
-			fTracer->TraceDecodedPercomBlock(myDriveNo, fBuffer, false, hi_cmd);
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDecodedPercomBlock(myDriveNo, buffer, false, hi_cmd);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 
 			if (wrapper->SendError()) {
 				LOG_SIO_ERROR_FAILED();
@@ -680,11 +695,11 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 		if (fImage->IsWriteProtected() || IsVirtualImage() ) {
 			fLastFDCStatus = 0xbf; // write protected
 			ret = AbstractSIOHandler::eWriteProtected;
-			memset(fBuffer,0,buflen);
+			memset(buffer,0,buflen);
 
 			fTracer->TraceCommandError(ret);
 			fTracer->TraceFormatDisk(myDriveNo, hi_cmd);
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 
 			if (wrapper->SendError()) {
 				LOG_SIO_ERROR_FAILED();
@@ -699,11 +714,11 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 						fFormatConfig.fSides)) {
 				fLastFDCStatus = 0xbf; // write protected
 				ret = AbstractSIOHandler::eImageError;
-				memset(fBuffer,0,buflen);
+				memset(buffer,0,buflen);
 
 				fTracer->TraceCommandError(ret);
 				fTracer->TraceFormatDisk(myDriveNo, hi_cmd);
-				fTracer->TraceDataBlock(fBuffer, buflen, description);
+				fTracer->TraceDataBlock(buffer, buflen, description);
 
 				DPRINTF("create image failed [%d %d]",
 					fFormatConfig.fSectorLength, fFormatConfig.fNumberOfSectors);
@@ -715,7 +730,7 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 				fLastFDCStatus = 0xff;
 				fImageConfig = fImage->GetImageConfig();
 				fFormatConfig = fImageConfig;
-				memset(fBuffer,255,buflen);
+				memset(buffer,255,buflen);
 
 				if ((lastChanged == false) && fImage->Changed()) {
 					fTracer->IndicateDriveChanged(myDriveNo);
@@ -724,7 +739,7 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 
 				fTracer->TraceCommandOK();
 				fTracer->TraceFormatDisk(myDriveNo, hi_cmd);
-				fTracer->TraceDataBlock(fBuffer, buflen, description);
+				fTracer->TraceDataBlock(buffer, buflen, description);
 
 				if ((ret=wrapper->SendComplete())) {
 					LOG_SIO_COMPLETE_FAILED();
@@ -733,7 +748,7 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 			}
 		}
 
-		if ((ret2=wrapper->SendDataFrame(fBuffer, buflen))) {
+		if ((ret2=wrapper->SendDataFrame(buffer, buflen))) {
 			LOG_SIO_SEND_DATA_FAILED();
 			if (ret==0) ret=ret2;
 			break;
@@ -773,11 +788,11 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 		if ( fImage->IsWriteProtected() || IsVirtualImage() ) {
 			fLastFDCStatus = 0xbf; // write protected
 			ret = AbstractSIOHandler::eWriteProtected;
-			memset(fBuffer,0,128);
+			memset(buffer,0,128);
 
 			fTracer->TraceCommandError(ret);
 			fTracer->TraceFormatEnhanced(myDriveNo, hi_cmd);
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 
 			if (wrapper->SendError()) {
 				LOG_SIO_ERROR_FAILED();
@@ -789,11 +804,11 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 			if (!fImage->CreateImage(e130kDisk)) {
 				fLastFDCStatus = 0xbf; // write protected
 				ret = AbstractSIOHandler::eImageError;
-				memset(fBuffer,0,128);
+				memset(buffer,0,128);
 
 				fTracer->TraceCommandError(ret);
 				fTracer->TraceFormatEnhanced(myDriveNo, hi_cmd);
-				fTracer->TraceDataBlock(fBuffer, buflen, description);
+				fTracer->TraceDataBlock(buffer, buflen, description);
 
 				if (wrapper->SendError()) {
 					LOG_SIO_ERROR_FAILED();
@@ -803,7 +818,7 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 				fLastFDCStatus = 0xff;
 				fImageConfig = fImage->GetImageConfig();
 				fFormatConfig = fImageConfig;
-				memset(fBuffer,255,128);
+				memset(buffer,255,128);
 
 				if ((lastChanged == false) && fImage->Changed()) {
 					fTracer->IndicateDriveChanged(myDriveNo);
@@ -812,7 +827,7 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 
 				fTracer->TraceCommandOK();
 				fTracer->TraceFormatEnhanced(myDriveNo, hi_cmd);
-				fTracer->TraceDataBlock(fBuffer, buflen, description);
+				fTracer->TraceDataBlock(buffer, buflen, description);
 
 				if ((ret=wrapper->SendComplete())) {
 					LOG_SIO_COMPLETE_FAILED();
@@ -821,7 +836,7 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 			}
 		}
 
-		if ((ret2=wrapper->SendDataFrame(fBuffer, 128))) {
+		if ((ret2=wrapper->SendDataFrame(buffer, 128))) {
 			LOG_SIO_SEND_DATA_FAILED();
 			if (ret==0) ret=ret2;
 			break;
@@ -838,7 +853,19 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 			size_t buflen = 1;
 			const char* description = "[ get speed byte ]";
 
-			fBuffer[0] = fSpeedByte;
+			buffer[0] = fCurrentSpeedByte;
+
+			// the baudrate is shared by all drives, the drive
+			// queried last sets it
+			if (fCurrentSpeedByte == fSpeedByte) {
+				wrapper->SetHighSpeedBaudrate(fHighSpeedBaudrate);
+			} else {
+				wrapper->SetHighSpeedBaudrate(wrapper->GetBaudrateForPokeyDivisor(fCurrentSpeedByte));
+			}
+			if (fSpeedChangePending) {
+				fSpeedChangePending = false;
+				fSpeedMonitor->Reset();
+			}
 
 			if ((ret=wrapper->SendCommandACK())) {
 				fTracer->TraceCommandError(ret);
@@ -848,14 +875,14 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 
 			fTracer->TraceCommandOK();
 			fTracer->TraceGetSpeedByte(myDriveNo);
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 	
 			if ((ret=wrapper->SendComplete())) {
 				LOG_SIO_COMPLETE_FAILED();
 				break;
 			}
 
-			if ((ret=wrapper->SendDataFrame(fBuffer, 1))) {
+			if ((ret=wrapper->SendDataFrame(buffer, 1))) {
 				LOG_SIO_SEND_DATA_FAILED();
 				break;
 			}
@@ -886,19 +913,19 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 	
 			size_t codelen = HighSpeedSIOCode::GetInstance()->GetCodeSize();
 
-			fBuffer[0] = codelen & 0xff;
-			fBuffer[1] = codelen >> 8;
+			buffer[0] = codelen & 0xff;
+			buffer[1] = codelen >> 8;
 
 			fTracer->TraceCommandOK(),
 			fTracer->TraceGetSioCodeLength(myDriveNo);
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 
 			if ((ret=wrapper->SendComplete())) {
 				LOG_SIO_COMPLETE_FAILED();
 				break;
 			}
 
-			if ((ret=wrapper->SendDataFrame(fBuffer, 2))) {
+			if ((ret=wrapper->SendDataFrame(buffer, 2))) {
 				LOG_SIO_SEND_DATA_FAILED();
 				break;
 			}
@@ -935,18 +962,18 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 	
 			uint16_t relocadr = frame.aux1 + (frame.aux2<<8);
 
-			HighSpeedSIOCode::GetInstance()->RelocateCode(fBuffer, relocadr);
+			HighSpeedSIOCode::GetInstance()->RelocateCode(buffer, relocadr);
 
 			fTracer->TraceCommandOK();
 			fTracer->TraceGetSioCode(myDriveNo);
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 
 			if ((ret=wrapper->SendComplete())) {
 				LOG_SIO_COMPLETE_FAILED();
 				break;
 			}
 
-			if ((ret=wrapper->SendDataFrame(fBuffer, buflen))) {
+			if ((ret=wrapper->SendDataFrame(buffer, buflen))) {
 				LOG_SIO_SEND_DATA_FAILED();
 				break;
 			}
@@ -1018,12 +1045,12 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 		const char* description = "[ read MyPicoDos ]";
 		MyPicoDosCode* mypdos = MyPicoDosCode::GetInstance();
 
-		if (!mypdos->GetMyPicoDosSector(sec, fBuffer, buflen)) {
+		if (!mypdos->GetMyPicoDosSector(sec, buffer, buflen)) {
 			ret = AbstractSIOHandler::eImageError;
 
 			fTracer->TraceCommandError(ret);
 			fTracer->TraceReadMyPicoDos(myDriveNo, sec);
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 
 			if (wrapper->SendError()) {
 				LOG_SIO_ERROR_FAILED();
@@ -1032,7 +1059,7 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 		} else {
 			fTracer->TraceCommandOK();
 			fTracer->TraceReadMyPicoDos(myDriveNo, sec);
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 
 			if ((ret=wrapper->SendComplete())) {
 				LOG_SIO_COMPLETE_FAILED();
@@ -1040,7 +1067,7 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 			}
 		}
 
-		if ((ret2=wrapper->SendDataFrame(fBuffer, buflen))) {
+		if ((ret2=wrapper->SendDataFrame(buffer, buflen))) {
 			LOG_SIO_SEND_DATA_FAILED();
 			if (ret==0) ret=ret2;
 			break;
@@ -1075,23 +1102,23 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 			time(&current_time);
 			ltime = localtime(&current_time);
 
-			fBuffer[0] = ltime->tm_mday;
-			fBuffer[1] = ltime->tm_mon+1;
-			fBuffer[2] = ltime->tm_year % 100;
-			fBuffer[3] = ltime->tm_hour;
-			fBuffer[4] = ltime->tm_min;
-			fBuffer[5] = ltime->tm_sec;
+			buffer[0] = ltime->tm_mday;
+			buffer[1] = ltime->tm_mon+1;
+			buffer[2] = ltime->tm_year % 100;
+			buffer[3] = ltime->tm_hour;
+			buffer[4] = ltime->tm_min;
+			buffer[5] = ltime->tm_sec;
 
 			fTracer->TraceCommandOK();
 			fTracer->TraceApeSpecial(myDriveNo, shortdesc);
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 	
 			if ((ret=wrapper->SendComplete())) {
 				LOG_SIO_COMPLETE_FAILED();
 				break;
 			}
 
-			if ((ret=wrapper->SendDataFrame(fBuffer, buflen))) {
+			if ((ret=wrapper->SendDataFrame(buffer, buflen))) {
 				LOG_SIO_SEND_DATA_FAILED();
 				break;
 			}
@@ -1109,28 +1136,28 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 				break;
 			}
 
-			memset(fBuffer, 0, buflen);
+			memset(buffer, 0, buflen);
 			char* fn = MiscUtils::ShortenFilename(fImage->GetFilename(), buflen - 2);
 			if (fn) {
-				snprintf((char*)fBuffer, buflen-1, "%s", fn);
+				snprintf((char*)buffer, buflen-1, "%s", fn);
 				delete[] fn;
 			}
 			if (fImage->IsVirtualImage()) {
-				fBuffer[255] = 'M';
+				buffer[255] = 'M';
 			} else {
-				fBuffer[255] = 'A';
+				buffer[255] = 'A';
 			}
 
 			fTracer->TraceCommandOK();
 			fTracer->TraceApeSpecial(myDriveNo, shortdesc);
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 	
 			if ((ret=wrapper->SendComplete())) {
 				LOG_SIO_COMPLETE_FAILED();
 				break;
 			}
 
-			if ((ret=wrapper->SendDataFrame(fBuffer, buflen))) {
+			if ((ret=wrapper->SendDataFrame(buffer, buflen))) {
 				LOG_SIO_SEND_DATA_FAILED();
 				break;
 			}
@@ -1147,20 +1174,20 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 				break;
 			}
 
-			memset(fBuffer, 0, buflen);
-			snprintf((char*)fBuffer, buflen - 1, "AtariSIO for Linux" VERSION_STRING "\233"
+			memset(buffer, 0, buflen);
+			snprintf((char*)buffer, buflen - 1, "AtariSIO for Linux" VERSION_STRING "\233"
 					"(c) 2003-2008 Matthias Reichl\233");
 
 			fTracer->TraceCommandOK();
 			fTracer->TraceApeSpecial(myDriveNo, shortdesc);
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 	
 			if ((ret=wrapper->SendComplete())) {
 				LOG_SIO_COMPLETE_FAILED();
 				break;
 			}
 
-			if ((ret=wrapper->SendDataFrame(fBuffer, buflen))) {
+			if ((ret=wrapper->SendDataFrame(buffer, buflen))) {
 				LOG_SIO_SEND_DATA_FAILED();
 				break;
 			}
@@ -1215,14 +1242,14 @@ int AtrSIOHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIO
 			size_t buflen = 3;
 			const char* description = "[ add command ]";
 
-			if ((ret=wrapper->ReceiveDataFrame(fBuffer, buflen)) ) {
+			if ((ret=wrapper->ReceiveDataFrame(buffer, buflen)) ) {
 				fTracer->TraceCommandError(ret);
 				LOG_SIO_RECEIVE_DATA_FAILED();
 				break;
 			}
 
 			fTracer->TraceCommandOK();
-			fTracer->TraceDataBlock(fBuffer, buflen, description);
+			fTracer->TraceDataBlock(buffer, buflen, description);
 
 			if ((ret=wrapper->SendComplete()) ) {
 				LOG_SIO_COMPLETE_FAILED();
@@ -1254,6 +1281,14 @@ unsupported_command:
 		LOG_SIO_MISC("resetting baudrate");
 	}
 
+	if (fTransferMonitor) {
+		fTransferMonitor->Record(frame, highspeed, ret);
+	} else if (fEnableHighSpeed) {
+		// the calibration needs the configured speed
+		fSpeedMonitor->Record(frame, highspeed, ret);
+		AdaptSpeed(myDriveNo, wrapper);
+	}
+
 	return ret;
 }
 
@@ -1262,6 +1297,11 @@ bool AtrSIOHandler::IsAtrSIOHandler() const
 	return true;
 }
 
+void AtrSIOHandler::SetTransferMonitor(const RCPtr<SIOTransferMonitor>& monitor)
+{
+	fTransferMonitor = monitor;
+}
+
 bool AtrSIOHandler::EnableHighSpeed(bool on)
 {
 	fEnableHighSpeed = on;
@@ -1288,9 +1328,69 @@ bool AtrSIOHandler::SetHighSpeedParameters(unsigned int pokeyDivisor, unsigned i
 	}
 	fSpeedByte = pokeyDivisor;
 	fHighSpeedBaudrate = baudrate;
+	fCurrentSpeedByte = pokeyDivisor;
+	fSpeedChangePending = false;
+	fSpeedMonitor->Reset();
 	return true;
 }
 
+// candidates for stepping the speed, fastest first
+static const uint8_t speedSteps[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, SPEED_BYTE_38400 };
+
+uint8_t AtrSIOHandler::GetSlowerSpeedByte(uint8_t speedByte, const RCPtr<SIOWrapper>& wrapper) const
+{
+	for (unsigned int i = 0; i < sizeof(speedSteps); i++) {
+		if (speedSteps[i] > speedByte && wrapper->GetBaudrateForPokeyDivisor(speedSteps[i])) {
+			return speedSteps[i];
+		}
+	}
+	return speedByte;
+}
+
+uint8_t AtrSIOHandler::GetFasterSpeedByte(uint8_t speedByte, const RCPtr<SIOWrapper>& wrapper) const
+{
+	for (int i = sizeof(speedSteps) - 1; i >= 0; i--) {
+		if (speedSteps[i] < speedByte && speedSteps[i] > fSpeedByte
+			&& wrapper->GetBaudrateForPokeyDivisor(speedSteps[i])) {
+			return speedSteps[i];
+		}
+	}
+	// never faster than configured
+	return fSpeedByte;
+}
+
+void AtrSIOHandler::AdaptSpeed(uint8_t driveNo, const RCPtr<SIOWrapper>& wrapper)
+{
+	// a change takes effect when the Atari queries the speed byte
+	// again, which high speed code does after an error. Until then
+	// the Atari still uses the old speed.
+	if (fSpeedChangePending) {
+		fSpeedMonitor->Reset();
+		return;
+	}
+
+	unsigned int errors = fSpeedMonitor->GetErrors();
+	unsigned int transfers = fSpeedMonitor->GetTransfers();
+
+	if (errors >= eMinSpeedErrors && errors * eSpeedErrorRatio > transfers) {
+		uint8_t slower = GetSlowerSpeedByte(fCurrentSpeedByte, wrapper);
+		if (slower != fCurrentSpeedByte) {
+			ALOG("D%d: %d high speed errors in %d transfers, reducing speed to pokey divisor %d",
+				driveNo, errors, transfers, slower);
+			fCurrentSpeedByte = slower;
+			fSpeedChangePending = true;
+		}
+		fSpeedMonitor->Reset();
+	} else if (fCurrentSpeedByte != fSpeedByte
+		&& fSpeedMonitor->GetCleanTransfers() >= eSpeedProbeTransfers) {
+		fCurrentSpeedByte = GetFasterSpeedByte(fCurrentSpeedByte, wrapper);
+		fSpeedChangePending = true;
+		ALOG("D%d: %d clean high speed transfers, trying pokey divisor %d",
+			driveNo, fSpeedMonitor->GetCleanTransfers(), fCurrentSpeedByte);
+		fSpeedMonitor->Reset();
+	}
+}
+
 bool AtrSIOHandler::EnableStrictFormatChecking(bool on)
 {
 	fStrictFormatChecking = on;
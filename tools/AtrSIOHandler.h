@@ -26,6 +26,7 @@
 #include "AbstractSIOHandler.h"
 #include "AtrImage.h"
 #include "SIOTracer.h"
+#include "SIOTransferMonitor.h"
 #include "VirtualImageObserver.h"
 
 class AtrSIOHandler : public AbstractSIOHandler {
@@ -36,7 +37,7 @@ public:
 	 * image in the destructor!
 	 */
 	virtual ~AtrSIOHandler();
-	virtual int ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper);
+	virtual int ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper, SIOScratchArena& scratch);
 
 	virtual bool IsAtrSIOHandler() const;
 
@@ -44,6 +45,7 @@ public:
 	virtual bool SetHighSpeedParameters(unsigned int pokeyDivisor, unsigned int baudrate);
 	virtual bool EnableXF551Mode(bool on);
 	virtual bool EnableStrictFormatChecking(bool on);
+	virtual void SetTransferMonitor(const RCPtr<SIOTransferMonitor>& monitor);
 
 	virtual RCPtr<DiskImage> GetDiskImage();
 	virtual RCPtr<const DiskImage> GetConstDiskImage() const;
@@ -53,6 +55,7 @@ public:
 
 	inline void SetVirtualImageObserver(RCPtr<VirtualImageObserver> observer);
 	inline RCPtr<const VirtualImageObserver> GetVirtualImageObserver() const;
+	inline RCPtr<VirtualImageObserver> GetVirtualImageObserver();
 
 private:
 	RCPtr<AtrImage> fImage;
@@ -72,19 +75,40 @@ private:
 	uint8_t fSpeedByte;
 	unsigned int fHighSpeedBaudrate;
 
+	// pokey divisor reported to the Atari, slower than fSpeedByte
+	// after too many high speed errors on this drive
+	uint8_t fCurrentSpeedByte;
+	// the Atari didn't query the changed speed byte yet
+	bool fSpeedChangePending;
+	RCPtr<SIOTransferMonitor> fSpeedMonitor;
+
 	uint8_t fLastFDCStatus;
 
 	SIOTracer* fTracer;
 
 	RCPtr<VirtualImageObserver> fVirtualImageObserver;
+	RCPtr<SIOTransferMonitor> fTransferMonitor;
 
 	inline bool IsVirtualImage() const;
 
+	// step fCurrentSpeedByte down after errors and back up
+	// after a run of clean transfers
+	void AdaptSpeed(uint8_t driveNo, const RCPtr<SIOWrapper>& wrapper);
+	uint8_t GetSlowerSpeedByte(uint8_t speedByte, const RCPtr<SIOWrapper>& wrapper) const;
+	uint8_t GetFasterSpeedByte(uint8_t speedByte, const RCPtr<SIOWrapper>& wrapper) const;
+
 	bool VerifyPercomFormat(uint8_t tracks, uint8_t sides, uint16_t sectors, uint16_t seclen, uint32_t total_sectors) const;
 
-	// static temporary (sector-) buffer, for all instances
+	// size of the temporary (sector-) buffer taken from the scratch arena
 	enum { eBufferSize = 8192 };
-	static uint8_t fBuffer[eBufferSize];
+
+	enum {
+		// slow down if more than 1 in eSpeedErrorRatio transfers fail
+		eSpeedErrorRatio = 20,
+		eMinSpeedErrors = 3,
+		// clean transfers before trying the next faster speed
+		eSpeedProbeTransfers = 256
+	};
 };
 
 inline RCPtr<DiskImage> AtrSIOHandler::GetDiskImage()
@@ -117,6 +141,11 @@ inline RCPtr<const VirtualImageObserver> AtrSIOHandler::GetVirtualImageObserver(
 	return fVirtualImageObserver;
 }
 
+inline RCPtr<VirtualImageObserver> AtrSIOHandler::GetVirtualImageObserver()
+{
+	return fVirtualImageObserver;
+}
+
 inline bool AtrSIOHandler::IsVirtualImage() const
 {
 	return fVirtualImageObserver.IsNotNull();
@@ -0,0 +1,186 @@
+/*
+   BackgroundImageLoader.cpp - load disk images without blocking SIO
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "BackgroundImageLoader.h"
+#include "DeviceManager.h"
+#include "MiscUtils.h"
+#include "AtariDebug.h"
+
+BackgroundImageLoader::BackgroundImageLoader(DeviceManager* manager)
+	: fDeviceManager(manager),
+	  fThreadRunning(false),
+	  fGeneration(DeviceManager::eMaxDriveNumber + 1, 0),
+	  fStop(false)
+{
+	pthread_mutex_init(&fMutex, NULL);
+	pthread_cond_init(&fCond, NULL);
+	fEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+BackgroundImageLoader::~BackgroundImageLoader()
+{
+	if (fThreadRunning) {
+		pthread_mutex_lock(&fMutex);
+		fStop = true;
+		pthread_cond_broadcast(&fCond);
+		pthread_mutex_unlock(&fMutex);
+		pthread_join(fThread, NULL);
+	}
+	if (fEventFd >= 0) {
+		close(fEventFd);
+	}
+	pthread_cond_destroy(&fCond);
+	pthread_mutex_destroy(&fMutex);
+}
+
+int BackgroundImageLoader::GetFileDescriptor() const
+{
+	return fEventFd;
+}
+
+bool BackgroundImageLoader::Load(int driveno, const char* filename)
+{
+	if (fEventFd < 0 || driveno < 0 || driveno >= (int) fGeneration.size()) {
+		return false;
+	}
+	if (!fThreadRunning) {
+		// the worker is started on first use and lives until the
+		// loader is destroyed
+		if (!MiscUtils::create_normal_priority_thread(fThread, ThreadFunc, this)) {
+			DPRINTF("cannot create image loader thread");
+			return false;
+		}
+		fThreadRunning = true;
+	}
+
+	Cancel(driveno);
+
+	Request req;
+	req.fDriveNo = driveno;
+	req.fFilename = filename;
+	req.fNoImage = false;
+
+	pthread_mutex_lock(&fMutex);
+	req.fGeneration = fGeneration[driveno];
+	fRequests.push_back(req);
+	pthread_cond_broadcast(&fCond);
+	pthread_mutex_unlock(&fMutex);
+	return true;
+}
+
+void BackgroundImageLoader::Cancel(int driveno)
+{
+	if (driveno < 0 || driveno >= (int) fGeneration.size()) {
+		return;
+	}
+	pthread_mutex_lock(&fMutex);
+	fGeneration[driveno]++;
+	for (unsigned int i = 0; i < fRequests.size(); ) {
+		if (fRequests[i].fDriveNo == driveno) {
+			fRequests.erase(fRequests.begin() + i);
+		} else {
+			i++;
+		}
+	}
+	pthread_mutex_unlock(&fMutex);
+}
+
+void* BackgroundImageLoader::ThreadFunc(void* arg)
+{
+	static_cast<BackgroundImageLoader*>(arg)->LoadImages();
+	return NULL;
+}
+
+void BackgroundImageLoader::Notify()
+{
+	uint64_t one = 1;
+	if (write(fEventFd, &one, sizeof(one)) != sizeof(one)) {
+		// counter is already non-zero, nothing to do
+	}
+}
+
+void BackgroundImageLoader::LoadImages()
+{
+	pthread_mutex_lock(&fMutex);
+	while (!fStop) {
+		if (fRequests.empty()) {
+			pthread_cond_wait(&fCond, &fMutex);
+			continue;
+		}
+		Request req = fRequests.front();
+		fRequests.erase(fRequests.begin());
+		pthread_mutex_unlock(&fMutex);
+
+		// errors are reported when the result is published,
+		// the tracer must only be used from the SIO thread
+		if (DeviceManager::IsDiskImageFilename(req.fFilename.c_str())) {
+			req.fImage = DeviceManager::LoadDiskImage(req.fFilename.c_str(), true);
+		} else {
+			req.fNoImage = true;
+		}
+
+		pthread_mutex_lock(&fMutex);
+		if (req.fGeneration == fGeneration[req.fDriveNo]) {
+			fResults.push_back(req);
+			Notify();
+		}
+	}
+	pthread_mutex_unlock(&fMutex);
+}
+
+bool BackgroundImageLoader::ProcessPollEvent()
+{
+	uint64_t count;
+	if (read(fEventFd, &count, sizeof(count)) != sizeof(count)) {
+		return false;
+	}
+
+	std::vector<Request> results;
+	pthread_mutex_lock(&fMutex);
+	for (unsigned int i = 0; i < fResults.size(); i++) {
+		if (fResults[i].fGeneration == fGeneration[fResults[i].fDriveNo]) {
+			results.push_back(fResults[i]);
+		}
+	}
+	fResults.clear();
+	pthread_mutex_unlock(&fMutex);
+
+	bool published = false;
+	for (unsigned int i = 0; i < results.size(); i++) {
+		DeviceManager::EDriveNumber driveno = DeviceManager::EDriveNumber(results[i].fDriveNo);
+		if (results[i].fNoImage) {
+			AERROR("loading \"%s\" into D%d: failed - not a disk image", results[i].fFilename.c_str(), driveno);
+			continue;
+		}
+		if (results[i].fImage.IsNull()) {
+			AERROR("loading \"%s\" into D%d: failed", results[i].fFilename.c_str(), driveno);
+			continue;
+		}
+		if (fDeviceManager->InstallDiskImage(driveno, results[i].fImage)) {
+			ALOG("loaded D%d: from \"%s\"", driveno, results[i].fImage->GetFilename());
+			published = true;
+		}
+	}
+	return published;
+}
@@ -0,0 +1,94 @@
+#ifndef BACKGROUNDIMAGELOADER_H
+#define BACKGROUNDIMAGELOADER_H
+
+/*
+   BackgroundImageLoader.h - load disk images without blocking SIO
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#include "AbstractPollHandler.h"
+#include "DiskImage.h"
+#include "RCPtr.h"
+
+class DeviceManager;
+
+// Reads disk images in a worker thread while the SIO loop keeps
+// serving the old image. Loaded images are staged and published in
+// ProcessPollEvent, ie between two command frames in the thread that
+// runs DoServing, by replacing the drive's handler in one step. The
+// drive is never empty during the swap and the old handler is released
+// after its last command completed.
+// Only image files are loaded in the background: putting other files
+// into a MyPicoDos image reports errors from deep down, and only the
+// SIO thread may use the tracer.
+
+class BackgroundImageLoader : public AbstractPollHandler {
+public:
+	BackgroundImageLoader(DeviceManager* manager);
+	virtual ~BackgroundImageLoader();
+
+	// queue loading filename into driveno. A newer request for the
+	// same drive replaces an older one.
+	bool Load(int driveno, const char* filename);
+
+	// drop pending and staged images for driveno, eg because the
+	// drive was changed directly
+	void Cancel(int driveno);
+
+	virtual int GetFileDescriptor() const;
+
+	// returns true if an image was published
+	virtual bool ProcessPollEvent();
+
+private:
+	struct Request {
+		int fDriveNo;
+		unsigned int fGeneration;
+		std::string fFilename;
+		RCPtr<DiskImage> fImage;
+		// set if the file isn't an image and wasn't read
+		bool fNoImage;
+	};
+
+	static void* ThreadFunc(void* arg);
+	void LoadImages();
+
+	void Notify();
+
+	DeviceManager* fDeviceManager;
+
+	int fEventFd;
+	pthread_t fThread;
+	bool fThreadRunning;
+
+	// everything below is protected by fMutex
+	pthread_mutex_t fMutex;
+	pthread_cond_t fCond;
+
+	std::vector<Request> fRequests;
+	std::vector<Request> fResults;
+	// requests and results with an older generation are dropped
+	std::vector<unsigned int> fGeneration;
+	bool fStop;
+};
+
+#endif
@@ -19,127 +19,187 @@
 */
 
 #include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 
 #include "ChunkReader.h"
 #include "AtariDebug.h"
 #include "Crc32.h"
 
-ChunkReader::ChunkReader(RCPtr<FileIO>& f, off_t start, off_t end, const char* name)
-	: fFile(f),
-	  fChunkStart(start),
-	  fChunkEnd(end),
+ChunkReader::FileData::FileData()
+	: fData(0),
+	  fLength(0),
+	  fIsMapped(false)
+{
+}
+
+ChunkReader::FileData::~FileData()
+{
+	if (fIsMapped) {
+		munmap(fData, fLength);
+	} else {
+		free(fData);
+	}
+}
+
+bool ChunkReader::FileData::Map(const char* filename)
+{
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat statbuf;
+	uint8_t magic[2];
+	// compressed files have to go through GZFileIO
+	if (fstat(fd, &statbuf) != 0 || !S_ISREG(statbuf.st_mode) || statbuf.st_size == 0
+	    || pread(fd, magic, 2, 0) != 2 || (magic[0] == 0x1f && magic[1] == 0x8b)) {
+		close(fd);
+		return false;
+	}
+	void* data = mmap(0, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+	fData = (uint8_t*) data;
+	fLength = statbuf.st_size;
+	fIsMapped = true;
+	return true;
+}
+
+bool ChunkReader::FileData::Load(const RCPtr<FileIO>& f)
+{
+	size_t size = 0x10000;
+	uint8_t* buf = (uint8_t*) malloc(size);
+	size_t len = 0;
+	unsigned int count;
+
+	if (!buf) {
+		return false;
+	}
+	while ((count = f->ReadBlock(buf + len, size - len)) > 0) {
+		len += count;
+		if (len == size) {
+			uint8_t* newbuf = (uint8_t*) realloc(buf, size * 2);
+			if (!newbuf) {
+				free(buf);
+				return false;
+			}
+			buf = newbuf;
+			size *= 2;
+		}
+	}
+	fData = buf;
+	fLength = len;
+	fIsMapped = false;
+	return true;
+}
+
+ChunkReader::ChunkReader(const RCPtr<FileData>& data, const uint8_t* start, size_t length, const char* name)
+	: fFileData(data),
+	  fChunkData(start),
+	  fChunkLength(length),
 	  fCurrentPosition(0)
 {
 	if (name) {
-		fName=new char[5];
 		memcpy(fName, name, 4);
 		fName[4] = 0;
+		fHasName = true;
 	} else {
-		fName = 0;
+		fName[0] = 0;
+		fHasName = false;
 	}
 }
 
 ChunkReader::~ChunkReader()
 {
-	if (fName) {
-		delete[] fName;
+}
+
+RCPtr<ChunkReader> ChunkReader::OpenChunkFile(const char* filename)
+{
+	RCPtr<FileData> data = new FileData;
+	if (!data->Map(filename)) {
+		RCPtr<FileIO> f;
+#ifdef USE_ZLIB
+		f = new GZFileIO();
+#else
+		f = new StdFileIO();
+#endif
+		if (!f->OpenRead(filename)) {
+			return RCPtr<ChunkReader>();
+		}
+		bool ok = data->Load(f);
+		f->Close();
+		if (!ok) {
+			return RCPtr<ChunkReader>();
+		}
 	}
+	return new ChunkReader(data, data->GetData(), data->GetLength());
 }
 
 RCPtr<ChunkReader> ChunkReader::OpenChunkFile(RCPtr<FileIO>& f)
 {
-	off_t currentPos = f->Tell();
-	off_t endPos = f->GetFileLength();
-
-	return new ChunkReader(f, currentPos, endPos);
+	RCPtr<FileData> data = new FileData;
+	if (!data->Load(f)) {
+		return RCPtr<ChunkReader>();
+	}
+	return new ChunkReader(data, data->GetData(), data->GetLength());
 }
 
 RCPtr<ChunkReader> ChunkReader::OpenChunk()
 {
-	if (fChunkStart + fCurrentPosition + 8 > fChunkEnd) {
+	if (!HasData(8)) {
 		return RCPtr<ChunkReader>();
 	}
 
+	const char* name = (const char*) fChunkData + fCurrentPosition;
+	fCurrentPosition += 4;
 	uint32_t chunklen;
-	char name[4];
-
-	SeekToCurrentPos();
+	ReadDword(chunklen);
 
-	if (fFile->ReadBlock(name, 4) != 4) {
-		return RCPtr<ChunkReader>();
-	}
-	if (!fFile->ReadDWord(chunklen)) {
-		return RCPtr<ChunkReader>();
-	}
-
-	if (fChunkStart+fCurrentPosition+8+(off_t)chunklen > fChunkEnd) {
+	if (!HasData(chunklen)) {
+		fCurrentPosition -= 8;
 		return RCPtr<ChunkReader>();
 	}
 
 	RCPtr<ChunkReader> chunk(new ChunkReader(
-		fFile,
-		fChunkStart+fCurrentPosition+8,
-		fChunkStart+fCurrentPosition+8+chunklen,
+		fFileData,
+		fChunkData + fCurrentPosition,
+		chunklen,
 		name)
 	);
-	fCurrentPosition = fCurrentPosition+8+chunklen;
+	fCurrentPosition += chunklen;
 	return chunk;
 }
 
-bool ChunkReader::ReadByte(uint8_t& byte)
-{
-	SeekToCurrentPos();
-
-	if (fChunkStart+fCurrentPosition+1 <= fChunkEnd) {
-		if (fFile->ReadBlock(&byte, 1) == 1) {
-			fCurrentPosition++;
-			return true;
-		}
-	}
-	return false;
-}
-
-bool ChunkReader::ReadWord(uint16_t& word)
-{
-	SeekToCurrentPos();
-	if (fChunkStart+fCurrentPosition+2 <= fChunkEnd) {
-		if (fFile->ReadWord(word)) {
-			fCurrentPosition+=2;
-			return true;
-		}
-	}
-	return false;
-}
-
-bool ChunkReader::ReadDword(uint32_t &dword)
+bool ChunkReader::ReadBlock(void* buf, unsigned int len)
 {
-	SeekToCurrentPos();
-	if (fChunkStart+fCurrentPosition+4 <= fChunkEnd) {
-		if (fFile->ReadDWord(dword)) {
-			fCurrentPosition+=4;
-			return true;
-		}
+	const uint8_t* data = GetBlock(len);
+	if (!data) {
+		return false;
 	}
-	return false;
+	memcpy(buf, data, len);
+	return true;
 }
 
-bool ChunkReader::ReadBlock(void* buf, unsigned int len)
+const uint8_t* ChunkReader::GetBlock(unsigned int len)
 {
-	SeekToCurrentPos();
-	if (fChunkStart+fCurrentPosition+(off_t)len <= fChunkEnd) {
-		if (fFile->ReadBlock(buf, len) == len) {
-			fCurrentPosition+=len;
-			return true;
-		}
+	if (!HasData(len)) {
+		return 0;
 	}
-	return false;
+	const uint8_t* data = fChunkData + fCurrentPosition;
+	fCurrentPosition += len;
+	return data;
 }
 
 uint32_t ChunkReader::CalculateCRC32() const
 {
 	uint32_t crc;
 
-	if (!CalculateCRC32(crc, 0, fChunkEnd-fChunkStart)) {
+	if (!CalculateCRC32(crc, 0, fChunkLength)) {
 		DPRINTF("internal error calculating CRC32!");
 		return 0;
 	}
@@ -148,41 +208,14 @@ uint32_t ChunkReader::CalculateCRC32() const
 
 bool ChunkReader::CalculateCRC32(uint32_t& checksum, off_t start_pos, off_t end_pos) const
 {
-	if (start_pos > end_pos) {
+	if (start_pos < 0 || start_pos > end_pos) {
 		return false;
 	}
-	if (fChunkStart+start_pos > fChunkEnd) {
-		return false;
-	}
-	if (fChunkStart+end_pos > fChunkEnd) {
+	if ((size_t)end_pos > fChunkLength) {
 		return false;
 	}
 
 	uint32_t crc = CRC32::CalcCRC32(0, NULL, 0);
-
-	size_t total_len = end_pos - start_pos;
-	size_t len;
-
-	fFile->Seek(fChunkStart + start_pos);
-
-	uint8_t tmp_buf[1024];
-
-	while (total_len) {
-		if (total_len > 1024) {
-			len = 1024;
-		} else {
-			len = total_len;
-		}
-
-		if (fFile->ReadBlock(tmp_buf, len) != len) {
-			return false;
-		}
-
-		crc = CRC32::CalcCRC32(crc, tmp_buf, len);
-
-		total_len -= len;
-	}
-	checksum = crc;
+	checksum = CRC32::CalcCRC32(crc, (void*) (fChunkData + start_pos), end_pos - start_pos);
 	return true;
 }
-
@@ -22,14 +22,22 @@
 */
 
 #include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
 #include "RefCounted.h"
 #include "RCPtr.h"
 #include "FileIO.h"
 
-class ChunkReader;
+// The whole file is mapped (or, for compressed files, read) into
+// memory once. Sub-chunks are views into this memory, so reading
+// fields doesn't need any further file access.
 
 class ChunkReader : public RefCounted {
 public:
+	// map the file into memory, gzip compressed files are decompressed
+	static RCPtr<ChunkReader> OpenChunkFile(const char* filename);
+
+	// read the file from the current position to the end into memory
 	static RCPtr<ChunkReader> OpenChunkFile(RCPtr<FileIO>& f);
 
 	// open sub-chunk at current position and move
@@ -40,42 +48,66 @@ public:
 	inline off_t GetChunkLength() const;
 	inline off_t GetCurrentPosition() const;
 
-	bool ReadByte(uint8_t& byte);
-	bool ReadWord(uint16_t& word);
-	bool ReadDword(uint32_t &dword);
+	// little endian values
+	inline bool ReadByte(uint8_t& byte);
+	inline bool ReadWord(uint16_t& word);
+	inline bool ReadDword(uint32_t &dword);
 	bool ReadBlock(void* buf, unsigned int len);
 
+	// returns a pointer to the next len bytes of the chunk and
+	// advances the current position, NULL if the chunk is too short.
+	// The data is valid as long as a reader of this file exists.
+	const uint8_t* GetBlock(unsigned int len);
+
 	uint32_t CalculateCRC32() const;
 	bool CalculateCRC32(uint32_t &checksum, off_t start_pos, off_t end_pos) const;
 
 private:
-	ChunkReader(RCPtr<FileIO>& f,
-		off_t start,
-		off_t end,
+	class FileData : public RefCounted {
+	public:
+		FileData();
+		virtual ~FileData();
+
+		bool Map(const char* filename);
+		bool Load(const RCPtr<FileIO>& f);
+
+		inline const uint8_t* GetData() const { return fData; }
+		inline size_t GetLength() const { return fLength; }
+
+	private:
+		uint8_t* fData;
+		size_t fLength;
+		bool fIsMapped;
+	};
+
+	ChunkReader(const RCPtr<FileData>& data,
+		const uint8_t* start,
+		size_t length,
 		const char* name=0);
 
 	virtual ~ChunkReader();
 
-	inline void SeekToCurrentPos() const;
+	inline bool HasData(size_t len) const;
 
 private:
-	RCPtr<FileIO> fFile;
+	RCPtr<FileData> fFileData;
 
-	off_t fChunkStart; // absolute file position (included)
-	off_t fChunkEnd; // absolute file position (not included)
-	off_t fCurrentPosition; // relative position within this chunk
+	const uint8_t* fChunkData;
+	size_t fChunkLength;
+	size_t fCurrentPosition; // relative position within this chunk
 
-	char *fName;
+	char fName[5];
+	bool fHasName;
 };
 
 inline const char* ChunkReader::GetChunkName() const
 {
-	return fName;
+	return fHasName ? fName : 0;
 }
 
 inline off_t ChunkReader::GetChunkLength() const
 {
-	return fChunkEnd-fChunkStart;
+	return fChunkLength;
 }
 
 inline off_t ChunkReader::GetCurrentPosition() const
@@ -83,9 +115,40 @@ inline off_t ChunkReader::GetCurrentPosition() const
 	return fCurrentPosition;
 }
 
-inline void ChunkReader::SeekToCurrentPos() const
+inline bool ChunkReader::HasData(size_t len) const
+{
+	return len <= fChunkLength - fCurrentPosition;
+}
+
+inline bool ChunkReader::ReadByte(uint8_t& byte)
+{
+	if (!HasData(1)) {
+		return false;
+	}
+	byte = fChunkData[fCurrentPosition++];
+	return true;
+}
+
+inline bool ChunkReader::ReadWord(uint16_t& word)
+{
+	if (!HasData(2)) {
+		return false;
+	}
+	const uint8_t* p = fChunkData + fCurrentPosition;
+	word = p[0] | (p[1] << 8);
+	fCurrentPosition += 2;
+	return true;
+}
+
+inline bool ChunkReader::ReadDword(uint32_t &dword)
 {
-	fFile->Seek(fChunkStart + fCurrentPosition);
+	if (!HasData(4)) {
+		return false;
+	}
+	const uint8_t* p = fChunkData + fCurrentPosition;
+	dword = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+	fCurrentPosition += 4;
+	return true;
 }
 
 #endif
@@ -24,47 +24,109 @@
 #include "Crc32.h"
 
 ChunkWriter::ChunkWriter(const char* chunkName)
-	: fIsOpen(true)
+	: fIsOpen(true),
+	  fFailed(false),
+	  fLastChunkStart(0),
+	  fLastChunkEnd(0)
 {
-	unsigned int i,len;
-
 	fAllocatedSize = 16;
 	fData =(uint8_t*) malloc(fAllocatedSize);
+	if (fData == NULL) {
+		fAllocatedSize = 0;
+		fFailed = true;
+	} else {
+		SetName(0, chunkName);
+		SetLength(0, 0);
+	}
+
+	fSize = 8;
+}
+
+ChunkWriter::~ChunkWriter()
+{
+	if (fData) {
+		free(fData);
+	}
+}
+
+void ChunkWriter::SetName(size_t pos, const char* chunkName)
+{
+	unsigned int i,len;
 
 	len = strlen(chunkName);
 	if (len > 4) {
 		len = 4;
 	}
 	for (i=0;i<len;i++) {
-		fData[i] = chunkName[i];
+		fData[pos+i] = chunkName[i];
 	}
 	for (i=len;i<4;i++) {
-		fData[i] = ' ';
+		fData[pos+i] = ' ';
 	}
-	for (i=4;i<8;i++) {
-		fData[i] = 0;
+}
+
+void ChunkWriter::SetLength(size_t pos, size_t length)
+{
+	fData[pos+4] = length & 0xff;
+	fData[pos+5] = ( length >>8 ) & 0xff;
+	fData[pos+6] = ( length >>16 ) & 0xff;
+	fData[pos+7] = ( length >>24 ) & 0xff;
+}
+
+bool ChunkWriter::Resize(size_t size)
+{
+	uint8_t* data = (uint8_t*) realloc(fData, size);
+	if (data == NULL) {
+		// keep the old buffer, it's freed in the destructor
+		fFailed = true;
+		return false;
 	}
+	fData = data;
+	fAllocatedSize = size;
+	return true;
+}
 
-	fSize = 8;
+bool ChunkWriter::Reserve(size_t size)
+{
+	if (size > fAllocatedSize) {
+		return Resize(size);
+	}
+	return true;
 }
 
-ChunkWriter::~ChunkWriter()
+bool ChunkWriter::BeginChunk(const char* chunkName)
 {
-	if (fData) {
-		free(fData);
+	if (fIsOpen && PrepareForSize(fSize+8)) {
+		SetName(fSize, chunkName);
+		SetLength(fSize, 0);
+		fOpenChunks.push_back(fSize);
+		fSize += 8;
+		return true;
+	} else {
+		return false;
+	}
+}
+
+bool ChunkWriter::EndChunk()
+{
+	if (fIsOpen && !fOpenChunks.empty()) {
+		size_t start = fOpenChunks.back();
+		fOpenChunks.pop_back();
+		SetLength(start, fSize-start-8);
+		fLastChunkStart = start;
+		fLastChunkEnd = fSize;
+		return true;
+	} else {
+		return false;
 	}
 }
 
 bool ChunkWriter::CloseChunk()
 {
-	if (fIsOpen) {
-		fData[4] = (fSize-8) & 0xff;
-		fData[5] = ( (fSize-8) >>8 ) & 0xff;
-		fData[6] = ( (fSize-8) >>16 ) & 0xff;
-		fData[7] = ( (fSize-8) >>24 ) & 0xff;
-		if (fSize != fAllocatedSize) {
-			fAllocatedSize = fSize;
-			fData = (uint8_t*) realloc(fData, fAllocatedSize);
+	if (fIsOpen && !fFailed && fOpenChunks.empty()) {
+		SetLength(0, fSize-8);
+		if (fSize != fAllocatedSize && !Resize(fSize)) {
+			return false;
 		}
 		fIsOpen = false;
 		return true;
@@ -75,8 +137,7 @@ bool ChunkWriter::CloseChunk()
 
 bool ChunkWriter::AppendByte(uint8_t byte)
 {
-	if (fIsOpen) {
-		PrepareForSize(fSize+1);
+	if (fIsOpen && PrepareForSize(fSize+1)) {
 		fData[fSize++] = byte;
 		return true;
 	} else {
@@ -86,8 +147,7 @@ bool ChunkWriter::AppendByte(uint8_t byte)
 
 bool ChunkWriter::AppendWord(uint16_t word)
 {
-	if (fIsOpen) {
-		PrepareForSize(fSize+2);
+	if (fIsOpen && PrepareForSize(fSize+2)) {
 		fData[fSize++] = word & 0xff;
 		fData[fSize++] = (word>>8) & 0xff;
 		return true;
@@ -98,8 +158,7 @@ bool ChunkWriter::AppendWord(uint16_t word)
 
 bool ChunkWriter::AppendDword(uint32_t dword)
 {
-	if (fIsOpen) {
-		PrepareForSize(fSize+4);
+	if (fIsOpen && PrepareForSize(fSize+4)) {
 		fData[fSize++] = dword & 0xff;
 		fData[fSize++] = (dword>>8) & 0xff;
 		fData[fSize++] = (dword>>16) & 0xff;
@@ -112,8 +171,7 @@ bool ChunkWriter::AppendDword(uint32_t dword)
 
 bool ChunkWriter::AppendBlock(const void* data, unsigned int len)
 {
-	if (fIsOpen) {
-		PrepareForSize(fSize+len);
+	if (fIsOpen && PrepareForSize(fSize+len)) {
 		memcpy(fData+fSize, data, len);
 		fSize+=len;
 		return true;
@@ -124,8 +182,7 @@ bool ChunkWriter::AppendBlock(const void* data, unsigned int len)
 
 bool ChunkWriter::AppendChunk(const RCPtr<ChunkWriter>& chunk)
 {
-	if (fIsOpen && !chunk->fIsOpen) {
-		PrepareForSize(fSize+chunk->fSize);
+	if (fIsOpen && !chunk->fIsOpen && PrepareForSize(fSize+chunk->fSize)) {
 		memcpy(fData+fSize, chunk->fData, chunk->fSize);
 		fSize+=chunk->fSize;
 		return true;
@@ -141,9 +198,18 @@ uint32_t ChunkWriter::CalculateCRC32() const
 	return crc;
 }
 
+uint32_t ChunkWriter::CalculateLastChunkCRC32() const
+{
+	uint32_t crc = CRC32::CalcCRC32(0L, NULL, 0);
+	if (fLastChunkEnd) {
+		crc = CRC32::CalcCRC32(crc, fData+fLastChunkStart+8, fLastChunkEnd-fLastChunkStart-8);
+	}
+	return crc;
+}
+
 bool ChunkWriter::WriteToFile(RCPtr<FileIO>& f) const
 {
-	if (!fIsOpen) {
+	if (!fIsOpen && !fFailed) {
 		if (f->WriteBlock(fData, fSize) == fSize) {
 			return true;
 		}
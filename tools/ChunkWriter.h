@@ -23,6 +23,8 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <vector>
 
 #include "RefCounted.h"
 #include "RCPtr.h"
@@ -47,8 +49,15 @@ public:
 	bool AppendBlock(const void* data, unsigned int len);
 	bool AppendChunk(const RCPtr<ChunkWriter>& chunk);
 
+	// start a sub-chunk which is written directly into the buffer
+	// of this chunk, the length field is filled in by EndChunk.
+	// Sub-chunks can be nested, all data is appended to the
+	// innermost open sub-chunk.
+	bool BeginChunk(const char* chunkName);
+	bool EndChunk();
+
 	// set the length field of the chunk and free any
-	// unused memory.
+	// unused memory. Fails if memory allocation failed before.
 	// Note: after closing a chunk, no further data may be appended
 	// to it!
 	bool CloseChunk();
@@ -56,24 +65,42 @@ public:
 	// calculates checksum of the data part of this chunk
 	uint32_t CalculateCRC32() const;
 
+	// calculates checksum of the data part of the sub-chunk
+	// that was ended last
+	uint32_t CalculateLastChunkCRC32() const;
+
+	// reserve memory for the expected size of the chunk
+	bool Reserve(size_t size);
+
 	bool WriteToFile(RCPtr<FileIO>& f) const;
 
 private:
-	inline void PrepareForSize(size_t size);
+	inline bool PrepareForSize(size_t size);
+	bool Resize(size_t size);
+
+	void SetName(size_t pos, const char* chunkName);
+	void SetLength(size_t pos, size_t length);
 
 	bool fIsOpen;
+	// set when growing the buffer failed, the chunk can't be written
+	bool fFailed;
 	size_t fAllocatedSize;
 	size_t fSize;
 
+	// start offsets of the open sub-chunks
+	std::vector<size_t> fOpenChunks;
+	size_t fLastChunkStart;
+	size_t fLastChunkEnd;
+
 	uint8_t* fData;
 };
 
-inline void ChunkWriter::PrepareForSize(size_t size)
+inline bool ChunkWriter::PrepareForSize(size_t size)
 {
 	if (size > fAllocatedSize) {
-		fAllocatedSize = (size) * 2;
-		fData = (uint8_t*) realloc(fData, fAllocatedSize);
+		return Resize(size * 2);
 	}
+	return true;
 }
 
 #endif
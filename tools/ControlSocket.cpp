@@ -0,0 +1,298 @@
+/*
+   ControlSocket.cpp - control atariserver from the host via a UNIX socket
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+#include "ControlSocket.h"
+#include "DeviceManager.h"
+#include "Error.h"
+#include "AtariDebug.h"
+
+ControlSocket::ControlSocket(DeviceManager* manager, CursesFrontend* frontend, const char* path)
+	: fPath(path),
+	  fEpollFd(-1),
+	  fListenFd(-1)
+{
+	// a separate instance so the result buffer of the Atari isn't
+	// touched by host commands
+	fRemoteControl = new RemoteControlHandler(manager, frontend);
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (fPath.empty() || fPath.size() >= sizeof(addr.sun_path)) {
+		throw ErrorObject("invalid control socket path");
+	}
+	strcpy(addr.sun_path, path);
+
+	// remove a stale socket left over by a previous run
+	struct stat statbuf;
+	if (lstat(path, &statbuf) == 0 && S_ISSOCK(statbuf.st_mode)) {
+		unlink(path);
+	}
+
+	fListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fListenFd < 0) {
+		throw ErrorObject("cannot create control socket");
+	}
+	if (bind(fListenFd, (struct sockaddr*) &addr, sizeof(addr)) || listen(fListenFd, eMaxClients)) {
+		close(fListenFd);
+		throw ErrorObject("cannot bind control socket to " + fPath);
+	}
+
+	fEpollFd = epoll_create1(EPOLL_CLOEXEC);
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fListenFd;
+	if (fEpollFd < 0 || epoll_ctl(fEpollFd, EPOLL_CTL_ADD, fListenFd, &ev)) {
+		if (fEpollFd >= 0) {
+			close(fEpollFd);
+		}
+		close(fListenFd);
+		unlink(path);
+		throw ErrorObject("cannot poll control socket");
+	}
+}
+
+ControlSocket::~ControlSocket()
+{
+	while (fClients.size()) {
+		CloseClient(fClients.size() - 1);
+	}
+	close(fEpollFd);
+	close(fListenFd);
+	unlink(fPath.c_str());
+}
+
+int ControlSocket::GetFileDescriptor() const
+{
+	return fEpollFd;
+}
+
+bool ControlSocket::ProcessPollEvent()
+{
+	enum { eMaxEvents = 8 };
+	struct epoll_event ev[eMaxEvents];
+
+	int num = epoll_wait(fEpollFd, ev, eMaxEvents, 0);
+	for (int e = 0; e < num; e++) {
+		if (ev[e].data.fd == fListenFd) {
+			AcceptClient();
+			continue;
+		}
+		for (unsigned int i = 0; i < fClients.size(); i++) {
+			if (fClients[i].fFd == ev[e].data.fd) {
+				bool ok = true;
+				if (ev[e].events & EPOLLOUT) {
+					ok = FlushClient(fClients[i]);
+				}
+				if (ok && !fClients[i].fInputClosed && (ev[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+					ok = ReadClient(fClients[i]);
+				}
+				if (!ok) {
+					CloseClient(i);
+				}
+				break;
+			}
+		}
+	}
+	return false;
+}
+
+void ControlSocket::AcceptClient()
+{
+	int fd = accept4(fListenFd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+	if (fd < 0) {
+		return;
+	}
+	if (fClients.size() >= eMaxClients) {
+		AWARN("control socket: too many connections");
+		close(fd);
+		return;
+	}
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	if (epoll_ctl(fEpollFd, EPOLL_CTL_ADD, fd, &ev)) {
+		close(fd);
+		return;
+	}
+
+	Client client;
+	client.fFd = fd;
+	client.fInBatch = false;
+	client.fInputClosed = false;
+	client.fEvents = EPOLLIN;
+	fClients.push_back(client);
+}
+
+void ControlSocket::CloseClient(unsigned int idx)
+{
+	epoll_ctl(fEpollFd, EPOLL_CTL_DEL, fClients[idx].fFd, NULL);
+	close(fClients[idx].fFd);
+	fClients.erase(fClients.begin() + idx);
+}
+
+bool ControlSocket::ReadClient(Client& client)
+{
+	char buf[1024];
+	ssize_t len = recv(client.fFd, buf, sizeof(buf), MSG_DONTWAIT);
+	if (len < 0) {
+		return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+	}
+	if (len == 0) {
+		// deliver the pending replies before closing
+		client.fInputClosed = true;
+		return FlushClient(client);
+	}
+	client.fInput.append(buf, len);
+
+	std::string::size_type pos;
+	while ((pos = client.fInput.find('\n')) != std::string::npos) {
+		std::string line(client.fInput, 0, pos);
+		client.fInput.erase(0, pos + 1);
+		if (line.size() && line[line.size() - 1] == '\r') {
+			line.resize(line.size() - 1);
+		}
+		if (!ProcessLine(client, line)) {
+			return false;
+		}
+	}
+	if (client.fInput.size() > eMaxLineLength) {
+		AWARN("control socket: line too long");
+		return false;
+	}
+	return true;
+}
+
+bool ControlSocket::ProcessLine(Client& client, const std::string& line)
+{
+	std::vector<std::string> result;
+
+	if (line.empty()) {
+		return true;
+	}
+	if (line == "begin") {
+		if (client.fInBatch) {
+			result.push_back("nested begin");
+			return SendReply(client, false, result);
+		}
+		client.fInBatch = true;
+		client.fBatch.clear();
+		return true;
+	}
+	if (client.fInBatch) {
+		if (line != "end") {
+			if (client.fBatch.size() + line.size() >= eMaxBatchLength) {
+				AWARN("control socket: batch too long");
+				return false;
+			}
+			client.fBatch += line;
+			client.fBatch += '\0';
+			return true;
+		}
+		client.fInBatch = false;
+		bool ok = fRemoteControl->ProcessHostCommands(client.fBatch.data(), client.fBatch.size(), result);
+		client.fBatch.clear();
+		return SendReply(client, ok, result);
+	}
+	if (line == "end") {
+		result.push_back("end without begin");
+		return SendReply(client, false, result);
+	}
+
+	bool ok = fRemoteControl->ProcessHostCommands(line.c_str(), line.size(), result);
+	return SendReply(client, ok, result);
+}
+
+bool ControlSocket::SendReply(Client& client, bool ok, const std::vector<std::string>& lines)
+{
+	char header[32];
+	snprintf(header, sizeof(header), "%s %u\n", ok ? "ok" : "error", (unsigned int) lines.size());
+
+	std::string reply(header);
+	for (unsigned int i = 0; i < lines.size(); i++) {
+		reply += lines[i];
+		reply += '\n';
+	}
+
+	client.fOutput += reply;
+	if (client.fOutput.size() > eMaxOutputLength) {
+		AWARN("control socket: client doesn't read replies");
+		return false;
+	}
+	return FlushClient(client);
+}
+
+bool ControlSocket::FlushClient(Client& client)
+{
+	size_t sent = 0;
+	while (sent < client.fOutput.size()) {
+		ssize_t len = send(client.fFd, client.fOutput.data() + sent,
+			client.fOutput.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (len < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				break;
+			}
+			AWARN("control socket: sending reply failed");
+			return false;
+		}
+		sent += len;
+	}
+	client.fOutput.erase(0, sent);
+
+	if (client.fInputClosed && client.fOutput.empty()) {
+		return false;
+	}
+
+	// only wait for EPOLLOUT while there's something left to send
+	uint32_t events = 0;
+	if (!client.fInputClosed) {
+		events |= EPOLLIN;
+	}
+	if (!client.fOutput.empty()) {
+		events |= EPOLLOUT;
+	}
+	if (events != client.fEvents) {
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = events;
+		ev.data.fd = client.fFd;
+		if (epoll_ctl(fEpollFd, EPOLL_CTL_MOD, client.fFd, &ev)) {
+			return false;
+		}
+		client.fEvents = events;
+	}
+	return true;
+}
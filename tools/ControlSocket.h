@@ -0,0 +1,100 @@
+#ifndef CONTROLSOCKET_H
+#define CONTROLSOCKET_H
+
+/*
+   ControlSocket.h - control atariserver from the host via a UNIX socket
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "AbstractPollHandler.h"
+#include "RemoteControlHandler.h"
+
+class DeviceManager;
+class CursesFrontend;
+
+// Accepts the remote control commands ("lo", "un", "xc", "st", ...)
+// from host programs. Each line sent by a client is one command,
+// commands between a "begin" and an "end" line are executed as one
+// batch which stops at the first failed command. Every command
+// (or batch) gets one reply:
+//
+// ok|error <number of lines>
+// <result lines>
+//
+// The listening socket and all connections are combined in one epoll
+// descriptor, so commands are processed between SIO commands from
+// the same poll set as the serial device. Connections never block:
+// replies are queued per client and sent when the socket is writable,
+// a client which doesn't read its replies is dropped.
+
+class ControlSocket : public AbstractPollHandler {
+public:
+	// throws ErrorObject if the socket can't be created
+	ControlSocket(DeviceManager* manager, CursesFrontend* frontend, const char* path);
+	virtual ~ControlSocket();
+
+	virtual int GetFileDescriptor() const;
+	virtual bool ProcessPollEvent();
+
+private:
+	enum {
+		eMaxClients = 16,
+		eMaxLineLength = 4096,
+		eMaxBatchLength = 0x10000,
+		eMaxOutputLength = 0x40000
+	};
+
+	struct Client {
+		int fFd;
+		std::string fInput;
+		bool fInBatch;
+		std::string fBatch;
+		// queued reply data, sent even after the client shut down
+		// its side of the connection
+		std::string fOutput;
+		bool fInputClosed;
+		uint32_t fEvents;
+	};
+
+	void AcceptClient();
+
+	// returns false if the connection was closed
+	bool ReadClient(Client& client);
+	bool ProcessLine(Client& client, const std::string& line);
+	bool SendReply(Client& client, bool ok, const std::vector<std::string>& lines);
+
+	// send as much queued output as possible without blocking,
+	// returns false if the connection failed or is finished
+	bool FlushClient(Client& client);
+
+	void CloseClient(unsigned int idx);
+
+	RCPtr<RemoteControlHandler> fRemoteControl;
+
+	std::string fPath;
+	int fEpollFd;
+	int fListenFd;
+
+	std::vector<Client> fClients;
+};
+
+#endif
@@ -82,6 +82,8 @@ Coprocess::Coprocess(const char* command, int* close_fds, int close_count)
 		if (!MiscUtils::drop_realtime_scheduling()) {
 			_exit(1);
 		}
+		// own process group so the whole command can be killed
+		setpgid(0, 0);
 		if (write_fd[0] != STDIN_FILENO) {
 			dup2(write_fd[0], STDIN_FILENO);
 		}
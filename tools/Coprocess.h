@@ -35,6 +35,8 @@ public:
 	bool Close();
 	void SetKillTimer(int timeout); // 0 to disable timer
 	bool Exit(int* exitstat = NULL);
+	// the child is the leader of its own process group
+	inline pid_t GetPid() const { return fChildPid; }
 private:
 	bool CheckGotLine(char* buf, int maxlen, int& len);
 	void SetBlockingRead(bool block);
@@ -18,6 +18,8 @@
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
+#include <stdio.h>
+
 #include "Crc32.h"
 
 static unsigned long* crc32_table=0;
@@ -57,3 +59,23 @@ unsigned long CRC32::CalcCRC32(unsigned long oldCRC, void *buf, unsigned int len
 
 	return crc;
 }
+
+bool CRC32::CalcFileCRC32(const char* filename, uint32_t& crc, unsigned int& length)
+{
+	FILE* f = fopen(filename, "rb");
+	if (!f) {
+		return false;
+	}
+	uint8_t buf[4096];
+	size_t len;
+	unsigned long c = 0;
+	length = 0;
+	while ((len = fread(buf, 1, sizeof(buf), f)) > 0) {
+		c = CalcCRC32(c, buf, len);
+		length += len;
+	}
+	bool ok = !ferror(f);
+	fclose(f);
+	crc = c;
+	return ok;
+}
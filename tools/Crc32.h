@@ -28,6 +28,9 @@ namespace CRC32 {
 
 	unsigned long CalcCRC32(unsigned long oldCRC, void *buf, unsigned int len);
 
+	// CRC32 and length of the contents of a file
+	bool CalcFileCRC32(const char* filename, uint32_t& crc, unsigned int& length);
+
 }
 
 #endif
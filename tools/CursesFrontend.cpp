@@ -1156,7 +1156,7 @@ void CursesFrontend::PrintLogLine(const char* format, ...)
 	fFirstLogLine = false;
 }
 
-int CursesFrontend::GetCh(bool ignoreResize)
+int CursesFrontend::GetCh(bool ignoreResize, bool returnPollEvents)
 {
 	int ret;
 	int ch;
@@ -1166,6 +1166,9 @@ int CursesFrontend::GetCh(bool ignoreResize)
 		if (ret == 1 && GotSigWinCh() && !ignoreResize ) {
 			ch = KEY_RESIZE;
 			break;
+		} else if (ret == 2 && returnPollEvents) {
+			ch = ePollEventKey;
+			break;
 		} else if (ret == 0) {
 			ch = wgetch(fInputLineWindow);
 			if (ch == KEY_RESIZE) {
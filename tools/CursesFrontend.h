@@ -90,7 +90,9 @@ public:
 	// update screen buffers
 	void UpdateScreen();
 
-	int GetCh(bool ignoreResize);
+	// if returnPollEvents is set ePollEventKey is returned when a
+	// poll handler (eg a DirectoryScanner) has new data
+	int GetCh(bool ignoreResize, bool returnPollEvents = false);
 
 	void SetTraceLevel(int level);
 
@@ -143,6 +145,7 @@ public:
 	unsigned int GetScreenHeight() { return fScreenHeight; }
 
 	enum { eVirtualDriveKey = 22 }; // control-V
+	enum { ePollEventKey = KEY_MAX + 1 };
 
 	inline void SetAskBeforeQuit(bool flag)
 	{
@@ -158,6 +161,7 @@ private:
 	friend class FileSelect;
 	void ShowHint(const char* string);
 	RCPtr<DirectoryCache>& GetDirectoryCache() { return fDirCache; }
+	RCPtr<DeviceManager>& GetDeviceManager() { return fDeviceManager; }
 
 	attr_t GetAuxColorStandard() { return fAuxColorStandard; }
 	attr_t GetAuxColorSelected() { return fAuxColorSelected; }
@@ -32,23 +32,56 @@
 #define DDPRINTF(x...) do { } while(0)
 
 DCMCodec::DCMCodec(const RCPtr<FileIO>& ioclass, const RCPtr<AtrMemoryImage>& img)
-	: fFileIO(ioclass),
+	: fIndexOnly(false),
+	  fRecordsSinceAnchor(0),
+	  fLastDecodedRecord(-1),
+	  fNumberOfSectors(0),
+	  fFileIO(ioclass),
 	  fAtrMemoryImage(img)
 {
 }
 
 DCMCodec::~DCMCodec()
 {
+	// file is kept open after LoadIndex
+	if (fFileIO->IsOpen()) {
+		fFileIO->Close();
+	}
 }
 
 bool DCMCodec::Load( const char* filename, bool beQuiet)
+{
+	fIndexOnly = false;
+	return DoLoad(filename, beQuiet);
+}
+
+bool DCMCodec::LoadIndex( const char* filename, bool beQuiet)
+{
+	fIndexOnly = true;
+	fRecords.clear();
+	fCheckpoints.clear();
+	fSectorRecord.clear();
+	fRecordsSinceAnchor = 0;
+	fLastDecodedRecord = -1;
+
+	if (!DoLoad(filename, beQuiet)) {
+		return false;
+	}
+	// the image holds a reference to us, don't create a cycle
+	fAtrMemoryImage.SetToNull();
+	return true;
+}
+
+bool DCMCodec::DoLoad( const char* filename, bool beQuiet)
 {
 	uint8_t	btArcType = 0;		//Block type for first block
 	uint8_t	btBlkType;		//Current block type
+	off_t	recordOffset;
 
 	fAlreadyFormatted = false;
 	fLastPassFlag = false;
 	fCurrentSector = 0;
+	memset( fCurrentBuffer, 0, sizeof(fCurrentBuffer) );
 
 	if (! fFileIO->OpenRead(filename)) {
 		if (!beQuiet) {
@@ -108,6 +141,8 @@ bool DCMCodec::Load( const char* filename, bool beQuiet)
 				break;
 			}
 
+			recordOffset = fFileIO->Tell();
+
 			if ( fFileIO->Tell() >= fFileLength )
 			{
 				goto failure_EOF;
@@ -173,9 +208,13 @@ bool DCMCodec::Load( const char* filename, bool beQuiet)
 				goto failure;
 			}
 
-			unsigned int len = fAtrMemoryImage->GetSectorLength(fCurrentSector);
+			if (fIndexOnly) {
+				bRes = AddIndexRecord(btBlkType & 0x7F, recordOffset);
+			} else {
+				unsigned int len = fAtrMemoryImage->GetSectorLength(fCurrentSector);
 
-			bRes = fAtrMemoryImage->WriteSector(fCurrentSector, fCurrentBuffer, len);
+				bRes = fAtrMemoryImage->WriteSector(fCurrentSector, fCurrentBuffer, len);
+			}
 
 			if (!bRes) {
 				if (!beQuiet) {
@@ -204,7 +243,9 @@ bool DCMCodec::Load( const char* filename, bool beQuiet)
 
 	} //infinite for (outpass)
 
-	fFileIO->Close();
+	if (!fIndexOnly) {
+		fFileIO->Close();
+	}
 	return true;
 
 failure_EOF:
@@ -417,13 +458,24 @@ bool DCMCodec::DecodeRecFA(bool beQuiet)
 
 	if ( !fAlreadyFormatted )
 	{
-		if (!fAtrMemoryImage->CreateImage(dformat)) {
+		bool formatOK;
+		if (fIndexOnly) {
+			// don't allocate image data, just set the format
+			formatOK = fAtrMemoryImage->SetFormat(dformat);
+		} else {
+			formatOK = fAtrMemoryImage->CreateImage(dformat);
+		}
+		if (!formatOK) {
 			if (!beQuiet) {
 				DPRINTF("DCM: cannot format memory image!");
 			}
 			return false;
 		}
 		fSectorSize = fAtrMemoryImage->GetSectorLength();
+		fNumberOfSectors = fAtrMemoryImage->GetNumberOfSectors();
+		if (fIndexOnly) {
+			fSectorRecord.assign(fNumberOfSectors + 1, -1);
+		}
 
 		fAlreadyFormatted = true;
 	}
@@ -441,6 +493,137 @@ failure_EOF:
 
 }
 
+bool DCMCodec::IsFullRecord(uint8_t type) const
+{
+	switch (type) {
+	case eDCM_COMPRESSED:
+	case eDCM_UNCOMPRESSED:
+		return true;
+	case eDCM_DOS_SECTOR:
+		// only sets the first 128 bytes
+		return fSectorSize == 128;
+	default:
+		return false;
+	}
+}
+
+bool DCMCodec::AddIndexRecord(uint8_t type, off_t offset)
+{
+	if (fCurrentSector == 0 || fCurrentSector > fNumberOfSectors) {
+		return false;
+	}
+
+	RecordInfo rec;
+	rec.fOffset = offset;
+	rec.fType = type;
+	rec.fCheckpoint = -1;
+
+	// records which only modify the previous sector data need the
+	// preceding records to be decoded. Store a copy of the decoded
+	// data from time to time to keep that chain short.
+	if (IsFullRecord(type)) {
+		fRecordsSinceAnchor = 0;
+	} else if (++fRecordsSinceAnchor >= eCheckpointDistance) {
+		rec.fCheckpoint = fCheckpoints.size() / fSectorSize;
+		fCheckpoints.insert(fCheckpoints.end(), fCurrentBuffer, fCurrentBuffer + fSectorSize);
+		fRecordsSinceAnchor = 0;
+	}
+
+	fSectorRecord[fCurrentSector] = fRecords.size();
+	fRecords.push_back(rec);
+	return true;
+}
+
+bool DCMCodec::DecodeRecord(unsigned int record)
+{
+	if ((int)record == fLastDecodedRecord) {
+		return true;
+	}
+
+	// search backwards for a record we can start decoding from
+	unsigned int first = record;
+	while (true) {
+		if ((int)first == fLastDecodedRecord) {
+			first++;
+			break;
+		}
+		const RecordInfo& rec = fRecords[first];
+		if (rec.fCheckpoint >= 0) {
+			memcpy(fCurrentBuffer, &fCheckpoints[rec.fCheckpoint * fSectorSize], fSectorSize);
+			first++;
+			break;
+		}
+		if (IsFullRecord(rec.fType)) {
+			break;
+		}
+		if (first == 0) {
+			memset(fCurrentBuffer, 0, sizeof(fCurrentBuffer));
+			break;
+		}
+		first--;
+	}
+
+	fLastDecodedRecord = -1;
+
+	for (unsigned int i = first; i <= record; i++) {
+		const RecordInfo& rec = fRecords[i];
+		if (!fFileIO->Seek(rec.fOffset)) {
+			AERROR("DCM: seek error");
+			return false;
+		}
+		bool bRes = true;
+		switch (rec.fType) {
+		case eDCM_CHANGE_BEGIN:
+			bRes = DecodeRec41(false);
+			break;
+		case eDCM_DOS_SECTOR:
+			bRes = DecodeRec42(false);
+			break;
+		case eDCM_COMPRESSED:
+			bRes = DecodeRec43(false);
+			break;
+		case eDCM_CHANGE_END:
+			bRes = DecodeRec44(false);
+			break;
+		case eDCM_SAME_AS_BEFORE:
+			break;
+		case eDCM_UNCOMPRESSED:
+			bRes = DecodeRec47(false);
+			break;
+		default:
+			Assert(false);
+			bRes = false;
+			break;
+		}
+		if (!bRes) {
+			return false;
+		}
+	}
+
+	fLastDecodedRecord = record;
+	return true;
+}
+
+bool DCMCodec::DecodeSector(unsigned int sector, uint8_t* buffer, unsigned int len)
+{
+	if (sector == 0 || sector >= fSectorRecord.size() || len > fSectorSize) {
+		DPRINTF("DCM: illegal sector %d in DecodeSector", sector);
+		return false;
+	}
+	int record = fSectorRecord[sector];
+	if (record < 0) {
+		// sector not stored in the DCM file
+		memset(buffer, 0, len);
+		return true;
+	}
+	if (!DecodeRecord(record)) {
+		memset(buffer, 0, len);
+		return false;
+	}
+	memcpy(buffer, fCurrentBuffer, len);
+	return true;
+}
+
 bool DCMCodec::ReadOffset( unsigned int& off, bool beQuiet )
 {
 	uint8_t bt;
@@ -25,18 +25,27 @@
 */
 
 #include <stdio.h>
+#include <vector>
 
 #include "AtrMemoryImage.h"
 #include "FileIO.h"
+#include "LazySectorSource.h"
 
-class DCMCodec
+class DCMCodec : public LazySectorSource
 {
 public:
 	DCMCodec(const RCPtr<FileIO>& ioclass, const RCPtr<AtrMemoryImage>& img);
-	~DCMCodec();
+	virtual ~DCMCodec();
 
 	bool Load( const char* filename, bool beQuiet);
 
+	// Only build an index of the sector records and keep the file
+	// open, sectors are decoded on demand by DecodeSector.
+	// After a successful call the codec no longer references the image.
+	bool LoadIndex( const char* filename, bool beQuiet);
+
+	virtual bool DecodeSector(unsigned int sector, uint8_t* buffer, unsigned int len);
+
 	bool Save( const char* filename);
 
 private:
@@ -66,6 +75,21 @@ private:
 	bool DecodeRec47(bool beQuiet);
 	bool DecodeRecFA(bool beQuiet);
 
+	bool DoLoad( const char* filename, bool beQuiet);
+
+	// lazy decoding
+	struct RecordInfo {
+		off_t fOffset;		// file position after the record type
+		uint8_t fType;
+		int fCheckpoint;	// index into fCheckpoints or -1
+	};
+
+	enum { eCheckpointDistance = 16 };
+
+	bool IsFullRecord(uint8_t type) const;
+	bool AddIndexRecord(uint8_t type, off_t offset);
+	bool DecodeRecord(unsigned int record);
+
 	bool ReadOffset(unsigned int& off, bool beQuiet);
 
 	void EncodeRec41( uint8_t*, int*, uint8_t*, uint8_t*, int );
@@ -89,6 +113,14 @@ private:
 	uint8_t* fPassBuffer;
 	uint8_t* fLastRec;
 
+	bool	fIndexOnly;
+	std::vector<RecordInfo> fRecords;
+	std::vector<int> fSectorRecord;
+	std::vector<uint8_t> fCheckpoints;
+	unsigned int fRecordsSinceAnchor;
+	int fLastDecodedRecord;
+	unsigned int fNumberOfSectors;
+
 	RCPtr<FileIO> fFileIO;
 	RCPtr<AtrMemoryImage> fAtrMemoryImage;
 };
@@ -40,12 +40,17 @@
 #include "Dos2xUtils.h"
 #include "AtrSearchPath.h"
 #include "MyPicoDosCode.h"
+#include "VirtualDriveWatcher.h"
+#include "BackgroundImageLoader.h"
+#include "SpeedCalibration.h"
+#include "SpeedProfile.h"
 
 #include "AtariDebug.h"
 
 DeviceManager::DeviceManager(const char* devname)
         : fUseStrictFormatChecking(false),
-	  fTapeSpeedPercent(100)
+	  fTapeSpeedPercent(100),
+	  fPrinterQueueFullPolicy(PrinterHandler::eBlockWhenFull)
 {
 	fSIOWrapper = SIOWrapper::CreateSIOWrapper(devname);
 	fSIOManager = new SIOManager(fSIOWrapper);
@@ -62,7 +67,26 @@ DeviceManager::DeviceManager(const char* devname)
 		SetHighSpeedMode(true);
 	}
 
+	fAdapterName = SpeedProfile::GetAdapterName(devname);
+	SpeedProfile::Profile profile;
+	if (fHighspeedBaudrate && SpeedProfile::Load(fAdapterName, profile)) {
+		if (SetHighSpeedParameters(profile.fPokeyDivisor, profile.fBaudrate)) {
+			ALOG("using calibrated pokey divisor %d (%d baud) of %s",
+				profile.fPokeyDivisor, profile.fBaudrate, fAdapterName.c_str());
+		}
+	}
+
 	EnableXF551Mode(false);
+
+	fVirtualDriveWatcher = new VirtualDriveWatcher(this);
+	if (fVirtualDriveWatcher->IsOK()) {
+		fSIOManager->AddPollHandler(fVirtualDriveWatcher);
+	}
+
+	fImageLoader = new BackgroundImageLoader(this);
+	if (fImageLoader->GetFileDescriptor() >= 0) {
+		fSIOManager->AddPollHandler(fImageLoader);
+	}
 }
 
 DeviceManager::~DeviceManager()
@@ -161,6 +185,18 @@ RCPtr<DiskImage> DeviceManager::LoadDiskImage(const char* filename, bool beQuiet
 	return image;
 }
 
+bool DeviceManager::IsDiskImageFilename(const char* filename)
+{
+#ifdef ENABLE_ATP
+	int len = strlen(filename);
+	if ( (len > 4 && strcasecmp(filename+len-4,".atp") == 0) ||
+	     (len > 7 && strcasecmp(filename+len-7,".atp.gz") == 0)) {
+		return true;
+	}
+#endif
+	return AtrMemoryImage::IsImageFilename(filename);
+}
+
 bool DeviceManager::LoadDiskImage(EDriveNumber driveno, const char* filename, bool beQuiet, bool forceUnload)
 {
 	if (!DriveNumberOK(driveno)) {
@@ -180,6 +216,49 @@ bool DeviceManager::LoadDiskImage(EDriveNumber driveno, const char* filename, bo
 		return false;
 	}
 
+	RCPtr<AbstractSIOHandler> handler = CreateDiskHandler(image);
+	if (handler.IsNull()) {
+		return false;
+	}
+
+	if (DriveInUse(driveno) && forceUnload && !beQuiet) {
+		ALOG("unloading D%d:", driveno);
+	}
+	SetDriveHandler(driveno, handler);
+
+	if (!beQuiet) {
+		ALOG("loaded D%d: from \"%s\"", driveno, image->GetFilename());
+	}
+	return true;
+}
+
+bool DeviceManager::LoadDiskImageInBackground(EDriveNumber driveno, const char* filename)
+{
+	if (!DriveNumberOK(driveno)) {
+		return false;
+	}
+	return fImageLoader->Load(driveno, filename);
+}
+
+bool DeviceManager::InstallDiskImage(EDriveNumber driveno, const RCPtr<DiskImage>& image)
+{
+	if (!DriveNumberOK(driveno)) {
+		return false;
+	}
+	RCPtr<AbstractSIOHandler> handler = CreateDiskHandler(image);
+	if (handler.IsNull()) {
+		return false;
+	}
+	fSIOManager->ReplaceHandler(eSIODriveBase+driveno, handler);
+
+	SIOTracer* tracer = SIOTracer::GetInstance();
+	tracer->IndicateDriveFormatted(driveno);
+	tracer->IndicateDriveChanged(driveno);
+	return true;
+}
+
+RCPtr<AbstractSIOHandler> DeviceManager::CreateDiskHandler(const RCPtr<DiskImage>& image)
+{
 	RCPtr<AbstractSIOHandler> handler;
 
 #ifdef ENABLE_ATP
@@ -194,28 +273,17 @@ bool DeviceManager::LoadDiskImage(EDriveNumber driveno, const char* filename, bo
 		handler->SetHighSpeedParameters(fPokeyDivisor, fHighspeedBaudrate);
 		handler->EnableXF551Mode(fEnableXF551Mode);
 		handler->EnableStrictFormatChecking(fUseStrictFormatChecking);
-	} else {
-		return false;
-	}
-
-	if (DriveInUse(driveno) && forceUnload) {
-		if (!beQuiet) {
-			ALOG("unloading D%d:", driveno);
-		}
-		UnloadDiskImage(driveno);
-	}
-
-	if (!fSIOManager->RegisterHandler(eSIODriveBase+driveno, handler)) {
-		if (!beQuiet) {
-			DPRINTF("cannot register device %d!",eSIODriveBase+driveno);
+		if (IsSpeedCalibrationRunning()) {
+			handler->SetTransferMonitor(fSpeedCalibration);
 		}
-		return false;
 	}
+	return handler;
+}
 
-	if (!beQuiet) {
-		ALOG("loaded D%d: from \"%s\"", driveno, image->GetFilename());
-	}
-	return true;
+void DeviceManager::SetDriveHandler(EDriveNumber driveno, const RCPtr<AbstractSIOHandler>& handler)
+{
+	fImageLoader->Cancel(driveno);
+	fSIOManager->ReplaceHandler(eSIODriveBase+driveno, handler);
 }
 
 bool DeviceManager::CreateVirtualDrive(
@@ -253,11 +321,19 @@ bool DeviceManager::CreateVirtualDrive(
 		absPath[len+1] = 0;
 	}
 
-	if (!CreateAtrMemoryImage(driveno, density, sectors, forceUnload)) {
+	// file data is read from the host files when the Atari accesses it,
+	// only boot, VTOC and directory sectors are kept in memory
+	RCPtr<HostFileSectorSource> hostFiles = new HostFileSectorSource(sectors);
+	RCPtr<AtrMemoryImage> img = new AtrMemoryImage;
+	if (!img->CreateLazyImage(density, sectors, hostFiles)) {
+		AERROR("cannot create virtual image");
+		return false;
+	}
+	img->SetChanged(false);
+	if (!RegisterAtrMemoryImage(driveno, img, forceUnload)) {
 		return false;
 	}
 
-	RCPtr<AtrMemoryImage> img = RCPtrStaticCast<AtrMemoryImage>(GetAtrImage(driveno));
 	img->SetIsVirtualImage(true);
 	RCPtr<VirtualImageObserver> observer;
 	RCPtr<Dos2xUtils> rootdir;
@@ -266,6 +342,7 @@ bool DeviceManager::CreateVirtualDrive(
 
 	observer = new VirtualImageObserver(img);
 	rootdir = new Dos2xUtils(img, absPath, observer);
+	rootdir->SetHostFileSource(hostFiles);
 	observer->SetRootDirectoryObserver(rootdir);
 
 	img->SetFilename(absPath);
@@ -294,6 +371,7 @@ bool DeviceManager::CreateVirtualDrive(
 
 	sioHandler = RCPtrStaticCast<AtrSIOHandler>(GetSIOHandler(driveno));
 	sioHandler->SetVirtualImageObserver(observer);
+	fVirtualDriveWatcher->Refresh();
 	return true;
 
 fail:
@@ -353,14 +431,19 @@ bool DeviceManager::ReloadDrive(EDriveNumber driveno)
 
 						char* filename = strdup(diskImage->GetFilename());
 
-						bool active = DeviceIsActive(driveno);
-						bool wp = DriveIsWriteProtected(driveno);
-						UnloadDiskImage(driveno);
-
-						if (!LoadDiskImage(driveno, filename, true)) {
+						// the old image stays loaded if reading fails
+						RCPtr<DiskImage> image = LoadDiskImage(filename, true);
+						RCPtr<AbstractSIOHandler> handler;
+						if (image.IsNotNull()) {
+							handler = CreateDiskHandler(image);
+						}
+						if (handler.IsNull()) {
 							ALOG("ERROR reloading drive D%d:", driveno);
 							ok = false;
 						} else {
+							bool active = DeviceIsActive(driveno);
+							bool wp = DriveIsWriteProtected(driveno);
+							SetDriveHandler(driveno, handler);
 							SetDeviceActive(driveno, active);
 							SetWriteProtectImage(driveno, wp);
 						}
@@ -409,15 +492,15 @@ bool DeviceManager::ReloadDrive(EDriveNumber driveno)
 				}
 
 
-				UnloadDiskImage(driveno);
+				// the new image replaces the old one in one step
 				if (diskFormat == eUserDefDisk) {
 					unsigned int estimatedSectors = Dos2xUtils::EstimateDiskSize(path, seclen, Dos2xUtils::ePicoName);
 					if (estimatedSectors > sectors) {
 						sectors = estimatedSectors;
 					}
-					ok = CreateVirtualDrive(driveno, path, seclen, sectors);
+					ok = CreateVirtualDrive(driveno, path, seclen, sectors, true, true);
 				} else {
-					ok = CreateVirtualDrive(driveno, path, diskFormat);
+					ok = CreateVirtualDrive(driveno, path, diskFormat, true);
 				}
 				free(path);
 			}
@@ -441,23 +524,7 @@ bool DeviceManager::CreateAtrMemoryImage(EDriveNumber driveno, EDiskFormat forma
 	img->CreateImage(format);
 	img->SetChanged(false);
 
-	RCPtr<AtrSIOHandler> handler(new AtrSIOHandler(img));
-	handler->EnableHighSpeed(fUseHighSpeed);
-	handler->SetHighSpeedParameters(fPokeyDivisor, fHighspeedBaudrate);
-	handler->EnableXF551Mode(fEnableXF551Mode);
-	handler->EnableStrictFormatChecking(fUseStrictFormatChecking);
-
-	if (DriveInUse(driveno) && forceUnload) {
-		ALOG("unloading D%d:", driveno);
-		UnloadDiskImage(driveno);
-	}
-
-	if (!fSIOManager->RegisterHandler(eSIODriveBase+driveno, handler)) {
-		DPRINTF("cannot register device %d!",eSIODriveBase+driveno);
-		return false;
-	}
-
-	return true;
+	return RegisterAtrMemoryImage(driveno, img, forceUnload);
 }
 
 bool DeviceManager::CreateAtrMemoryImage(EDriveNumber driveno, ESectorLength density, unsigned int sectors, bool forceUnload)
@@ -475,21 +542,17 @@ bool DeviceManager::CreateAtrMemoryImage(EDriveNumber driveno, ESectorLength den
 	img->CreateImage(density, sectors);
 	img->SetChanged(false);
 
-	RCPtr<AtrSIOHandler> handler(new AtrSIOHandler(img));
-	handler->EnableHighSpeed(fUseHighSpeed);
-	handler->SetHighSpeedParameters(fPokeyDivisor, fHighspeedBaudrate);
-	handler->EnableXF551Mode(fEnableXF551Mode);
-	handler->EnableStrictFormatChecking(fUseStrictFormatChecking);
+	return RegisterAtrMemoryImage(driveno, img, forceUnload);
+}
+
+bool DeviceManager::RegisterAtrMemoryImage(EDriveNumber driveno, const RCPtr<AtrMemoryImage>& img, bool forceUnload)
+{
+	RCPtr<AbstractSIOHandler> handler = CreateDiskHandler(img);
 
 	if (DriveInUse(driveno) && forceUnload) {
 		ALOG("unloading D%d:", driveno);
-		UnloadDiskImage(driveno);
-	}
-
-	if (!fSIOManager->RegisterHandler(eSIODriveBase+driveno, handler)) {
-		DPRINTF("cannot register device %d!",eSIODriveBase+driveno);
-		return false;
 	}
+	SetDriveHandler(driveno, handler);
 
 	return true;
 }
@@ -510,9 +573,7 @@ bool DeviceManager::UnloadDiskImage(EDriveNumber driveno)
 	}
 
 	for (int i=min; i<=max;i++) {
-		if (DriveInUse(EDriveNumber(i))) {
-			fSIOManager->UnregisterHandler(eSIODriveBase+i);
-		}
+		SetDriveHandler(EDriveNumber(i), RCPtr<AbstractSIOHandler>());
 	}
 	return true;
 }
@@ -768,11 +829,8 @@ bool DeviceManager::ExchangeDrives(EDriveNumber drive1, EDriveNumber drive2)
 	RCPtr<AbstractSIOHandler> h1 (fSIOManager->GetHandler(eSIODriveBase+drive1));
 	RCPtr<AbstractSIOHandler> h2 (fSIOManager->GetHandler(eSIODriveBase+drive2));
 
-	fSIOManager->UnregisterHandler(eSIODriveBase+drive1);
-	fSIOManager->UnregisterHandler(eSIODriveBase+drive2);
-
-	fSIOManager->RegisterHandler(eSIODriveBase+drive1,h2);
-	fSIOManager->RegisterHandler(eSIODriveBase+drive2,h1);
+	SetDriveHandler(drive1, h2);
+	SetDriveHandler(drive2, h1);
 	return true;
 }
 
@@ -858,6 +916,35 @@ bool DeviceManager::DriveIsVirtualImage(EDriveNumber driveno) const
 	return false;
 }
 
+RCPtr<Dos2xUtils> DeviceManager::GetVirtualDriveRoot(EDriveNumber driveno)
+{
+	if (!DriveNumberOK(driveno) || !DriveInUse(driveno)) {
+		return RCPtr<Dos2xUtils>();
+	}
+	if (!DriveIsVirtualImage(driveno)) {
+		return RCPtr<Dos2xUtils>();
+	}
+	RCPtr<AtrSIOHandler> sioHandler = RCPtrStaticCast<AtrSIOHandler>(GetSIOHandler(driveno));
+	RCPtr<VirtualImageObserver> observer = sioHandler->GetVirtualImageObserver();
+	if (observer.IsNull()) {
+		return RCPtr<Dos2xUtils>();
+	}
+	return observer->GetRootDirectoryObserver();
+}
+
+bool DeviceManager::OpenImageLibrary(const char* indexfile)
+{
+	RCPtr<ImageLibrary> library = new ImageLibrary;
+	if (!library->Open(indexfile)) {
+		AERROR("cannot open image library index \"%s\"", indexfile);
+		return false;
+	}
+	fImageLibrary = library;
+	ALOG("image library: %d files in %d images",
+		library->GetNumberOfFiles(), library->GetNumberOfImages());
+	return true;
+}
+
 unsigned int DeviceManager::GetDriveImageSize(EDriveNumber driveno) const
 {
 	if (!DriveNumberOK(driveno)) {
@@ -879,6 +966,16 @@ int DeviceManager::DoServing(int otherReadPollDevice)
 	return fSIOManager->DoServing(otherReadPollDevice);
 }
 
+bool DeviceManager::AddPollHandler(const RCPtr<AbstractPollHandler>& handler)
+{
+	return fSIOManager->AddPollHandler(handler);
+}
+
+void DeviceManager::RemovePollHandler(const RCPtr<AbstractPollHandler>& handler)
+{
+	fSIOManager->RemovePollHandler(handler);
+}
+
 bool DeviceManager::DriveNumberOK(EDriveNumber driveno) const
 {
 	if (driveno < eMinDriveNumber || driveno > eMaxDriveNumber ) {
@@ -958,6 +1055,37 @@ bool DeviceManager::SetHighSpeedParameters(unsigned int pokeyDivisor, unsigned i
 	return SetHighSpeedMode(fUseHighSpeed);
 }
 
+bool DeviceManager::StartSpeedCalibration()
+{
+	if (!fUseHighSpeed) {
+		AERROR("high speed mode is disabled");
+		return false;
+	}
+	if (fSpeedCalibration.IsNull()) {
+		fSpeedCalibration = new SpeedCalibration(this, fAdapterName);
+	}
+	SetTransferMonitor(fSpeedCalibration);
+	if (!fSpeedCalibration->Start()) {
+		SetTransferMonitor(RCPtr<SIOTransferMonitor>());
+		return false;
+	}
+	return true;
+}
+
+void DeviceManager::SetTransferMonitor(const RCPtr<SIOTransferMonitor>& monitor)
+{
+	for (int i=eMinDriveNumber; i<=eMaxDriveNumber; i++) {
+		if (DriveInUse(EDriveNumber(i))) {
+			GetSIOHandler((EDriveNumber)i)->SetTransferMonitor(monitor);
+		}
+	}
+}
+
+bool DeviceManager::IsSpeedCalibrationRunning() const
+{
+	return fSpeedCalibration.IsNotNull() && fSpeedCalibration->IsRunning();
+}
+
 bool DeviceManager::EnableXF551Mode(bool on)
 {
 	fEnableXF551Mode = on;
@@ -1043,7 +1171,7 @@ bool DeviceManager::InstallPrinterHandler(const char* dest, PrinterHandler::EEOL
 		return false;
 	}
 	try {
-		RCPtr<PrinterHandler> handler = new PrinterHandler(dest, conv);
+		RCPtr<PrinterHandler> handler = new PrinterHandler(dest, conv, fPrinterQueueFullPolicy);
 		if (!fSIOManager->RegisterHandler(eSIOPrinter, handler)) {
 			DPRINTF("cannot register printer handler");
 			return false;
@@ -1079,6 +1207,11 @@ bool DeviceManager::FlushPrinterData()
 	}
 }
 
+void DeviceManager::SetPrinterQueueFullPolicy(PrinterHandler::EQueueFullPolicy policy)
+{
+	fPrinterQueueFullPolicy = policy;
+}
+
 PrinterHandler::EEOLConversion DeviceManager::GetPrinterEOLConversion() const
 {
 	if (DriveInUse(ePrinter)) {
@@ -22,12 +22,21 @@
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
+#include <string>
+
 #include "SIOManager.h"
 #include "AtrImage.h"
+#include "AtrMemoryImage.h"
 #include "RCPtr.h"
 #include "RefCounted.h"
 #include "PrinterHandler.h"
 #include "CasHandler.h"
+#include "Dos2xUtils.h"
+#include "ImageLibrary.h"
+
+class VirtualDriveWatcher;
+class BackgroundImageLoader;
+class SpeedCalibration;
 
 class DeviceManager : public RefCounted {
 public:
@@ -66,6 +75,19 @@ public:
 	static RCPtr<DiskImage> LoadDiskImage(const char* filename, bool beQuiet = false);
 	bool LoadDiskImage(EDriveNumber driveno, const char* filename, bool beQuiet = false, bool forceUnload = false);
 
+	// true if LoadDiskImage reads filename as an image. Other files
+	// are put into a new MyPicoDos image.
+	static bool IsDiskImageFilename(const char* filename);
+
+	// read the image in a background thread while the drive keeps
+	// serving the current image, then swap it in between two
+	// command frames. Errors are reported when loading finished.
+	// Only image files are accepted, see BackgroundImageLoader.
+	bool LoadDiskImageInBackground(EDriveNumber driveno, const char* filename);
+
+	// replace the image of driveno in one step
+	bool InstallDiskImage(EDriveNumber driveno, const RCPtr<DiskImage>& image);
+
 	bool ReloadDrive(EDriveNumber driveno);
 
 	bool CreateVirtualDrive(
@@ -88,13 +110,23 @@ public:
 	bool DriveIsWriteProtected(EDriveNumber driveno) const;
 	bool DriveIsChanged(EDriveNumber driveno) const;
 	bool DriveIsVirtualImage(EDriveNumber driveno) const;
+	RCPtr<Dos2xUtils> GetVirtualDriveRoot(EDriveNumber driveno);
 	unsigned int GetDriveImageSize(EDriveNumber driveno) const;
 	bool DriveNumberOK(EDriveNumber driveno) const;
 
+	// index of disk image collections, used to locate an image by
+	// the files it contains
+	bool OpenImageLibrary(const char* indexfile);
+	inline RCPtr<ImageLibrary> GetImageLibrary();
+
 	bool InstallPrinterHandler(const char* dest, PrinterHandler::EEOLConversion);
 	bool RemovePrinterHandler();
 	bool FlushPrinterData();
 
+	// used for printer handlers installed after this call
+	void SetPrinterQueueFullPolicy(PrinterHandler::EQueueFullPolicy policy);
+	inline PrinterHandler::EQueueFullPolicy GetPrinterQueueFullPolicy() const;
+
 	PrinterHandler::EEOLConversion GetPrinterEOLConversion() const;
 	PrinterHandler::EPrinterStatus GetPrinterRunningStatus() const;
 	const char* GetPrinterFilename() const;
@@ -109,6 +141,16 @@ public:
 	inline uint8_t GetHighSpeedPokeyDivisor() const;
 	inline unsigned int GetHighSpeedBaudrate() const;
 
+	// test pokey divisors while the Atari transfers data at high
+	// speed and save the fastest reliable one in the speed profile
+	// of the adapter, which is applied on the next start
+	bool StartSpeedCalibration();
+	bool IsSpeedCalibrationRunning() const;
+
+	// attach a monitor to all disk drives, NULL removes it
+	void SetTransferMonitor(const RCPtr<SIOTransferMonitor>& monitor);
+	inline const std::string& GetAdapterName() const;
+
 	bool EnableXF551Mode(bool on);
 	bool GetXF551Mode() const;
 
@@ -117,6 +159,10 @@ public:
 
 	int DoServing(int otherReadPollDevice=-1);
 
+	// poll additional file descriptors while serving, see SIOManager
+	bool AddPollHandler(const RCPtr<AbstractPollHandler>& handler);
+	void RemovePollHandler(const RCPtr<AbstractPollHandler>& handler);
+
 	RCPtr<SIOManager> GetSIOManager();
 	RCPtr<SIOWrapper> GetSIOWrapper();
 
@@ -145,6 +191,13 @@ private:
 	RCPtr<AbstractSIOHandler> GetSIOHandler(EDriveNumber driveno) const;
 	RCPtr<const AbstractSIOHandler> GetConstSIOHandler(EDriveNumber driveno) const;
 
+	bool RegisterAtrMemoryImage(EDriveNumber driveno, const RCPtr<AtrMemoryImage>& img, bool forceUnload);
+
+	RCPtr<AbstractSIOHandler> CreateDiskHandler(const RCPtr<DiskImage>& image);
+
+	// replace the handler of driveno and cancel pending background loads
+	void SetDriveHandler(EDriveNumber driveno, const RCPtr<AbstractSIOHandler>& handler);
+
 	bool fUseHighSpeed;
 	SIOWrapper::ESIOTiming fSioTiming;
 
@@ -153,11 +206,23 @@ private:
 	bool fUseStrictFormatChecking;
 
 	unsigned int fTapeSpeedPercent;
+	PrinterHandler::EQueueFullPolicy fPrinterQueueFullPolicy;
 	bool fEnableXF551Mode;
 	SIOWrapper::ESIOServerCommandLine fCableType;
 	RCPtr<CasHandler> fCasHandler;
+	RCPtr<VirtualDriveWatcher> fVirtualDriveWatcher;
+	RCPtr<BackgroundImageLoader> fImageLoader;
+	RCPtr<ImageLibrary> fImageLibrary;
+
+	std::string fAdapterName;
+	RCPtr<SpeedCalibration> fSpeedCalibration;
 };
 
+inline RCPtr<ImageLibrary> DeviceManager::GetImageLibrary()
+{
+	return fImageLibrary;
+}
+
 inline RCPtr<SIOManager> DeviceManager::GetSIOManager()
 {
 	return fSIOManager;
@@ -208,6 +273,16 @@ inline uint8_t DeviceManager::GetHighSpeedPokeyDivisor() const
 	return fPokeyDivisor;
 }
 
+inline const std::string& DeviceManager::GetAdapterName() const
+{
+	return fAdapterName;
+}
+
+inline PrinterHandler::EQueueFullPolicy DeviceManager::GetPrinterQueueFullPolicy() const
+{
+	return fPrinterQueueFullPolicy;
+}
+
 inline unsigned int DeviceManager::GetTapeSpeedPercent() const
 {
 	return fTapeSpeedPercent;
@@ -67,7 +67,8 @@ void DirEntry::SetName(const char* string)
 
 Directory::Directory()
 	: fEntries(0), fSize(0), fAllocatedSize(0),
-	  fFileselectorPosition(0)
+	  fFileselectorPosition(0),
+	  fComplete(false)
 {
 }
 
@@ -179,9 +180,52 @@ int Directory::ReadDirectory(const char* path, bool sortDir, bool alwaysStatFile
 	if ((sortDir) && (fSize > 2) ) {
 		qsort(&(fEntries[1]), fSize-1, sizeof(DirEntry*), compare_direntry);
 	}
+	fComplete = true;
 	return fSize;
 }
 
+void Directory::InitIncremental()
+{
+	Init();
+	AddEntry("..", DirEntry::eParentDirectory, 0);
+	fComplete = false;
+}
+
+void Directory::AddSortedEntries(DirEntry** entries, unsigned int count)
+{
+	if (count == 0) {
+		return;
+	}
+	if (fSize == 0) {
+		AddEntry("..", DirEntry::eParentDirectory, 0);
+	}
+	qsort(entries, count, sizeof(DirEntry*), compare_direntry);
+
+	// merge from the end so the existing entries can stay in place
+	PrepareForIndex(fSize + count - 1);
+	int src = fSize - 1;
+	int add = count - 1;
+	int dst = fSize + count - 1;
+	while (add >= 0) {
+		if (src >= 1 && compare_direntry(&fEntries[src], &entries[add]) > 0) {
+			fEntries[dst--] = fEntries[src--];
+		} else {
+			fEntries[dst--] = entries[add--];
+		}
+	}
+	fSize += count;
+}
+
+int Directory::IndexOf(const DirEntry* entry) const
+{
+	for (unsigned int i = 0; i < fSize; i++) {
+		if (fEntries[i] == entry) {
+			return i;
+		}
+	}
+	return -1;
+}
+
 int Directory::Find(const char* name, unsigned int startPos)
 {
 	if (name == NULL) {
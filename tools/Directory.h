@@ -71,6 +71,21 @@ public:
 
 	int Find(const char* name, unsigned int startPos = 0);
 
+	// position of entry, -1 if it's not in the directory
+	int IndexOf(const DirEntry* entry) const;
+
+	// start an empty directory (with only the ".." entry) which is
+	// filled later with AddSortedEntries, eg by DirectoryScanner
+	void InitIncremental();
+
+	// sort entries and merge them into the already sorted directory.
+	// The directory takes ownership of the entries.
+	void AddSortedEntries(DirEntry** entries, unsigned int count);
+
+	// false while a DirectoryScanner is still adding entries
+	bool IsComplete() const { return fComplete; }
+	void SetComplete(bool complete) { fComplete = complete; }
+
 	//hack for storing the current position in the file selector
 	inline unsigned int GetFileselectorPosition() const;
 	inline void SetFileselectorPosition(unsigned int pos);
@@ -86,6 +101,7 @@ private:
 	unsigned int fAllocatedSize;
 
 	unsigned int fFileselectorPosition;
+	bool fComplete;
 };
 
 inline void Directory::PrepareForIndex(unsigned int num)
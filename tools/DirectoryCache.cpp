@@ -28,7 +28,7 @@
 #include "AtariDebug.h"
 
 DirectoryCache::DirectoryCache()
-	: fCachedPath(0)
+	: fUseCounter(0)
 {
 }
 
@@ -39,77 +39,125 @@ DirectoryCache::~DirectoryCache()
 
 void DirectoryCache::ClearDirectoryData()
 {
-	if (fCachedDirectory) {
-		// remember last fileselector position
-		fCachedFileselectorPosition = fCachedDirectory->GetFileselectorPosition();
+	for (unsigned int i = 0; i < fEntries.size(); i++) {
+		if (fEntries[i].fDirectory) {
+			// remember last fileselector position
+			fEntries[i].fFileselectorPosition = fEntries[i].fDirectory->GetFileselectorPosition();
+		}
+		fEntries[i].fDirectory = 0;
 	}
-	fCachedDirectory = 0;
 }
 
 void DirectoryCache::ClearCache()
 {
-	ClearDirectoryData();
-	if (fCachedPath) {
-		delete[] fCachedPath;
-	}
-	fCachedPath = 0;
-	fCachedFileselectorPosition = 0;
+	fEntries.clear();
 }
 
-RCPtr<Directory> DirectoryCache::GetDirectory(const char* path, EDirectoryMode dirMode)
+DirectoryCache::CacheEntry* DirectoryCache::PrepareEntry(const char* path, EDirectoryMode dirMode, bool& hit)
 {
+	hit = false;
+
 	char p[PATH_MAX];
 	if (realpath(path, p) == NULL) {
-		return RCPtr<Directory>();
+		return 0;
 	}
 	struct stat statbuf;
 	if (stat(p, &statbuf) != 0) {
-		return RCPtr<Directory>();
+		return 0;
 	}
-	//DPRINTF("cachedPath: %s path: %s", fCachedPath, p);
-	//DPRINTF("cachedDirMode: %d dirMode: %d", fDirectoryMode, dirMode);
-	
-	unsigned int fileselectPos = 0;
-	bool setFileselectPos = false;
-
-	if (fCachedPath && (strcmp(p, fCachedPath) == 0)) {
-		if ( (dirMode == fCachedDirectoryMode) || (dirMode == eDirectoryUnsortedOrSorted) ) {
-			if (statbuf.st_mtime == fCachedModificationTime ) {
-				if (fCachedDirectory) {
-					//DPRINTF("DirCache hit: %s", fCachedPath);
-					return fCachedDirectory;
-				} else {
-					//DPRINTF("DirCache metadata hit: %s, pos=%d", fCachedPath, fCachedFileselectorPosition);
-					// metatdata matches, rebuild directory and restore
-					// fileselector position
-					fileselectPos = fCachedFileselectorPosition;
-					setFileselectPos = true;
+
+	CacheEntry* entry = 0;
+	for (unsigned int i = 0; i < fEntries.size(); i++) {
+		if (fEntries[i].fPath == p) {
+			entry = &fEntries[i];
+			break;
+		}
+	}
+
+	bool unchanged = false;
+	if (entry) {
+		unchanged = (statbuf.st_mtime == entry->fModificationTime)
+			&& (statbuf.st_mtim.tv_nsec == entry->fModificationTimeNsec);
+		if (unchanged && ( (dirMode == entry->fDirectoryMode) || (dirMode == eDirectoryUnsortedOrSorted) ) ) {
+			entry->fLastUse = ++fUseCounter;
+			if (entry->fDirectory && entry->fDirectory->IsComplete()) {
+				//DPRINTF("DirCache hit: %s", p);
+				hit = true;
+				return entry;
+			}
+			if (entry->fDirectory) {
+				// scan was aborted, continue at the same position
+				entry->fFileselectorPosition = entry->fDirectory->GetFileselectorPosition();
+			}
+		} else {
+			//DPRINTF("DirCache invalidated - directory changed");
+			unchanged = false;
+		}
+	} else {
+		if (fEntries.size() >= eMaxCachedDirectories) {
+			unsigned int oldest = 0;
+			for (unsigned int i = 1; i < fEntries.size(); i++) {
+				if (fEntries[i].fLastUse < fEntries[oldest].fLastUse) {
+					oldest = i;
 				}
-			} else {
-				//DPRINTF("DirCache invalidated - directory changed");
 			}
+			fEntries.erase(fEntries.begin() + oldest);
 		}
+		fEntries.push_back(CacheEntry());
+		entry = &fEntries.back();
+		entry->fPath = p;
 	}
-	if (fCachedPath) {
-		delete[] fCachedPath;
-	}
-	fCachedPath = new char[strlen(p)+1];
-	strcpy(fCachedPath, p);
-	//DPRINTF("DirCache miss: %s", fCachedPath);
+
+	//DPRINTF("DirCache miss: %s", p);
 	if (dirMode == eDirectoryUnsortedOrSorted) {
 		dirMode = eDirectoryUnsorted;
 	}
-	fCachedDirectoryMode = dirMode;
-	fCachedModificationTime = statbuf.st_mtime;
-	
-	fCachedDirectory = new Directory;
+	entry->fDirectoryMode = dirMode;
+	entry->fModificationTime = statbuf.st_mtime;
+	entry->fModificationTimeNsec = statbuf.st_mtim.tv_nsec;
+	entry->fLastUse = ++fUseCounter;
+	if (!unchanged) {
+		entry->fFileselectorPosition = 0;
+	}
+	entry->fDirectory = new Directory;
+	entry->fDirectory->SetFileselectorPosition(entry->fFileselectorPosition);
+	return entry;
+}
+
+RCPtr<Directory> DirectoryCache::GetDirectory(const char* path, EDirectoryMode dirMode)
+{
+	bool hit;
+	CacheEntry* entry = PrepareEntry(path, dirMode, hit);
+	if (!entry) {
+		return RCPtr<Directory>();
+	}
+	if (hit) {
+		return entry->fDirectory;
+	}
+	if (entry->fDirectory->ReadDirectory(entry->fPath.c_str(), (entry->fDirectoryMode == eDirectorySorted) ) < 0) {
+		entry->fDirectory = 0;
+	} else {
+		entry->fDirectory->SetFileselectorPosition(entry->fFileselectorPosition);
+	}
+	return entry->fDirectory;
+}
 
-	if (fCachedDirectory->ReadDirectory(fCachedPath, (fCachedDirectoryMode == eDirectorySorted) ) < 0) {
-		fCachedDirectory = 0;
+RCPtr<Directory> DirectoryCache::ScanDirectory(const char* path, RCPtr<DirectoryScanner>& scanner)
+{
+	scanner = 0;
+	bool hit;
+	CacheEntry* entry = PrepareEntry(path, eDirectorySorted, hit);
+	if (!entry) {
+		return RCPtr<Directory>();
+	}
+	if (hit) {
+		return entry->fDirectory;
 	}
-	if (fCachedDirectory && setFileselectPos) {
-		//DPRINTF("setting fileselector position to %d", fileselectPos);
-		fCachedDirectory->SetFileselectorPosition(fileselectPos);
+	scanner = new DirectoryScanner(entry->fDirectory);
+	if (!scanner->Start(entry->fPath.c_str())) {
+		scanner = 0;
+		entry->fDirectory = 0;
+		return RCPtr<Directory>();
 	}
-	return fCachedDirectory;
+	return entry->fDirectory;
 }
@@ -2,7 +2,7 @@
 #define DIRECTORYCACHE_H
 
 /*
-   DirectoryCache.h - simple directory-cache
+   DirectoryCache.h - directory-cache
 
    Copyright (C) 2003, 2004 Matthias Reichl <hias@horus.com>
 
@@ -21,7 +21,11 @@
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
+#include <string>
+#include <vector>
+
 #include "Directory.h"
+#include "DirectoryScanner.h"
 #include "RefCounted.h"
 #include "RCPtr.h"
 
@@ -39,17 +43,36 @@ public:
 	};
 	RCPtr<Directory> GetDirectory(const char* path, EDirectoryMode dirMode);
 
+	// get the sorted directory. If it's not cached, an empty directory
+	// is returned and scanner is set to the DirectoryScanner that
+	// fills it, the caller has to register it with the SIO loop.
+	RCPtr<Directory> ScanDirectory(const char* path, RCPtr<DirectoryScanner>& scanner);
+
 	// only clear cached directory data but keep meta information
 	void ClearDirectoryData();
 	// completely flush the cache
 	void ClearCache();
 
 private:
-	RCPtr<Directory> fCachedDirectory;
-	char* fCachedPath;
-	time_t fCachedModificationTime;
-	EDirectoryMode fCachedDirectoryMode;
-	unsigned int fCachedFileselectorPosition;
+	enum { eMaxCachedDirectories = 16 };
+
+	struct CacheEntry {
+		std::string fPath;
+		RCPtr<Directory> fDirectory;
+		time_t fModificationTime;
+		long fModificationTimeNsec;
+		EDirectoryMode fDirectoryMode;
+		unsigned int fFileselectorPosition;
+		unsigned int fLastUse;
+	};
+
+	// find or create the cache entry of path. Returns the entry
+	// if the cached directory data can be used, otherwise the entry
+	// is prepared to receive new data.
+	CacheEntry* PrepareEntry(const char* path, EDirectoryMode dirMode, bool& hit);
+
+	std::vector<CacheEntry> fEntries;
+	unsigned int fUseCounter;
 };
 
 #endif
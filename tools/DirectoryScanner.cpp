@@ -0,0 +1,263 @@
+/*
+   DirectoryScanner.cpp - read a directory in the background
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+
+#include "DirectoryScanner.h"
+#include "MiscUtils.h"
+#include "AtariDebug.h"
+
+DirectoryScanner::DirectoryScanner(const RCPtr<Directory>& directory)
+	: fDirectory(directory),
+	  fDirFd(-1),
+	  fNumberOfThreads(0),
+	  fListingDone(false),
+	  fRunningStatThreads(0),
+	  fStop(false),
+	  fFinished(false)
+{
+	pthread_mutex_init(&fMutex, NULL);
+	pthread_cond_init(&fCond, NULL);
+	fEventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+DirectoryScanner::~DirectoryScanner()
+{
+	Stop();
+	if (fEventFd >= 0) {
+		close(fEventFd);
+	}
+	pthread_cond_destroy(&fCond);
+	pthread_mutex_destroy(&fMutex);
+}
+
+int DirectoryScanner::GetFileDescriptor() const
+{
+	return fEventFd;
+}
+
+bool DirectoryScanner::Start(const char* path)
+{
+	Stop();
+	if (fEventFd < 0) {
+		return false;
+	}
+	fDirFd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fDirFd < 0) {
+		return false;
+	}
+	fDirectory->InitIncremental();
+	fStop = false;
+	fListingDone = false;
+	fFinished = false;
+
+	if (!MiscUtils::create_normal_priority_thread(fListThread, ListThreadFunc, this, 256*1024)) {
+		DPRINTF("cannot create directory list thread");
+		close(fDirFd);
+		fDirFd = -1;
+		return false;
+	}
+	// stat threads wait for the mutex until the count is set
+	pthread_mutex_lock(&fMutex);
+	fNumberOfThreads = 0;
+	for (unsigned int i = 0; i < eNumberOfStatThreads; i++) {
+		if (!MiscUtils::create_normal_priority_thread(fStatThread[i], StatThreadFunc, this, 256*1024)) {
+			break;
+		}
+		fNumberOfThreads++;
+	}
+	fRunningStatThreads = fNumberOfThreads;
+	if (fNumberOfThreads == 0) {
+		DPRINTF("cannot create directory stat threads");
+		fStop = true;
+		pthread_cond_broadcast(&fCond);
+	}
+	pthread_mutex_unlock(&fMutex);
+
+	if (fNumberOfThreads == 0) {
+		Stop();
+		return false;
+	}
+	return true;
+}
+
+void DirectoryScanner::Stop()
+{
+	if (fDirFd < 0) {
+		return;
+	}
+	pthread_mutex_lock(&fMutex);
+	fStop = true;
+	pthread_cond_broadcast(&fCond);
+	pthread_mutex_unlock(&fMutex);
+
+	pthread_join(fListThread, NULL);
+	for (unsigned int i = 0; i < fNumberOfThreads; i++) {
+		pthread_join(fStatThread[i], NULL);
+	}
+	fNumberOfThreads = 0;
+
+	for (unsigned int i = 0; i < fPendingNames.size(); i++) {
+		delete[] fPendingNames[i];
+	}
+	fPendingNames.clear();
+	for (unsigned int i = 0; i < fResults.size(); i++) {
+		delete fResults[i];
+	}
+	fResults.clear();
+
+	close(fDirFd);
+	fDirFd = -1;
+}
+
+void* DirectoryScanner::ListThreadFunc(void* arg)
+{
+	static_cast<DirectoryScanner*>(arg)->ListEntries();
+	return NULL;
+}
+
+void* DirectoryScanner::StatThreadFunc(void* arg)
+{
+	static_cast<DirectoryScanner*>(arg)->StatEntries();
+	return NULL;
+}
+
+void DirectoryScanner::Notify()
+{
+	uint64_t one = 1;
+	if (write(fEventFd, &one, sizeof(one)) != sizeof(one)) {
+		// counter is already non-zero, nothing to do
+	}
+}
+
+void DirectoryScanner::ListEntries()
+{
+	enum { eBatchSize = 64 };
+	std::vector<char*> batch;
+
+	DIR* dir = 0;
+	int fd = dup(fDirFd);
+	if (fd >= 0) {
+		dir = fdopendir(fd);
+		if (!dir) {
+			close(fd);
+		}
+	}
+
+	struct dirent* de;
+	while (dir && (de = readdir(dir)) != NULL) {
+		if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+			continue;
+		}
+		char* name = new char[strlen(de->d_name) + 1];
+		strcpy(name, de->d_name);
+		batch.push_back(name);
+
+		if (batch.size() >= eBatchSize) {
+			pthread_mutex_lock(&fMutex);
+			bool stop = fStop;
+			fPendingNames.insert(fPendingNames.end(), batch.begin(), batch.end());
+			pthread_cond_broadcast(&fCond);
+			pthread_mutex_unlock(&fMutex);
+			batch.clear();
+			if (stop) {
+				break;
+			}
+		}
+	}
+	if (dir) {
+		closedir(dir);
+	}
+
+	pthread_mutex_lock(&fMutex);
+	fPendingNames.insert(fPendingNames.end(), batch.begin(), batch.end());
+	fListingDone = true;
+	pthread_cond_broadcast(&fCond);
+	pthread_mutex_unlock(&fMutex);
+}
+
+void DirectoryScanner::StatEntries()
+{
+	pthread_mutex_lock(&fMutex);
+	while (true) {
+		while (!fStop && fPendingNames.empty() && !fListingDone) {
+			pthread_cond_wait(&fCond, &fMutex);
+		}
+		if (fStop || fPendingNames.empty()) {
+			break;
+		}
+		char* name = fPendingNames.back();
+		fPendingNames.pop_back();
+		pthread_mutex_unlock(&fMutex);
+
+		DirEntry* entry = 0;
+		struct stat statbuf;
+		if (fstatat(fDirFd, name, &statbuf, 0) == 0) {
+			if (S_ISREG(statbuf.st_mode)) {
+				entry = new DirEntry(name, DirEntry::eFile, statbuf.st_size);
+			} else if (S_ISDIR(statbuf.st_mode)) {
+				entry = new DirEntry(name, DirEntry::eDirectory, statbuf.st_size);
+			}
+		}
+		delete[] name;
+
+		pthread_mutex_lock(&fMutex);
+		if (entry) {
+			fResults.push_back(entry);
+			if (fResults.size() == 1) {
+				Notify();
+			}
+		}
+	}
+	fRunningStatThreads--;
+	if (fRunningStatThreads == 0) {
+		Notify();
+	}
+	pthread_mutex_unlock(&fMutex);
+}
+
+bool DirectoryScanner::ProcessPollEvent()
+{
+	uint64_t count;
+	if (read(fEventFd, &count, sizeof(count)) != sizeof(count)) {
+		return false;
+	}
+	std::vector<DirEntry*> results;
+	pthread_mutex_lock(&fMutex);
+	results.swap(fResults);
+	bool done = (fRunningStatThreads == 0) && !fStop;
+	pthread_mutex_unlock(&fMutex);
+
+	if (results.size()) {
+		fDirectory->AddSortedEntries(&results[0], results.size());
+	}
+	if (done && !fFinished) {
+		fFinished = true;
+		fDirectory->SetComplete(true);
+		return true;
+	}
+	return results.size() > 0;
+}
@@ -0,0 +1,88 @@
+#ifndef DIRECTORYSCANNER_H
+#define DIRECTORYSCANNER_H
+
+/*
+   DirectoryScanner.h - read a directory in the background
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <pthread.h>
+#include <vector>
+
+#include "AbstractPollHandler.h"
+#include "Directory.h"
+#include "RCPtr.h"
+
+// Fills a sorted Directory without blocking the SIO loop. One thread
+// reads the names, a small pool of threads stats them relative to
+// the directory descriptor (which is what takes time on network
+// filesystems). Results are merged into the directory in
+// ProcessPollEvent, ie in the thread that runs DoServing.
+
+class DirectoryScanner : public AbstractPollHandler {
+public:
+	DirectoryScanner(const RCPtr<Directory>& directory);
+	virtual ~DirectoryScanner();
+
+	// start reading path, the directory is reset to only contain ".."
+	bool Start(const char* path);
+
+	// wait for running threads to finish and drop pending results
+	void Stop();
+
+	// true when all entries have been added to the directory
+	bool IsFinished() const { return fFinished; }
+
+	virtual int GetFileDescriptor() const;
+
+	// returns true if entries were added or the scan finished
+	virtual bool ProcessPollEvent();
+
+private:
+	enum { eNumberOfStatThreads = 4 };
+
+	static void* ListThreadFunc(void* arg);
+	static void* StatThreadFunc(void* arg);
+	void ListEntries();
+	void StatEntries();
+
+	void Notify();
+
+	RCPtr<Directory> fDirectory;
+
+	int fDirFd;
+	int fEventFd;
+
+	pthread_t fListThread;
+	pthread_t fStatThread[eNumberOfStatThreads];
+	unsigned int fNumberOfThreads;
+
+	// everything below is protected by fMutex
+	pthread_mutex_t fMutex;
+	pthread_cond_t fCond;
+
+	std::vector<char*> fPendingNames;
+	std::vector<DirEntry*> fResults;
+	bool fListingDone;
+	unsigned int fRunningStatThreads;
+	bool fStop;
+
+	bool fFinished;
+};
+
+#endif
@@ -41,7 +41,7 @@ typedef enum {
 
 inline ESectorLength SectorLength(bool isDD) { if (isDD) { return e256BytesPerSector; } else { return e128BytesPerSector; } }
 
-class DiskImage : public RefCounted {
+class DiskImage : public ThreadSafeRefCounted {
 public:
 
 	DiskImage();
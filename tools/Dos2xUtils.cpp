@@ -26,6 +26,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <algorithm>
 
 #include "OS.h"
 #include "Dos2xUtils.h"
@@ -37,6 +38,7 @@ using namespace MiscUtils;
 #include "MyPicoDosCode.h"
 #include "SIOTracer.h"
 #include "FileIO.h"
+#include "AtrMemoryImage.h"
 
 #include "winver.h"
 
@@ -55,7 +57,8 @@ Dos2xUtils::Dos2xUtils(RCPtr<DiskImage> img,
 	  fIsDos25EnhancedDensity(false),
 	  fUse16BitSectorLinks(false),
 	  fNumberOfVTOCs(0),
-	  fIsRootDirectory(false)
+	  fIsRootDirectory(false),
+	  fPicoNameType(eNoPicoName)
 {
 	Assert(fImage);
 
@@ -82,6 +85,9 @@ Dos2xUtils::Dos2xUtils(RCPtr<DiskImage> img,
 	for (i=0;i<eMaxEntries;i++) {
 		fOrigName[i] = 0;
 		fAtariName[i] = 0;
+		fHostSize[i] = 0;
+		fHostMTime[i] = 0;
+		fWriteStream[i] = 0;
 	}
 	if (fObserver) {
 		fObserver->SetDirectoryObserver(fDirSector, this);
@@ -104,7 +110,8 @@ Dos2xUtils::Dos2xUtils( DiskImage* img,
 	  fIsDos25EnhancedDensity(isDos25ED),
 	  fUse16BitSectorLinks(use16BitLinks),
 	  fNumberOfVTOCs(numVTOC),
-	  fIsRootDirectory(false)
+	  fIsRootDirectory(false),
+	  fPicoNameType(eNoPicoName)
 {
 	Assert(fImage);
 	Assert(directory);
@@ -129,6 +136,9 @@ Dos2xUtils::Dos2xUtils( DiskImage* img,
 	for (i=0;i<eMaxEntries;i++) {
 		fOrigName[i] = 0;
 		fAtariName[i] = 0;
+		fHostSize[i] = 0;
+		fHostMTime[i] = 0;
+		fWriteStream[i] = 0;
 	}
 	if (fObserver) {
 		fObserver->SetDirectoryObserver(fDirSector, this);
@@ -137,6 +147,9 @@ Dos2xUtils::Dos2xUtils( DiskImage* img,
 
 Dos2xUtils::~Dos2xUtils()
 {
+	for (unsigned int i=0;i<eMaxEntries;i++) {
+		AbortWriteStream(i);
+	}
 	if (fObserver) {
 		fObserver->RemoveDirectoryObserver(fDirSector, this);
 	}
@@ -161,13 +174,12 @@ bool Dos2xUtils::AddFiles(EPicoNameType piconametype)
 		DPRINTF("AddFiles: directory is NULL");
 		return false;
 	}
+	fPicoNameType = piconametype;
 	RCPtr<Directory> dir = new Directory();
 	int num = dir->ReadDirectory(fDirectory, true);
 	//DPRINTF("ReadDirectory(\"%s\") returned %d", fDirectory, num);
 	bool recurseSubdirs = (GetDosFormat() == eMyDos);
 	int i;
-	unsigned int entryNum;
-	unsigned int dirsec;
 	for (i=fEntryCount ; (fEntryCount < eMaxEntries) && i<num ; i++) {
 		DirEntry* e = dir->Get(i);
 		//DPRINTF("AddFiles(%s): processing %s", fDirectory, e->fName);
@@ -179,19 +191,8 @@ bool Dos2xUtils::AddFiles(EPicoNameType piconametype)
 			break;
 		case DirEntry::eDirectory:
 			if (recurseSubdirs) {
-				dirsec = AddDirectory(e->fName, entryNum);
-				if (dirsec == 0) {
+				if (!AddSubdirectory(e->fName, piconametype)) {
 					ok = false;
-				} else {
-					char newpath[PATH_MAX];
-					snprintf(newpath, PATH_MAX-1, "%s%c%s", fDirectory, DIR_SEPARATOR, e->fName);
-					newpath[PATH_MAX-1] = 0;
-					fSubdir[entryNum] = new Dos2xUtils(fImage, newpath, fObserver, dirsec,
-						fDosFormat, fIsDos25EnhancedDensity, fUse16BitSectorLinks,
-						fNumberOfVTOCs);
-					if (!fSubdir[entryNum]->AddFiles(piconametype)) {
-						ok = false;
-					}
 				}
 			} else {
 			}
@@ -224,6 +225,11 @@ bool Dos2xUtils::AddFiles(EPicoNameType piconametype)
 	return ok;
 }
 
+void Dos2xUtils::SetHostFileSource(const RCPtr<HostFileSectorSource>& source)
+{
+	fHostFiles = source;
+}
+
 bool Dos2xUtils::AddFile(const char* name)
 {
 	char p[PATH_MAX];
@@ -276,7 +282,7 @@ bool Dos2xUtils::AddFile(const char* name)
 		return false;
 	}
 
-	if (filelen > 0) {
+	if (filelen > 0 && fHostFiles.IsNull()) {
 		buffer = new uint8_t[filelen];
 		if (fread(buffer, 1, filelen, f) != (size_t) filelen) {
 			AERROR("reading file \"%s\" failed", p);
@@ -325,10 +331,15 @@ bool Dos2xUtils::AddFile(const char* name)
 	}
 
 
-	WriteBufferToImage(entryNum, buffer, filelen, sectors, fileSeclen, sector720);
+	if (fHostFiles.IsNotNull()) {
+		MapHostFileToImage(entryNum, p, filelen, sectors, fileSeclen, sector720);
+	} else {
+		WriteBufferToImage(entryNum, buffer, filelen, sectors, fileSeclen, sector720);
+	}
 
 	unsigned int startsec = sectors[0];
 	SetAtariDirectory(entryNum, atariname, sector720, false, startsec, fileSeclen);
+	RecordHostFileState(entryNum, p);
 	ALOG("Added file \"%s\"", p);
 
 	delete[] sectors;
@@ -338,6 +349,23 @@ bool Dos2xUtils::AddFile(const char* name)
 	return true;
 }
 
+bool Dos2xUtils::AddSubdirectory(const char* name, EPicoNameType piconametype)
+{
+	unsigned int entryNum;
+	unsigned int dirsec = AddDirectory(name, entryNum);
+	if (dirsec == 0) {
+		return false;
+	}
+	char newpath[PATH_MAX];
+	snprintf(newpath, PATH_MAX-1, "%s%c%s", fDirectory, DIR_SEPARATOR, name);
+	newpath[PATH_MAX-1] = 0;
+	fSubdir[entryNum] = new Dos2xUtils(fImage, newpath, fObserver, dirsec,
+		fDosFormat, fIsDos25EnhancedDensity, fUse16BitSectorLinks,
+		fNumberOfVTOCs);
+	fSubdir[entryNum]->SetHostFileSource(fHostFiles);
+	return fSubdir[entryNum]->AddFiles(piconametype);
+}
+
 unsigned int Dos2xUtils::AddDirectory(const char* name, unsigned int& entryNum)
 {
 	char p[PATH_MAX];
@@ -467,6 +495,56 @@ bool Dos2xUtils::WriteBufferToImage(
 	return true;
 }
 
+bool Dos2xUtils::MapHostFileToImage(
+	unsigned int entryNum,
+	const char* path, unsigned int filelen,
+	const unsigned int* sectors, unsigned int num_sectors,
+	bool& sector720)
+{
+	bool use16BitLinks = Use16BitSectorLinks();
+	unsigned int seclen = fImage->GetSectorLength();
+	unsigned int remain = filelen;
+	unsigned int bytes;
+	unsigned int next;
+	sector720 = false;
+	unsigned int i;
+	unsigned int file = fHostFiles->AddFile(path);
+	// the file might have been replaced on the host
+	fHostFiles->CloseFile();
+
+	// sectors might still hold data of a previously deleted file
+	AtrMemoryImage* lazyImage = 0;
+	if (fImage->IsAtrImage() && static_cast<AtrImage*>(fImage)->IsAtrMemoryImage()) {
+		lazyImage = static_cast<AtrMemoryImage*>(fImage);
+	}
+	for (i=0;i<num_sectors;i++) {
+		if (remain > seclen - 3) {
+			bytes = seclen - 3;
+		} else {
+			bytes = remain;
+		}
+		remain -= bytes;
+
+		if (i+1 < num_sectors) {
+			next = sectors[i+1];
+		} else {
+			next = 0;
+		}
+		if (!use16BitLinks) {
+			next &= 1023;
+			next |= entryNum << 10;
+		}
+		fHostFiles->MapSector(sectors[i], file, i*(seclen-3), (next << 8) | bytes);
+		if (lazyImage) {
+			lazyImage->DiscardLazySector(sectors[i]);
+		}
+		if (sectors[i] >= 720) {
+			sector720 = true;
+		}
+	}
+	return true;
+}
+
 bool Dos2xUtils::SetAtariDirectory(
 	unsigned int entryNum,
 	const char* atariname,
@@ -525,11 +603,10 @@ bool Dos2xUtils::AddEntry(const char* longname, char*& atariname, unsigned int&
 
 bool Dos2xUtils::AddEntry(const char* atariname, bool allowNameChange, unsigned int& entryNumber)
 {
-	if (fEntryCount == eMaxEntries) {
+	if (!FindFreeEntry(entryNumber)) {
 		AERROR("directory full - skipping %s", atariname);
 		return false;
 	}
-	entryNumber = fEntryCount;
 
 	fAtariName[entryNumber] = new char[12];
 	memcpy(fAtariName[entryNumber], atariname, 12);
@@ -559,7 +636,9 @@ bool Dos2xUtils::AddEntry(const char* atariname, bool allowNameChange, unsigned
 		return false;
 	}
 
-	fEntryCount++;
+	if (entryNumber >= fEntryCount) {
+		fEntryCount = entryNumber + 1;
+	}
 	return true;
 }
 
@@ -626,9 +705,21 @@ void Dos2xUtils::BuildAtariName(const char* name, char* atariname)
 
 bool Dos2xUtils::CheckNameUnique(unsigned int entryNum)
 {
+	uint8_t status[eMaxEntries];
+	char names[eMaxEntries][12];
+	bool haveDir = ReadDirectoryStatus(status, names);
+
 	unsigned int i;
-	for (i=0;i<entryNum;i++) {
-		if (strcmp(fAtariName[i], fAtariName[entryNum]) == 0) {
+	for (i=0;i<eMaxEntries;i++) {
+		if (i == entryNum) {
+			continue;
+		}
+		if (fAtariName[i] && strcmp(fAtariName[i], fAtariName[entryNum]) == 0) {
+			return false;
+		}
+		// files created by the Atari
+		if (haveDir && status[i] != 0 && status[i] != 0x80
+		    && strcmp(names[i], fAtariName[entryNum]) == 0) {
 			return false;
 		}
 	}
@@ -720,6 +811,8 @@ bool Dos2xUtils::WriteAtariFileToDisk(
 		return false;
 	}
 
+	DetachHostFile(filename);
+
 	FILE *f;
 	if (!(f=fopen(filename,"wb"))) {
 		AERROR("unable to create file \"%s\"", filename);
@@ -773,48 +866,558 @@ fail:
 	return false;
 }
 
-void Dos2xUtils::IndicateSectorWrite(unsigned int sector)
+void Dos2xUtils::DetachHostFile(const char* path)
+{
+	unsigned int file;
+	if (fHostFiles.IsNull() || !fHostFiles->FindFile(path, file)) {
+		return;
+	}
+	uint8_t buf[256];
+	unsigned int len = fImage->GetSectorLength();
+	unsigned int sector;
+	while ((sector = fHostFiles->GetFirstSectorOfFile(file)) != 0) {
+		if (fImage->ReadSector(sector, buf, len)) {
+			fImage->WriteSector(sector, buf, len);
+		}
+		fHostFiles->UnmapSector(sector);
+	}
+	fHostFiles->CloseFile();
+}
+
+void Dos2xUtils::RecordHostFileState(unsigned int entryNum, const char* path)
+{
+	struct stat statbuf;
+	if (stat(path, &statbuf) == 0) {
+		fHostSize[entryNum] = statbuf.st_size;
+		fHostMTime[entryNum] = statbuf.st_mtime;
+	} else {
+		fHostSize[entryNum] = 0;
+		fHostMTime[entryNum] = 0;
+	}
+}
+
+bool Dos2xUtils::ReadDirectoryStatus(uint8_t* status, char names[][12]) const
+{
+	unsigned int seclen = fImage->GetSectorLength();
+	uint8_t buf[256];
+	for (unsigned int s = 0; s < 8; s++) {
+		if (!fImage->ReadSector(fDirSector + s, buf, seclen)) {
+			return false;
+		}
+		for (unsigned int i = 0; i < 8; i++) {
+			status[s*8 + i] = buf[i*16];
+			memcpy(names[s*8 + i], buf + i*16 + 5, 11);
+			names[s*8 + i][11] = 0;
+		}
+	}
+	return true;
+}
+
+bool Dos2xUtils::FindFreeEntry(unsigned int& entryNum) const
+{
+	uint8_t status[eMaxEntries];
+	char names[eMaxEntries][12];
+	if (!ReadDirectoryStatus(status, names)) {
+		return false;
+	}
+	for (unsigned int i = 0; i < eMaxEntries; i++) {
+		if ((status[i] == 0 || status[i] == 0x80) && fAtariName[i] == 0) {
+			entryNum = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Dos2xUtils::FindHostEntry(const char* name, const uint8_t* status, unsigned int& entryNum) const
+{
+	for (unsigned int i = 0; i < eMaxEntries; i++) {
+		if (status[i] == 0 || status[i] == 0x80) {
+			continue;
+		}
+		if (fOrigName[i] && strcmp(fOrigName[i], name) == 0) {
+			entryNum = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Dos2xUtils::DeleteFileEntry(unsigned int entryNum)
+{
+	unsigned int seclen = fImage->GetSectorLength();
+	unsigned int numsec = fImage->GetNumberOfSectors();
+	uint8_t buf[256];
+	uint8_t secbuf[256];
+	unsigned int dirsec = fDirSector + (entryNum >> 3);
+	unsigned int offset = (entryNum & 7) << 4;
+
+	if (!fImage->ReadSector(dirsec, buf, seclen)) {
+		return false;
+	}
+	bool use16BitLinks = (buf[offset] & 4) == 4;
+	unsigned int count = buf[offset + 1] + (buf[offset + 2] << 8);
+	unsigned int sector = buf[offset + 3] + (buf[offset + 4] << 8);
+
+	// the sector data is left untouched so an Atari currently
+	// reading the file still gets a consistent chain
+	while (sector && count) {
+		if (sector < 4 || sector > numsec) {
+			DPRINTF("illegal sector %d in file chain", sector);
+			break;
+		}
+		if (!fImage->ReadSector(sector, secbuf, seclen)) {
+			break;
+		}
+		unsigned int next;
+		if (use16BitLinks) {
+			next = secbuf[seclen-2] + (secbuf[seclen-3] << 8);
+		} else {
+			next = secbuf[seclen-2] + ((secbuf[seclen-3] & 3)<< 8);
+		}
+		FreeSector(sector);
+		sector = next;
+		count--;
+	}
+
+	buf[offset] = 0x80;
+	fImage->WriteSector(dirsec, buf, seclen);
+	IndicateDeleteEntry(entryNum, fAtariName[entryNum]);
+	return true;
+}
+
+void Dos2xUtils::GetDirectoryTree(std::vector< RCPtr<Dos2xUtils> >& list)
+{
+	list.push_back(this);
+	for (unsigned int i = 0; i < eMaxEntries; i++) {
+		if (fSubdir[i].IsNotNull()) {
+			fSubdir[i]->GetDirectoryTree(list);
+		}
+	}
+}
+
+bool Dos2xUtils::HasOpenFiles() const
+{
+	uint8_t status[eMaxEntries];
+	char names[eMaxEntries][12];
+	if (!ReadDirectoryStatus(status, names)) {
+		return false;
+	}
+	for (unsigned int i = 0; i < eMaxEntries; i++) {
+		// DOS sets bit 0 while a file is open for writing, closed
+		// DOS 2.5 files above sector 720 have bit 0 but not bit 6 set
+		if ((status[i] & 0x41) == 0x41) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool Dos2xUtils::SyncWithHostDirectory(bool& changed, bool& complete)
 {
-	if (sector < fDirSector || sector > fDirSector + 7) {
+	changed = false;
+	complete = true;
+	if (!fDirectory) {
+		return false;
+	}
+	if (HasOpenFiles()) {
+		// DOS keeps the VTOC in memory while a file is open
+		return false;
+	}
+
+	uint8_t status[eMaxEntries];
+	char names[eMaxEntries][12];
+	if (!ReadDirectoryStatus(status, names)) {
+		return false;
+	}
+
+	char path[PATH_MAX];
+	char name[PATH_MAX];
+	struct stat statbuf;
+	unsigned int i;
+
+	// files removed or changed on the host
+	for (i=0;i<eMaxEntries;i++) {
+		if (!fOrigName[i] || fHostMTime[i] == 0 || fSubdir[i].IsNotNull()) {
+			continue;
+		}
+		if (status[i] == 0 || status[i] == 0x80 || (status[i] & 0x10)) {
+			continue;
+		}
+		if (fIsRootDirectory) {
+			snprintf(path, PATH_MAX-1, "%s%s", fDirectory, fOrigName[i]);
+		} else {
+			snprintf(path, PATH_MAX-1, "%s%c%s", fDirectory, DIR_SEPARATOR, fOrigName[i]);
+		}
+		path[PATH_MAX-1] = 0;
+
+		bool removed = (stat(path, &statbuf) != 0) || !S_ISREG(statbuf.st_mode);
+		if (!removed && statbuf.st_size == fHostSize[i] && statbuf.st_mtime == fHostMTime[i]) {
+			continue;
+		}
+		strncpy(name, fOrigName[i], PATH_MAX-1);
+		name[PATH_MAX-1] = 0;
+
+		DeleteFileEntry(i);
+		changed = true;
+		if (removed) {
+			ALOG("Removed file \"%s\"", path);
+		} else if (!AddFile(name)) {
+			complete = false;
+		}
+	}
+
+	// files and directories added on the host
+	RCPtr<Directory> dir = new Directory();
+	int num = dir->ReadDirectory(fDirectory, true);
+	bool recurseSubdirs = (GetDosFormat() == eMyDos);
+	for (int n=0;n<num;n++) {
+		DirEntry* e = dir->Get(n);
+		if (e->fType != DirEntry::eFile && !(e->fType == DirEntry::eDirectory && recurseSubdirs)) {
+			continue;
+		}
+		if (!ReadDirectoryStatus(status, names)) {
+			return false;
+		}
+		unsigned int entryNum;
+		if (FindHostEntry(e->fName, status, entryNum)) {
+			continue;
+		}
+		if (e->fType == DirEntry::eFile) {
+			if (!AddFile(e->fName)) {
+				complete = false;
+			}
+		} else {
+			if (!AddSubdirectory(e->fName, fPicoNameType)) {
+				complete = false;
+			}
+		}
+		changed = true;
+	}
+
+	if (changed && fPicoNameType != eNoPicoName) {
+		if (!ReadDirectoryStatus(status, names)) {
+			return false;
+		}
+		for (i=0;i<eMaxEntries;i++) {
+			if (status[i] != 0 && status[i] != 0x80 && !fOrigName[i]
+			    && fAtariName[i] && strcmp(fAtariName[i], "PICONAMETXT") == 0) {
+				DeleteFileEntry(i);
+			}
+		}
+		if (!CreatePiconame(fPicoNameType)) {
+			AERROR("updating PICONAME.TXT failed!");
+			complete = false;
+		}
+	}
+	return true;
+}
+
+bool Dos2xUtils::AttachDirectory(EPicoNameType piconametype)
+{
+	uint8_t status[eMaxEntries];
+	char names[eMaxEntries][12];
+	if (!ReadDirectoryStatus(status, names)) {
+		return false;
+	}
+	if (fNumberOfVTOCs == 0) {
+		fNumberOfVTOCs = CalculateNumberOfVTOCs();
+	}
+	fPicoNameType = piconametype;
+	for (unsigned int i = 0; i < eMaxEntries; i++) {
+		if (status[i] == 0 || status[i] == 0x80 || fAtariName[i]) {
+			continue;
+		}
+		fAtariName[i] = new char[12];
+		memcpy(fAtariName[i], names[i], 12);
+		if (i >= fEntryCount) {
+			fEntryCount = i + 1;
+		}
+	}
+	return true;
+}
+
+bool Dos2xUtils::AttachHostFile(unsigned int entryNum, const char* name, off_t size, time_t mtime)
+{
+	uint8_t status[eMaxEntries];
+	char names[eMaxEntries][12];
+	if (entryNum >= eMaxEntries || !fAtariName[entryNum] || fOrigName[entryNum]) {
+		return false;
+	}
+	if (!ReadDirectoryStatus(status, names) || (status[entryNum] & 0x10)) {
+		return false;
+	}
+	fOrigName[entryNum] = new char[strlen(name) + 1];
+	strcpy(fOrigName[entryNum], name);
+	fHostSize[entryNum] = size;
+	fHostMTime[entryNum] = mtime;
+	return true;
+}
+
+RCPtr<Dos2xUtils> Dos2xUtils::AttachHostDirectory(unsigned int entryNum, const char* name)
+{
+	if (entryNum >= eMaxEntries || !fAtariName[entryNum] || fOrigName[entryNum]
+	    || !fDirectory || GetDosFormat() != eMyDos) {
+		return RCPtr<Dos2xUtils>();
+	}
+	unsigned int seclen = fImage->GetSectorLength();
+	uint8_t buf[256];
+	if (!fImage->ReadSector(fDirSector + (entryNum >> 3), buf, seclen)) {
+		return RCPtr<Dos2xUtils>();
+	}
+	unsigned int offset = (entryNum & 7) << 4;
+	unsigned int dirsec = buf[offset + 3] + (buf[offset + 4] << 8);
+	if (!(buf[offset] & 0x10) || dirsec < 4 || dirsec + 7 > fImage->GetNumberOfSectors()) {
+		return RCPtr<Dos2xUtils>();
+	}
+
+	char newpath[PATH_MAX];
+	snprintf(newpath, PATH_MAX-1, "%s%c%s", fDirectory, DIR_SEPARATOR, name);
+	newpath[PATH_MAX-1] = 0;
+
+	RCPtr<Dos2xUtils> subdir = new Dos2xUtils(fImage, newpath, fObserver, dirsec,
+		fDosFormat, fIsDos25EnhancedDensity, fUse16BitSectorLinks,
+		fNumberOfVTOCs);
+	subdir->SetHostFileSource(fHostFiles);
+	if (!subdir->AttachDirectory(fPicoNameType)) {
+		return RCPtr<Dos2xUtils>();
+	}
+	fOrigName[entryNum] = new char[strlen(name) + 1];
+	strcpy(fOrigName[entryNum], name);
+	fSubdir[entryNum] = subdir;
+	return subdir;
+}
+
+const char* Dos2xUtils::GetHostName(unsigned int entryNum) const
+{
+	if (entryNum >= eMaxEntries) {
+		return 0;
+	}
+	return fOrigName[entryNum];
+}
+
+void Dos2xUtils::GetHostFileState(unsigned int entryNum, off_t& size, time_t& mtime) const
+{
+	if (entryNum >= eMaxEntries) {
+		size = 0;
+		mtime = 0;
+	} else {
+		size = fHostSize[entryNum];
+		mtime = fHostMTime[entryNum];
+	}
+}
+
+RCPtr<Dos2xUtils> Dos2xUtils::GetSubdirectory(unsigned int entryNum) const
+{
+	if (entryNum >= eMaxEntries) {
+		return RCPtr<Dos2xUtils>();
+	}
+	return fSubdir[entryNum];
+}
+
+void Dos2xUtils::IndicateEntryWrite(unsigned int sector, unsigned int slot,
+	const uint8_t* oldEntry, const uint8_t* newEntry)
+{
+	if (sector < fDirSector || sector > fDirSector + 7 || slot > 7) {
 		DPRINTF("invalid notification for sector %d", sector);
 		return;
 	}
-	if (!fObserver) {
-		DPRINTF("virtual image observer is NULL");
+	unsigned int entryNum = (sector - fDirSector) * 8 + slot;
+	uint8_t oldstat = oldEntry[0];
+	uint8_t newstat = newEntry[0];
+	if (oldstat == newstat) {
 		return;
 	}
-	uint8_t* oldBuf = fObserver->fOldSectorBuffer;
-	uint8_t* newBuf = fObserver->fNewSectorBuffer;
+	//DPRINTF("status change %d: %02x->%02x", entryNum, oldstat, newstat);
+	char atariname[12];
+	memcpy(atariname, newEntry+5, 11);
+	atariname[11] = 0;
+	unsigned int startsec = newEntry[3] + (newEntry[4]<<8);
+
+	if (newstat == 0x80 || newstat == 0) {
+		IndicateDeleteEntry(entryNum, atariname);
+	} else if ((oldstat & 0x43) == 0x43 && (newstat & 0x42) == 0x42) {
+		// DOS 2.x close file
+		IndicateCloseFile(entryNum, atariname, startsec, newstat);
+	} else if ((oldstat & 0x43) == 0x43 && (newstat & 0x43) == 0x03) {
+		// DOS 2.5 close file for files with sectors > 720
+		IndicateCloseFile(entryNum, atariname, startsec, newstat);
+	} else if ((newstat & 0x43) == 0x43) {
+		IndicateOpenFile(entryNum, atariname, startsec, newstat);
+	} else if ((oldstat & 0x10) == 0 && (newstat & 0x10) == 0x10) {
+		IndicateCreateDirectory(entryNum, atariname, startsec);
+	} else {
+		DPRINTF("unhandeled status change %d: %02x->%02x", entryNum, oldstat, newstat);
+	}
+}
 
-	int i, base;
-	base = (sector - fDirSector) * 8;
-	for (i=0;i<8;i++) {
-		uint8_t oldstat = oldBuf[i*16];
-		uint8_t newstat = newBuf[i*16];
-		if (oldstat != newstat) {
-			//DPRINTF("status change %d: %02x->%02x", i+base, oldstat, newstat);
-			char atariname[12];
-			memcpy(atariname, newBuf+i*16+5, 11);
-			atariname[11] = 0;
-			unsigned int sector = newBuf[i*16+3] + (newBuf[i*16+4]<<8);
-
-			if (newstat == 0x80 || newstat == 0) {
-				IndicateDeleteEntry(i+base, atariname);
-			} else if ((oldstat & 0x43) == 0x43 && (newstat & 0x42) == 0x42) {
-				// DOS 2.x close file
-				IndicateCloseFile(i+base, atariname, sector, newstat);
-			} else if ((oldstat & 0x43) == 0x43 && (newstat & 0x43) == 0x03) {
-				// DOS 2.5 close file for files with sectors > 720
-				IndicateCloseFile(i+base, atariname, sector, newstat);
-			} else if ((oldstat & 0x10) == 0 && (newstat & 0x10) == 0x10) {
-				IndicateCreateDirectory(i+base, atariname, sector);
-			} else {
-				DPRINTF("unhandeled status change %d: %02x->%02x", i+base, oldstat, newstat);
+void Dos2xUtils::IndicateOpenFile(unsigned int entryNum, const char* atariname, unsigned int sector, uint8_t fileStat)
+{
+	AbortWriteStream(entryNum);
+	if (!fObserver || sector < 4 || sector > fImage->GetNumberOfSectors()) {
+		return;
+	}
+	char* origname = GetOrigName(entryNum, atariname);
+	if (origname == NULL) {
+		DPRINTF("unable to get original name of \"%s\"", atariname);
+		return;
+	}
+
+	DetachHostFile(origname);
+
+	// keep the host file intact until the Atari closed the file
+	static const char tmpSuffix[] = ".atarisio-tmp";
+	char* tmpname = new char[strlen(origname) + sizeof(tmpSuffix)];
+	strcpy(tmpname, origname);
+	strcat(tmpname, tmpSuffix);
+
+	FILE* f = fopen(tmpname, "wb");
+	if (!f) {
+		// try again with a complete write when the file is closed
+		DPRINTF("unable to create file \"%s\"", tmpname);
+		delete[] tmpname;
+		delete[] origname;
+		return;
+	}
+	WriteStream* stream = new WriteStream;
+	stream->fFile = f;
+	stream->fPath = origname;
+	stream->fTmpPath = tmpname;
+	stream->fLength = 0;
+	stream->fNextSector = 0;
+	stream->fUse16BitLinks = (fileStat & 4) == 4;
+	stream->fValid = true;
+	fWriteStream[entryNum] = stream;
+	SetStreamNextSector(stream, sector);
+}
+
+void Dos2xUtils::SetStreamNextSector(WriteStream* stream, unsigned int sector)
+{
+	unsigned int old = stream->fNextSector;
+	if (old == sector) {
+		return;
+	}
+	if (old && std::find(stream->fSectors.begin(), stream->fSectors.end(), old) == stream->fSectors.end()) {
+		fObserver->RemoveFileObserver(old, this);
+	}
+	stream->fNextSector = sector;
+	if (sector) {
+		fObserver->SetFileObserver(sector, this);
+	}
+}
+
+void Dos2xUtils::IndicateFileSectorWrite(unsigned int sector, const uint8_t* data)
+{
+	WriteStream* stream = 0;
+	unsigned int idx = 0;
+	for (unsigned int e = 0; e < eMaxEntries && !stream; e++) {
+		WriteStream* s = fWriteStream[e];
+		if (!s || !s->fValid) {
+			continue;
+		}
+		std::vector<unsigned int>::iterator it = std::find(s->fSectors.begin(), s->fSectors.end(), sector);
+		if (it != s->fSectors.end()) {
+			// the Atari rewrote a sector, drop everything after it
+			stream = s;
+			idx = it - s->fSectors.begin();
+			for (unsigned int i = idx + 1; i < s->fSectors.size(); i++) {
+				if (s->fSectors[i] != s->fNextSector) {
+					fObserver->RemoveFileObserver(s->fSectors[i], this);
+				}
 			}
+			s->fSectors.resize(idx + 1);
+			s->fOffsets.resize(idx + 1);
+		} else if (s->fNextSector == sector) {
+			stream = s;
+			idx = s->fSectors.size();
+			s->fSectors.push_back(sector);
+			s->fOffsets.push_back(s->fLength);
 		}
 	}
-	i=0;
-	return;
+	if (!stream) {
+		return;
+	}
+
+	unsigned int seclen = fImage->GetSectorLength();
+	unsigned int numsec = fImage->GetNumberOfSectors();
+	unsigned int bytes = data[seclen-1];
+	unsigned int next;
+	if (stream->fUse16BitLinks) {
+		next = data[seclen-2] + (data[seclen-3] << 8);
+	} else {
+		next = data[seclen-2] + ((data[seclen-3] & 3) << 8);
+	}
+	if (bytes > seclen - 3 || (next && (next < 4 || next > numsec))) {
+		// not a DOS data sector, leave it to the check on close
+		stream->fValid = false;
+		return;
+	}
+
+	long offset = stream->fOffsets[idx];
+	if (fseek(stream->fFile, offset, SEEK_SET) ||
+		(bytes && fwrite(data, 1, bytes, stream->fFile) != bytes)) {
+		AERROR("unable to write file \"%s\"", stream->fPath);
+		stream->fValid = false;
+		return;
+	}
+	stream->fLength = offset + bytes;
+	SetStreamNextSector(stream, next);
+}
+
+bool Dos2xUtils::FinishWriteStream(unsigned int entryNum, unsigned int startSector)
+{
+	WriteStream* stream = fWriteStream[entryNum];
+	if (!stream) {
+		return false;
+	}
+	bool ok = stream->fValid
+		&& stream->fNextSector == 0
+		&& stream->fSectors.size()
+		&& stream->fSectors[0] == startSector;
+	if (ok) {
+		// a rewritten last sector might have shortened the file
+		if (fflush(stream->fFile) || ftruncate(fileno(stream->fFile), stream->fLength)) {
+			ok = false;
+		}
+	}
+	if (fclose(stream->fFile)) {
+		ok = false;
+	}
+	stream->fFile = 0;
+	if (ok && rename(stream->fTmpPath, stream->fPath)) {
+		AERROR("unable to rename \"%s\" to \"%s\"", stream->fTmpPath, stream->fPath);
+		ok = false;
+	}
+	if (!ok) {
+		unlink(stream->fTmpPath);
+	}
+	AbortWriteStream(entryNum);
+	return ok;
+}
+
+void Dos2xUtils::AbortWriteStream(unsigned int entryNum)
+{
+	WriteStream* stream = fWriteStream[entryNum];
+	if (!stream) {
+		return;
+	}
+	if (fObserver) {
+		for (unsigned int i = 0; i < stream->fSectors.size(); i++) {
+			fObserver->RemoveFileObserver(stream->fSectors[i], this);
+		}
+		if (stream->fNextSector) {
+			fObserver->RemoveFileObserver(stream->fNextSector, this);
+		}
+	}
+	if (stream->fFile) {
+		// the host file is left untouched
+		fclose(stream->fFile);
+		unlink(stream->fTmpPath);
+	}
+	delete[] stream->fPath;
+	delete[] stream->fTmpPath;
+	delete stream;
+	fWriteStream[entryNum] = 0;
 }
 
 void Dos2xUtils::IndicateDeleteEntry(unsigned int num, const char* /*atariname*/)
@@ -824,6 +1427,8 @@ void Dos2xUtils::IndicateDeleteEntry(unsigned int num, const char* /*atariname*/
 		DPRINTF("IndicateDeleteEntry: invalid entry %d", num);
 		return;
 	}
+	// the Atari deleted a file it was still writing
+	AbortWriteStream(num);
 	if (fOrigName[num]) {
 		delete[] fOrigName[num];
 		fOrigName[num] = 0;
@@ -833,6 +1438,8 @@ void Dos2xUtils::IndicateDeleteEntry(unsigned int num, const char* /*atariname*/
 		fAtariName[num] = 0;
 	}
 	fSubdir[num] = 0;
+	fHostSize[num] = 0;
+	fHostMTime[num] = 0;
 }
 
 void Dos2xUtils::IndicateCloseFile(unsigned int entryNum, const char* atariname, unsigned int sector, uint8_t fileStat)
@@ -855,12 +1462,17 @@ void Dos2xUtils::IndicateCloseFile(unsigned int entryNum, const char* atariname,
 		fileStat |= 0x40;
 	}
 	if (fileStat == 0x42) {
-		if (!WriteAtariFileToDisk(origname, sector, use16Bit)) {
+		if (FinishWriteStream(entryNum, sector)) {
+			RecordHostFileState(entryNum, origname);
+			ALOG("wrote virtual file \"%s\"", origname);
+		} else if (!WriteAtariFileToDisk(origname, sector, use16Bit)) {
 			AERROR("error writing virtual file \"%s\"", origname);
 		} else {
+			RecordHostFileState(entryNum, origname);
 			ALOG("wrote virtual file \"%s\"", origname);
 		}
 	} else {
+		AbortWriteStream(entryNum);
 		DPRINTF("skipping closed file with status %02x", fileStat);
 	}
 	delete[] origname;
@@ -902,6 +1514,7 @@ void Dos2xUtils::IndicateCreateDirectory(unsigned int entryNum, const char* atar
 	fSubdir[entryNum] = new Dos2xUtils(fImage, origname, fObserver, sector,
 		fDosFormat, fIsDos25EnhancedDensity,
 		fUse16BitSectorLinks, fNumberOfVTOCs);
+	fSubdir[entryNum]->SetHostFileSource(fHostFiles);
 	delete[] origname;
 }
 
@@ -1106,6 +1719,22 @@ RCPtr<Dos2xUtils::Dos2Dir> Dos2xUtils::GetDos2Directory(bool beQuiet, unsigned i
 	return dir;
 }
 
+void Dos2xUtils::BuildDisplayName(const char* rawname, char* name)
+{
+	int i;
+	char* p = name;
+	for (i = 0; i < 8 && rawname[i] != ' '; i++) {
+		*p++ = rawname[i] & 0x7f;
+	}
+	if (rawname[8] != ' ') {
+		*p++ = '.';
+		for (i = 8; i < 11 && rawname[i] != ' '; i++) {
+			*p++ = rawname[i] & 0x7f;
+		}
+	}
+	*p = 0;
+}
+
 void Dos2xUtils::DumpRawDirectory(bool beQuiet) const
 {
 	unsigned int sector = 361;
@@ -1222,6 +1851,22 @@ bool Dos2xUtils::SetDosFormat(EDosFormat format)
 }
 
 
+unsigned int Dos2xUtils::CalculateNumberOfVTOCs() const
+{
+	if (GetDosFormat() != eMyDos) {
+		return 1;
+	}
+	unsigned int numsec = fImage->GetNumberOfSectors();
+	unsigned int seclen = fImage->GetSectorLength();
+	unsigned int numVTOC = 1 + (numsec + 80) / (seclen * 8);
+
+	if (seclen == e128BytesPerSector && numVTOC > 1 && (numVTOC & 1)) {
+		// mydos allocates VTOC in pairs of 2 in SD
+		numVTOC++;
+	}
+	return numVTOC;
+}
+
 bool Dos2xUtils::InitVTOC()
 {
 	uint8_t buf[256];
@@ -1279,16 +1924,12 @@ bool Dos2xUtils::InitVTOC()
 		}
 	} else if (GetDosFormat() == eMyDos) {
 		// general MyDos format
-		numVTOC = 1 + (numsec + 80) / (seclen * 8);
+		numVTOC = CalculateNumberOfVTOCs();
 
 		if (seclen == e128BytesPerSector) {
 			if (numVTOC == 1) {
 				buf[0] = 2;
 			} else {
-				if (numVTOC & 1) {
-					// mydos allocates VTOC in pairs of 2 in SD
-					numVTOC++;
-				}
 				buf[0] = (numVTOC+1) / 2 + 2;
 				fUse16BitSectorLinks=true;
 			}
@@ -1653,6 +2294,45 @@ void Dos2xUtils::MarkSectorsFree(unsigned int first_sector, unsigned int last_se
 	}
 }
 
+void Dos2xUtils::FreeSector(unsigned int sector)
+{
+	uint8_t vtocBuf[256];
+	unsigned int seclen = fImage->GetSectorLength();
+	unsigned int secBit = 128 >> (sector & 7);
+	unsigned int secByte = sector >> 3;
+	unsigned int vtocSector;
+	unsigned int countSector = eVTOCSector;
+	unsigned int countOffset = 3;
+
+	if (IsDos25EnhancedDensity()) {
+		if (secByte < 90) {
+			vtocSector = eVTOCSector;
+			secByte += 10;
+		} else {
+			vtocSector = eVTOC2Sector;
+			secByte -= 6;
+			countSector = eVTOC2Sector;
+			countOffset = 122;
+		}
+	} else {
+		vtocSector = eVTOCSector - (secByte + 10) / seclen;
+		secByte = (secByte + 10) & (seclen-1);
+	}
+
+	fImage->ReadSector(vtocSector, vtocBuf, seclen);
+	if (vtocBuf[secByte] & secBit) {
+		// already free
+		return;
+	}
+	MarkSectorsFree(sector, sector);
+
+	fImage->ReadSector(countSector, vtocBuf, seclen);
+	unsigned int freesec = vtocBuf[countOffset] + (vtocBuf[countOffset+1] << 8) + 1;
+	vtocBuf[countOffset] = freesec & 0xff;
+	vtocBuf[countOffset+1] = freesec >> 8;
+	fImage->WriteSector(countSector, vtocBuf, seclen);
+}
+
 unsigned int Dos2xUtils::GetNumberOfFreeSectors()
 {
 	if (GetDosFormat() == eUnknownDos) {
@@ -21,10 +21,16 @@
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
+#include <vector>
+#include <sys/types.h>
+#include <time.h>
+#include <stdio.h>
+
 #include "RefCounted.h"
 #include "RCPtr.h"
 #include "AtrImage.h"
 #include "VirtualImageObserver.h"
+#include "HostFileSectorSource.h"
 
 class Dos2xUtils : public RefCounted {
 public:
@@ -41,6 +47,40 @@ public:
 
 	bool AddFiles(EPicoNameType piconametype = eNoPicoName);
 
+	// let AddFile(s) only map the data sectors to the host files,
+	// the file data is read when the sectors are accessed
+	void SetHostFileSource(const RCPtr<HostFileSectorSource>& source);
+
+	const char* GetDirectory() const { return fDirectory; }
+
+	// append this directory and all subdirectories to list
+	void GetDirectoryTree(std::vector< RCPtr<Dos2xUtils> >& list);
+
+	// true if the Atari has a file in this directory open for writing
+	bool HasOpenFiles() const;
+
+	// apply files added, removed or changed in the host directory
+	// since the image was created to the Atari directory and VTOC.
+	// Data of changed files is always written to newly allocated
+	// sectors, the old sectors are only marked free in the VTOC.
+	// complete is false if some host files couldn't be added.
+	bool SyncWithHostDirectory(bool& changed, bool& complete);
+
+	// take over the directory of an image that was created from the
+	// host directory earlier, so SyncWithHostDirectory only has to
+	// apply the differences. AttachHostFile connects an entry to the
+	// host file it was created from, size and mtime are the state of
+	// the host file when its data was written.
+	bool AttachDirectory(EPicoNameType piconametype = eNoPicoName);
+	bool AttachHostFile(unsigned int entryNum, const char* name, off_t size, time_t mtime);
+	RCPtr<Dos2xUtils> AttachHostDirectory(unsigned int entryNum, const char* name);
+
+	// host file or directory an entry was created from, 0 if none
+	inline unsigned int GetEntryCount() const { return fEntryCount; }
+	const char* GetHostName(unsigned int entryNum) const;
+	void GetHostFileState(unsigned int entryNum, off_t& size, time_t& mtime) const;
+	RCPtr<Dos2xUtils> GetSubdirectory(unsigned int entryNum) const;
+
 	// DOS 2.x file access methods
 	enum EDosFormat {
 		eUnknownDos = 0,
@@ -212,6 +252,10 @@ public:
 	};
 
 	RCPtr<Dos2Dir> GetDos2Directory(bool beQuiet = false, unsigned int dirSector = 361) const;
+
+	// convert the 11 character name of a directory entry to NAME.EXT,
+	// name must have room for at least 13 characters
+	static void BuildDisplayName(const char* rawname, char* name);
 	void DumpRawDirectory(bool beQuiet = false) const;
 
 	bool AddFile(const char* filename);
@@ -219,7 +263,11 @@ public:
 
 private:
 	friend class VirtualImageObserver;
-	void IndicateSectorWrite(unsigned int sector);
+	// called with the old and new contents of a directory entry
+	void IndicateEntryWrite(unsigned int sector, unsigned int slot,
+		const uint8_t* oldEntry, const uint8_t* newEntry);
+	// called when the Atari writes a sector of a file opened for writing
+	void IndicateFileSectorWrite(unsigned int sector, const uint8_t* data);
 
 private:
 	Dos2xUtils( DiskImage* img,
@@ -233,6 +281,7 @@ private:
 
 	bool AddDataBlock(const char* atariname, const uint8_t* datablock, unsigned int blocklen);
 	unsigned int AddDirectory(const char* dirname, unsigned int& entryNum);
+	bool AddSubdirectory(const char* dirname, EPicoNameType piconametype);
 	
 	bool AddEntry(const char* longname, char*& atariname, unsigned int& entryNumber);
 	bool AddEntry(const char* atariname, bool allowNameChange, unsigned int& entryNumber);
@@ -251,6 +300,16 @@ private:
 		unsigned int startSector,
 		unsigned int sectorCount);
 
+	bool MapHostFileToImage(
+		unsigned int entrynum,
+		const char* path, unsigned int filelen,
+		const unsigned int* sectors, unsigned int num_sectors,
+		bool& usedSectorAbove720);
+
+	// copy the data of sectors still mapped to the host file
+	// into the image before the host file is overwritten
+	void DetachHostFile(const char* path);
+
 	bool WriteAtariFileToDisk(
 		const char* filename,
 		unsigned int starting_sector,
@@ -269,10 +328,42 @@ private:
 	bool CheckNameUnique(unsigned int entryNum);
 
 	void IndicateDeleteEntry(unsigned int entryNum, const char* atariname);
+	void IndicateOpenFile(unsigned int entryNum, const char* atariname, unsigned int sector, uint8_t fileStat);
 	void IndicateCloseFile(unsigned int entryNum, const char* atariname, unsigned int sector, uint8_t fileStat);
 	void IndicateCreateDirectory(unsigned int entryNum, const char* atariname, unsigned int sector);
 
+	unsigned int CalculateNumberOfVTOCs() const;
+
 	void MarkSectorsFree(unsigned int first_sector, unsigned int last_sector);
+	void FreeSector(unsigned int sector);
+
+	bool ReadDirectoryStatus(uint8_t* status, char names[][12]) const;
+	bool FindFreeEntry(unsigned int& entryNum) const;
+	bool FindHostEntry(const char* name, const uint8_t* status, unsigned int& entryNum) const;
+	bool DeleteFileEntry(unsigned int entryNum);
+
+	void RecordHostFileState(unsigned int entryNum, const char* path);
+
+	// A file the Atari opened for writing. Sectors are appended to
+	// a temporary file next to the host file as they arrive by
+	// following the sector links, starting with the first sector from
+	// the directory entry. The temporary file replaces the host file
+	// when the Atari closes the file.
+	struct WriteStream {
+		FILE* fFile;
+		char* fPath;
+		char* fTmpPath;
+		std::vector<unsigned int> fSectors;
+		std::vector<long> fOffsets;
+		long fLength;
+		unsigned int fNextSector;
+		bool fUse16BitLinks;
+		bool fValid;
+	};
+
+	void SetStreamNextSector(WriteStream* stream, unsigned int sector);
+	bool FinishWriteStream(unsigned int entryNum, unsigned int startSector);
+	void AbortWriteStream(unsigned int entryNum);
 
 	enum { eMaxEntries = 64 };
 
@@ -284,8 +375,16 @@ private:
 	char* fAtariName[eMaxEntries];
 	RCPtr<Dos2xUtils> fSubdir[eMaxEntries];
 
+	// size and modification time of the host file when it was
+	// added to or written from the image, 0 if unknown
+	off_t fHostSize[eMaxEntries];
+	time_t fHostMTime[eMaxEntries];
+
+	WriteStream* fWriteStream[eMaxEntries];
+
 	DiskImage* fImage;
 	VirtualImageObserver* fObserver;
+	RCPtr<HostFileSectorSource> fHostFiles;
 
 	EDosFormat fDosFormat;
 	bool fIsDos25EnhancedDensity;
@@ -293,6 +392,7 @@ private:
 	unsigned int fNumberOfVTOCs;
 
 	bool fIsRootDirectory;
+	EPicoNameType fPicoNameType;
 };
 
 #endif
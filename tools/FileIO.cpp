@@ -19,6 +19,7 @@
 */
 
 #include <unistd.h>
+#include <string.h>
 
 #include "FileIO.h"
 #include "AtariDebug.h"
@@ -147,6 +148,35 @@ bool FileIO::Unlink(const char* filename)
 	return unlink(filename) == 0;
 }
 
+unsigned int FileIO::ReadBlockAt(off_t pos, void* buf, unsigned int len)
+{
+	if (!Seek(pos)) {
+		return 0;
+	}
+	return ReadBlock(buf, len);
+}
+
+static unsigned int ReadFileAt(FILE* f, off_t pos, void* buf, unsigned int len)
+{
+#ifdef WINVER
+	if (fseek(f, pos, SEEK_SET) != 0) {
+		return 0;
+	}
+	return fread(buf, 1, len, f);
+#else
+	int fd = fileno(f);
+	unsigned int done = 0;
+	while (done < len) {
+		ssize_t cnt = pread(fd, (uint8_t*) buf + done, len - done, pos + done);
+		if (cnt <= 0) {
+			break;
+		}
+		done += cnt;
+	}
+	return done;
+#endif
+}
+
 StdFileIO::StdFileIO()
 	: super(), fFile(0)
 {
@@ -235,6 +265,15 @@ off_t StdFileIO::Tell()
 	return ftell(fFile);
 }
 
+unsigned int StdFileIO::ReadBlockAt(off_t pos, void* buf, unsigned int len)
+{
+	if (!IsOpen()) {
+		Assert(false);
+		return 0;
+	}
+	return ReadFileAt(fFile, pos, buf, len);
+}
+
 bool StdFileIO::Seek(off_t pos)
 {
 	if (!IsOpen()) {
@@ -254,8 +293,31 @@ bool StdFileIO::IsOpen() const
 
 #ifdef USE_ZLIB
 
+// gzip only, no zlib header and no transparent reads
+#define GZIP_WINDOW_BITS (15 + 16)
+
+// each access point keeps a 32k window, so this costs about 3% of
+// the uncompressed size
+unsigned int GZFileIO::fIndexSpan = 1024*1024;
+
 GZFileIO::GZFileIO()
-	: super(), fFile(0)
+	: super(),
+	  fFile(0),
+	  fRawFile(0),
+	  fTransparent(false),
+	  fStreamInitialized(false),
+	  fRawDeflate(false),
+	  fEOF(false),
+	  fError(false),
+	  fInput(0),
+	  fInOffset(0),
+	  fWindow(0),
+	  fWindowPos(0),
+	  fProduced(0),
+	  fValidStart(0),
+	  fPos(0),
+	  fTotalLength(-1),
+	  fIndexing(false)
 {
 }
 
@@ -274,8 +336,42 @@ bool GZFileIO::OpenRead(const char* filename)
 		return false;
 	}
 
-	fFile = gzopen(filename,"rb");
-	return IsOpen();
+	fRawFile = fopen(filename, "rb");
+	if (!fRawFile) {
+		return false;
+	}
+
+	uint8_t magic[2];
+	size_t len = fread(magic, 1, 2, fRawFile);
+	fseek(fRawFile, 0, SEEK_SET);
+
+	if (len != 2 || magic[0] != 0x1f || magic[1] != 0x8b) {
+		fTransparent = true;
+		return true;
+	}
+	fTransparent = false;
+
+	memset(&fStream, 0, sizeof(fStream));
+	fStream.zalloc = Z_NULL;
+	fStream.zfree = Z_NULL;
+	fStream.opaque = Z_NULL;
+	if (inflateInit2(&fStream, GZIP_WINDOW_BITS) != Z_OK) {
+		fclose(fRawFile);
+		fRawFile = 0;
+		return false;
+	}
+	fStreamInitialized = true;
+
+	fInput = new uint8_t[eInputBufferSize];
+	fWindow = new uint8_t[eWindowSize];
+	fTotalLength = -1;
+	fIndexing = false;
+
+	if (!ResetToStart()) {
+		FreeReadState();
+		return false;
+	}
+	return true;
 }
 
 bool GZFileIO::OpenWrite(const char* filename)
@@ -296,11 +392,241 @@ bool GZFileIO::Close()
 		return false;
 	}
 
-	bool ret = (gzclose(fFile) == 0);
-	fFile = 0;
-	return ret;
+	if (fFile) {
+		bool ret = (gzclose(fFile) == 0);
+		fFile = 0;
+		return ret;
+	}
+
+	FreeReadState();
+	return true;
 }
 
+void GZFileIO::FreeReadState()
+{
+	if (fStreamInitialized) {
+		inflateEnd(&fStream);
+		fStreamInitialized = false;
+	}
+	if (fRawFile) {
+		fclose(fRawFile);
+		fRawFile = 0;
+	}
+	delete[] fInput;
+	fInput = 0;
+	delete[] fWindow;
+	fWindow = 0;
+
+	for (unsigned int i = 0; i < fIndex.size(); i++) {
+		delete[] fIndex[i].fWindow;
+	}
+	fIndex.clear();
+	fTransparent = false;
+}
+
+bool GZFileIO::FillInput()
+{
+	// keep unused input, eg when checking for the next gzip member
+	if (fStream.avail_in && fStream.next_in != fInput) {
+		memmove(fInput, fStream.next_in, fStream.avail_in);
+	}
+	fStream.next_in = fInput;
+	size_t len = fread(fInput + fStream.avail_in, 1, eInputBufferSize - fStream.avail_in, fRawFile);
+	fInOffset += len;
+	fStream.avail_in += len;
+	return len > 0;
+}
+
+bool GZFileIO::ResetToStart()
+{
+	if (fseek(fRawFile, 0, SEEK_SET)) {
+		fError = true;
+		return false;
+	}
+	fInOffset = 0;
+	fStream.next_in = fInput;
+	fStream.avail_in = 0;
+	if (inflateReset2(&fStream, GZIP_WINDOW_BITS) != Z_OK) {
+		fError = true;
+		return false;
+	}
+	fRawDeflate = false;
+	fEOF = false;
+	fError = false;
+	memset(fWindow, 0, eWindowSize);
+	fWindowPos = 0;
+	fProduced = 0;
+	fValidStart = 0;
+	fPos = 0;
+	return true;
+}
+
+bool GZFileIO::RestoreAccessPoint(const AccessPoint& point)
+{
+	off_t offset = point.fIn - (point.fBits ? 1 : 0);
+	fError = true;
+	if (fseek(fRawFile, offset, SEEK_SET)) {
+		return false;
+	}
+	fInOffset = offset;
+	fStream.next_in = fInput;
+	fStream.avail_in = 0;
+
+	if (inflateReset2(&fStream, -15) != Z_OK) {
+		return false;
+	}
+	if (point.fBits) {
+		int c = getc(fRawFile);
+		if (c == EOF) {
+			return false;
+		}
+		fInOffset++;
+		if (inflatePrime(&fStream, point.fBits, c >> (8 - point.fBits)) != Z_OK) {
+			return false;
+		}
+	}
+	if (inflateSetDictionary(&fStream, point.fWindow, eWindowSize) != Z_OK) {
+		return false;
+	}
+
+	memcpy(fWindow, point.fWindow, eWindowSize);
+	fWindowPos = 0;
+	fProduced = point.fOut;
+	fValidStart = point.fOut > eWindowSize ? point.fOut - eWindowSize : 0;
+	fPos = point.fOut;
+	fRawDeflate = true;
+	fEOF = false;
+	fError = false;
+	return true;
+}
+
+bool GZFileIO::StartNextMember()
+{
+	// inflate only skips the gzip trailer if it parsed the header
+	if (fRawDeflate) {
+		for (int i = 0; i < 8; i++) {
+			if (fStream.avail_in == 0 && !FillInput()) {
+				return false;
+			}
+			fStream.next_in++;
+			fStream.avail_in--;
+		}
+	}
+	if (fStream.avail_in < 2) {
+		FillInput();
+	}
+	// like gzread, ignore trailing garbage
+	if (fStream.avail_in < 2 || fStream.next_in[0] != 0x1f || fStream.next_in[1] != 0x8b) {
+		return false;
+	}
+	if (inflateReset2(&fStream, GZIP_WINDOW_BITS) != Z_OK) {
+		return false;
+	}
+	fRawDeflate = false;
+	return true;
+}
+
+void GZFileIO::AddAccessPoint()
+{
+	AccessPoint point;
+	point.fOut = fProduced;
+	point.fIn = fInOffset - fStream.avail_in;
+	point.fBits = fStream.data_type & 7;
+	point.fWindow = new uint8_t[eWindowSize];
+
+	// store window with the oldest data first
+	unsigned int len = eWindowSize - fWindowPos;
+	if (len) {
+		memcpy(point.fWindow, fWindow + fWindowPos, len);
+	}
+	if (fWindowPos) {
+		memcpy(point.fWindow + len, fWindow, fWindowPos);
+	}
+	fIndex.push_back(point);
+}
+
+bool GZFileIO::InflateChunk()
+{
+	Assert(fPos == fProduced);
+
+	if (fEOF || fError) {
+		return false;
+	}
+	if (fWindowPos == eWindowSize) {
+		fWindowPos = 0;
+	}
+
+	off_t start = fProduced;
+
+	fStream.next_out = fWindow + fWindowPos;
+	fStream.avail_out = eWindowSize - fWindowPos;
+
+	while (fStream.avail_out) {
+		if (fStream.avail_in == 0 && !FillInput()) {
+			// truncated file
+			fEOF = true;
+			break;
+		}
+		unsigned int avail = fStream.avail_out;
+		int ret = inflate(&fStream, Z_BLOCK);
+		unsigned int len = avail - fStream.avail_out;
+		fWindowPos += len;
+		fProduced += len;
+
+		if (ret == Z_STREAM_END) {
+			if (!StartNextMember()) {
+				fEOF = true;
+				fTotalLength = fProduced;
+				break;
+			}
+			continue;
+		}
+		if (ret != Z_OK) {
+			fError = true;
+			break;
+		}
+
+		// at the end of a deflate block header, but not the last one
+		if (fIndexing && (fStream.data_type & 128) && !(fStream.data_type & 64)) {
+			off_t last = fIndex.empty() ? 0 : fIndex.back().fOut;
+			if (fProduced >= last + (off_t)fIndexSpan) {
+				AddAccessPoint();
+			}
+		}
+	}
+	return fProduced > start;
+}
+
+const GZFileIO::AccessPoint* GZFileIO::FindAccessPoint(off_t pos) const
+{
+	// binary search for the last point at or before pos
+	unsigned int lo = 0;
+	unsigned int hi = fIndex.size();
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+		if (fIndex[mid].fOut <= pos) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if (lo == 0) {
+		return 0;
+	}
+	return &fIndex[lo - 1];
+}
+
+bool GZFileIO::SkipTo(off_t pos)
+{
+	while (fProduced < pos) {
+		fPos = fProduced;
+		if (!InflateChunk()) {
+			return false;
+		}
+	}
+	fPos = pos;
+	return true;
+}
 
 unsigned int GZFileIO::ReadBlock(void* buf, unsigned int len)
 {
@@ -308,12 +634,39 @@ unsigned int GZFileIO::ReadBlock(void* buf, unsigned int len)
 		Assert(false);
 		return 0;
 	}
-	return gzread(fFile, buf, len);
+	if (fFile) {
+		// opened for writing
+		return gzread(fFile, buf, len);
+	}
+	if (fTransparent) {
+		return fread(buf, 1, len, fRawFile);
+	}
+
+	uint8_t* dest = (uint8_t*) buf;
+	unsigned int done = 0;
+	while (done < len) {
+		if (fPos == fProduced && !InflateChunk()) {
+			break;
+		}
+		unsigned int avail = fProduced - fPos;
+		unsigned int idx = (fWindowPos + eWindowSize - avail) % eWindowSize;
+		unsigned int cnt = len - done;
+		if (cnt > avail) {
+			cnt = avail;
+		}
+		if (cnt > eWindowSize - idx) {
+			cnt = eWindowSize - idx;
+		}
+		memcpy(dest + done, fWindow + idx, cnt);
+		done += cnt;
+		fPos += cnt;
+	}
+	return done;
 }
 
 unsigned int GZFileIO::WriteBlock(const void* buf, unsigned int len)
 {
-	if (!IsOpen()) {
+	if (!IsOpen() || !fFile) {
 		Assert(false);
 		return 0;
 	}
@@ -327,17 +680,29 @@ off_t GZFileIO::GetFileLength()
 		Assert(false);
 		return 0;
 	}
-	off_t current_pos = gztell(fFile);
-	off_t len = current_pos;
-	off_t s;
-
-	uint8_t buf[256];
-
-	while ( (s = gzread(fFile,buf,256)) ) {
-		len += s;
+	if (fFile) {
+		return gztell(fFile);
+	}
+	if (fTransparent) {
+		off_t current_pos = ftell(fRawFile);
+		fseek(fRawFile, 0, SEEK_END);
+		off_t len = ftell(fRawFile);
+		fseek(fRawFile, current_pos, SEEK_SET);
+		return len;
+	}
+	if (fTotalLength >= 0) {
+		return fTotalLength;
 	}
 
-	gzseek(fFile, current_pos, SEEK_SET); 
+	// decompress up to the end, this also completes an index
+	// which is being built
+	off_t current_pos = fPos;
+	while (!fEOF && !fError) {
+		fPos = fProduced;
+		InflateChunk();
+	}
+	off_t len = fProduced;
+	Seek(current_pos);
 	return len;
 }
 
@@ -347,7 +712,21 @@ off_t GZFileIO::Tell()
 		Assert(false);
 		return 0;
 	}
-	return gztell(fFile);
+	if (fFile) {
+		return gztell(fFile);
+	}
+	if (fTransparent) {
+		return ftell(fRawFile);
+	}
+	return fPos;
+}
+
+unsigned int GZFileIO::ReadBlockAt(off_t pos, void* buf, unsigned int len)
+{
+	if (fTransparent) {
+		return ReadFileAt(fRawFile, pos, buf, len);
+	}
+	return super::ReadBlockAt(pos, buf, len);
 }
 
 bool GZFileIO::Seek(off_t pos)
@@ -356,15 +735,53 @@ bool GZFileIO::Seek(off_t pos)
 		Assert(false);
 		return false;
 	}
-	if (gzseek(fFile, pos, SEEK_SET) != (int)pos) {
+	if (fFile) {
+		return gzseek(fFile, pos, SEEK_SET) == pos;
+	}
+	if (fTransparent) {
+		return fseek(fRawFile, pos, SEEK_SET) == 0;
+	}
+	if (pos < 0) {
 		return false;
 	}
-	return true;
+
+	if (!fError) {
+		// still in the window?
+		off_t valid = fProduced - fValidStart;
+		if (valid > eWindowSize) {
+			valid = eWindowSize;
+		}
+		if (pos <= fProduced && fProduced - pos <= valid) {
+			fPos = pos;
+			return true;
+		}
+	}
+
+	if (pos < fProduced && !fIndexing) {
+		// first backward seek, index the file while inflating
+		// it again from the start
+		fIndexing = true;
+	}
+
+	const AccessPoint* point = FindAccessPoint(pos);
+
+	if (pos > fProduced && !fError && (point == 0 || point->fOut <= fProduced)) {
+		// just continue decompressing
+	} else if (point) {
+		if (!RestoreAccessPoint(*point)) {
+			return false;
+		}
+	} else {
+		if (!ResetToStart()) {
+			return false;
+		}
+	}
+	return SkipTo(pos);
 }
 
 bool GZFileIO::IsOpen() const
 {
-	return fFile != 0;
+	return fFile != 0 || fRawFile != 0;
 }
 
 #endif
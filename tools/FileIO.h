@@ -27,6 +27,7 @@
 
 #ifdef USE_ZLIB
 #include <zlib.h>
+#include <vector>
 #endif
 
 #include "RefCounted.h"
@@ -49,6 +50,10 @@ public:
 	virtual bool Seek(off_t pos) = 0;
 	virtual off_t Tell() = 0;
 
+	// read len bytes at pos. Plain files are read with pread, without
+	// filling the stdio buffer. The file position is undefined afterwards.
+	virtual unsigned int ReadBlockAt(off_t pos, void* buf, unsigned int len);
+
 	bool ReadByte(uint8_t& byte);
 	bool WriteByte(const uint8_t& byte);
 
@@ -91,6 +96,8 @@ public:
 	virtual bool Seek(off_t pos);
 	virtual off_t Tell();
 
+	virtual unsigned int ReadBlockAt(off_t pos, void* buf, unsigned int len);
+
 	virtual bool IsOpen() const;
 
 private:
@@ -101,6 +108,13 @@ private:
 
 #ifdef USE_ZLIB
 
+// Reading gzip files is done with inflate directly instead of gzread.
+// While decompressing an index of access points (position in the
+// compressed file plus the preceding 32k window of uncompressed data)
+// is built every "index span" bytes, so seeking only has to decompress
+// from the nearest access point instead of from the start of the file.
+// Files that aren't gzip compressed are read as-is.
+
 class GZFileIO : public FileIO
 {
 public:
@@ -119,14 +133,90 @@ public:
 	virtual bool Seek(off_t pos);
 	virtual off_t Tell();
 
+	virtual unsigned int ReadBlockAt(off_t pos, void* buf, unsigned int len);
+
 	virtual bool IsOpen() const;
 
+	// distance between access points in uncompressed bytes. Access
+	// points are only recorded after the first backward seek, files
+	// which are just read sequentially don't need an index
+	static void SetIndexSpan(unsigned int span);
+	static unsigned int GetIndexSpan();
+
+	unsigned int GetNumberOfAccessPoints() const;
+
 private:
 	typedef FileIO super;
 
+	enum {
+		eWindowSize = 32768,
+		eInputBufferSize = 16384
+	};
+
+	struct AccessPoint {
+		off_t fOut;		// offset in uncompressed data
+		off_t fIn;		// offset in compressed file
+		int fBits;		// number of bits of the byte at fIn-1 to use
+		uint8_t* fWindow;	// preceding uncompressed data
+	};
+
+	bool FillInput();
+	bool ResetToStart();
+	bool RestoreAccessPoint(const AccessPoint& point);
+	bool StartNextMember();
+	bool InflateChunk();
+	void AddAccessPoint();
+	const AccessPoint* FindAccessPoint(off_t pos) const;
+	bool SkipTo(off_t pos);
+
+	void FreeReadState();
+
+	// write mode
 	gzFile fFile;
+
+	// read mode
+	FILE* fRawFile;
+	bool fTransparent;
+
+	z_stream fStream;
+	bool fStreamInitialized;
+	bool fRawDeflate;
+	bool fEOF;
+	bool fError;
+
+	uint8_t* fInput;
+	off_t fInOffset;		// file offset after the data in fInput
+
+	// circular buffer holding the last 32k of uncompressed data
+	uint8_t* fWindow;
+	unsigned int fWindowPos;
+	off_t fProduced;		// uncompressed bytes up to fWindowPos
+	off_t fValidStart;		// window is valid from this offset on
+	off_t fPos;			// current read position
+
+	off_t fTotalLength;		// -1 if not known yet
+
+	std::vector<AccessPoint> fIndex;
+	bool fIndexing;			// record access points while inflating
+
+	static unsigned int fIndexSpan;
 };
 
+inline void GZFileIO::SetIndexSpan(unsigned int span)
+{
+	fIndexSpan = span;
+}
+
+inline unsigned int GZFileIO::GetIndexSpan()
+{
+	return fIndexSpan;
+}
+
+inline unsigned int GZFileIO::GetNumberOfAccessPoints() const
+{
+	return fIndex.size();
+}
+
 #endif
 
 #endif
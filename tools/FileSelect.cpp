@@ -31,6 +31,7 @@
 #include "MiscUtils.h"
 #include "SIOTracer.h"
 #include "CursesFrontend.h"
+#include "StringInput.h"
 
 using namespace MiscUtils;
 
@@ -38,13 +39,20 @@ FileSelect::FileSelect(CursesFrontend *frontend)
 	: fFrontend(frontend),
 	  fEnableVirtualDriveKey(false),
 	  fInputIsVirtualDrive(false),
-	  fEnableDos2xDirectory(false)
+	  fEnableDos2xDirectory(false),
+	  fSelectedEntry(0),
+	  fRestorePosition(0),
+	  fRestorePending(false),
+	  fLibraryMatch(0)
 {
 	fInputLineWindow = fFrontend->GetInputLineWindow();
+	fPendingSeek[0] = 0;
+	fLibraryQuery[0] = 0;
 }
 
 FileSelect::~FileSelect()
 {
+	StopScanner();
 }
 
 bool FileSelect::InitScreenSize()
@@ -116,6 +124,10 @@ bool FileSelect::Select(WINDOW* win,
 			GotoPosition(pos);
 			DisplayDir();
 		} else {
+			if (fScanner.IsNotNull()) {
+				// try again when the directory is complete
+				strcpy(fPendingSeek, fSearchFilename);
+			}
 			fSearchFilename[0] = 0;
 			fSearchFilenameLength = 0;
 		}
@@ -127,8 +139,12 @@ bool FileSelect::Select(WINDOW* win,
 	fFrontend->UpdateScreen();
 
 	while(1) {
-		int ch = fFrontend->GetCh(false);
+		fSelectedEntry = fDirectory->Get(fPosition);
+		int ch = fFrontend->GetCh(false, fScanner.IsNotNull());
+		UpdateScannedDirectory();
 		switch (ch) {
+		case CursesFrontend::ePollEventKey:
+			break;
 		case KEY_RESIZE:
 			fFrontend->HandleResize(true);
 			if (!InitScreenSize()) {
@@ -300,6 +316,11 @@ bool FileSelect::Select(WINDOW* win,
 				beep();
 			}
 			break;
+		case 12: // ^L - find image in library
+			if (!FindInLibrary()) {
+				return false;
+			}
+			break;
 		case 21: // ^U - clear input
 			fSearchFilenameLength = 0;
 			fSearchFilename[0] = 0;
@@ -344,13 +365,27 @@ bool FileSelect::Init()
 	}
 	strcpy(fPath, rp);
 
-	fDirectory = fFrontend->GetDirectoryCache()->GetDirectory(fPath, DirectoryCache::eDirectorySorted);
+	StopScanner();
+	fPendingSeek[0] = 0;
+	fDirectory = fFrontend->GetDirectoryCache()->ScanDirectory(fPath, fScanner);
+	if (fScanner.IsNotNull() && !fFrontend->GetDeviceManager()->AddPollHandler(fScanner)) {
+		// can't scan in the background, read it the old way
+		fScanner = 0;
+		fDirectory = fFrontend->GetDirectoryCache()->GetDirectory(fPath, DirectoryCache::eDirectorySorted);
+	}
 	if (fDirectory.IsNull()) {
 		DPRINTF("reading directory \"%s\" failed!", fPath);
 		return false;
 	}
 
-	fPosition = fDirectory->GetFileselectorPosition();
+	if (fScanner.IsNotNull()) {
+		fPosition = 0;
+		fRestorePosition = fDirectory->GetFileselectorPosition();
+		fRestorePending = true;
+	} else {
+		fPosition = fDirectory->GetFileselectorPosition();
+		fRestorePending = false;
+	}
 	fOldPosition = 0;
 	fDisplayStart = fOldDisplayStart = 0;
 	fDirectorySize = fDirectory->Size();
@@ -363,6 +398,128 @@ bool FileSelect::Init()
 	return true;
 }
 
+void FileSelect::StopScanner()
+{
+	if (fScanner.IsNotNull()) {
+		fFrontend->GetDeviceManager()->RemovePollHandler(fScanner);
+		fScanner = 0;
+	}
+}
+
+void FileSelect::UpdateScannedDirectory()
+{
+	bool finished = fScanner.IsNotNull() && fScanner->IsFinished();
+	if (fDirectory->Size() == fDirectorySize && !finished) {
+		return;
+	}
+	fDirectorySize = fDirectory->Size();
+	int pos = fDirectory->IndexOf(fSelectedEntry);
+	fPosition = (pos >= 0) ? pos : 0;
+
+	if (finished) {
+		StopScanner();
+		// restore the old position unless the cursor was moved
+		if (fRestorePending && fPosition == 0) {
+			if (fPendingSeek[0]) {
+				pos = fDirectory->Find(fPendingSeek);
+				if (pos >= 0) {
+					strcpy(fSearchFilename, fPendingSeek);
+					fSearchFilenameLength = strlen(fSearchFilename);
+					fPosition = pos;
+					DisplaySearchFilename();
+				}
+			} else if (fRestorePosition < fDirectorySize) {
+				fPosition = fRestorePosition;
+			}
+		}
+		fRestorePending = false;
+		fPendingSeek[0] = 0;
+	}
+	CheckUpperMargin(true);
+	CheckLowerMargin(true);
+	DisplayDir(true);
+	fFrontend->UpdateScreen();
+}
+
+bool FileSelect::FindInLibrary()
+{
+	RCPtr<ImageLibrary> library = fFrontend->GetDeviceManager()->GetImageLibrary();
+	if (library.IsNull()) {
+		beep();
+		return true;
+	}
+
+	static const char* prompt = "find in library: ";
+	unsigned int promptlen = strlen(prompt);
+	unsigned int width = getmaxx(fInputLineWindow);
+	if (width <= promptlen + 1) {
+		beep();
+		return true;
+	}
+
+	char query[NAME_MAX];
+	strcpy(query, fLibraryQuery);
+	werase(fInputLineWindow);
+	mvwaddstr(fInputLineWindow, 0, 0, prompt);
+
+	// entering the same name again cycles through the matches
+	StringInput input(fFrontend);
+	if (input.InputString(fInputLineWindow, promptlen, 0, width - promptlen - 1,
+		query, NAME_MAX, -1, true) != StringInput::eInputOK || query[0] == 0) {
+		DisplaySearchFilename();
+		return true;
+	}
+	if (strcmp(query, fLibraryQuery) == 0) {
+		fLibraryMatch++;
+	} else {
+		strcpy(fLibraryQuery, query);
+		fLibraryMatch = 0;
+	}
+
+	std::vector<ImageLibrary::Match> matches;
+	if (!library->FindByName(query, matches)) {
+		beep();
+		DisplaySearchFilename();
+		return true;
+	}
+	fLibraryMatch %= matches.size();
+	const ImageLibrary::Match& match = matches[fLibraryMatch];
+
+	const char* name = strrchr(match.fImagePath, DIR_SEPARATOR);
+	if (!name) {
+		beep();
+		DisplaySearchFilename();
+		return true;
+	}
+	// keep the separator for images in the root directory
+	unsigned int dirlen = (name == match.fImagePath) ? 1 : name - match.fImagePath;
+	name++;
+	if (dirlen >= PATH_MAX || strlen(name) >= NAME_MAX) {
+		beep();
+		DisplaySearchFilename();
+		return true;
+	}
+	memcpy(fPath, match.fImagePath, dirlen);
+	fPath[dirlen] = 0;
+	if (!Init()) {
+		return false;
+	}
+
+	int pos = fDirectory->Find(name);
+	if (pos >= 0) {
+		GotoPosition(pos);
+	} else if (fScanner.IsNotNull()) {
+		strcpy(fPendingSeek, name);
+	}
+
+	char info[NAME_MAX + 32];
+	snprintf(info, sizeof(info), "%s (%d/%d)", match.fFilePath,
+		fLibraryMatch + 1, (int) matches.size());
+	werase(fInputLineWindow);
+	mvwaddnstr(fInputLineWindow, 0, 0, info, width - 1);
+	return true;
+}
+
 void FileSelect::InitScreen()
 {
 	fFrontend->SetTopLineFilename(fPath, true);
@@ -26,6 +26,7 @@
 
 #include "CursesFrontend.h"
 #include "Directory.h"
+#include "DirectoryScanner.h"
 
 class FileSelect {
 public:
@@ -46,6 +47,11 @@ private:
 	bool Init();
 	void InitScreen();
 
+	void StopScanner();
+	// adjust to entries added by the scanner, keeping the
+	// cursor on the same entry
+	void UpdateScannedDirectory();
+
 	void GotoPosition(unsigned int pos);
 	void PlaceCursorTop();
 
@@ -60,6 +66,11 @@ private:
 
 	DirEntry::EEntryType BuildFilename(char* filename);
 
+	// ask for an Atari filename and go to the next image in the
+	// library which contains it. returns false if the directory
+	// of the image couldn't be read.
+	bool FindInLibrary();
+
 	CursesFrontend* fFrontend;
 	WINDOW* fWindow;
 	WINDOW* fInputLineWindow;
@@ -82,6 +93,16 @@ private:
 	bool fEnableVirtualDriveKey;
 	bool fInputIsVirtualDrive;
 	bool fEnableDos2xDirectory;
+
+	RCPtr<DirectoryScanner> fScanner;
+	DirEntry* fSelectedEntry;
+	// fileselector position to restore once the scan is finished
+	unsigned int fRestorePosition;
+	bool fRestorePending;
+	char fPendingSeek[NAME_MAX];
+
+	char fLibraryQuery[NAME_MAX];
+	unsigned int fLibraryMatch;
 };
 
 #endif
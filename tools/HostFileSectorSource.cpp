@@ -0,0 +1,213 @@
+/*
+   HostFileSectorSource.cpp - read sectors of a virtual drive from host files
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include "HostFileSectorSource.h"
+#include "AtariDebug.h"
+
+HostFileSectorSource::HostFileSectorSource(unsigned int numberOfSectors)
+	: fNumberOfSectors(numberOfSectors),
+	  fSectorInfo(numberOfSectors + 1),
+	  fOpenFile(eNoFile)
+{
+	for (unsigned int i = 0; i <= fNumberOfSectors; i++) {
+		fSectorInfo[i].fFile = eNoFile;
+		fSectorInfo[i].fOffset = 0;
+		fSectorInfo[i].fLink = 0;
+		fSectorInfo[i].fPrev = 0;
+		fSectorInfo[i].fNext = 0;
+	}
+	fFileIO = new StdFileIO();
+}
+
+HostFileSectorSource::~HostFileSectorSource()
+{
+	CloseFile();
+}
+
+unsigned int HostFileSectorSource::AddFile(const char* path)
+{
+	unsigned int file;
+	if (!FindFile(path, file)) {
+		FileInfo info;
+		info.fPath = path;
+		info.fFirstSector = 0;
+		fFiles.push_back(info);
+		file = fFiles.size() - 1;
+		fFileIndex[info.fPath] = file;
+	}
+	RecordFileState(fFiles[file]);
+	return file;
+}
+
+bool HostFileSectorSource::FindFile(const char* path, unsigned int& file) const
+{
+	std::map<std::string, unsigned int>::const_iterator iter = fFileIndex.find(path);
+	if (iter == fFileIndex.end()) {
+		return false;
+	}
+	file = iter->second;
+	return true;
+}
+
+void HostFileSectorSource::RecordFileState(FileInfo& info)
+{
+	struct stat statbuf;
+	if (stat(info.fPath.c_str(), &statbuf) == 0) {
+		info.fSize = statbuf.st_size;
+		info.fMTime = statbuf.st_mtime;
+	} else {
+		info.fSize = 0;
+		info.fMTime = 0;
+	}
+	info.fChanged = false;
+}
+
+bool HostFileSectorSource::CheckFileState(FileInfo& info)
+{
+	if (info.fChanged) {
+		return false;
+	}
+	struct stat statbuf;
+	if (stat(info.fPath.c_str(), &statbuf) != 0) {
+		// removed files are handled when opening them
+		return true;
+	}
+	if (statbuf.st_size != info.fSize || statbuf.st_mtime != info.fMTime) {
+		AWARN("\"%s\" changed on the host", info.fPath.c_str());
+		info.fChanged = true;
+		return false;
+	}
+	return true;
+}
+
+void HostFileSectorSource::MapSector(unsigned int sector, unsigned int file, uint32_t offset, uint32_t link)
+{
+	if (sector == 0 || sector > fNumberOfSectors || file >= fFiles.size()) {
+		Assert(false);
+		return;
+	}
+	UnmapSector(sector);
+
+	SectorInfo& info = fSectorInfo[sector];
+	info.fFile = file;
+	info.fOffset = offset;
+	info.fLink = link;
+	info.fPrev = 0;
+	info.fNext = fFiles[file].fFirstSector;
+	if (info.fNext) {
+		fSectorInfo[info.fNext].fPrev = sector;
+	}
+	fFiles[file].fFirstSector = sector;
+}
+
+void HostFileSectorSource::UnmapSector(unsigned int sector)
+{
+	if (sector == 0 || sector > fNumberOfSectors) {
+		return;
+	}
+	SectorInfo& info = fSectorInfo[sector];
+	if (info.fFile == eNoFile) {
+		return;
+	}
+	if (info.fPrev) {
+		fSectorInfo[info.fPrev].fNext = info.fNext;
+	} else {
+		fFiles[info.fFile].fFirstSector = info.fNext;
+	}
+	if (info.fNext) {
+		fSectorInfo[info.fNext].fPrev = info.fPrev;
+	}
+	info.fFile = eNoFile;
+	info.fPrev = 0;
+	info.fNext = 0;
+}
+
+unsigned int HostFileSectorSource::GetFirstSectorOfFile(unsigned int file) const
+{
+	if (file >= fFiles.size()) {
+		return 0;
+	}
+	return fFiles[file].fFirstSector;
+}
+
+void HostFileSectorSource::CloseFile()
+{
+	if (fFileIO->IsOpen()) {
+		fFileIO->Close();
+	}
+	fOpenFile = eNoFile;
+}
+
+bool HostFileSectorSource::DecodeSector(unsigned int sector, uint8_t* buffer, unsigned int len)
+{
+	memset(buffer, 0, len);
+	if (sector == 0 || sector > fNumberOfSectors) {
+		return false;
+	}
+	const SectorInfo& info = fSectorInfo[sector];
+	if (info.fFile == eNoFile) {
+		return true;
+	}
+	if (len < 4) {
+		return false;
+	}
+
+	FileInfo& file = fFiles[info.fFile];
+	if (file.fChanged) {
+		// the sector layout doesn't match the file any more
+		return false;
+	}
+
+	buffer[len - 3] = (info.fLink >> 16) & 0xff;
+	buffer[len - 2] = (info.fLink >> 8) & 0xff;
+	buffer[len - 1] = info.fLink & 0xff;
+
+	unsigned int bytes = info.fLink & 0xff;
+	if (bytes > len - 3) {
+		bytes = len - 3;
+	}
+	if (bytes == 0) {
+		return true;
+	}
+
+	if (fOpenFile != info.fFile) {
+		CloseFile();
+		// the file is only checked when it's opened. If it changes
+		// later the directory watcher adds it again, which closes it.
+		if (!CheckFileState(file)) {
+			return false;
+		}
+		if (!fFileIO->OpenRead(file.fPath.c_str())) {
+			// the file was removed from the host, keep the sector
+			// structure intact so the Atari can still follow the chain
+			DPRINTF("cannot open \"%s\"", file.fPath.c_str());
+			return true;
+		}
+		fOpenFile = info.fFile;
+	}
+
+	if (fFileIO->Seek(info.fOffset)) {
+		fFileIO->ReadBlock(buffer, bytes);
+	}
+	return true;
+}
@@ -0,0 +1,100 @@
+#ifndef HOSTFILESECTORSOURCE_H
+#define HOSTFILESECTORSOURCE_H
+
+/*
+   HostFileSectorSource.h - read sectors of a virtual drive from host files
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <string>
+#include <vector>
+#include <map>
+#include <sys/types.h>
+
+#include "LazySectorSource.h"
+#include "FileIO.h"
+#include "RCPtr.h"
+
+// Data sectors of a virtual drive are described by the host file and
+// the offset of the data within the file plus the DOS 2.x sector link.
+// The file data is only read when the sector is accessed, sectors
+// without a mapping are zero-filled. Size and modification time of
+// the host file are recorded when it's added and compared when the
+// file is opened for reading. Sectors of a file which changed fail to
+// decode until the file is added again.
+
+class HostFileSectorSource : public LazySectorSource {
+public:
+	HostFileSectorSource(unsigned int numberOfSectors);
+	virtual ~HostFileSectorSource();
+
+	// returns the file number to use in MapSector. Adding a file
+	// again records its current size and modification time
+	unsigned int AddFile(const char* path);
+
+	// find the file number of a previously added file
+	bool FindFile(const char* path, unsigned int& file) const;
+
+	// link contains the last 3 bytes of the sector (the sector link
+	// in the upper 16 bits, the number of data bytes in the lowest 8 bits)
+	void MapSector(unsigned int sector, unsigned int file, uint32_t offset, uint32_t link);
+	void UnmapSector(unsigned int sector);
+
+	// returns 0 if no sector is mapped to the file
+	unsigned int GetFirstSectorOfFile(unsigned int file) const;
+
+	unsigned int GetNumberOfSectors() const { return fNumberOfSectors; }
+
+	// close the currently open host file
+	void CloseFile();
+
+	virtual bool DecodeSector(unsigned int sector, uint8_t* buffer, unsigned int len);
+
+private:
+	enum { eNoFile = 0xffffffff };
+
+	struct SectorInfo {
+		unsigned int fFile;
+		uint32_t fOffset;
+		uint32_t fLink;
+		// list of the sectors of the file, 0 terminated
+		unsigned int fPrev;
+		unsigned int fNext;
+	};
+
+	struct FileInfo {
+		std::string fPath;
+		unsigned int fFirstSector;
+		off_t fSize;
+		time_t fMTime;
+		bool fChanged;
+	};
+
+	void RecordFileState(FileInfo& info);
+	bool CheckFileState(FileInfo& info);
+
+	unsigned int fNumberOfSectors;
+	std::vector<SectorInfo> fSectorInfo;
+	std::vector<FileInfo> fFiles;
+	std::map<std::string, unsigned int> fFileIndex;
+
+	RCPtr<FileIO> fFileIO;
+	unsigned int fOpenFile;
+};
+
+#endif
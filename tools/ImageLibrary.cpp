@@ -0,0 +1,619 @@
+/*
+   ImageLibrary.cpp - persistent index of the files in a collection of
+   disk images
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <algorithm>
+
+#include "ImageLibrary.h"
+#include "AtrMemoryImage.h"
+#include "Crc32.h"
+#include "SIOTracer.h"
+
+static const char sMagic[8] = { 'A', 'T', 'R', 'I', 'D', 'X', '1', 0 };
+static const uint32_t sByteOrder = 0x01020304;
+
+enum {
+	eMaxDirectoryDepth = 32,
+	eMaxAtariDirectoryDepth = 8
+};
+
+struct ImageLibrary::NameCompare {
+	NameCompare(const ImageLibrary* lib) : fLib(lib) {}
+
+	bool operator() (uint32_t file, const char* name) const
+	{
+		return strcasecmp(fLib->GetString(fLib->fFiles[file].fName), name) < 0;
+	}
+
+	const ImageLibrary* fLib;
+};
+
+struct ImageLibrary::CrcCompare {
+	CrcCompare(const ImageLibrary* lib) : fLib(lib) {}
+
+	bool operator() (uint32_t file, uint32_t crc) const
+	{
+		return fLib->fFiles[file].fCrc < crc;
+	}
+
+	const ImageLibrary* fLib;
+};
+
+ImageLibrary::ImageLibrary()
+	: fData(0),
+	  fDataSize(0),
+	  fHeader(0),
+	  fImages(0),
+	  fFiles(0),
+	  fNameIndex(0),
+	  fCrcIndex(0),
+	  fStringPool(0)
+{
+}
+
+ImageLibrary::~ImageLibrary()
+{
+	Close();
+}
+
+bool ImageLibrary::Open(const char* indexfile)
+{
+	Close();
+
+	int fd = open(indexfile, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat statbuf;
+	if (fstat(fd, &statbuf) != 0 || statbuf.st_size < (off_t) sizeof(Header)) {
+		close(fd);
+		return false;
+	}
+	void* data = mmap(0, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+	fData = (uint8_t*) data;
+	fDataSize = statbuf.st_size;
+	fHeader = (const Header*) fData;
+
+	if (!ValidateIndex()) {
+		Close();
+		return false;
+	}
+	fImages = (const ImageRecord*) (fData + fHeader->fImageTableOffset);
+	fFiles = (const FileRecord*) (fData + fHeader->fFileTableOffset);
+	fNameIndex = (const uint32_t*) (fData + fHeader->fNameIndexOffset);
+	fCrcIndex = (const uint32_t*) (fData + fHeader->fCrcIndexOffset);
+	fStringPool = (const char*) (fData + fHeader->fStringPoolOffset);
+	return true;
+}
+
+void ImageLibrary::Close()
+{
+	if (fData) {
+		munmap(fData, fDataSize);
+	}
+	fData = 0;
+	fDataSize = 0;
+	fHeader = 0;
+	fImages = 0;
+	fFiles = 0;
+	fNameIndex = 0;
+	fCrcIndex = 0;
+	fStringPool = 0;
+}
+
+static bool CheckTable(size_t dataSize, uint32_t offset, uint64_t length, unsigned int align)
+{
+	return (offset % align == 0) && ((uint64_t) offset + length <= dataSize);
+}
+
+bool ImageLibrary::ValidateIndex() const
+{
+	const Header* h = fHeader;
+	if (memcmp(h->fMagic, sMagic, sizeof(sMagic)) || h->fByteOrder != sByteOrder) {
+		return false;
+	}
+	if (!CheckTable(fDataSize, h->fImageTableOffset, (uint64_t) h->fNumberOfImages * sizeof(ImageRecord), 8)
+	    || !CheckTable(fDataSize, h->fFileTableOffset, (uint64_t) h->fNumberOfFiles * sizeof(FileRecord), 4)
+	    || !CheckTable(fDataSize, h->fNameIndexOffset, (uint64_t) h->fNumberOfFiles * 4, 4)
+	    || !CheckTable(fDataSize, h->fCrcIndexOffset, (uint64_t) h->fNumberOfFiles * 4, 4)
+	    || !CheckTable(fDataSize, h->fStringPoolOffset, h->fStringPoolSize, 1)) {
+		return false;
+	}
+	const char* pool = (const char*) (fData + h->fStringPoolOffset);
+	uint32_t poolSize = h->fStringPoolSize;
+	if (poolSize == 0 || pool[poolSize - 1] != 0) {
+		return false;
+	}
+
+	// check all references once so lookups needn't do it
+	const ImageRecord* images = (const ImageRecord*) (fData + h->fImageTableOffset);
+	const FileRecord* files = (const FileRecord*) (fData + h->fFileTableOffset);
+	const uint32_t* nameIndex = (const uint32_t*) (fData + h->fNameIndexOffset);
+	const uint32_t* crcIndex = (const uint32_t*) (fData + h->fCrcIndexOffset);
+	uint32_t i;
+	for (i = 0; i < h->fNumberOfImages; i++) {
+		if (images[i].fPath >= poolSize
+		    || (uint64_t) images[i].fFirstFile + images[i].fNumberOfFiles > h->fNumberOfFiles) {
+			return false;
+		}
+	}
+	for (i = 0; i < h->fNumberOfFiles; i++) {
+		if (files[i].fImage >= h->fNumberOfImages
+		    || files[i].fPath >= poolSize || files[i].fName >= poolSize
+		    || nameIndex[i] >= h->fNumberOfFiles || crcIndex[i] >= h->fNumberOfFiles) {
+			return false;
+		}
+	}
+	return true;
+}
+
+unsigned int ImageLibrary::GetNumberOfImages() const
+{
+	return fHeader ? fHeader->fNumberOfImages : 0;
+}
+
+unsigned int ImageLibrary::GetNumberOfFiles() const
+{
+	return fHeader ? fHeader->fNumberOfFiles : 0;
+}
+
+void ImageLibrary::FillMatch(uint32_t fileNum, Match& match) const
+{
+	const FileRecord& file = fFiles[fileNum];
+	match.fImagePath = GetString(fImages[file.fImage].fPath);
+	match.fFilePath = GetString(file.fPath);
+	match.fLength = file.fLength;
+	match.fSectors = file.fSectors;
+	match.fCrc = file.fCrc;
+}
+
+unsigned int ImageLibrary::FindByName(const char* prefix, std::vector<Match>& matches,
+	unsigned int maxMatches) const
+{
+	matches.clear();
+	if (!IsOpen()) {
+		return 0;
+	}
+	size_t len = strlen(prefix);
+	const uint32_t* end = fNameIndex + fHeader->fNumberOfFiles;
+	const uint32_t* it = std::lower_bound(fNameIndex, end, prefix, NameCompare(this));
+
+	Match match;
+	while (it != end && (maxMatches == 0 || matches.size() < maxMatches)) {
+		if (strncasecmp(GetString(fFiles[*it].fName), prefix, len) != 0) {
+			break;
+		}
+		FillMatch(*it, match);
+		matches.push_back(match);
+		it++;
+	}
+	return matches.size();
+}
+
+unsigned int ImageLibrary::FindByCrc(uint32_t crc, std::vector<Match>& matches,
+	unsigned int maxMatches) const
+{
+	matches.clear();
+	if (!IsOpen()) {
+		return 0;
+	}
+	const uint32_t* end = fCrcIndex + fHeader->fNumberOfFiles;
+	const uint32_t* it = std::lower_bound(fCrcIndex, end, crc, CrcCompare(this));
+
+	Match match;
+	while (it != end && fFiles[*it].fCrc == crc
+	       && (maxMatches == 0 || matches.size() < maxMatches)) {
+		FillMatch(*it, match);
+		matches.push_back(match);
+		it++;
+	}
+	return matches.size();
+}
+
+int ImageLibrary::FindImage(const char* path) const
+{
+	if (!IsOpen()) {
+		return -1;
+	}
+	int lo = 0;
+	int hi = (int) fHeader->fNumberOfImages - 1;
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		int cmp = strcmp(GetString(fImages[mid].fPath), path);
+		if (cmp == 0) {
+			return mid;
+		}
+		if (cmp < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid - 1;
+		}
+	}
+	return -1;
+}
+
+bool ImageLibrary::IsImageFilename(const char* filename)
+{
+	static const char* extensions[] = {
+		".atr", ".atr.gz", ".atz",
+		".xfd", ".xfd.gz", ".xfz",
+		".dcm", ".dcm.gz",
+		".di", ".di.gz",
+		0
+	};
+	size_t len = strlen(filename);
+	for (int i = 0; extensions[i]; i++) {
+		size_t extlen = strlen(extensions[i]);
+		if (len > extlen && strcasecmp(filename + len - extlen, extensions[i]) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ImageLibrary::CalculateFileCrc(const char* filename, uint32_t& crc, unsigned int& length)
+{
+	return CRC32::CalcFileCRC32(filename, crc, length);
+}
+
+bool ImageLibrary::HashFile(const RCPtr<AtrImage>& image, unsigned int startSector,
+	bool use16BitLinks, BuildFile& file) const
+{
+	unsigned int seclen = image->GetSectorLength();
+	unsigned int numsec = image->GetNumberOfSectors();
+	std::vector<bool> visited(numsec + 1, false);
+	uint8_t buf[256];
+	unsigned long crc = 0;
+	unsigned int sector = startSector;
+
+	file.fLength = 0;
+	file.fSectors = 0;
+	while (sector) {
+		if (sector < 4 || sector > numsec || visited[sector]) {
+			return false;
+		}
+		visited[sector] = true;
+		if (!image->ReadSector(sector, buf, seclen)) {
+			return false;
+		}
+		unsigned int bytes = buf[seclen - 1];
+		if (bytes > seclen - 3) {
+			return false;
+		}
+		crc = CRC32::CalcCRC32(crc, buf, bytes);
+		file.fLength += bytes;
+		file.fSectors++;
+		if (use16BitLinks) {
+			sector = buf[seclen - 2] + (buf[seclen - 3] << 8);
+		} else {
+			sector = buf[seclen - 2] + ((buf[seclen - 3] & 3) << 8);
+		}
+	}
+	file.fCrc = crc;
+	return true;
+}
+
+void ImageLibrary::IndexDirectory(const RCPtr<AtrImage>& image, const RCPtr<Dos2xUtils>& utils,
+	unsigned int dirSector, const std::string& prefix, BuildImage* result,
+	unsigned int depth) const
+{
+	RCPtr<Dos2xUtils::Dos2Dir> dir = utils->GetDos2Directory(true, dirSector);
+	if (dir.IsNull()) {
+		return;
+	}
+	for (unsigned int i = 0; i < dir->GetNumberOfFiles(); i++) {
+		uint8_t status = dir->GetFileStatus(i);
+		char name[13];
+		Dos2xUtils::BuildDisplayName(dir->GetRawFilename(i), name);
+
+		if ((status & 0xdf) == 0x10) {
+			if (depth < eMaxAtariDirectoryDepth) {
+				IndexDirectory(image, utils, dir->GetFileStartingSector(i),
+					prefix + name + ">", result, depth + 1);
+			}
+			continue;
+		}
+
+		BuildFile file;
+		file.fPath = prefix + name;
+		file.fNameOffset = prefix.size();
+		if (!HashFile(image, dir->GetFileStartingSector(i), (status & 4) != 0, file)) {
+			// broken sector chain, keep the directory information
+			file.fLength = 0;
+			file.fSectors = dir->GetFileSectorLength(i);
+			file.fCrc = 0;
+		}
+		result->fFiles.push_back(file);
+	}
+}
+
+bool ImageLibrary::IndexImage(BuildImage* image) const
+{
+	RCPtr<AtrMemoryImage> atr = new AtrMemoryImage;
+	if (!atr->ReadImageFromFile(image->fPath.c_str(), true)) {
+		return false;
+	}
+	RCPtr<Dos2xUtils> utils = new Dos2xUtils(atr);
+	IndexDirectory(atr, utils, 361, "", image, 0);
+	return true;
+}
+
+bool ImageLibrary::ReuseImage(BuildImage* image) const
+{
+	int idx = FindImage(image->fPath.c_str());
+	if (idx < 0) {
+		return false;
+	}
+	const ImageRecord& rec = fImages[idx];
+	if (rec.fMTime != image->fMTime || rec.fSize != image->fSize) {
+		return false;
+	}
+	for (uint32_t i = 0; i < rec.fNumberOfFiles; i++) {
+		const FileRecord& f = fFiles[rec.fFirstFile + i];
+		BuildFile file;
+		file.fPath = GetString(f.fPath);
+		file.fNameOffset = f.fName - f.fPath;
+		file.fLength = f.fLength;
+		file.fSectors = f.fSectors;
+		file.fCrc = f.fCrc;
+		image->fFiles.push_back(file);
+	}
+	return true;
+}
+
+void ImageLibrary::ScanDirectory(const std::string& path, std::vector<BuildImage*>& images,
+	unsigned int& reused, unsigned int& scanned, bool verbose, unsigned int depth)
+{
+	DIR* dir = opendir(path.c_str());
+	if (!dir) {
+		AWARN("cannot read directory \"%s\"", path.c_str());
+		return;
+	}
+	std::vector<std::string> subdirs;
+	struct dirent* de;
+	while ((de = readdir(dir))) {
+		if (de->d_name[0] == '.') {
+			continue;
+		}
+		std::string fullpath = path;
+		if (fullpath.empty() || fullpath[fullpath.size() - 1] != '/') {
+			fullpath += '/';
+		}
+		fullpath += de->d_name;
+
+		struct stat statbuf;
+		if (stat(fullpath.c_str(), &statbuf) != 0) {
+			continue;
+		}
+		if (S_ISDIR(statbuf.st_mode)) {
+			subdirs.push_back(fullpath);
+			continue;
+		}
+		if (!S_ISREG(statbuf.st_mode) || !IsImageFilename(de->d_name)) {
+			continue;
+		}
+
+		BuildImage* image = new BuildImage;
+		image->fPath = fullpath;
+		image->fMTime = (int64_t) statbuf.st_mtime * 1000000000 + statbuf.st_mtim.tv_nsec;
+		image->fSize = statbuf.st_size;
+		if (ReuseImage(image)) {
+			reused++;
+		} else {
+			// images which can't be read are stored without files so
+			// they aren't retried on every update
+			if (!IndexImage(image) && verbose) {
+				AWARN("cannot read image \"%s\"", fullpath.c_str());
+			}
+			scanned++;
+			if (verbose) {
+				ALOG("%s: %d files", fullpath.c_str(), (int) image->fFiles.size());
+			}
+		}
+		images.push_back(image);
+	}
+	closedir(dir);
+
+	if (depth < eMaxDirectoryDepth) {
+		for (unsigned int i = 0; i < subdirs.size(); i++) {
+			ScanDirectory(subdirs[i], images, reused, scanned, verbose, depth + 1);
+		}
+	}
+}
+
+namespace {
+	struct ImagePathLess {
+		template<class T> bool operator() (const T* a, const T* b) const
+		{
+			return a->fPath < b->fPath;
+		}
+	};
+
+	struct BuildNameLess {
+		BuildNameLess(const std::vector<const char*>& names) : fNames(names) {}
+		bool operator() (uint32_t a, uint32_t b) const
+		{
+			int cmp = strcasecmp(fNames[a], fNames[b]);
+			return cmp < 0 || (cmp == 0 && a < b);
+		}
+		const std::vector<const char*>& fNames;
+	};
+
+	struct BuildCrcLess {
+		BuildCrcLess(const std::vector<uint32_t>& crcs) : fCrcs(crcs) {}
+		bool operator() (uint32_t a, uint32_t b) const
+		{
+			return fCrcs[a] < fCrcs[b] || (fCrcs[a] == fCrcs[b] && a < b);
+		}
+		const std::vector<uint32_t>& fCrcs;
+	};
+}
+
+bool ImageLibrary::Update(const char* indexfile, const std::vector<std::string>& directories,
+	bool verbose)
+{
+	std::vector<BuildImage*> images;
+	unsigned int reused = 0, scanned = 0;
+
+	for (unsigned int i = 0; i < directories.size(); i++) {
+		char rp[PATH_MAX];
+		if (realpath(directories[i].c_str(), rp) == NULL) {
+			AWARN("cannot access directory \"%s\"", directories[i].c_str());
+			continue;
+		}
+		ScanDirectory(rp, images, reused, scanned, verbose, 0);
+	}
+
+	// overlapping directories would add images twice
+	std::sort(images.begin(), images.end(), ImagePathLess());
+	unsigned int out = 0;
+	for (unsigned int i = 0; i < images.size(); i++) {
+		if (out && images[out - 1]->fPath == images[i]->fPath) {
+			delete images[i];
+		} else {
+			images[out++] = images[i];
+		}
+	}
+	images.resize(out);
+
+	if (verbose) {
+		ALOG("%d images: %d unchanged, %d scanned", (int) images.size(), reused, scanned);
+	}
+
+	bool ok = WriteIndex(indexfile, images);
+	for (unsigned int i = 0; i < images.size(); i++) {
+		delete images[i];
+	}
+	if (!ok) {
+		return false;
+	}
+	return Open(indexfile);
+}
+
+bool ImageLibrary::WriteIndex(const char* filename, const std::vector<BuildImage*>& images)
+{
+	std::string pool;
+	std::vector<ImageRecord> imageTable;
+	std::vector<FileRecord> fileTable;
+	std::vector<const char*> names;
+	std::vector<uint32_t> crcs;
+
+	// an empty string at offset 0 keeps the pool non-empty
+	pool += '\0';
+
+	for (uint32_t i = 0; i < images.size(); i++) {
+		const BuildImage* image = images[i];
+		ImageRecord rec;
+		memset(&rec, 0, sizeof(rec));
+		rec.fMTime = image->fMTime;
+		rec.fSize = image->fSize;
+		rec.fPath = pool.size();
+		rec.fFirstFile = fileTable.size();
+		rec.fNumberOfFiles = image->fFiles.size();
+		pool += image->fPath;
+		pool += '\0';
+		imageTable.push_back(rec);
+
+		for (unsigned int j = 0; j < image->fFiles.size(); j++) {
+			const BuildFile& file = image->fFiles[j];
+			FileRecord frec;
+			frec.fImage = i;
+			frec.fPath = pool.size();
+			frec.fName = frec.fPath + file.fNameOffset;
+			frec.fLength = file.fLength;
+			frec.fSectors = file.fSectors;
+			frec.fCrc = file.fCrc;
+			pool += file.fPath;
+			pool += '\0';
+			fileTable.push_back(frec);
+			names.push_back(file.fPath.c_str() + file.fNameOffset);
+			crcs.push_back(file.fCrc);
+		}
+	}
+
+	uint32_t numFiles = fileTable.size();
+	std::vector<uint32_t> nameIndex(numFiles), crcIndex(numFiles);
+	for (uint32_t i = 0; i < numFiles; i++) {
+		nameIndex[i] = crcIndex[i] = i;
+	}
+	std::sort(nameIndex.begin(), nameIndex.end(), BuildNameLess(names));
+	std::sort(crcIndex.begin(), crcIndex.end(), BuildCrcLess(crcs));
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.fMagic, sMagic, sizeof(sMagic));
+	header.fByteOrder = sByteOrder;
+	header.fNumberOfImages = imageTable.size();
+	header.fNumberOfFiles = numFiles;
+	header.fStringPoolSize = pool.size();
+	header.fImageTableOffset = (sizeof(Header) + 7) & ~7;
+	header.fFileTableOffset = header.fImageTableOffset + imageTable.size() * sizeof(ImageRecord);
+	header.fNameIndexOffset = header.fFileTableOffset + numFiles * sizeof(FileRecord);
+	header.fCrcIndexOffset = header.fNameIndexOffset + numFiles * 4;
+	header.fStringPoolOffset = header.fCrcIndexOffset + numFiles * 4;
+
+	std::string tmpname = filename;
+	tmpname += ".new";
+	FILE* f = fopen(tmpname.c_str(), "wb");
+	if (!f) {
+		AERROR("cannot create index file \"%s\"", tmpname.c_str());
+		return false;
+	}
+	static const uint8_t padding[8] = { 0 };
+	size_t padlen = header.fImageTableOffset - sizeof(header);
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+		&& fwrite(padding, 1, padlen, f) == padlen;
+	if (ok && imageTable.size()) {
+		ok = fwrite(&imageTable[0], sizeof(ImageRecord), imageTable.size(), f) == imageTable.size();
+	}
+	if (ok && numFiles) {
+		ok = fwrite(&fileTable[0], sizeof(FileRecord), numFiles, f) == numFiles
+			&& fwrite(&nameIndex[0], 4, numFiles, f) == numFiles
+			&& fwrite(&crcIndex[0], 4, numFiles, f) == numFiles;
+	}
+	if (ok) {
+		ok = fwrite(pool.data(), pool.size(), 1, f) == 1;
+	}
+	if (fclose(f) != 0) {
+		ok = false;
+	}
+	// replace the old index atomically, readers which still have
+	// it mapped keep their copy
+	if (!ok || rename(tmpname.c_str(), filename) != 0) {
+		AERROR("error writing index file \"%s\"", filename);
+		unlink(tmpname.c_str());
+		return false;
+	}
+	return true;
+}
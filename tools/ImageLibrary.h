@@ -0,0 +1,184 @@
+#ifndef IMAGELIBRARY_H
+#define IMAGELIBRARY_H
+
+/*
+   ImageLibrary.h - persistent index of the files in a collection of
+   disk images
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "RefCounted.h"
+#include "RCPtr.h"
+#include "AtrImage.h"
+#include "Dos2xUtils.h"
+
+#define ATRINDEX_DEFAULT_FILE "atrindex.idx"
+
+// The index file is mapped read-only and consists of sorted tables,
+// so lookups are binary searches without parsing or allocation:
+//
+//   header
+//   image table   sorted by path: path, mtime, size, file range
+//   file table    grouped by image: Atari path, length, sectors, CRC32
+//   name index    file numbers sorted by filename (without directory)
+//   crc index     file numbers sorted by CRC32 of the file contents
+//   string pool   0-terminated strings referenced by offset
+//
+// The file uses host byte order, it is a cache and is simply rebuilt
+// when it doesn't match.
+
+class ImageLibrary : public RefCounted {
+public:
+	ImageLibrary();
+	virtual ~ImageLibrary();
+
+	bool Open(const char* indexfile);
+	void Close();
+	inline bool IsOpen() const;
+
+	// Scan all disk images below the given directories and write a
+	// new index file. Entries of images whose size and modification
+	// time didn't change are taken over from the currently opened
+	// index. On success the new index is opened, which invalidates
+	// all previously returned matches.
+	bool Update(const char* indexfile, const std::vector<std::string>& directories,
+		bool verbose = false);
+
+	struct Match {
+		const char* fImagePath;
+		// path inside the image, subdirectories are separated by '>'
+		const char* fFilePath;
+		unsigned int fLength;
+		unsigned int fSectors;
+		uint32_t fCrc;
+	};
+
+	// find files whose name (without directory) starts with prefix,
+	// case-insensitive. maxMatches = 0 returns all matches.
+	unsigned int FindByName(const char* prefix, std::vector<Match>& matches,
+		unsigned int maxMatches = 0) const;
+
+	// find files with identical contents
+	unsigned int FindByCrc(uint32_t crc, std::vector<Match>& matches,
+		unsigned int maxMatches = 0) const;
+
+	unsigned int GetNumberOfImages() const;
+	unsigned int GetNumberOfFiles() const;
+
+	static bool IsImageFilename(const char* filename);
+
+	// CRC32 of a host file, for searching copies of it in the library
+	static bool CalculateFileCrc(const char* filename, uint32_t& crc, unsigned int& length);
+
+private:
+	struct Header {
+		char fMagic[8];
+		uint32_t fByteOrder;
+		uint32_t fNumberOfImages;
+		uint32_t fNumberOfFiles;
+		uint32_t fStringPoolSize;
+		uint32_t fImageTableOffset;
+		uint32_t fFileTableOffset;
+		uint32_t fNameIndexOffset;
+		uint32_t fCrcIndexOffset;
+		uint32_t fStringPoolOffset;
+		uint32_t fReserved;
+	};
+
+	struct ImageRecord {
+		// modification time in nanoseconds
+		int64_t fMTime;
+		int64_t fSize;
+		uint32_t fPath;
+		uint32_t fFirstFile;
+		uint32_t fNumberOfFiles;
+		uint32_t fReserved;
+	};
+
+	struct FileRecord {
+		uint32_t fImage;
+		uint32_t fPath;
+		uint32_t fName;
+		uint32_t fLength;
+		uint32_t fSectors;
+		uint32_t fCrc;
+	};
+
+	struct BuildFile {
+		std::string fPath;
+		unsigned int fNameOffset;
+		unsigned int fLength;
+		unsigned int fSectors;
+		uint32_t fCrc;
+	};
+
+	struct BuildImage {
+		std::string fPath;
+		int64_t fMTime;
+		int64_t fSize;
+		std::vector<BuildFile> fFiles;
+	};
+
+	struct NameCompare;
+	struct CrcCompare;
+
+	bool ValidateIndex() const;
+
+	inline const char* GetString(uint32_t offset) const;
+	void FillMatch(uint32_t fileNum, Match& match) const;
+	int FindImage(const char* path) const;
+
+	void ScanDirectory(const std::string& path, std::vector<BuildImage*>& images,
+		unsigned int& reused, unsigned int& scanned, bool verbose, unsigned int depth);
+	bool ReuseImage(BuildImage* image) const;
+	bool IndexImage(BuildImage* image) const;
+	void IndexDirectory(const RCPtr<AtrImage>& image, const RCPtr<Dos2xUtils>& utils,
+		unsigned int dirSector, const std::string& prefix, BuildImage* result,
+		unsigned int depth) const;
+	bool HashFile(const RCPtr<AtrImage>& image, unsigned int startSector,
+		bool use16BitLinks, BuildFile& file) const;
+
+	static bool WriteIndex(const char* filename, const std::vector<BuildImage*>& images);
+
+	uint8_t* fData;
+	size_t fDataSize;
+
+	const Header* fHeader;
+	const ImageRecord* fImages;
+	const FileRecord* fFiles;
+	const uint32_t* fNameIndex;
+	const uint32_t* fCrcIndex;
+	const char* fStringPool;
+};
+
+inline bool ImageLibrary::IsOpen() const
+{
+	return fData != 0;
+}
+
+inline const char* ImageLibrary::GetString(uint32_t offset) const
+{
+	return fStringPool + offset;
+}
+
+#endif
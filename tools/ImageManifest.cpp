@@ -0,0 +1,295 @@
+/*
+   ImageManifest.cpp - record of the host files a disk image was built from
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "ImageManifest.h"
+#include "Crc32.h"
+#include "OS.h"
+#include "winver.h"
+
+static const char sManifestHeader[] = "dir2atr manifest 1";
+
+ImageManifest::ImageManifest()
+{
+}
+
+ImageManifest::~ImageManifest()
+{
+}
+
+bool ImageManifest::ReadFromFile(const char* filename)
+{
+	fOptions.clear();
+	fEntries.clear();
+	fHostPathIndex.clear();
+
+	FILE* f = fopen(filename, "r");
+	if (!f) {
+		return false;
+	}
+
+	char line[PATH_MAX + 128];
+	bool ok = false;
+	std::map<std::string, std::string> dirHostPath;
+
+	if (!fgets(line, sizeof(line), f) || strncmp(line, sManifestHeader, strlen(sManifestHeader))) {
+		goto done;
+	}
+	if (!fgets(line, sizeof(line), f) || strncmp(line, "options\t", 8)) {
+		goto done;
+	}
+	line[strcspn(line, "\r\n")] = 0;
+	fOptions = line + 8;
+
+	while (fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "\r\n")] = 0;
+
+		// split off the fixed fields, the name is the rest of the line
+		char* field[6];
+		unsigned int numFields = (line[0] == 'D') ? 3 : 6;
+		char* p = line;
+		unsigned int i;
+		for (i = 0; i < numFields; i++) {
+			field[i] = p;
+			if (i + 1 < numFields) {
+				p = strchr(p, '\t');
+				if (!p) {
+					break;
+				}
+				*p++ = 0;
+			}
+		}
+		if (i != numFields || strlen(field[0]) != 1 || !*field[1] || !*field[numFields-1]) {
+			goto done;
+		}
+
+		Entry e;
+		e.fEntryPath = field[1];
+		e.fName = field[numFields-1];
+		e.fSize = 0;
+		e.fMTime = 0;
+		e.fCrc = 0;
+
+		std::string parent;
+		std::string::size_type slash = e.fEntryPath.rfind('/');
+		if (slash != std::string::npos) {
+			parent = e.fEntryPath.substr(0, slash);
+			std::map<std::string, std::string>::const_iterator it = dirHostPath.find(parent);
+			if (it == dirHostPath.end()) {
+				goto done;
+			}
+			e.fHostPath = it->second + "/" + e.fName;
+		} else {
+			e.fHostPath = e.fName;
+		}
+
+		switch (field[0][0]) {
+		case 'D':
+			e.fIsDirectory = true;
+			dirHostPath[e.fEntryPath] = e.fHostPath;
+			break;
+		case 'F':
+			e.fIsDirectory = false;
+			e.fSize = strtoll(field[2], 0, 10);
+			e.fMTime = strtoll(field[3], 0, 10);
+			e.fCrc = strtoul(field[4], 0, 16);
+			break;
+		default:
+			goto done;
+		}
+		fHostPathIndex[e.fHostPath] = fEntries.size();
+		fEntries.push_back(e);
+	}
+	ok = !ferror(f);
+done:
+	fclose(f);
+	if (!ok) {
+		fOptions.clear();
+		fEntries.clear();
+		fHostPathIndex.clear();
+	}
+	return ok;
+}
+
+bool ImageManifest::WriteToFile(const char* filename) const
+{
+	FILE* f = fopen(filename, "w");
+	if (!f) {
+		return false;
+	}
+	fprintf(f, "%s\noptions\t%s\n", sManifestHeader, fOptions.c_str());
+	for (unsigned int i = 0; i < fEntries.size(); i++) {
+		const Entry& e = fEntries[i];
+		if (e.fIsDirectory) {
+			fprintf(f, "D\t%s\t%s\n", e.fEntryPath.c_str(), e.fName.c_str());
+		} else {
+			fprintf(f, "F\t%s\t%lld\t%lld\t%08lx\t%s\n", e.fEntryPath.c_str(),
+				(long long) e.fSize, (long long) e.fMTime,
+				(unsigned long) e.fCrc, e.fName.c_str());
+		}
+	}
+	bool ok = !ferror(f);
+	if (fclose(f)) {
+		ok = false;
+	}
+	return ok;
+}
+
+std::string ImageManifest::GetHostFilename(const RCPtr<Dos2xUtils>& dir, const char* name)
+{
+	std::string path = dir->GetDirectory();
+	if (path.empty() || path[path.size() - 1] != DIR_SEPARATOR) {
+		path += DIR_SEPARATOR;
+	}
+	return path + name;
+}
+
+const ImageManifest::Entry* ImageManifest::FindHostPath(const std::string& hostPath) const
+{
+	std::map<std::string, unsigned int>::const_iterator it = fHostPathIndex.find(hostPath);
+	if (it == fHostPathIndex.end()) {
+		return 0;
+	}
+	return &fEntries[it->second];
+}
+
+bool ImageManifest::AttachImage(const RCPtr<Dos2xUtils>& root, unsigned int& unchanged)
+{
+	std::map<std::string, RCPtr<Dos2xUtils> > dirs;
+	struct stat statbuf;
+
+	unchanged = 0;
+	for (unsigned int i = 0; i < fEntries.size(); i++) {
+		Entry& e = fEntries[i];
+
+		RCPtr<Dos2xUtils> parent = root;
+		std::string::size_type slash = e.fEntryPath.rfind('/');
+		if (slash != std::string::npos) {
+			std::map<std::string, RCPtr<Dos2xUtils> >::const_iterator it =
+				dirs.find(e.fEntryPath.substr(0, slash));
+			if (it == dirs.end()) {
+				return false;
+			}
+			parent = it->second;
+		}
+		unsigned int entryNum = atoi(e.fEntryPath.c_str() + (slash == std::string::npos ? 0 : slash + 1));
+		std::string hostname = GetHostFilename(parent, e.fName.c_str());
+
+		if (e.fIsDirectory) {
+			// SyncWithHostDirectory doesn't remove subdirectories
+			if (stat(hostname.c_str(), &statbuf) || !S_ISDIR(statbuf.st_mode)) {
+				return false;
+			}
+			RCPtr<Dos2xUtils> dir = parent->AttachHostDirectory(entryNum, e.fName.c_str());
+			if (dir.IsNull()) {
+				return false;
+			}
+			dirs[e.fEntryPath] = dir;
+			continue;
+		}
+
+		off_t size = e.fSize;
+		time_t mtime = e.fMTime;
+		if (stat(hostname.c_str(), &statbuf) == 0 && S_ISREG(statbuf.st_mode)
+		    && statbuf.st_size == e.fSize) {
+			bool same = (statbuf.st_mtime == e.fMTime);
+			if (!same) {
+				// eg a fresh checkout, only the timestamp changed
+				uint32_t crc;
+				unsigned int length;
+				same = CRC32::CalcFileCRC32(hostname.c_str(), crc, length)
+					&& crc == e.fCrc && (off_t) length == statbuf.st_size;
+			}
+			if (same) {
+				size = statbuf.st_size;
+				mtime = statbuf.st_mtime;
+				e.fMTime = mtime;
+				unchanged++;
+			}
+		}
+		if (!parent->AttachHostFile(entryNum, e.fName.c_str(), size, mtime)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void ImageManifest::Build(const RCPtr<Dos2xUtils>& root, const ImageManifest* old)
+{
+	fEntries.clear();
+	fHostPathIndex.clear();
+	BuildDirectory(root, std::string(), std::string(), old);
+}
+
+void ImageManifest::BuildDirectory(const RCPtr<Dos2xUtils>& dir, const std::string& entryPrefix,
+	const std::string& hostPrefix, const ImageManifest* old)
+{
+	for (unsigned int i = 0; i < dir->GetEntryCount(); i++) {
+		const char* name = dir->GetHostName(i);
+		if (!name) {
+			continue;
+		}
+		char num[16];
+		snprintf(num, sizeof(num), "%d", i);
+
+		Entry e;
+		e.fEntryPath = entryPrefix + num;
+		e.fName = name;
+		e.fHostPath = hostPrefix + name;
+		e.fSize = 0;
+		e.fMTime = 0;
+		e.fCrc = 0;
+
+		RCPtr<Dos2xUtils> subdir = dir->GetSubdirectory(i);
+		if (subdir.IsNotNull()) {
+			e.fIsDirectory = true;
+			fHostPathIndex[e.fHostPath] = fEntries.size();
+			fEntries.push_back(e);
+			BuildDirectory(subdir, e.fEntryPath + "/", e.fHostPath + "/", old);
+			continue;
+		}
+
+		e.fIsDirectory = false;
+		off_t size;
+		time_t mtime;
+		dir->GetHostFileState(i, size, mtime);
+		e.fSize = size;
+		e.fMTime = mtime;
+
+		const Entry* oldEntry = old ? old->FindHostPath(e.fHostPath) : 0;
+		if (oldEntry && !oldEntry->fIsDirectory
+		    && oldEntry->fSize == e.fSize && oldEntry->fMTime == e.fMTime) {
+			e.fCrc = oldEntry->fCrc;
+		} else {
+			unsigned int length;
+			if (!CRC32::CalcFileCRC32(GetHostFilename(dir, name).c_str(), e.fCrc, length)) {
+				// never matches, the file is rewritten on the next update
+				e.fSize = -1;
+			}
+		}
+		fHostPathIndex[e.fHostPath] = fEntries.size();
+		fEntries.push_back(e);
+	}
+}
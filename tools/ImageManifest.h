@@ -0,0 +1,101 @@
+#ifndef IMAGEMANIFEST_H
+#define IMAGEMANIFEST_H
+
+/*
+   ImageManifest.h - record of the host files a disk image was built from
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "RefCounted.h"
+#include "RCPtr.h"
+#include "Dos2xUtils.h"
+
+// The manifest is a text file with one line per directory entry that
+// was created from a host file or directory:
+//
+//   F <entry> <size> <mtime> <crc32> <name>
+//   D <entry> <name>
+//
+// fields are separated by tabs. <entry> is the directory entry number,
+// prefixed with the entry numbers of the parent directories, eg "3/12".
+// The options line describes how the image was created, the manifest
+// only applies to images created with identical options.
+
+class ImageManifest : public RefCounted {
+public:
+	ImageManifest();
+	virtual ~ImageManifest();
+
+	bool ReadFromFile(const char* filename);
+	bool WriteToFile(const char* filename) const;
+
+	inline void SetOptions(const std::string& options);
+	inline const std::string& GetOptions() const;
+
+	// connect the directory entries of the image to the host files
+	// recorded in the manifest. Files whose size and modification
+	// time or CRC are unchanged get their current state recorded,
+	// so Dos2xUtils::SyncWithHostDirectory leaves them alone.
+	// Returns false if the image doesn't match the manifest.
+	bool AttachImage(const RCPtr<Dos2xUtils>& root, unsigned int& unchanged);
+
+	// record the host files of the image. CRCs of files that are
+	// unchanged since the old manifest was created are taken over.
+	void Build(const RCPtr<Dos2xUtils>& root, const ImageManifest* old = 0);
+
+private:
+	struct Entry {
+		std::string fEntryPath;
+		std::string fName;
+		// path of the host file relative to the image directory
+		std::string fHostPath;
+		bool fIsDirectory;
+		int64_t fSize;
+		int64_t fMTime;
+		uint32_t fCrc;
+	};
+
+	void BuildDirectory(const RCPtr<Dos2xUtils>& dir, const std::string& entryPrefix,
+		const std::string& hostPrefix, const ImageManifest* old);
+
+	const Entry* FindHostPath(const std::string& hostPath) const;
+
+	static std::string GetHostFilename(const RCPtr<Dos2xUtils>& dir, const char* name);
+
+	std::string fOptions;
+	std::vector<Entry> fEntries;
+	std::map<std::string, unsigned int> fHostPathIndex;
+};
+
+inline void ImageManifest::SetOptions(const std::string& options)
+{
+	fOptions = options;
+}
+
+inline const std::string& ImageManifest::GetOptions() const
+{
+	return fOptions;
+}
+
+#endif
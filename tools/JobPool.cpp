@@ -0,0 +1,165 @@
+/*
+   JobPool.cpp - run a list of jobs in worker threads
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "JobPool.h"
+#ifdef JOBPOOL_THREADS
+#include "MiscUtils.h"
+#endif
+
+void JobOutput::Printf(const char* format, ...)
+{
+	va_list ap;
+	va_start(ap, format);
+	if (fBuffered) {
+		char buf[PATH_MAX + 256];
+		vsnprintf(buf, sizeof(buf), format, ap);
+		fText += buf;
+	} else {
+		vprintf(format, ap);
+	}
+	va_end(ap);
+}
+
+JobPool::JobPool(JobFunc func, void* arg)
+	: fFunc(func),
+	  fArg(arg)
+{
+#ifdef JOBPOOL_THREADS
+	pthread_mutex_init(&fMutex, 0);
+	pthread_cond_init(&fCond, 0);
+#endif
+}
+
+JobPool::~JobPool()
+{
+#ifdef JOBPOOL_THREADS
+	pthread_cond_destroy(&fCond);
+	pthread_mutex_destroy(&fMutex);
+#endif
+}
+
+unsigned int JobPool::GetNumberOfThreads(int numThreads, unsigned int numJobs)
+{
+	if (numThreads <= 0) {
+#ifdef JOBPOOL_THREADS
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		if (cpus > eMaxDefaultThreads) {
+			cpus = eMaxDefaultThreads;
+		}
+		numThreads = (cpus > 1) ? cpus : 1;
+#else
+		numThreads = 1;
+#endif
+	}
+	if ((unsigned int) numThreads > numJobs) {
+		numThreads = numJobs;
+	}
+	return numThreads;
+}
+
+#ifdef JOBPOOL_THREADS
+
+void* JobPool::ThreadFunc(void* arg)
+{
+	static_cast<JobPool*>(arg)->RunJobs();
+	return 0;
+}
+
+void JobPool::RunJobs()
+{
+	pthread_mutex_lock(&fMutex);
+	while (fNext < fNumJobs) {
+		unsigned int idx = fNext;
+		if (idx >= fPrinted + eMaxAhead) {
+			pthread_cond_wait(&fCond, &fMutex);
+			continue;
+		}
+		fNext++;
+		pthread_mutex_unlock(&fMutex);
+
+		JobOutput out(true);
+		int result = fFunc(idx, out, fArg);
+
+		pthread_mutex_lock(&fMutex);
+		fOutput[idx].swap(out.fText);
+		fResult[idx] = result;
+		fDone[idx] = true;
+		pthread_cond_broadcast(&fCond);
+	}
+	pthread_mutex_unlock(&fMutex);
+}
+
+bool JobPool::Run(unsigned int numJobs, unsigned int numThreads, std::vector<int>& results)
+{
+	fNumJobs = numJobs;
+	fNext = 0;
+	fPrinted = 0;
+	fOutput.assign(numJobs, std::string());
+	fResult.assign(numJobs, 0);
+	fDone.assign(numJobs, false);
+
+	std::vector<pthread_t> threads;
+	for (unsigned int i = 0; i < numThreads; i++) {
+		pthread_t thread;
+		if (!MiscUtils::create_normal_priority_thread(thread, ThreadFunc, this)) {
+			break;
+		}
+		threads.push_back(thread);
+	}
+	if (threads.empty()) {
+		return false;
+	}
+
+	for (unsigned int i = 0; i < numJobs; i++) {
+		std::string out;
+		pthread_mutex_lock(&fMutex);
+		while (!fDone[i]) {
+			pthread_cond_wait(&fCond, &fMutex);
+		}
+		out.swap(fOutput[i]);
+		int result = fResult[i];
+		fPrinted = i + 1;
+		pthread_cond_broadcast(&fCond);
+		pthread_mutex_unlock(&fMutex);
+		if (result == 0) {
+			fputs(out.c_str(), stdout);
+		}
+	}
+
+	for (unsigned int i = 0; i < threads.size(); i++) {
+		pthread_join(threads[i], 0);
+	}
+	results = fResult;
+	return true;
+}
+
+#else
+
+bool JobPool::Run(unsigned int, unsigned int, std::vector<int>&)
+{
+	return false;
+}
+
+#endif
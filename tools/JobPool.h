@@ -0,0 +1,91 @@
+#ifndef JOBPOOL_H
+#define JOBPOOL_H
+
+/*
+   JobPool.h - run a list of jobs in worker threads
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <string>
+#include <vector>
+
+#if !defined(WINVER) && !defined(POSIXVER)
+#define JOBPOOL_THREADS
+#include <pthread.h>
+#endif
+
+// messages of a job are collected in a string when it runs in the
+// pool, so they can be printed in the order of the job list
+struct JobOutput {
+	JobOutput(bool buffered) : fBuffered(buffered) {}
+
+	void Printf(const char* format, ...)
+		__attribute__ ((format (printf, 2, 3)));
+
+	bool fBuffered;
+	std::string fText;
+};
+
+// Runs jobs 0..numJobs-1 in worker threads and prints their output to
+// stdout in job order. The tracer isn't thread safe: callers switch
+// tracing off while the pool runs and repeat failed jobs sequentially
+// afterwards to report their errors.
+
+class JobPool {
+public:
+	// run job idx and return 0 on success
+	typedef int (*JobFunc)(unsigned int idx, JobOutput& out, void* arg);
+
+	JobPool(JobFunc func, void* arg);
+	~JobPool();
+
+	// numThreads 0 selects one thread per CPU. The result is limited
+	// to the number of jobs.
+	static unsigned int GetNumberOfThreads(int numThreads, unsigned int numJobs);
+
+	// the output of failed jobs isn't printed. Returns false if no
+	// worker thread could be started, no job was run then.
+	bool Run(unsigned int numJobs, unsigned int numThreads, std::vector<int>& results);
+
+private:
+	enum {
+		// limit the number of buffered outputs if a slow job
+		// holds up the output
+		eMaxAhead = 256,
+		eMaxDefaultThreads = 16
+	};
+
+	JobFunc fFunc;
+	void* fArg;
+
+#ifdef JOBPOOL_THREADS
+	static void* ThreadFunc(void* arg);
+	void RunJobs();
+
+	pthread_mutex_t fMutex;
+	pthread_cond_t fCond;
+	unsigned int fNumJobs;
+	unsigned int fNext;
+	unsigned int fPrinted;
+	std::vector<std::string> fOutput;
+	std::vector<int> fResult;
+	std::vector<bool> fDone;
+#endif
+};
+
+#endif
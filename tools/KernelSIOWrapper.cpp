@@ -32,7 +32,10 @@
 #include "Error.h"
 
 KernelSIOWrapper::KernelSIOWrapper(int fileno)
-	: super(fileno)
+	: super(fileno),
+	  fAutobaud(false),
+	  fBaudrateKnown(false),
+	  fBaudrate(0)
 {
 	InitializeBaudrates();
 }
@@ -75,6 +78,7 @@ int KernelSIOWrapper::Set1050CableType(E1050CableType type)
 	if (fLastResult == -1) {
 		fLastResult = errno;
 	}
+	fBaudrateKnown = false;
 
 	return fLastResult;
 }
@@ -103,6 +107,7 @@ int KernelSIOWrapper::SetSIOServerMode(ESIOServerCommandLine cmdLine)
 		if (fLastResult == -1) {
 			fLastResult = errno;
 		}
+		fBaudrateKnown = false;
 	}
 	return fLastResult;
 }
@@ -133,7 +138,7 @@ int KernelSIOWrapper::ExtSIO(Ext_SIO_parameters& params)
 	return fLastResult;
 }
 
-int KernelSIOWrapper::WaitForCommandFrame(int otherReadPollDevice)
+int KernelSIOWrapper::WaitForCommandFrame(int otherReadPollDevice, int auxReadPollDevice)
 {
 	fd_set read_set;
 	fd_set except_set;
@@ -149,12 +154,20 @@ int KernelSIOWrapper::WaitForCommandFrame(int otherReadPollDevice)
 		FD_ZERO(&except_set);
 		FD_SET(fDeviceFileNo, &except_set);
 
-		if (otherReadPollDevice>=0) {
-			if (otherReadPollDevice > maxfd) {
-				maxfd = otherReadPollDevice;
-			}
+		if (otherReadPollDevice>=0 || auxReadPollDevice>=0) {
 			FD_ZERO(&read_set);
-			FD_SET(otherReadPollDevice, &read_set);
+			if (otherReadPollDevice>=0) {
+				if (otherReadPollDevice > maxfd) {
+					maxfd = otherReadPollDevice;
+				}
+				FD_SET(otherReadPollDevice, &read_set);
+			}
+			if (auxReadPollDevice>=0) {
+				if (auxReadPollDevice > maxfd) {
+					maxfd = auxReadPollDevice;
+				}
+				FD_SET(auxReadPollDevice, &read_set);
+			}
 
 			// timeout for checking printer queue
 			tv.tv_sec = 15;
@@ -170,9 +183,12 @@ int KernelSIOWrapper::WaitForCommandFrame(int otherReadPollDevice)
 			if (FD_ISSET(fDeviceFileNo, &except_set)) {
 				return 0;
 			}
-			if (FD_ISSET(otherReadPollDevice, &read_set)) {
+			if (otherReadPollDevice>=0 && FD_ISSET(otherReadPollDevice, &read_set)) {
 				return 1;
 			}
+			if (auxReadPollDevice>=0 && FD_ISSET(auxReadPollDevice, &read_set)) {
+				return 3;
+			}
 			DPRINTF("illegal condition using select!");
 			return -2;
 		} else {
@@ -200,6 +216,16 @@ int KernelSIOWrapper::GetCommandFrame(SIO_command_frame& frame)
 		fLastResult = ioctl(fDeviceFileNo, ATARISIO_IOC_GET_COMMAND_FRAME, &frame);
 		if (fLastResult == -1) {
 			fLastResult = errno;
+		} else if (fBaudrateKnown) {
+			fCommandFrameBaudrate = fBaudrate;
+		} else {
+			int result = fLastResult;
+			fCommandFrameBaudrate = GetBaudrate();
+			if (!fAutobaud && GetLastStatus() == 0) {
+				fBaudrate = fCommandFrameBaudrate;
+				fBaudrateKnown = true;
+			}
+			fLastResult = result;
 		}
 	}
 	return fLastResult;
@@ -408,6 +434,10 @@ int KernelSIOWrapper::SetBaudrate(unsigned int baudrate, bool /* now */)
 		fLastResult = ioctl(fDeviceFileNo, ATARISIO_IOC_SET_BAUDRATE, baudrate);
 		if (fLastResult == -1) {
 			fLastResult = errno;
+			fBaudrateKnown = false;
+		} else {
+			fBaudrate = baudrate;
+			fBaudrateKnown = !fAutobaud;
 		}
 	}
 	return fLastResult;
@@ -447,6 +477,15 @@ int KernelSIOWrapper::SetAutobaud(unsigned int on)
 		fLastResult = ioctl(fDeviceFileNo, ATARISIO_IOC_SET_AUTOBAUD, on);
 		if (fLastResult == -1) {
 			fLastResult = errno;
+			fBaudrateKnown = false;
+		} else if (on) {
+			fAutobaud = true;
+			fBaudrateKnown = false;
+		} else {
+			fAutobaud = false;
+			// the driver switched back to the standard baudrate
+			fBaudrate = fStandardBaudrate;
+			fBaudrateKnown = true;
 		}
 	}
 	return fLastResult;
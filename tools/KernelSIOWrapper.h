@@ -56,7 +56,7 @@ public:
 	 * SIO server methods
 	 */
 
-	virtual int WaitForCommandFrame(int otherReadPollDevice=-1);
+	virtual int WaitForCommandFrame(int otherReadPollDevice=-1, int auxReadPollDevice=-1);
 	/*
 	 * return values:
 	 * -1 = timeout
@@ -116,6 +116,12 @@ public:
 
 private:
 	typedef SIOWrapper super;
+
+	// the driver only changes the baudrate on its own in autobaud
+	// mode, otherwise fBaudrate mirrors its current rate
+	bool fAutobaud;
+	bool fBaudrateKnown;
+	unsigned int fBaudrate;
 };
 
 #endif
@@ -0,0 +1,43 @@
+#ifndef LAZYSECTORSOURCE_H
+#define LAZYSECTORSOURCE_H
+
+/*
+   LazySectorSource.h - decode sectors of an image file on demand
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdint.h>
+
+#include "RefCounted.h"
+
+// A lazy sector source keeps the image file open and knows where
+// the data of each sector is stored in it. AtrMemoryImage uses it
+// to decode sectors when they are first accessed instead of decoding
+// the whole image when it is loaded.
+
+class LazySectorSource : public RefCounted {
+public:
+	LazySectorSource() {}
+	virtual ~LazySectorSource() {}
+
+	// decode sector into buffer. len is the length of the sector,
+	// sectors not contained in the image file are zero-filled.
+	virtual bool DecodeSector(unsigned int sector, uint8_t* buffer, unsigned int len) = 0;
+};
+
+#endif
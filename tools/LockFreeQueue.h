@@ -0,0 +1,153 @@
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+/*
+   LockFreeQueue.h - bounded single-producer/single-consumer queue
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <atomic>
+
+// Ring buffer used to pass data between the realtime SIO thread and
+// normal priority worker threads. Exactly one thread may call the
+// producer methods (GetWriteSlot/CommitWrite/Push) and exactly one
+// thread may call the consumer methods (GetReadSlot/CommitRead/Pop).
+// Neither side ever blocks or allocates memory.
+//
+// Size must be a power of 2, one slot is always left empty.
+
+template<class T, unsigned int Size>
+class LockFreeQueue {
+public:
+	LockFreeQueue()
+		: fHead(0), fTail(0)
+	{
+		static_assert((Size & (Size - 1)) == 0, "queue size must be a power of 2");
+	}
+
+	// producer side
+
+	// returns NULL if the queue is full
+	inline T* GetWriteSlot();
+	inline void CommitWrite();
+
+	inline bool Push(const T& item);
+
+	// consumer side
+
+	// returns NULL if the queue is empty
+	inline T* GetReadSlot();
+	inline void CommitRead();
+
+	inline bool Pop(T& item);
+
+	// may be called from either side
+	inline bool IsEmpty() const;
+	inline bool IsFull() const;
+	inline unsigned int GetUsedSlots() const;
+
+	enum { eCapacity = Size - 1 };
+
+private:
+	enum { eMask = Size - 1 };
+
+	T fSlots[Size];
+
+	// written by consumer only
+	std::atomic<unsigned int> fHead;
+	// written by producer only
+	std::atomic<unsigned int> fTail;
+};
+
+template<class T, unsigned int Size>
+inline T* LockFreeQueue<T, Size>::GetWriteSlot()
+{
+	unsigned int tail = fTail.load(std::memory_order_relaxed);
+	if (((tail + 1) & eMask) == fHead.load(std::memory_order_acquire)) {
+		return 0;
+	}
+	return &fSlots[tail];
+}
+
+template<class T, unsigned int Size>
+inline void LockFreeQueue<T, Size>::CommitWrite()
+{
+	unsigned int tail = fTail.load(std::memory_order_relaxed);
+	fTail.store((tail + 1) & eMask, std::memory_order_release);
+}
+
+template<class T, unsigned int Size>
+inline bool LockFreeQueue<T, Size>::Push(const T& item)
+{
+	T* slot = GetWriteSlot();
+	if (!slot) {
+		return false;
+	}
+	*slot = item;
+	CommitWrite();
+	return true;
+}
+
+template<class T, unsigned int Size>
+inline T* LockFreeQueue<T, Size>::GetReadSlot()
+{
+	unsigned int head = fHead.load(std::memory_order_relaxed);
+	if (head == fTail.load(std::memory_order_acquire)) {
+		return 0;
+	}
+	return &fSlots[head];
+}
+
+template<class T, unsigned int Size>
+inline void LockFreeQueue<T, Size>::CommitRead()
+{
+	unsigned int head = fHead.load(std::memory_order_relaxed);
+	fHead.store((head + 1) & eMask, std::memory_order_release);
+}
+
+template<class T, unsigned int Size>
+inline bool LockFreeQueue<T, Size>::Pop(T& item)
+{
+	T* slot = GetReadSlot();
+	if (!slot) {
+		return false;
+	}
+	item = *slot;
+	CommitRead();
+	return true;
+}
+
+template<class T, unsigned int Size>
+inline bool LockFreeQueue<T, Size>::IsEmpty() const
+{
+	return fHead.load(std::memory_order_acquire) == fTail.load(std::memory_order_acquire);
+}
+
+template<class T, unsigned int Size>
+inline bool LockFreeQueue<T, Size>::IsFull() const
+{
+	return ((fTail.load(std::memory_order_acquire) + 1) & eMask) == fHead.load(std::memory_order_acquire);
+}
+
+template<class T, unsigned int Size>
+inline unsigned int LockFreeQueue<T, Size>::GetUsedSlots() const
+{
+	return (fTail.load(std::memory_order_acquire) - fHead.load(std::memory_order_acquire)) & eMask;
+}
+
+#endif
@@ -0,0 +1,432 @@
+/*
+   LoopbackSIOWrapper.cpp - replay SIO command frames without hardware
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "LoopbackSIOWrapper.h"
+#include "Crc32.h"
+
+LoopbackSIOWrapper::LoopbackSIOWrapper()
+	: SIOWrapper(-1),
+	  fPos(0),
+	  fBaudrate(19200),
+	  fTime(0),
+	  fRecording(true),
+	  fTiming(false),
+	  fCpuTimerRunning(false),
+	  fCpuStart(0)
+{
+	fStandardBaudrate = 19200;
+	fHighspeedBaudrate = 57600;
+	fCommandFrameBaudrate = 19200;
+}
+
+LoopbackSIOWrapper::~LoopbackSIOWrapper()
+{
+}
+
+void LoopbackSIOWrapper::AddFrame(const Frame& frame)
+{
+	fFrames.push_back(frame);
+}
+
+void LoopbackSIOWrapper::AddFrame(uint8_t device, uint8_t command, unsigned int aux,
+	unsigned int baudrate, unsigned int delay)
+{
+	Frame f;
+	memset(&f.fFrame, 0, sizeof(f.fFrame));
+	f.fFrame.device_id = device;
+	f.fFrame.command = command;
+	f.fFrame.aux1 = aux & 0xff;
+	f.fFrame.aux2 = (aux >> 8) & 0xff;
+	f.fBaudrate = baudrate;
+	f.fDelay = delay;
+	fFrames.push_back(f);
+}
+
+static int hex_digit(char c)
+{
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+bool LoopbackSIOWrapper::ReadSession(const char* filename)
+{
+	FILE* f = fopen(filename, "r");
+	if (!f) {
+		return false;
+	}
+
+	bool ok = true;
+	unsigned int delay = 0;
+	char line[0x10000 * 2 + 256];
+	while (ok && fgets(line, sizeof(line), f)) {
+		char* p = line + strspn(line, " \t");
+		if (*p == '#' || *p == '\r' || *p == '\n' || *p == 0) {
+			continue;
+		}
+		if (strncmp(p, "delay", 5) == 0) {
+			delay += strtoul(p + 5, 0, 10);
+			continue;
+		}
+
+		Frame frame;
+		unsigned int dev, cmd, aux1, aux2;
+		int len;
+		if (sscanf(p, "%x %x %x %x%n", &dev, &cmd, &aux1, &aux2, &len) != 4) {
+			ok = false;
+			break;
+		}
+		memset(&frame.fFrame, 0, sizeof(frame.fFrame));
+		frame.fFrame.device_id = dev;
+		frame.fFrame.command = cmd;
+		frame.fFrame.aux1 = aux1;
+		frame.fFrame.aux2 = aux2;
+		frame.fBaudrate = 19200;
+		frame.fDelay = delay;
+		delay = 0;
+
+		p += len;
+		p += strspn(p, " \t");
+		if (*p == '@') {
+			frame.fBaudrate = strtoul(p + 1, &p, 10);
+			if (frame.fBaudrate == 0) {
+				ok = false;
+				break;
+			}
+			p += strspn(p, " \t");
+		}
+		while (hex_digit(p[0]) >= 0) {
+			if (hex_digit(p[1]) < 0) {
+				ok = false;
+				break;
+			}
+			frame.fData.push_back(hex_digit(p[0]) * 16 + hex_digit(p[1]));
+			p += 2;
+		}
+		p += strspn(p, " \t\r\n");
+		if (*p) {
+			ok = false;
+		}
+		fFrames.push_back(frame);
+	}
+	fclose(f);
+	return ok;
+}
+
+bool LoopbackSIOWrapper::WriteSession(const char* filename) const
+{
+	FILE* f = fopen(filename, "w");
+	if (!f) {
+		return false;
+	}
+	fprintf(f, "# device command aux1 aux2 [@baudrate] [data]\n");
+	for (unsigned int i = 0; i < fFrames.size(); i++) {
+		const Frame& frame = fFrames[i];
+		if (frame.fDelay) {
+			fprintf(f, "delay %u\n", frame.fDelay);
+		}
+		fprintf(f, "%02x %02x %02x %02x", frame.fFrame.device_id, frame.fFrame.command,
+			frame.fFrame.aux1, frame.fFrame.aux2);
+		if (frame.fBaudrate != 19200) {
+			fprintf(f, " @%u", frame.fBaudrate);
+		}
+		if (frame.fData.size()) {
+			fputc(' ', f);
+			for (unsigned int j = 0; j < frame.fData.size(); j++) {
+				fprintf(f, "%02x", frame.fData[j]);
+			}
+		}
+		fputc('\n', f);
+	}
+	bool ok = !ferror(f);
+	if (fclose(f)) {
+		ok = false;
+	}
+	return ok;
+}
+
+void LoopbackSIOWrapper::Rewind()
+{
+	fPos = 0;
+	fTime = 0;
+	fBaudrate = fStandardBaudrate;
+	fEvents.clear();
+	fCpuTimerRunning = false;
+	fCpuTimes.resize(fFrames.size());
+	for (unsigned int i = 0; i < fCpuTimes.size(); i++) {
+		fCpuTimes[i] = 0;
+	}
+}
+
+static unsigned long long cpu_time()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void LoopbackSIOWrapper::StopCpuTimer()
+{
+	if (fCpuTimerRunning) {
+		if (fPos > 0 && fPos <= fCpuTimes.size()) {
+			fCpuTimes[fPos - 1] += cpu_time() - fCpuStart;
+		}
+		fCpuTimerRunning = false;
+	}
+}
+
+unsigned long long LoopbackSIOWrapper::Transmit(unsigned int gap, unsigned int length)
+{
+	unsigned long long start = fTime + gap;
+	// 10 bits per byte
+	fTime = start + (length * 10ULL * 1000000ULL + fBaudrate / 2) / fBaudrate;
+	return start;
+}
+
+void LoopbackSIOWrapper::Record(unsigned long long time, EEventType type, const uint8_t* buf, unsigned int length)
+{
+	if (!fRecording) {
+		return;
+	}
+	Event e;
+	e.fTime = time;
+	e.fType = type;
+	e.fFrameNumber = fPos ? fPos - 1 : 0;
+	e.fLength = length;
+	e.fCrc = buf ? CRC32::CalcCRC32(0, (void*) buf, length) : 0;
+	e.fBaudrate = fBaudrate;
+	fEvents.push_back(e);
+}
+
+int LoopbackSIOWrapper::WaitForCommandFrame(int, int)
+{
+	if (fTiming) {
+		StopCpuTimer();
+	}
+	// makes DoServing return once all frames are processed
+	return (fPos < fFrames.size()) ? 0 : 1;
+}
+
+int LoopbackSIOWrapper::GetCommandFrame(SIO_command_frame& frame)
+{
+	const Frame& f = fFrames[fPos++];
+	frame = f.fFrame;
+	fBaudrate = f.fBaudrate;
+	fCommandFrameBaudrate = fBaudrate;
+	// the idle time is added before the frame, the frame itself
+	// ends at the current time
+	unsigned long long start = Transmit(f.fDelay, 5);
+	Record(start, eCommandFrame);
+	// emulated drive timing (ATP) is relative to the virtual clock,
+	// waiting for a point in the past returns immediately
+	frame.reception_timestamp = fTime;
+
+	if (fTiming) {
+		fCpuTimerRunning = true;
+		fCpuStart = cpu_time();
+	}
+	return 0;
+}
+
+int LoopbackSIOWrapper::SendCommandACK()
+{
+	Record(Transmit(eResponseGap, 1), eCommandACK);
+	return 0;
+}
+
+int LoopbackSIOWrapper::SendCommandNAK()
+{
+	Record(Transmit(eResponseGap, 1), eCommandNAK);
+	return 0;
+}
+
+int LoopbackSIOWrapper::SendDataACK()
+{
+	Record(Transmit(eResponseGap, 1), eDataACK);
+	return 0;
+}
+
+int LoopbackSIOWrapper::SendDataNAK()
+{
+	Record(Transmit(eResponseGap, 1), eDataNAK);
+	return 0;
+}
+
+int LoopbackSIOWrapper::SendComplete()
+{
+	Record(Transmit(eCompleteGap, 1), eComplete);
+	return 0;
+}
+
+int LoopbackSIOWrapper::SendError()
+{
+	Record(Transmit(eCompleteGap, 1), eError);
+	return 0;
+}
+
+int LoopbackSIOWrapper::SendDataFrame(uint8_t* buf, unsigned int length)
+{
+	// data plus checksum
+	Record(Transmit(0, length + 1), eSendData, buf, length);
+	return 0;
+}
+
+int LoopbackSIOWrapper::ReceiveDataFrame(uint8_t* buf, unsigned int length)
+{
+	const Frame& f = fFrames[fPos - 1];
+	unsigned int copylen = f.fData.size();
+	if (copylen > length) {
+		copylen = length;
+	}
+	if (copylen) {
+		memcpy(buf, &f.fData[0], copylen);
+	}
+	if (copylen < length) {
+		memset(buf + copylen, fPos & 0xff, length - copylen);
+	}
+	Record(Transmit(eResponseGap, length + 1), eReceiveData, buf, length);
+	return 0;
+}
+
+int LoopbackSIOWrapper::SendRawFrame(uint8_t* buf, unsigned int length)
+{
+	Record(Transmit(0, length), eSendRaw, buf, length);
+	return 0;
+}
+
+int LoopbackSIOWrapper::SendCommandACKXF551()
+{
+	int ret = SendCommandACK();
+	fBaudrate = 38400;
+	return ret;
+}
+
+int LoopbackSIOWrapper::SendCompleteXF551()
+{
+	return SendComplete();
+}
+
+int LoopbackSIOWrapper::SendDataFrameXF551(uint8_t* buf, unsigned int length)
+{
+	int ret = SendDataFrame(buf, length);
+	fBaudrate = fStandardBaudrate;
+	return ret;
+}
+
+int LoopbackSIOWrapper::SetBaudrate(unsigned int baudrate, bool)
+{
+	if (baudrate != fBaudrate) {
+		fBaudrate = baudrate;
+		Record(fTime, eBaudrate);
+	}
+	return 0;
+}
+
+int LoopbackSIOWrapper::SetStandardBaudrate(unsigned int baudrate)
+{
+	fStandardBaudrate = baudrate;
+	return 0;
+}
+
+int LoopbackSIOWrapper::SetHighSpeedBaudrate(unsigned int baudrate)
+{
+	fHighspeedBaudrate = baudrate;
+	return 0;
+}
+
+unsigned int LoopbackSIOWrapper::GetBaudrateForPokeyDivisor(unsigned int pokey_div)
+{
+	switch (pokey_div) {
+	case ATARISIO_POKEY_DIVISOR_STANDARD:
+		return 19200;
+	case ATARISIO_POKEY_DIVISOR_2XSIO_XF551:
+		return 38400;
+	case ATARISIO_POKEY_DIVISOR_3XSIO:
+		return 57600;
+	default:
+		return ATARISIO_ATARI_FREQUENCY_PAL / (2 * (pokey_div + 7));
+	}
+}
+
+std::string LoopbackSIOWrapper::FormatEvent(const Event& e, const std::vector<Frame>& frames)
+{
+	char buf[128];
+	int len = snprintf(buf, sizeof(buf), "%llu ", e.fTime);
+	switch (e.fType) {
+	case eCommandFrame: {
+		const SIO_command_frame& f = frames[e.fFrameNumber].fFrame;
+		snprintf(buf + len, sizeof(buf) - len, "frame %02x %02x %02x %02x @%u",
+			f.device_id, f.command, f.aux1, f.aux2, e.fBaudrate);
+		break;
+	}
+	case eCommandACK:
+		snprintf(buf + len, sizeof(buf) - len, "ack");
+		break;
+	case eCommandNAK:
+		snprintf(buf + len, sizeof(buf) - len, "nak");
+		break;
+	case eDataACK:
+		snprintf(buf + len, sizeof(buf) - len, "data-ack");
+		break;
+	case eDataNAK:
+		snprintf(buf + len, sizeof(buf) - len, "data-nak");
+		break;
+	case eComplete:
+		snprintf(buf + len, sizeof(buf) - len, "complete");
+		break;
+	case eError:
+		snprintf(buf + len, sizeof(buf) - len, "error");
+		break;
+	case eSendData:
+		snprintf(buf + len, sizeof(buf) - len, "send %u %08lx",
+			e.fLength, (unsigned long) e.fCrc);
+		break;
+	case eReceiveData:
+		snprintf(buf + len, sizeof(buf) - len, "receive %u %08lx",
+			e.fLength, (unsigned long) e.fCrc);
+		break;
+	case eSendRaw:
+		snprintf(buf + len, sizeof(buf) - len, "raw %u %08lx",
+			e.fLength, (unsigned long) e.fCrc);
+		break;
+	case eBaudrate:
+		snprintf(buf + len, sizeof(buf) - len, "baudrate %u", e.fBaudrate);
+		break;
+	}
+	return buf;
+}
+
+void LoopbackSIOWrapper::WriteTrace(FILE* f) const
+{
+	for (unsigned int i = 0; i < fEvents.size(); i++) {
+		fprintf(f, "%s\n", FormatEvent(fEvents[i], fFrames).c_str());
+	}
+}
@@ -0,0 +1,190 @@
+#ifndef LOOPBACKSIOWRAPPER_H
+#define LOOPBACKSIOWRAPPER_H
+
+/*
+   LoopbackSIOWrapper.h - replay SIO command frames without hardware
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "SIOWrapper.h"
+
+// Plays a session of command frames into SIOManager::DoServing, as if
+// they were sent by an Atari. DoServing returns once all frames have
+// been processed.
+//
+// All responses of the handlers are recorded with timestamps from a
+// virtual clock, which advances by the transmission time of every
+// frame at the current baudrate plus fixed protocol gaps, so traces
+// are identical on every run and can be compared against golden
+// traces. Optionally the CPU time spent on each command is measured.
+//
+// With recording and timing disabled serving a session doesn't
+// allocate memory.
+
+class LoopbackSIOWrapper : public SIOWrapper {
+public:
+	struct Frame {
+		SIO_command_frame fFrame;
+		// baudrate the Atari sent the command frame at
+		unsigned int fBaudrate;
+		// idle time before the command frame, in usec
+		unsigned int fDelay;
+		// data frame sent by the Atari (eg for write commands), the
+		// received data is filled with a pattern if it's too short
+		std::vector<uint8_t> fData;
+	};
+
+	enum EEventType {
+		eCommandFrame,
+		eCommandACK,
+		eCommandNAK,
+		eDataACK,
+		eDataNAK,
+		eComplete,
+		eError,
+		eSendData,
+		eReceiveData,
+		eSendRaw,
+		eBaudrate
+	};
+
+	struct Event {
+		// virtual time in usec
+		unsigned long long fTime;
+		EEventType fType;
+		// number of the command frame the event belongs to
+		unsigned int fFrameNumber;
+		unsigned int fLength;
+		uint32_t fCrc;
+		unsigned int fBaudrate;
+	};
+
+	LoopbackSIOWrapper();
+	virtual ~LoopbackSIOWrapper();
+
+	void AddFrame(const Frame& frame);
+	void AddFrame(uint8_t device, uint8_t command, unsigned int aux,
+		unsigned int baudrate = 19200, unsigned int delay = 0);
+
+	// one frame per line, hex values:
+	// [delay <usec>]
+	// <device> <command> <aux1> <aux2> [@<baudrate>] [<data>]
+	bool ReadSession(const char* filename);
+	bool WriteSession(const char* filename) const;
+
+	unsigned int GetNumberOfFrames() const { return fFrames.size(); }
+	const Frame& GetFrame(unsigned int i) const { return fFrames[i]; }
+
+	// restart the session, clear the recorded events and the clock
+	void Rewind();
+
+	void SetRecording(bool on) { fRecording = on; }
+	void SetTiming(bool on) { fTiming = on; }
+
+	const std::vector<Event>& GetEvents() const { return fEvents; }
+
+	// CPU time in nsec spent on processing each frame, valid if
+	// timing was enabled
+	const std::vector<unsigned long long>& GetCpuTimes() const { return fCpuTimes; }
+
+	// one line per event
+	void WriteTrace(FILE* f) const;
+	static std::string FormatEvent(const Event& event, const std::vector<Frame>& frames);
+
+	virtual int Set1050CableType(E1050CableType) { return 0; }
+	virtual int SetSIOServerMode(ESIOServerCommandLine) { return 0; }
+	virtual int DirectSIO(SIO_parameters&) { return -1; }
+	virtual int ExtSIO(Ext_SIO_parameters&) { return -1; }
+
+	virtual int WaitForCommandFrame(int otherReadPollDevice, int auxReadPollDevice);
+	virtual int GetCommandFrame(SIO_command_frame& frame);
+
+	virtual int SendCommandACK();
+	virtual int SendCommandNAK();
+	virtual int SendDataACK();
+	virtual int SendDataNAK();
+	virtual int SendComplete();
+	virtual int SendError();
+	virtual int SendDataFrame(uint8_t* buf, unsigned int length);
+	virtual int ReceiveDataFrame(uint8_t* buf, unsigned int length);
+	virtual int SendRawFrame(uint8_t* buf, unsigned int length);
+	virtual int ReceiveRawFrame(uint8_t*, unsigned int) { return -1; }
+	virtual int SendCommandACKXF551();
+	virtual int SendCompleteXF551();
+	virtual int SendDataFrameXF551(uint8_t* buf, unsigned int length);
+
+	virtual int SetBaudrate(unsigned int baudrate, bool now = true);
+	virtual int SetStandardBaudrate(unsigned int baudrate);
+	virtual int SetHighSpeedBaudrate(unsigned int baudrate);
+	virtual int SetAutobaud(unsigned int) { return 0; }
+	virtual int SetHighSpeedPause(unsigned int) { return 0; }
+	virtual int SetSioTiming(ESIOTiming) { return 0; }
+	virtual ESIOTiming GetDefaultSioTiming() { return eStrictTiming; }
+
+	virtual int SetTapeBaudrate(unsigned int) { return 0; }
+	virtual int SendTapeBlock(uint8_t*, unsigned int) { return 0; }
+	virtual int StartTapeMode() { return 0; }
+	virtual int EndTapeMode() { return 0; }
+	virtual int SendRawDataNoWait(uint8_t*, unsigned int) { return 0; }
+	virtual int FlushWriteBuffer() { return 0; }
+	virtual int SendFskData(uint16_t*, unsigned int) { return 0; }
+
+	virtual int GetBaudrate() { return fBaudrate; }
+	virtual int GetExactBaudrate() { return fBaudrate; }
+	virtual int DebugKernelStatus() { return 0; }
+	virtual int EnableTimestampRecording(unsigned int) { return 0; }
+	virtual int GetTimestamps(SIO_timestamps&) { return -1; }
+	virtual unsigned int GetBaudrateForPokeyDivisor(unsigned int pokey_div);
+
+private:
+	enum {
+		// gap between the command frame and the ACK and between
+		// the end of a data frame and the following response
+		eResponseGap = 300,
+		// gap between ACK and complete
+		eCompleteGap = 250
+	};
+
+	// advance the clock by the gap plus the transmission time
+	// of length bytes, returns the time the transmission started
+	unsigned long long Transmit(unsigned int gap, unsigned int length);
+
+	void Record(unsigned long long time, EEventType type,
+		const uint8_t* buf = 0, unsigned int length = 0);
+
+	void StopCpuTimer();
+
+	std::vector<Frame> fFrames;
+	unsigned int fPos;
+	unsigned int fBaudrate;
+	unsigned long long fTime;
+
+	bool fRecording;
+	std::vector<Event> fEvents;
+
+	bool fTiming;
+	bool fCpuTimerRunning;
+	unsigned long long fCpuStart;
+	std::vector<unsigned long long> fCpuTimes;
+};
+
+#endif
@@ -38,6 +38,7 @@
 #include <sys/mman.h>
 #include <sys/param.h>
 #include <time.h>
+#include <malloc.h>
 #endif
 
 #include "winver.h"
@@ -159,6 +160,27 @@ static void reserve_stack_memory()
 	memset(dummy_string, 0, RESERVE_STACK_SIZE);
 }
 
+// keep freed memory in the malloc arena and pre-fault it, so that
+// later allocations on the SIO path don't cause page faults
+static void reserve_heap_memory()
+{
+#define RESERVE_HEAP_SIZE (4*1024*1024)
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+
+	char* dummy_heap = (char*) malloc(RESERVE_HEAP_SIZE);
+	if (dummy_heap) {
+		long pagesize = sysconf(_SC_PAGESIZE);
+		if (pagesize <= 0) {
+			pagesize = 4096;
+		}
+		for (long i = 0; i < RESERVE_HEAP_SIZE; i += pagesize) {
+			dummy_heap[i] = 0;
+		}
+		free(dummy_heap);
+	}
+}
+
 static bool uids_set = false;
 
 static uid_t euid, uid;
@@ -187,8 +209,9 @@ bool MiscUtils::drop_root_privileges()
 static bool realtime_sched_set = false;
 static int old_sched_policy;
 static int old_sched_priority;
+static int realtime_cpu = -1;
 
-bool MiscUtils::set_realtime_scheduling(int priority)
+bool MiscUtils::set_realtime_scheduling(int priority, int cpu, bool useFifo, bool lockFutureMemory)
 {
 	struct sched_param sp;
 	pid_t myPid;
@@ -215,19 +238,38 @@ bool MiscUtils::set_realtime_scheduling(int priority)
 	}
 	old_sched_priority = sp.sched_priority;
 
+	int policy = useFifo ? SCHED_FIFO : SCHED_RR;
+
 	memset(&sp, 0, sizeof(struct sched_param));
-	sp.sched_priority = sched_get_priority_max(SCHED_RR) - priority;
+	sp.sched_priority = sched_get_priority_max(policy) - priority;
 
-	if (sched_setscheduler(myPid, SCHED_RR, &sp) == 0) {
+	if (sched_setscheduler(myPid, policy, &sp) == 0) {
 		realtime_sched_set = true;
 		ret = true;
-		ALOG("activated realtime scheduling");
+		ALOG("activated realtime scheduling (%s)", useFifo ? "SCHED_FIFO" : "SCHED_RR");
 	} else {
 		AWARN("Cannot set realtime scheduling! please run as root!");
 	}
 
+	if (cpu >= 0) {
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		CPU_SET(cpu, &cpuset);
+		if (sched_setaffinity(0, sizeof(cpu_set_t), &cpuset) == 0) {
+			realtime_cpu = cpu;
+			ALOG("pinned SIO thread to CPU %d", cpu);
+		} else {
+			AWARN("cannot pin SIO thread to CPU %d", cpu);
+		}
+	}
+
 	reserve_stack_memory();
-	if (mlockall(MCL_CURRENT) == 0) {
+	int lockFlags = MCL_CURRENT;
+	if (lockFutureMemory) {
+		reserve_heap_memory();
+		lockFlags |= MCL_FUTURE;
+	}
+	if (mlockall(lockFlags) == 0) {
 		ALOG("mlockall(2) succeeded");
 	} else {
 		AWARN("mlockall(2) failed!");
@@ -286,6 +328,44 @@ bool MiscUtils::drop_realtime_scheduling()
 	return true;
 }
 
+bool MiscUtils::create_normal_priority_thread(pthread_t& thread, void* (*start_routine)(void*), void* arg, size_t stacksize)
+{
+	pthread_attr_t attr;
+	struct sched_param sp;
+
+	if (pthread_attr_init(&attr)) {
+		return false;
+	}
+
+	// threads inherit the realtime policy of their creator by default
+	memset(&sp, 0, sizeof(struct sched_param));
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	pthread_attr_setschedparam(&attr, &sp);
+
+	if (stacksize) {
+		pthread_attr_setstacksize(&attr, stacksize);
+	}
+
+	if (realtime_cpu >= 0) {
+		cpu_set_t cpuset;
+		CPU_ZERO(&cpuset);
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		for (long i = 0; i < cpus && i < CPU_SETSIZE; i++) {
+			if (i != realtime_cpu) {
+				CPU_SET(i, &cpuset);
+			}
+		}
+		if (CPU_COUNT(&cpuset)) {
+			pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpuset);
+		}
+	}
+
+	bool ret = (pthread_create(&thread, &attr, start_routine, arg) == 0);
+	pthread_attr_destroy(&attr);
+	return ret;
+}
+
 #define NANOSLEEP_THRES 20000
 
 void MiscUtils::WaitUntil(TimestampType endTime)
@@ -29,6 +29,9 @@
 #ifndef WINVER
 #include <sys/time.h>
 #endif
+#if !defined(WINVER) && !defined(POSIXVER)
+#include <pthread.h>
+#endif
 
 namespace MiscUtils {
 	char* ShortenFilename(const char* filename, unsigned int maxlen, bool stripExtension = false);
@@ -36,9 +39,18 @@ namespace MiscUtils {
 #if !defined(WINVER) && !defined(POSIXVER)
 
 	bool drop_root_privileges();
-	bool set_realtime_scheduling(int priority);
+	// cpu >= 0 pins the calling (SIO) thread to the given core,
+	// useFifo selects SCHED_FIFO instead of SCHED_RR.
+	// lockFutureMemory also locks later mappings and keeps a
+	// pre-faulted heap reserve so allocations on the SIO path don't
+	// fault. Freed memory is then never returned to the system.
+	bool set_realtime_scheduling(int priority, int cpu = -1, bool useFifo = false, bool lockFutureMemory = false);
 	bool drop_realtime_scheduling();
 
+	// start a helper thread with normal (SCHED_OTHER) priority. If the
+	// SIO thread was pinned to a core the helper is kept off that core.
+	bool create_normal_priority_thread(pthread_t& thread, void* (*start_routine)(void*), void* arg, size_t stacksize = 0);
+
 	typedef uint64_t TimestampType;
 
 	inline TimestampType TimevalToTimestamp(struct timeval& tv)
@@ -20,20 +20,40 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <time.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
 #include "PrinterHandler.h"
 #include "AtariDebug.h"
 #include "MiscUtils.h"
 #include "Error.h"
 
-PrinterHandler::PrinterHandler(const char* dest, EEOLConversion conv)
+// maximum time to wait for the writer thread in eBlockWhenFull mode
+#define QUEUE_FULL_TIMEOUT_SEC 15
+
+// time the writer thread gets to write pending data on exit
+#define TERMINATE_TIMEOUT_SEC 10
+
+PrinterHandler::PrinterHandler(const char* dest, EEOLConversion conv, EQueueFullPolicy policy)
 	: fEOLConversion(conv),
+	  fQueueFullPolicy(policy),
 	  fProcessSpawned(false),
 	  fFile(NULL),
 	  fCoprocess(NULL),
-	  fWroteData(false),
+	  fRenderer(NULL),
+	  fSIODeviceFD(-1),
+	  fCoprocessPid(0),
+	  fJobPending(false),
+	  fWaitingForSpace(false),
+	  fTerminate(false),
+	  fAbort(false),
+	  fWriterStatus(eStatusOK),
+	  fWriteError(0),
+	  fDroppedLogLines(0),
 	  fPrinterStatus(eStatusOK)
 {
 	fTracer = SIOTracer::GetInstance();
@@ -45,6 +65,7 @@ PrinterHandler::PrinterHandler(const char* dest, EEOLConversion conv)
 	Assert(*dest);
 
 	int len;
+	PrinterRenderer::EOutputFormat renderFormat;
 	if (*dest == '|') {
 		if (dest[1] == 0) {
 			throw ErrorObject("PrinterHandler: missing command");
@@ -54,6 +75,32 @@ PrinterHandler::PrinterHandler(const char* dest, EEOLConversion conv)
 		strcpy(fFilename, dest);
 		fPrintCommand = fFilename+1;
 		fDestination = eProcess;
+	} else if (PrinterRenderer::IsRenderFilename(dest, renderFormat)) {
+		// output files are created when a job is finished, check
+		// that we'll be able to write to the destination directory
+		char abspath[PATH_MAX];
+		char dirpath[PATH_MAX];
+		strncpy(dirpath, dest, PATH_MAX - 1);
+		dirpath[PATH_MAX - 1] = 0;
+		char* slash = strrchr(dirpath, '/');
+		const char* basename = dest;
+		if (slash) {
+			*slash = 0;
+			basename = slash + 1;
+			if (dirpath[0] == 0) {
+				strcpy(dirpath, "/");
+			}
+		} else {
+			strcpy(dirpath, ".");
+		}
+		if (realpath(dirpath, abspath) == NULL || access(abspath, W_OK)) {
+			throw FileCreateError(dest);
+		}
+		len = strlen(abspath) + strlen(basename) + 1;
+		fFilename = new char[len+1];
+		snprintf(fFilename, len+1, "%s/%s", abspath, basename);
+		fRenderer = new PrinterRenderer(renderFormat);
+		fDestination = eRender;
 	} else {
 		fFile = fopen(dest, "w");
 		if (fFile == NULL) {
@@ -69,50 +116,276 @@ PrinterHandler::PrinterHandler(const char* dest, EEOLConversion conv)
 		strcpy(fFilename, abspath);
 		fDestination = eFile;
 	}
+
+	if (sem_init(&fBlockSemaphore, 0, 0)) {
+		if (fFile) {
+			fclose(fFile);
+		}
+		delete fRenderer;
+		delete[] fFilename;
+		throw ErrorObject("PrinterHandler: cannot create semaphore");
+	}
+	if (sem_init(&fSpaceSemaphore, 0, 0)) {
+		if (fFile) {
+			fclose(fFile);
+		}
+		sem_destroy(&fBlockSemaphore);
+		delete fRenderer;
+		delete[] fFilename;
+		throw ErrorObject("PrinterHandler: cannot create semaphore");
+	}
+	if (!MiscUtils::create_normal_priority_thread(fWriterThread, WriterThreadFunc, this, 256*1024)) {
+		if (fFile) {
+			fclose(fFile);
+		}
+		sem_destroy(&fBlockSemaphore);
+		sem_destroy(&fSpaceSemaphore);
+		delete fRenderer;
+		delete[] fFilename;
+		throw ErrorObject("PrinterHandler: cannot start writer thread");
+	}
 }
 
 PrinterHandler::~PrinterHandler()
 {
+	StopWriter();
+	sem_destroy(&fBlockSemaphore);
+	sem_destroy(&fSpaceSemaphore);
+
+	ProcessWriterLog();
+
 	if (fDestination == eFile) {
 		if (fFile) {
 			fclose(fFile);
 		}
 		fFile = NULL;
-	} else {
+	}
+	delete fRenderer;
+	delete[] fFilename;
+}
+
+void PrinterHandler::StopWriter()
+{
+	fTerminate.store(true);
+	sem_post(&fBlockSemaphore);
+
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += TERMINATE_TIMEOUT_SEC;
+	if (pthread_timedjoin_np(fWriterThread, NULL, &ts) == 0) {
+		return;
+	}
+
+	// most likely a print command which doesn't read its input,
+	// kill it so the writer returns from the pipe write
+	AWARN("printer writer thread doesn't finish, discarding printer data");
+	fAbort.store(true);
+	pid_t pid = fCoprocessPid.load();
+	if (pid > 0) {
+		kill(-pid, SIGKILL);
+	}
+	pthread_join(fWriterThread, NULL);
+}
+
+bool PrinterHandler::WaitForQueueSpace()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += QUEUE_FULL_TIMEOUT_SEC;
+
+	// drop wakeups left over from the last wait
+	while (sem_trywait(&fSpaceSemaphore) == 0) {
+	}
+	fWaitingForSpace.store(true);
+	bool ok = true;
+	// the writer may have freed a slot before it saw the flag
+	while (fBlockQueue.IsFull()) {
+		if (sem_timedwait(&fSpaceSemaphore, &ts)) {
+			if (errno == EINTR) {
+				continue;
+			}
+			ok = false;
+			break;
+		}
+	}
+	fWaitingForSpace.store(false);
+	return ok;
+}
+
+bool PrinterHandler::QueueBlock(EBlockType type, const char* data, unsigned int len, bool wait)
+{
+	PrinterBlock* block = fBlockQueue.GetWriteSlot();
+	if (!block && wait && WaitForQueueSpace()) {
+		block = fBlockQueue.GetWriteSlot();
+	}
+	if (!block) {
+		return false;
+	}
+	Assert(len <= eMaxBlockLength);
+	block->fType = type;
+	block->fLength = len;
+	if (len) {
+		memcpy(block->fData, data, len);
+	}
+	fBlockQueue.CommitWrite();
+	sem_post(&fBlockSemaphore);
+	return true;
+}
+
+void PrinterHandler::ProcessWriterLog()
+{
+	LogLine* line;
+	while ((line = fLogQueue.GetReadSlot()) != 0) {
+		switch (line->fType) {
+		case eLogPrinter:
+			fTracer->TraceString(SIOTracer::eTracePrinter, "%s", line->fText);
+			break;
+		case eLogInfo:
+			ALOG("%s", line->fText);
+			break;
+		case eLogWarning:
+			AWARN("%s", line->fText);
+			break;
+		case eLogError:
+			AERROR("%s", line->fText);
+			break;
+		}
+		fLogQueue.CommitRead();
+	}
+	unsigned int dropped = fDroppedLogLines.exchange(0);
+	if (dropped) {
+		AWARN("[printer] dropped %u log messages", dropped);
+	}
+
+	EPrinterStatus stat = fWriterStatus.load();
+	if (stat != fPrinterStatus) {
+		fPrinterStatus = stat;
+		fTracer->IndicatePrinterChanged();
+	}
+}
+
+void* PrinterHandler::WriterThreadFunc(void* arg)
+{
+	// signals are handled by the main thread
+	sigset_t sigset;
+	sigfillset(&sigset);
+	pthread_sigmask(SIG_BLOCK, &sigset, NULL);
+
+	static_cast<PrinterHandler*>(arg)->RunWriter();
+	return NULL;
+}
+
+void PrinterHandler::RunWriter()
+{
+	PrinterBlock* block;
+	while (true) {
+		while (sem_wait(&fBlockSemaphore) && errno == EINTR) {
+		}
+		while ((block = fBlockQueue.GetReadSlot()) != 0) {
+			if (!fAbort.load()) {
+				WriteBlock(*block);
+			}
+			fBlockQueue.CommitRead();
+			if (fWaitingForSpace.load()) {
+				sem_post(&fSpaceSemaphore);
+			}
+		}
+		if (fTerminate.load()) {
+			if (fProcessSpawned) {
+				CloseProcess();
+			}
+			if (fDestination == eRender && !fAbort.load()) {
+				WriteRenderedJob();
+			}
+			return;
+		}
+	}
+}
+
+void PrinterHandler::WriteBlock(const PrinterBlock& block)
+{
+	switch (block.fType) {
+	case eData:
+		if (fDestination == eRender) {
+			fRenderer->ProcessData((const uint8_t*) block.fData, block.fLength);
+		} else if (fDestination == eFile) {
+			if (fwrite(block.fData, 1, block.fLength, fFile) != block.fLength) {
+				fWriteError.store(AbstractSIOHandler::eWritePrinterError);
+				fWriterStatus.store(eStatusError);
+			} else {
+				fWriterStatus.store(eStatusOK);
+			}
+		} else {
+			if (!fProcessSpawned) {
+				if (SpawnProcess()) {
+					WriterLog(eLogPrinter, "[printer] spawned process \"%s\"", fPrintCommand);
+				} else {
+					WriterLog(eLogError, "error spawning printer process \"%s\"", fPrintCommand);
+					fWriteError.store(AbstractSIOHandler::eExecError);
+					fWriterStatus.store(eStatusError);
+					break;
+				}
+			}
+			if (!fCoprocess->WriteData(block.fData, block.fLength)) {
+				fWriteError.store(AbstractSIOHandler::eWritePrinterError);
+				fWriterStatus.store(eStatusError);
+			}
+			LogExternalReplies();
+		}
+		break;
+	case eEndJob:
 		if (fProcessSpawned) {
+			WriterLog(eLogPrinter, "[printer] flushing pending printer data");
 			CloseProcess();
 		}
+		if (fDestination == eRender) {
+			WriteRenderedJob();
+		}
+		break;
+	case eFlushFile:
+		if (fDestination == eFile) {
+			if (fflush(fFile)) {
+				fWriterStatus.store(eStatusError);
+			}
+		}
+		break;
 	}
-	delete[] fFilename;
 }
 
-bool PrinterHandler::SpawnProcess(const RCPtr<SIOWrapper>& wrapper)
+void PrinterHandler::WriterLog(ELogType type, const char* format, ...)
+{
+	LogLine* line = fLogQueue.GetWriteSlot();
+	if (!line) {
+		fDroppedLogLines++;
+		return;
+	}
+	va_list arg;
+	va_start(arg, format);
+	vsnprintf(line->fText, eMaxLogLength, format, arg);
+	va_end(arg);
+	line->fType = type;
+	fLogQueue.CommitWrite();
+}
+
+bool PrinterHandler::SpawnProcess()
 {
 	if (fProcessSpawned) {
 		Assert(false);
 		return false;
 	}
-	fWroteData = false;
 	try {
-		int fd = wrapper->GetDeviceFD();
-		fCoprocess = new Coprocess(fPrintCommand, &fd, 1);
+		int fd = fSIODeviceFD.load();
+		fCoprocess = new Coprocess(fPrintCommand, &fd, fd >= 0 ? 1 : 0);
+		fCoprocessPid.store(fCoprocess->GetPid());
 	}
 	catch (ErrorObject& err) {
-		AERROR("%s", err.AsCString());
-		fPrinterStatus = eStatusError;
+		WriterLog(eLogError, "%s", err.AsCString());
+		fWriterStatus.store(eStatusError);
 		return false;
 	}
 
-	fPrinterStatus = eStatusSpawned;
+	fWriterStatus.store(eStatusSpawned);
 	fProcessSpawned = true;
-
-	/*
-	struct timespec ts;
-	ts.tv_sec = 0;
-	ts.tv_nsec = 100*1000*1000;
-	nanosleep(&ts, NULL);
-	LogExternalReplies();
-	*/
 	return true;
 }
 
@@ -121,73 +394,94 @@ bool PrinterHandler::CloseProcess()
 	bool ret = true;
 	LogExternalReplies();
 	if (!fCoprocess->Close()) {
-		AERROR("closing printer process failed");
-		fPrinterStatus = eStatusError;
+		WriterLog(eLogError, "closing printer process failed");
 		ret = false;
 	}
 	LogExternalReplies(true);
 	int i;
 	if (!fCoprocess->Exit(&i)) {
-		AERROR("shutting down printer process failed");
-		fPrinterStatus = eStatusError;
+		WriterLog(eLogError, "shutting down printer process failed");
 		ret = false;
 	}
 	if (i != 0) {
-		AWARN("printer process exited with status %d", i);
+		WriterLog(eLogWarning, "printer process exited with status %d", i);
 	}
-	fPrinterStatus = eStatusOK;
+	fCoprocessPid.store(0);
+	delete fCoprocess;
+	fCoprocess = NULL;
+	fWriterStatus.store(ret ? eStatusOK : eStatusError);
 	fProcessSpawned = false;
 	return ret;
 }
 
-void PrinterHandler::ProcessDelayedTasks(bool isForced)
+void PrinterHandler::WriteRenderedJob()
 {
-	EPrinterStatus oldStat = fPrinterStatus;
-	if (fProcessSpawned && fWroteData) {
-		fTracer->TraceString(SIOTracer::eTracePrinter, "[printer] flushing pending printer data");
-		CloseProcess();
+	if (!fRenderer->HasPendingOutput()) {
+		return;
 	}
-	if (fDestination==eFile && isForced) {
-		if (fFile) {
-			if (fflush(fFile)) {
-				fPrinterStatus = eStatusError;
-			}
-		} else {
-			Assert(false);
+	std::string outname;
+	if (fRenderer->WriteJob(fFilename, outname)) {
+		WriterLog(eLogPrinter, "[printer] wrote \"%s\"", outname.c_str());
+		fWriterStatus.store(eStatusOK);
+	} else {
+		WriterLog(eLogError, "error writing printer output \"%s\"", outname.c_str());
+		fWriteError.store(AbstractSIOHandler::eWritePrinterError);
+		fWriterStatus.store(eStatusError);
+	}
+}
+
+void PrinterHandler::ProcessDelayedTasks(bool isForced)
+{
+	if (fJobPending) {
+		// retry on the next call if the queue is full
+		if (QueueBlock(eEndJob, 0, 0, isForced)) {
+			fJobPending = false;
 		}
 	}
-	if (fPrinterStatus != oldStat) {
-		fTracer->IndicatePrinterChanged();
+	if (fDestination==eFile && isForced) {
+		QueueBlock(eFlushFile, 0, 0, true);
 	}
+	ProcessWriterLog();
 }
 
 void PrinterHandler::LogExternalReplies(bool block)
 {
 	Assert(fProcessSpawned);
 	int len;
-	while (fCoprocess->ReadLine(fBuffer, eBufferLength, len, block)) {
-		ALOG("[printer process] %s", fBuffer);
+	while (fCoprocess->ReadLine(fReplyBuffer, eBufferLength, len, block)) {
+		WriterLog(eLogInfo, "[printer process] %s", fReplyBuffer);
 	}
 }
 
-int PrinterHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper)
+int PrinterHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper, SIOScratchArena& scratch)
 {
 	int ret=0;
 
+	ProcessWriterLog();
+
 	fTracer->TraceCommandFrame(frame);
 
 	switch (frame.command) {
 	case 0x53: {
 		// get status
 
+		unsigned int buflen = 4;
+		uint8_t* buf = scratch.Allocate(buflen);
+		if (!buf) {
+			if (wrapper->SendCommandNAK()) {
+				LOG_SIO_CMD_NAK_FAILED();
+			}
+			ret = AbstractSIOHandler::eScratchExhausted;
+			fTracer->TraceCommandError(ret);
+			break;
+		}
+
 		if ((ret=wrapper->SendCommandACK())) {
 			fTracer->TraceCommandError(ret);
 			LOG_SIO_CMD_ACK_FAILED();
 			break;
 		}
 
-		unsigned int buflen = 4;
-		uint8_t buf[buflen];
 		const char* description = "[ get printer status ]";
 
 		buf[0] = 0;
@@ -213,15 +507,32 @@ int PrinterHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SI
 	}
 	case 0x57: {
 		// write to printer
-		if ((ret=wrapper->SendCommandACK())) {
+		if (fQueueFullPolicy == eBusyWhenFull && fBlockQueue.IsFull()) {
+			// printer busy, let the Atari retry the command
+			if (wrapper->SendCommandNAK()) {
+				LOG_SIO_CMD_NAK_FAILED();
+			}
+			ret = AbstractSIOHandler::ePrinterBusy;
 			fTracer->TraceCommandError(ret);
-			LOG_SIO_CMD_ACK_FAILED();
 			break;
 		}
 
-		EPrinterStatus oldStat = fPrinterStatus;
 		unsigned int buflen = 40;
-		uint8_t buf[buflen];
+		uint8_t* buf = scratch.Allocate(buflen);
+		if (!buf) {
+			if (wrapper->SendCommandNAK()) {
+				LOG_SIO_CMD_NAK_FAILED();
+			}
+			ret = AbstractSIOHandler::eScratchExhausted;
+			fTracer->TraceCommandError(ret);
+			break;
+		}
+
+		if ((ret=wrapper->SendCommandACK())) {
+			fTracer->TraceCommandError(ret);
+			LOG_SIO_CMD_ACK_FAILED();
+			break;
+		}
 
 		const char* description = "[ write printer data ]";
 
@@ -248,37 +559,25 @@ int PrinterHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SI
 				fBuffer[len++] = 10; break;
 			}
 		}
-		bool new_spawn = false;
-		bool spawn_ok = true;
-		bool write_ok = false;
-		if (fDestination == eFile) {
-			fWroteData = true;
-			if (fwrite(fBuffer, 1, len, fFile) != len) {
-				write_ok = false;
-				ret = AbstractSIOHandler::eWritePrinterError;
-				fPrinterStatus = eStatusError;
-			} else {
-				write_ok = true;
-				fPrinterStatus = eStatusOK;
-			}
+
+		// errors of the writer thread are reported on the next write
+		bool write_ok = true;
+		int writeError = fWriteError.exchange(0);
+		if (writeError) {
+			write_ok = false;
+			ret = writeError;
+		}
+
+		fSIODeviceFD.store(wrapper->GetDeviceFD());
+		if (QueueBlock(eData, fBuffer, len, fQueueFullPolicy == eBlockWhenFull)) {
+			fJobPending = true;
 		} else {
-			if (!fProcessSpawned) {
-				new_spawn = true;
-				spawn_ok = SpawnProcess(wrapper);
-				if (!spawn_ok) {
-					ret = AbstractSIOHandler::eExecError;
-					fPrinterStatus = eStatusError;
-				}
-			}
-			if (spawn_ok) {
-				fWroteData = true;
-				write_ok = fCoprocess->WriteData(fBuffer, len);
-				if (!write_ok) {
-					ret = AbstractSIOHandler::eWritePrinterError;
-					fPrinterStatus = eStatusError;
-				}
-			}
+			write_ok = false;
+			ret = (fQueueFullPolicy == eBlockWhenFull) ?
+				AbstractSIOHandler::eWritePrinterError :
+				AbstractSIOHandler::ePrinterBusy;
 		}
+
 		if (write_ok) {
 			fTracer->TraceCommandOK();
 		} else {
@@ -286,33 +585,6 @@ int PrinterHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SI
 		}
 		fTracer->TraceWritePrinter();
 		fTracer->TraceDataBlock(buf, buflen, description);
-		if (fDestination == eProcess) {
-			if (new_spawn) {
-				if (spawn_ok) {
-					fTracer->TraceString(SIOTracer::eTracePrinter, "[printer] spawned process \"%s\"", fPrintCommand);
-				} else {
-					AERROR("error spawning printer process \"%s\"", fPrintCommand);
-					if (fProcessSpawned) {
-						LogExternalReplies();
-						CloseProcess();
-					}
-				}
-			}
-		}
-
-		/*
-		if (!write_ok) {
-			AERROR("unable to write printer data");
-		}
-		*/
-
-		if (fProcessSpawned) {
-			LogExternalReplies();
-		}
-
-		if (oldStat != fPrinterStatus) {
-			fTracer->IndicatePrinterChanged();
-		}
 
 		if (write_ok) {
 			if ((ret=wrapper->SendComplete())) {
@@ -23,18 +23,35 @@
 
 
 #include <limits.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <atomic>
 #include "AbstractSIOHandler.h"
 #include "SIOTracer.h"
 #include "Coprocess.h"
+#include "LockFreeQueue.h"
+#include "PrinterRenderer.h"
+
+// Printer data is passed through a bounded queue to a writer thread
+// which does the (possibly blocking) file and pipe I/O, so a slow
+// print command can't stall the SIO thread.
+//
+// If the destination filename ends in .pdf or .png the printer output
+// is rendered into pages instead of being stored raw. Rendered jobs are
+// written when the printer has been idle for some time.
 
 class PrinterHandler : public AbstractSIOHandler {
 public:
 	enum EEOLConversion { eRaw, eLF, eCR, eCRLF };
 
-	PrinterHandler(const char* dest, EEOLConversion conv);
+	// what to do if the output queue is full: wait for the writer
+	// thread or NAK the write command so the Atari retries later
+	enum EQueueFullPolicy { eBlockWhenFull, eBusyWhenFull };
+
+	PrinterHandler(const char* dest, EEOLConversion conv, EQueueFullPolicy policy = eBlockWhenFull);
 	virtual ~PrinterHandler();
 
-	virtual int ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper);
+	virtual int ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper, SIOScratchArena& scratch);
 
 	virtual bool IsPrinterHandler() const;
 
@@ -49,6 +66,7 @@ public:
 
 	void SetEOLConversion(EEOLConversion conv);
 	inline EEOLConversion GetEOLConversion() const;
+	inline EQueueFullPolicy GetQueueFullPolicy() const;
 	inline const char* GetFilename() const;
 
 	enum EPrinterStatus {
@@ -60,14 +78,48 @@ public:
 	inline EPrinterStatus GetPrinterStatus() const;
 
 private:
-	bool SpawnProcess(const RCPtr<SIOWrapper>& wrapper);
-	bool CloseProcess();
+	enum EBlockType { eData, eEndJob, eFlushFile };
+
+	enum { eMaxBlockLength = 48 };
+
+	struct PrinterBlock {
+		EBlockType fType;
+		unsigned int fLength;
+		char fData[eMaxBlockLength];
+	};
+
+	enum ELogType { eLogPrinter, eLogInfo, eLogWarning, eLogError };
+
+	enum { eMaxLogLength = 256 };
+
+	struct LogLine {
+		ELogType fType;
+		char fText[eMaxLogLength];
+	};
+
+	enum { eBlockQueueSize = 128, eLogQueueSize = 64 };
 
+	// called from the SIO thread
+	bool QueueBlock(EBlockType type, const char* data = 0, unsigned int len = 0, bool wait = true);
+	bool WaitForQueueSpace();
+	void StopWriter();
+	void ProcessWriterLog();
+
+	// called from the writer thread
+	static void* WriterThreadFunc(void* arg);
+	void RunWriter();
+	void WriteBlock(const PrinterBlock& block);
+	bool SpawnProcess();
+	bool CloseProcess();
+	void WriteRenderedJob();
 	void LogExternalReplies(bool block=false);
+	void WriterLog(ELogType type, const char* format, ...)
+		__attribute__ ((format (printf, 3, 4)));
 
 	EEOLConversion fEOLConversion;
+	EQueueFullPolicy fQueueFullPolicy;
 
-	enum EDest { eFile, eProcess };
+	enum EDest { eFile, eProcess, eRender };
 	EDest fDestination;
 
 	char* fFilename;
@@ -76,12 +128,40 @@ private:
 
 	FILE* fFile;
 	Coprocess* fCoprocess;
+	PrinterRenderer* fRenderer;
+
+	// set by the SIO thread, the print command must not inherit it
+	std::atomic<int> fSIODeviceFD;
+	// print command of the writer thread, killed if it hangs on exit
+	std::atomic<pid_t> fCoprocessPid;
 
-	bool fWroteData;
+	// data was queued since the last end-of-job marker
+	bool fJobPending;
 
 	enum { eBufferLength = 512 };
 	char fBuffer[eBufferLength];
+	char fReplyBuffer[eBufferLength];
+
+	LockFreeQueue<PrinterBlock, eBlockQueueSize> fBlockQueue;
+	LockFreeQueue<LogLine, eLogQueueSize> fLogQueue;
+
+	sem_t fBlockSemaphore;
+	// posted by the writer when it freed a slot while the SIO
+	// thread is waiting for one
+	sem_t fSpaceSemaphore;
+	std::atomic<bool> fWaitingForSpace;
+	pthread_t fWriterThread;
 
+	// write all queued blocks and stop
+	std::atomic<bool> fTerminate;
+	// discard the queued blocks, the writer didn't stop in time
+	std::atomic<bool> fAbort;
+
+	std::atomic<EPrinterStatus> fWriterStatus;
+	std::atomic<int> fWriteError;
+	std::atomic<unsigned int> fDroppedLogLines;
+
+	// last status reported to the tracer
 	EPrinterStatus fPrinterStatus;
 	SIOTracer* fTracer;
 };
@@ -91,6 +171,11 @@ inline PrinterHandler::EEOLConversion PrinterHandler::GetEOLConversion() const
 	return fEOLConversion;
 }
 
+inline PrinterHandler::EQueueFullPolicy PrinterHandler::GetQueueFullPolicy() const
+{
+	return fQueueFullPolicy;
+}
+
 inline const char* PrinterHandler::GetFilename() const
 {
 	return fFilename;
@@ -98,7 +183,7 @@ inline const char* PrinterHandler::GetFilename() const
 
 inline PrinterHandler::EPrinterStatus PrinterHandler::GetPrinterStatus() const
 {
-	return fPrinterStatus;
+	return fWriterStatus.load();
 }
 
 #endif
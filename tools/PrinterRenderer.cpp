@@ -0,0 +1,845 @@
+/*
+   PrinterRenderer - render Atari 820/1027 and Epson FX-80 printer
+   output into PDF or PNG files
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "PrinterRenderer.h"
+#include "AtariDebug.h"
+
+// character widths in points
+#define PICA_WIDTH (72.0 / 10)
+#define ELITE_WIDTH (72.0 / 12)
+#define CONDENSED_WIDTH (72.0 / 17.16)
+
+#define DEFAULT_LINE_SPACING (72.0 / 6)
+#define DEFAULT_LEFT_MARGIN 18.0
+#define TOP_OF_FORM 12.0
+#define FONT_SIZE 12.0
+
+// graphics: pins are 1/72 inch apart
+#define PIN_DISTANCE 1.0
+#define GRAPHICS_TOP_OFFSET 9.0
+
+// PNG output resolution (pixels per point)
+#define PNG_SCALE 2
+
+// 5x7 font for characters 0x20-0x7e, one byte per column, bit 0 = top row
+static const uint8_t font5x7[95][5] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5f, 0x00, 0x00 },
+	{ 0x00, 0x07, 0x00, 0x07, 0x00 }, { 0x14, 0x7f, 0x14, 0x7f, 0x14 },
+	{ 0x24, 0x2a, 0x7f, 0x2a, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 },
+	{ 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 },
+	{ 0x00, 0x1c, 0x22, 0x41, 0x00 }, { 0x00, 0x41, 0x22, 0x1c, 0x00 },
+	{ 0x14, 0x08, 0x3e, 0x08, 0x14 }, { 0x08, 0x08, 0x3e, 0x08, 0x08 },
+	{ 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 },
+	{ 0x00, 0x60, 0x60, 0x00, 0x00 }, { 0x20, 0x10, 0x08, 0x04, 0x02 },
+	{ 0x3e, 0x51, 0x49, 0x45, 0x3e }, { 0x00, 0x42, 0x7f, 0x40, 0x00 },
+	{ 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4b, 0x31 },
+	{ 0x18, 0x14, 0x12, 0x7f, 0x10 }, { 0x27, 0x45, 0x45, 0x45, 0x39 },
+	{ 0x3c, 0x4a, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 },
+	{ 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1e },
+	{ 0x00, 0x36, 0x36, 0x00, 0x00 }, { 0x00, 0x56, 0x36, 0x00, 0x00 },
+	{ 0x08, 0x14, 0x22, 0x41, 0x00 }, { 0x14, 0x14, 0x14, 0x14, 0x14 },
+	{ 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 },
+	{ 0x32, 0x49, 0x79, 0x41, 0x3e }, { 0x7e, 0x11, 0x11, 0x11, 0x7e },
+	{ 0x7f, 0x49, 0x49, 0x49, 0x36 }, { 0x3e, 0x41, 0x41, 0x41, 0x22 },
+	{ 0x7f, 0x41, 0x41, 0x22, 0x1c }, { 0x7f, 0x49, 0x49, 0x49, 0x41 },
+	{ 0x7f, 0x09, 0x09, 0x09, 0x01 }, { 0x3e, 0x41, 0x49, 0x49, 0x7a },
+	{ 0x7f, 0x08, 0x08, 0x08, 0x7f }, { 0x00, 0x41, 0x7f, 0x41, 0x00 },
+	{ 0x20, 0x40, 0x41, 0x3f, 0x01 }, { 0x7f, 0x08, 0x14, 0x22, 0x41 },
+	{ 0x7f, 0x40, 0x40, 0x40, 0x40 }, { 0x7f, 0x02, 0x0c, 0x02, 0x7f },
+	{ 0x7f, 0x04, 0x08, 0x10, 0x7f }, { 0x3e, 0x41, 0x41, 0x41, 0x3e },
+	{ 0x7f, 0x09, 0x09, 0x09, 0x06 }, { 0x3e, 0x41, 0x51, 0x21, 0x5e },
+	{ 0x7f, 0x09, 0x19, 0x29, 0x46 }, { 0x46, 0x49, 0x49, 0x49, 0x31 },
+	{ 0x01, 0x01, 0x7f, 0x01, 0x01 }, { 0x3f, 0x40, 0x40, 0x40, 0x3f },
+	{ 0x1f, 0x20, 0x40, 0x20, 0x1f }, { 0x3f, 0x40, 0x38, 0x40, 0x3f },
+	{ 0x63, 0x14, 0x08, 0x14, 0x63 }, { 0x07, 0x08, 0x70, 0x08, 0x07 },
+	{ 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x7f, 0x41, 0x41, 0x00 },
+	{ 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7f, 0x00 },
+	{ 0x04, 0x02, 0x01, 0x02, 0x04 }, { 0x40, 0x40, 0x40, 0x40, 0x40 },
+	{ 0x00, 0x01, 0x02, 0x04, 0x00 }, { 0x20, 0x54, 0x54, 0x54, 0x78 },
+	{ 0x7f, 0x48, 0x44, 0x44, 0x38 }, { 0x38, 0x44, 0x44, 0x44, 0x20 },
+	{ 0x38, 0x44, 0x44, 0x48, 0x7f }, { 0x38, 0x54, 0x54, 0x54, 0x18 },
+	{ 0x08, 0x7e, 0x09, 0x01, 0x02 }, { 0x0c, 0x52, 0x52, 0x52, 0x3e },
+	{ 0x7f, 0x08, 0x04, 0x04, 0x78 }, { 0x00, 0x44, 0x7d, 0x40, 0x00 },
+	{ 0x20, 0x40, 0x44, 0x3d, 0x00 }, { 0x7f, 0x10, 0x28, 0x44, 0x00 },
+	{ 0x00, 0x41, 0x7f, 0x40, 0x00 }, { 0x7c, 0x04, 0x18, 0x04, 0x78 },
+	{ 0x7c, 0x08, 0x04, 0x04, 0x78 }, { 0x38, 0x44, 0x44, 0x44, 0x38 },
+	{ 0x7c, 0x14, 0x14, 0x14, 0x08 }, { 0x08, 0x14, 0x14, 0x18, 0x7c },
+	{ 0x7c, 0x08, 0x04, 0x04, 0x08 }, { 0x48, 0x54, 0x54, 0x54, 0x20 },
+	{ 0x04, 0x3f, 0x44, 0x40, 0x20 }, { 0x3c, 0x40, 0x40, 0x20, 0x7c },
+	{ 0x1c, 0x20, 0x40, 0x20, 0x1c }, { 0x3c, 0x40, 0x30, 0x40, 0x3c },
+	{ 0x44, 0x28, 0x10, 0x28, 0x44 }, { 0x0c, 0x50, 0x50, 0x50, 0x3c },
+	{ 0x44, 0x64, 0x54, 0x4c, 0x44 }, { 0x00, 0x08, 0x36, 0x41, 0x00 },
+	{ 0x00, 0x00, 0x7f, 0x00, 0x00 }, { 0x00, 0x41, 0x36, 0x08, 0x00 },
+	{ 0x10, 0x08, 0x08, 0x10, 0x08 }
+};
+
+PrinterRenderer::PrinterRenderer(EOutputFormat format)
+	: fFormat(format),
+	  fPageStarted(false),
+	  fJobNumber(0)
+{
+	ResetPrinterState();
+}
+
+PrinterRenderer::~PrinterRenderer()
+{
+}
+
+bool PrinterRenderer::IsRenderFilename(const char* filename, EOutputFormat& format)
+{
+	if (!filename) {
+		return false;
+	}
+	size_t len = strlen(filename);
+	if (len < 5) {
+		return false;
+	}
+	if (strcasecmp(filename + len - 4, ".pdf") == 0) {
+		format = ePDF;
+		return true;
+	}
+	if (strcasecmp(filename + len - 4, ".png") == 0) {
+		format = ePNG;
+		return true;
+	}
+	return false;
+}
+
+void PrinterRenderer::ResetPrinterState()
+{
+	fX = DEFAULT_LEFT_MARGIN;
+	fY = TOP_OF_FORM;
+	fLineSpacing = DEFAULT_LINE_SPACING;
+	fLeftMargin = DEFAULT_LEFT_MARGIN;
+	fRightMargin = DEFAULT_LEFT_MARGIN + 80 * PICA_WIDTH;
+	fPageLength = ePageHeight;
+
+	fBold = false;
+	fItalic = false;
+	fUnderline = false;
+	fCondensed = false;
+	fElite = false;
+	fDoubleWidth = false;
+	fDoubleWidthLine = false;
+
+	fParserState = eStateNormal;
+	fEscapeCommand = 0;
+	fEscapeParamCount = 0;
+	fEscapeParamPos = 0;
+	fGraphicsRemaining = 0;
+	fGraphicsDotWidth = 1.2;
+}
+
+void PrinterRenderer::Reset()
+{
+	fPages.clear();
+	fPageStarted = false;
+	ResetPrinterState();
+}
+
+bool PrinterRenderer::HasPendingOutput() const
+{
+	return !fPages.empty();
+}
+
+PrinterRenderer::Page& PrinterRenderer::CurrentPage()
+{
+	if (!fPageStarted) {
+		fPages.push_back(Page());
+		fPageStarted = true;
+	}
+	return fPages.back();
+}
+
+double PrinterRenderer::GetCharWidth() const
+{
+	double w;
+	if (fCondensed) {
+		w = CONDENSED_WIDTH;
+	} else if (fElite) {
+		w = ELITE_WIDTH;
+	} else {
+		w = PICA_WIDTH;
+	}
+	if (fDoubleWidth || fDoubleWidthLine) {
+		w *= 2;
+	}
+	return w;
+}
+
+unsigned int PrinterRenderer::GetAttributes() const
+{
+	unsigned int attr = 0;
+	if (fBold) {
+		attr |= eAttrBold;
+	}
+	if (fItalic) {
+		attr |= eAttrItalic;
+	}
+	if (fUnderline) {
+		attr |= eAttrUnderline;
+	}
+	return attr;
+}
+
+void PrinterRenderer::CarriageReturn()
+{
+	fX = fLeftMargin;
+}
+
+void PrinterRenderer::LineFeed(double distance)
+{
+	fDoubleWidthLine = false;
+	fY += distance;
+	if (fY > fPageLength) {
+		// continue on next page
+		fPageStarted = false;
+		fY = TOP_OF_FORM;
+	}
+}
+
+void PrinterRenderer::FormFeed()
+{
+	fDoubleWidthLine = false;
+	if (!fPageStarted && fPages.empty()) {
+		// form feed on an empty job still gives one (empty) page
+		CurrentPage();
+	}
+	fPageStarted = false;
+	fX = fLeftMargin;
+	fY = TOP_OF_FORM;
+}
+
+void PrinterRenderer::PrintChar(uint8_t c)
+{
+	bool italic = fItalic;
+
+	// the FX-80 prints codes 128-255 as italic versions of 0-127
+	if (c >= 128) {
+		c &= 0x7f;
+		italic = true;
+	}
+	if (c < 32 || c > 126) {
+		return;
+	}
+
+	double w = GetCharWidth();
+	if (fX + w > fRightMargin + 0.01) {
+		CarriageReturn();
+		LineFeed(fLineSpacing);
+	}
+
+	unsigned int attr = GetAttributes();
+	if (italic) {
+		attr |= eAttrItalic;
+	}
+
+	Page& page = CurrentPage();
+	if (!page.fText.empty()) {
+		TextRun& run = page.fText.back();
+		if (run.fY == fY && run.fCharWidth == w && run.fAttributes == attr
+			&& (run.fX + run.fText.length() * w) - fX < 0.01
+			&& (run.fX + run.fText.length() * w) - fX > -0.01) {
+			run.fText += char(c);
+			fX += w;
+			return;
+		}
+	}
+	TextRun run;
+	run.fX = fX;
+	run.fY = fY;
+	run.fCharWidth = w;
+	run.fAttributes = attr;
+	run.fText = char(c);
+	page.fText.push_back(run);
+	fX += w;
+}
+
+void PrinterRenderer::StartGraphics(unsigned int density, unsigned int count)
+{
+	switch (density) {
+	case 0: fGraphicsDotWidth = 72.0 / 60; break;
+	case 1:
+	case 2: fGraphicsDotWidth = 72.0 / 120; break;
+	case 3: fGraphicsDotWidth = 72.0 / 240; break;
+	case 4: fGraphicsDotWidth = 72.0 / 80; break;
+	case 5: fGraphicsDotWidth = 72.0 / 72; break;
+	case 6: fGraphicsDotWidth = 72.0 / 90; break;
+	default: fGraphicsDotWidth = 72.0 / 60; break;
+	}
+	fGraphicsRemaining = count;
+	if (count) {
+		fParserState = eStateGraphics;
+	} else {
+		fParserState = eStateNormal;
+	}
+}
+
+void PrinterRenderer::ProcessGraphicsByte(uint8_t c)
+{
+	if (c) {
+		Page& page = CurrentPage();
+		for (int i = 0; i < 8; i++) {
+			if (c & (0x80 >> i)) {
+				Dot dot;
+				dot.fX = fX;
+				dot.fY = fY - GRAPHICS_TOP_OFFSET + i * PIN_DISTANCE;
+				dot.fWidth = PIN_DISTANCE;
+				page.fDots.push_back(dot);
+			}
+		}
+	}
+	fX += fGraphicsDotWidth;
+	if (--fGraphicsRemaining == 0) {
+		fParserState = eStateNormal;
+	}
+}
+
+unsigned int PrinterRenderer::GetEscapeParamCount(uint8_t cmd) const
+{
+	switch (cmd) {
+	case '-': case 'W': case '3': case 'A': case 'J': case 'Q':
+	case 'l': case 'C': case 'N': case 'S': case 'R': case 'x':
+	case 'p': case '!': case 'U': case 's': case 'j': case 'i':
+	case 'k': case 't': case 'm': case 'r': case 'I': case '/':
+		return 1;
+	case 'K': case 'L': case 'Y': case 'Z': case 'f': case 'e':
+	case '?':
+		return 2;
+	case '*': case '^':
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+void PrinterRenderer::ProcessEscape(uint8_t cmd, const uint8_t* p)
+{
+	switch (cmd) {
+	case '@':
+		ResetPrinterState();
+		break;
+	case 'E': case 'G':
+		fBold = true; break;
+	case 'F': case 'H':
+		fBold = false; break;
+	case '4':
+		fItalic = true; break;
+	case '5':
+		fItalic = false; break;
+	case '-':
+		fUnderline = (p[0] == 1 || p[0] == '1'); break;
+	case 'W':
+		fDoubleWidth = (p[0] == 1 || p[0] == '1'); break;
+	case 0x0e:
+		fDoubleWidthLine = true; break;
+	case 0x0f:
+		fCondensed = true; break;
+	case 'M':
+		fElite = true; break;
+	case 'P':
+		fElite = false; break;
+	case '0':
+		fLineSpacing = 72.0 / 8; break;
+	case '1':
+		fLineSpacing = 7.0; break;
+	case '2':
+		fLineSpacing = DEFAULT_LINE_SPACING; break;
+	case '3':
+		fLineSpacing = p[0] * 72.0 / 216; break;
+	case 'A':
+		fLineSpacing = p[0] * 72.0 / 72; break;
+	case 'J':
+		LineFeed(p[0] * 72.0 / 216); break;
+	case 'Q':
+		if (p[0]) {
+			fRightMargin = DEFAULT_LEFT_MARGIN + p[0] * GetCharWidth();
+		}
+		break;
+	case 'l':
+		fLeftMargin = DEFAULT_LEFT_MARGIN + p[0] * GetCharWidth();
+		if (fX < fLeftMargin) {
+			fX = fLeftMargin;
+		}
+		break;
+	case 'C':
+		if (p[0]) {
+			fPageLength = p[0] * fLineSpacing;
+		} else {
+			fPageLength = p[1] * 72.0;
+		}
+		if (fPageLength <= TOP_OF_FORM || fPageLength > ePageHeight) {
+			fPageLength = ePageHeight;
+		}
+		break;
+	case '!':
+		fElite = (p[0] & 1) != 0;
+		fCondensed = (p[0] & 4) != 0;
+		fBold = (p[0] & (8 | 16)) != 0;
+		fDoubleWidth = (p[0] & 32) != 0;
+		fItalic = (p[0] & 64) != 0;
+		fUnderline = (p[0] & 128) != 0;
+		break;
+	case 0x19:
+		// Atari 1027: underline on
+		fUnderline = true; break;
+	case 0x1a:
+		// Atari 1027: underline off
+		fUnderline = false; break;
+	case 'K':
+		StartGraphics(0, p[0] + 256 * p[1]); break;
+	case 'L':
+		StartGraphics(1, p[0] + 256 * p[1]); break;
+	case 'Y':
+		StartGraphics(2, p[0] + 256 * p[1]); break;
+	case 'Z':
+		StartGraphics(3, p[0] + 256 * p[1]); break;
+	case '*':
+		StartGraphics(p[0], p[1] + 256 * p[2]); break;
+	case '^':
+		// 9 pin graphics, 2 bytes per column. Only the top 8 pins are used.
+		StartGraphics(p[0], (p[1] + 256 * p[2]) * 2);
+		break;
+	default:
+		// everything else is ignored
+		break;
+	}
+}
+
+void PrinterRenderer::ProcessByte(uint8_t c)
+{
+	switch (fParserState) {
+	case eStateGraphics:
+		ProcessGraphicsByte(c);
+		return;
+	case eStateTabList:
+		if (c == 0 || c == 0x7f) {
+			fParserState = eStateNormal;
+		}
+		return;
+	case eStateEscape:
+		fEscapeCommand = c;
+		if (c == 'D' || c == 'B' || c == 'b') {
+			fParserState = eStateTabList;
+			return;
+		}
+		fEscapeParamCount = GetEscapeParamCount(c);
+		fEscapeParamPos = 0;
+		if (fEscapeParamCount) {
+			fParserState = eStateEscapeParams;
+		} else {
+			fParserState = eStateNormal;
+			ProcessEscape(c, fEscapeParams);
+		}
+		return;
+	case eStateEscapeParams:
+		fEscapeParams[fEscapeParamPos++] = c;
+		if (fEscapeCommand == 'C' && fEscapeParamPos == 1 && c == 0) {
+			// ESC C 0 n: page length in inches
+			fEscapeParamCount = 2;
+		}
+		if (fEscapeParamPos >= fEscapeParamCount) {
+			fParserState = eStateNormal;
+			ProcessEscape(fEscapeCommand, fEscapeParams);
+		}
+		return;
+	case eStateNormal:
+		break;
+	}
+
+	switch (c) {
+	case 27:
+		fParserState = eStateEscape;
+		break;
+	case 155:	// ATASCII EOL
+	case 10:	// printer is set to auto-CR on LF
+	case 11:
+		CarriageReturn();
+		LineFeed(fLineSpacing);
+		break;
+	case 13:
+		CarriageReturn();
+		break;
+	case 12:
+		FormFeed();
+		break;
+	case 8:
+		fX -= GetCharWidth();
+		if (fX < fLeftMargin) {
+			fX = fLeftMargin;
+		}
+		break;
+	case 9: {
+			double tab = 8 * GetCharWidth();
+			int n = int((fX - fLeftMargin) / tab) + 1;
+			fX = fLeftMargin + n * tab;
+			break;
+		}
+	case 14:
+		fDoubleWidthLine = true; break;
+	case 20:
+		fDoubleWidthLine = false; break;
+	case 15:
+		fCondensed = true; break;
+	case 18:
+		fCondensed = false; break;
+	default:
+		PrintChar(c);
+		break;
+	}
+}
+
+void PrinterRenderer::ProcessData(const uint8_t* data, unsigned int len)
+{
+	for (unsigned int i = 0; i < len; i++) {
+		ProcessByte(data[i]);
+	}
+}
+
+bool PrinterRenderer::WriteJob(const char* filenameTemplate, std::string& outname)
+{
+	if (fPages.empty()) {
+		return false;
+	}
+
+	// split template into base name and extension
+	std::string base(filenameTemplate);
+	std::string ext;
+	size_t dotpos = base.rfind('.');
+	if (dotpos != std::string::npos) {
+		ext = base.substr(dotpos);
+		base = base.substr(0, dotpos);
+	}
+
+	// use the next job number none of the files exist for. Numbers
+	// above 9999 just get more digits.
+	char buf[PATH_MAX];
+	unsigned int numFiles = (fFormat == ePDF) ? 1 : fPages.size();
+	bool exists;
+	do {
+		fJobNumber++;
+		exists = false;
+		for (unsigned int i = 0; !exists && i < numFiles; i++) {
+			BuildJobFilename(buf, base, ext, i);
+			exists = (access(buf, F_OK) == 0);
+		}
+	} while (exists);
+
+	BuildJobFilename(buf, base, ext, 0);
+	outname = buf;
+
+	bool ok = true;
+	if (fFormat == ePDF) {
+		ok = WritePDF(buf);
+	} else {
+		for (unsigned int i = 0; ok && i < fPages.size(); i++) {
+			BuildJobFilename(buf, base, ext, i);
+			ok = WritePNG(buf, fPages[i]);
+		}
+	}
+
+	fPages.clear();
+	fPageStarted = false;
+	fX = fLeftMargin;
+	fY = TOP_OF_FORM;
+	return ok;
+}
+
+void PrinterRenderer::BuildJobFilename(char* buf, const std::string& base, const std::string& ext, unsigned int page) const
+{
+	if (fFormat == ePDF) {
+		snprintf(buf, PATH_MAX, "%s-%04u%s", base.c_str(), fJobNumber, ext.c_str());
+	} else {
+		snprintf(buf, PATH_MAX, "%s-%04u-%02u%s", base.c_str(), fJobNumber, page + 1, ext.c_str());
+	}
+}
+
+void PrinterRenderer::AppendPDFString(std::string& str, const std::string& text)
+{
+	str += '(';
+	for (unsigned int i = 0; i < text.length(); i++) {
+		char c = text[i];
+		if (c == '(' || c == ')' || c == '\\') {
+			str += '\\';
+		}
+		str += c;
+	}
+	str += ')';
+}
+
+bool PrinterRenderer::WritePDF(const char* filename)
+{
+	FILE* f = fopen(filename, "wbx");
+	if (!f) {
+		return false;
+	}
+
+	// object numbers: 1 catalog, 2 pages, 3-6 fonts,
+	// then page and content stream objects for each page
+	unsigned int numPages = fPages.size();
+	unsigned int numObjects = 6 + 2 * numPages;
+	std::vector<long> offsets(numObjects + 1);
+
+	static const char* fontNames[4] = {
+		"Courier", "Courier-Bold", "Courier-Oblique", "Courier-BoldOblique"
+	};
+
+	char tmp[256];
+
+	fprintf(f, "%%PDF-1.4\n");
+
+	offsets[1] = ftell(f);
+	fprintf(f, "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+
+	offsets[2] = ftell(f);
+	fprintf(f, "2 0 obj\n<< /Type /Pages /Count %u /Kids [", numPages);
+	for (unsigned int i = 0; i < numPages; i++) {
+		fprintf(f, " %u 0 R", 7 + 2 * i);
+	}
+	fprintf(f, " ] >>\nendobj\n");
+
+	for (unsigned int i = 0; i < 4; i++) {
+		offsets[3 + i] = ftell(f);
+		fprintf(f, "%u 0 obj\n<< /Type /Font /Subtype /Type1 /BaseFont /%s /Encoding /WinAnsiEncoding >>\nendobj\n",
+			3 + i, fontNames[i]);
+	}
+
+	for (unsigned int i = 0; i < numPages; i++) {
+		const Page& page = fPages[i];
+		std::string content;
+
+		for (unsigned int r = 0; r < page.fText.size(); r++) {
+			const TextRun& run = page.fText[r];
+			unsigned int font = 1;
+			if (run.fAttributes & eAttrBold) {
+				font += 1;
+			}
+			if (run.fAttributes & eAttrItalic) {
+				font += 2;
+			}
+			// Courier glyphs are 0.6 em wide
+			double scale = run.fCharWidth / (FONT_SIZE * 0.6) * 100;
+			double y = ePageHeight - run.fY;
+			snprintf(tmp, sizeof(tmp), "BT /F%u %.1f Tf %.2f Tz 1 0 0 1 %.2f %.2f Tm ",
+				font, FONT_SIZE, scale, run.fX, y);
+			content += tmp;
+			AppendPDFString(content, run.fText);
+			content += " Tj ET\n";
+			if (run.fAttributes & eAttrUnderline) {
+				snprintf(tmp, sizeof(tmp), "0.6 w %.2f %.2f m %.2f %.2f l S\n",
+					run.fX, y - 2,
+					run.fX + run.fText.length() * run.fCharWidth, y - 2);
+				content += tmp;
+			}
+		}
+		for (unsigned int d = 0; d < page.fDots.size(); d++) {
+			const Dot& dot = page.fDots[d];
+			snprintf(tmp, sizeof(tmp), "%.2f %.2f %.2f %.2f re f\n",
+				dot.fX, ePageHeight - dot.fY - dot.fWidth, dot.fWidth, dot.fWidth);
+			content += tmp;
+		}
+
+		unsigned int pageObj = 7 + 2 * i;
+		offsets[pageObj] = ftell(f);
+		fprintf(f, "%u 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox [0 0 %d %d]"
+			" /Resources << /Font << /F1 3 0 R /F2 4 0 R /F3 5 0 R /F4 6 0 R >> >>"
+			" /Contents %u 0 R >>\nendobj\n",
+			pageObj, ePageWidth, ePageHeight, pageObj + 1);
+
+		offsets[pageObj + 1] = ftell(f);
+		fprintf(f, "%u 0 obj\n<< /Length %u >>\nstream\n", pageObj + 1, (unsigned int) content.length());
+		fwrite(content.data(), 1, content.length(), f);
+		fprintf(f, "endstream\nendobj\n");
+	}
+
+	long xref = ftell(f);
+	fprintf(f, "xref\n0 %u\n0000000000 65535 f \n", numObjects + 1);
+	for (unsigned int i = 1; i <= numObjects; i++) {
+		fprintf(f, "%010ld 00000 n \n", offsets[i]);
+	}
+	fprintf(f, "trailer\n<< /Size %u /Root 1 0 R >>\nstartxref\n%ld\n%%%%EOF\n",
+		numObjects + 1, xref);
+
+	bool ok = !ferror(f);
+	if (fclose(f)) {
+		ok = false;
+	}
+	return ok;
+}
+
+#ifdef USE_ZLIB
+static inline void PutBE32(uint8_t* buf, uint32_t val)
+{
+	buf[0] = (val >> 24) & 0xff;
+	buf[1] = (val >> 16) & 0xff;
+	buf[2] = (val >> 8) & 0xff;
+	buf[3] = val & 0xff;
+}
+
+static void PutPNGChunk(FILE* f, const char* type, const uint8_t* data, uint32_t len)
+{
+	uint8_t hdr[8];
+	PutBE32(hdr, len);
+	memcpy(hdr + 4, type, 4);
+	fwrite(hdr, 1, 8, f);
+	if (len) {
+		fwrite(data, 1, len, f);
+	}
+	uLong crc = crc32(0L, Z_NULL, 0);
+	crc = crc32(crc, (const Bytef*) type, 4);
+	if (len) {
+		crc = crc32(crc, data, len);
+	}
+	uint8_t crcbuf[4];
+	PutBE32(crcbuf, crc);
+	fwrite(crcbuf, 1, 4, f);
+}
+
+static inline void FillRect(uint8_t* bitmap, int width, int height, double x, double y, double w, double h)
+{
+	int x0 = int(x * PNG_SCALE + 0.5);
+	int y0 = int(y * PNG_SCALE + 0.5);
+	int x1 = int((x + w) * PNG_SCALE + 0.5);
+	int y1 = int((y + h) * PNG_SCALE + 0.5);
+	if (x1 == x0) {
+		x1++;
+	}
+	if (y1 == y0) {
+		y1++;
+	}
+	if (x0 < 0) x0 = 0;
+	if (y0 < 0) y0 = 0;
+	if (x1 > width) x1 = width;
+	if (y1 > height) y1 = height;
+	for (int yy = y0; yy < y1; yy++) {
+		// each scanline starts with the filter type byte
+		uint8_t* line = bitmap + yy * (width + 1) + 1;
+		for (int xx = x0; xx < x1; xx++) {
+			line[xx] = 0;
+		}
+	}
+}
+#endif
+
+bool PrinterRenderer::WritePNG(const char* filename, const Page& page)
+{
+#ifdef USE_ZLIB
+	const int width = ePageWidth * PNG_SCALE;
+	const int height = ePageHeight * PNG_SCALE;
+	const uLong rawlen = (width + 1) * height;
+
+	// 8 bit grayscale, white background, filter type 0
+	uint8_t* bitmap = new uint8_t[rawlen];
+	memset(bitmap, 0xff, rawlen);
+	for (int y = 0; y < height; y++) {
+		bitmap[y * (width + 1)] = 0;
+	}
+
+	for (unsigned int r = 0; r < page.fText.size(); r++) {
+		const TextRun& run = page.fText[r];
+		double colWidth = run.fCharWidth / 6;
+		for (unsigned int i = 0; i < run.fText.length(); i++) {
+			uint8_t c = run.fText[i];
+			if (c < 32 || c > 126) {
+				continue;
+			}
+			const uint8_t* glyph = font5x7[c - 32];
+			double cx = run.fX + i * run.fCharWidth;
+			for (int col = 0; col < 5; col++) {
+				for (int row = 0; row < 7; row++) {
+					if (glyph[col] & (1 << row)) {
+						double x = cx + col * colWidth;
+						double y = run.fY - 7 + row;
+						if (run.fAttributes & eAttrItalic) {
+							x += (6 - row) * 0.25;
+						}
+						double w = colWidth;
+						if (run.fAttributes & eAttrBold) {
+							w += 0.5;
+						}
+						FillRect(bitmap, width, height, x, y, w, 1);
+					}
+				}
+			}
+		}
+		if (run.fAttributes & eAttrUnderline) {
+			FillRect(bitmap, width, height, run.fX, run.fY + 1.5,
+				run.fText.length() * run.fCharWidth, 0.5);
+		}
+	}
+	for (unsigned int d = 0; d < page.fDots.size(); d++) {
+		const Dot& dot = page.fDots[d];
+		FillRect(bitmap, width, height, dot.fX, dot.fY, dot.fWidth, dot.fWidth);
+	}
+
+	uLongf complen = compressBound(rawlen);
+	uint8_t* compressed = new uint8_t[complen];
+	if (compress2(compressed, &complen, bitmap, rawlen, Z_BEST_SPEED) != Z_OK) {
+		delete[] bitmap;
+		delete[] compressed;
+		return false;
+	}
+	delete[] bitmap;
+
+	FILE* f = fopen(filename, "wbx");
+	if (!f) {
+		delete[] compressed;
+		return false;
+	}
+
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', 0x0d, 0x0a, 0x1a, 0x0a };
+	fwrite(signature, 1, 8, f);
+
+	uint8_t ihdr[13];
+	PutBE32(ihdr, width);
+	PutBE32(ihdr + 4, height);
+	ihdr[8] = 8;	// bit depth
+	ihdr[9] = 0;	// grayscale
+	ihdr[10] = 0;	// deflate
+	ihdr[11] = 0;	// filter method
+	ihdr[12] = 0;	// no interlace
+	PutPNGChunk(f, "IHDR", ihdr, 13);
+	PutPNGChunk(f, "IDAT", compressed, complen);
+	PutPNGChunk(f, "IEND", NULL, 0);
+	delete[] compressed;
+
+	bool ok = !ferror(f);
+	if (fclose(f)) {
+		ok = false;
+	}
+	return ok;
+#else
+	(void) filename;
+	(void) page;
+	DPRINTF("PNG output needs zlib support");
+	return false;
+#endif
+}
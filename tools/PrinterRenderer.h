@@ -0,0 +1,161 @@
+#ifndef PRINTERRENDERER_H
+#define PRINTERRENDERER_H
+
+/*
+   PrinterRenderer - render Atari 820/1027 and Epson FX-80 printer
+   output into PDF or PNG files
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// The renderer interprets a subset of the Epson FX-80 escape sequences
+// (plus the Atari 1027 underline codes) and collects the printed text
+// and bit image graphics in an in-memory page model. When a print job
+// ends all pages are written out in one go, either as a single PDF
+// file or as one PNG file per page.
+//
+// Coordinates are in points (1/72 inch), origin at the top left of
+// an US letter page.
+
+class PrinterRenderer {
+public:
+	enum EOutputFormat { ePDF, ePNG };
+
+	PrinterRenderer(EOutputFormat format);
+	~PrinterRenderer();
+
+	void ProcessData(const uint8_t* data, unsigned int len);
+
+	// true if something was printed since the last WriteJob
+	bool HasPendingOutput() const;
+
+	// Write the current job and start a new one. filenameTemplate is
+	// eg "/tmp/print.pdf", jobs are stored as /tmp/print-0001.pdf (PDF)
+	// or /tmp/print-0001-01.png, /tmp/print-0001-02.png,... (PNG).
+	// The name of the (first) file written is returned in outname.
+	// Job numbers of existing files are skipped, and writing fails
+	// instead of overwriting a file that appeared in the meantime.
+	bool WriteJob(const char* filenameTemplate, std::string& outname);
+
+	// discard current job and reset printer state
+	void Reset();
+
+	static bool IsRenderFilename(const char* filename, EOutputFormat& format);
+
+	enum {
+		ePageWidth = 612,
+		ePageHeight = 792
+	};
+
+private:
+	enum EAttributes {
+		eAttrBold = 1,
+		eAttrItalic = 2,
+		eAttrUnderline = 4
+	};
+
+	struct TextRun {
+		double fX;
+		double fY;		// baseline
+		double fCharWidth;
+		unsigned int fAttributes;
+		std::string fText;
+	};
+
+	struct Dot {
+		double fX;
+		double fY;
+		double fWidth;
+	};
+
+	struct Page {
+		std::vector<TextRun> fText;
+		std::vector<Dot> fDots;
+	};
+
+	void ResetPrinterState();
+
+	void ProcessByte(uint8_t c);
+	void ProcessEscape(uint8_t cmd, const uint8_t* params);
+	unsigned int GetEscapeParamCount(uint8_t cmd) const;
+	void ProcessGraphicsByte(uint8_t c);
+
+	void PrintChar(uint8_t c);
+	void CarriageReturn();
+	void LineFeed(double distance);
+	void FormFeed();
+	Page& CurrentPage();
+
+	double GetCharWidth() const;
+	unsigned int GetAttributes() const;
+
+	void StartGraphics(unsigned int density, unsigned int count);
+
+	// buf must hold PATH_MAX characters, page starts at 0
+	void BuildJobFilename(char* buf, const std::string& base, const std::string& ext, unsigned int page) const;
+
+	bool WritePDF(const char* filename);
+	bool WritePNG(const char* filename, const Page& page);
+
+	static void AppendPDFString(std::string& str, const std::string& text);
+
+	EOutputFormat fFormat;
+
+	std::vector<Page> fPages;
+	bool fPageStarted;
+	unsigned int fJobNumber;
+
+	// printer state
+	double fX;
+	double fY;
+	double fLineSpacing;
+	double fLeftMargin;
+	double fRightMargin;
+	double fPageLength;
+
+	bool fBold;
+	bool fItalic;
+	bool fUnderline;
+	bool fCondensed;
+	bool fElite;
+	bool fDoubleWidth;
+	bool fDoubleWidthLine;	// SO, cancelled at end of line
+
+	// escape sequence parser state
+	enum EParserState {
+		eStateNormal,
+		eStateEscape,
+		eStateEscapeParams,
+		eStateTabList,
+		eStateGraphics
+	};
+	EParserState fParserState;
+	uint8_t fEscapeCommand;
+	unsigned int fEscapeParamCount;
+	unsigned int fEscapeParamPos;
+	uint8_t fEscapeParams[4];
+
+	unsigned int fGraphicsRemaining;
+	double fGraphicsDotWidth;
+};
+
+#endif
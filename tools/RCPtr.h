@@ -40,6 +40,17 @@ public:
 		inline RCPtr<T>& operator=(const RCPtr<T2>& other);
 	inline RCPtr<T>& operator=(T *const otherPtr);
 
+#if __cplusplus >= 201103L
+	// moving takes over the reference of other, no Ref/UnRef needed
+	inline RCPtr(RCPtr<T>&& other);
+        template<class T2>
+		inline RCPtr(RCPtr<T2>&& other);
+
+	inline RCPtr<T>& operator=(RCPtr<T>&& other);
+        template<class T2>
+		inline RCPtr<T>& operator=(RCPtr<T2>&& other);
+#endif
+
 	inline T* operator->() const;
 	inline T& operator*() const;
 
@@ -134,6 +145,48 @@ inline RCPtr<T>& RCPtr<T>::operator=(const RCPtr<T2>& other)
 	return *this;
 }
 
+#if __cplusplus >= 201103L
+template<class T>
+inline RCPtr<T>::RCPtr(RCPtr<T>&& other)
+	: pointee(other.pointee)
+{
+	other.pointee = 0;
+}
+
+template<class T> template<class T2>
+inline RCPtr<T>::RCPtr(RCPtr<T2>&& other)
+	: pointee(other.pointee)
+{
+	other.pointee = 0;
+}
+
+template<class T>
+inline RCPtr<T>& RCPtr<T>::operator=(RCPtr<T>&& other)
+{
+	if (this != &other) {
+		T* old = pointee;
+		pointee = other.pointee;
+		other.pointee = 0;
+		if (old != 0) {
+			old->UnRef();
+		}
+	}
+	return *this;
+}
+
+template<class T> template<class T2>
+inline RCPtr<T>& RCPtr<T>::operator=(RCPtr<T2>&& other)
+{
+	T* old = pointee;
+	pointee = other.pointee;
+	other.pointee = 0;
+	if (old != 0) {
+		old->UnRef();
+	}
+	return *this;
+}
+#endif
+
 template<class T>
 inline bool RCPtr<T>::operator==(const RCPtr<T>& other) const
 {
@@ -80,4 +80,74 @@ inline RefCounted& RefCounted::operator=(const RefCounted&)
 	return *this;
 }
 
+// Same interface as RefCounted, but the refcount is updated atomically
+// so RCPtrs to the object may be copied and released in different
+// threads concurrently. Only use it for objects that are actually
+// shared between threads, the atomic operations are more expensive.
+//
+// Taking a new reference can't race with the object being deleted
+// (the caller already holds one), so increments are relaxed. The
+// decrement releases, and the thread deleting the object acquires,
+// so all writes done through other references are visible to the
+// destructor.
+
+class ThreadSafeRefCounted {
+public:
+	ThreadSafeRefCounted();
+
+	ThreadSafeRefCounted(const ThreadSafeRefCounted& other);
+
+	virtual ~ThreadSafeRefCounted() {}
+
+	inline void Ref() const;
+	inline void UnRef() const;
+
+	bool IsShared() const;
+
+	int GetRefCount() const;
+
+protected:
+	ThreadSafeRefCounted& operator=(const ThreadSafeRefCounted& other);
+
+private:
+	mutable int refCount;
+};
+
+inline ThreadSafeRefCounted::ThreadSafeRefCounted()
+	: refCount(0)
+{}
+
+// don't copy refcount!
+inline ThreadSafeRefCounted::ThreadSafeRefCounted(const ThreadSafeRefCounted&)
+	: refCount(0)
+{}
+
+inline void ThreadSafeRefCounted::Ref() const
+{
+	__atomic_fetch_add(&refCount, 1, __ATOMIC_RELAXED);
+}
+
+inline void ThreadSafeRefCounted::UnRef() const
+{
+	if (__atomic_fetch_sub(&refCount, 1, __ATOMIC_RELEASE) == 1) {
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		delete this;
+	}
+}
+
+inline bool ThreadSafeRefCounted::IsShared() const
+{
+	return __atomic_load_n(&refCount, __ATOMIC_RELAXED) > 1;
+}
+
+inline int ThreadSafeRefCounted::GetRefCount() const
+{
+	return __atomic_load_n(&refCount, __ATOMIC_RELAXED);
+}
+
+inline ThreadSafeRefCounted& ThreadSafeRefCounted::operator=(const ThreadSafeRefCounted&)
+{
+	return *this;
+}
+
 #endif
@@ -57,7 +57,7 @@ RemoteControlHandler::~RemoteControlHandler()
 {
 }
 
-int RemoteControlHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper)
+int RemoteControlHandler::ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper, SIOScratchArena& scratch)
 {
 	int ret=0;
 
@@ -80,6 +80,17 @@ int RemoteControlHandler::ProcessCommandFrame(SIO_command_frame& frame, const RC
 			break;
 		}
 		*/
+		uint8_t* buf = scratch.Allocate(buflen+1);
+		if (!buf) {
+			if (wrapper->SendCommandNAK()) {
+				LOG_SIO_CMD_NAK_FAILED();
+			}
+			ret = AbstractSIOHandler::eScratchExhausted;
+			fTracer->TraceCommandError(ret);
+			ResetResult();
+			break;
+		}
+
 		if ((ret=wrapper->SendCommandACK())) {
 			LOG_SIO_CMD_ACK_FAILED();
 			ResetResult();
@@ -87,7 +98,6 @@ int RemoteControlHandler::ProcessCommandFrame(SIO_command_frame& frame, const RC
 		}
 
 
-		uint8_t buf[buflen+1];
 		const char* description = "[ remote command ]";
 
 		if (buflen) {
@@ -135,14 +145,23 @@ int RemoteControlHandler::ProcessCommandFrame(SIO_command_frame& frame, const RC
 	case 0x53: {
 		// get status
 
+		unsigned int buflen = 4;
+		uint8_t* buf = scratch.Allocate(buflen);
+		if (!buf) {
+			if (wrapper->SendCommandNAK()) {
+				LOG_SIO_CMD_NAK_FAILED();
+			}
+			ret = AbstractSIOHandler::eScratchExhausted;
+			fTracer->TraceCommandError(ret);
+			break;
+		}
+
 		if ((ret=wrapper->SendCommandACK())) {
 			fTracer->TraceCommandError(ret);
 			LOG_SIO_CMD_ACK_FAILED();
 			break;
 		}
 
-		unsigned int buflen = 4;
-		uint8_t buf[buflen];
 		const char* description = "[ get remote control status ]";
 
 		unsigned int resultlen = fResult->GetLength();
@@ -186,6 +205,18 @@ int RemoteControlHandler::ProcessCommandFrame(SIO_command_frame& frame, const RC
 			break;
 		}
 
+		unsigned int buflen = 128;
+		unsigned int copylen = buflen;
+		uint8_t* buf = scratch.Allocate(buflen);
+		if (!buf) {
+			if (wrapper->SendCommandNAK()) {
+				LOG_SIO_CMD_NAK_FAILED();
+			}
+			ret = AbstractSIOHandler::eScratchExhausted;
+			fTracer->TraceCommandError(ret);
+			break;
+		}
+
 		ret = wrapper->SendCommandACK();
 		if (ret) {
 			fTracer->TraceCommandError(ret);
@@ -193,10 +224,6 @@ int RemoteControlHandler::ProcessCommandFrame(SIO_command_frame& frame, const RC
 			break;
 		}
 
-		unsigned int buflen = 128;
-		unsigned int copylen = buflen;
-		uint8_t buf[buflen];
-
 		const char* description = "[ read remote control result ]";
 
 		if (offset+buflen>resultlen) {
@@ -243,14 +270,23 @@ int RemoteControlHandler::ProcessCommandFrame(SIO_command_frame& frame, const RC
 	case 0x54: {
 		// get time (format identical to ApeTime)
 
+		unsigned int buflen = 6;
+		uint8_t* buf = scratch.Allocate(buflen);
+		if (!buf) {
+			if (wrapper->SendCommandNAK()) {
+				LOG_SIO_CMD_NAK_FAILED();
+			}
+			ret = AbstractSIOHandler::eScratchExhausted;
+			fTracer->TraceCommandError(ret);
+			break;
+		}
+
 		if ((ret=wrapper->SendCommandACK())) {
 			fTracer->TraceCommandError(ret);
 			LOG_SIO_CMD_ACK_FAILED();
 			break;
 		}
 
-		unsigned int buflen = 6;
-		uint8_t buf[buflen];
 		const char* description = "[ remote control get time ]";
 		time_t current_time;
 		struct tm* ltime;
@@ -338,6 +374,22 @@ void RemoteControlHandler::AddResultString(const char* string)
 	fResult->AppendByte(0);
 }
 
+bool RemoteControlHandler::ProcessHostCommands(const char* buf, int buflen, std::vector<std::string>& result)
+{
+	ResetResult();
+	bool ok = ProcessMultipleCommands(buf, buflen, fDeviceManager->GetSIOWrapper());
+
+	const char* str = (const char*) fResult->GetInternalDataPointer();
+	size_t len = fResult->GetLength();
+	size_t pos = 0;
+	while (pos < len) {
+		result.push_back(str + pos);
+		pos += strlen(str + pos) + 1;
+	}
+	ResetResult();
+	return ok;
+}
+
 bool RemoteControlHandler::ProcessCommand(const char* cmd, const RCPtr<SIOWrapper>& wrapper)
 {
 	int ret = true;
@@ -360,6 +412,8 @@ bool RemoteControlHandler::ProcessCommand(const char* cmd, const RCPtr<SIOWrappe
 		AddResultString("sp speed           xf XF551 mode");
 		AddResultString("cd change dir      ls list directory");
 		AddResultString("sh shell command   pl print log");
+		AddResultString("fi find in library lf load from library");
+		AddResultString("sw swap in image in the background");
 		return true;
 	}
 
@@ -389,6 +443,85 @@ lo_usage:
 		return false;
 	}
 
+	if (strncasecmp(cmd,"sw",2)==0) { // load drive in the background
+		if (!ValidDriveNo(*arg)) {
+			AddResultString("invalid drive number");
+			goto sw_usage;
+		}
+		driveno=GetDriveNo(*arg);
+		arg++; EatSpace(arg);
+		if (!*arg) {
+			goto sw_usage;
+		}
+		ret = fDeviceManager->LoadDiskImageInBackground(driveno, arg);
+		if (!ret) {
+			AddResultString("loading disk image failed");
+		}
+		return ret;
+sw_usage:
+		AddResultString("usage: sw <driveno> <filename>");
+		return false;
+	}
+
+	if (strncasecmp(cmd,"fi",2)==0) { // find file in image library
+		RCPtr<ImageLibrary> library = fDeviceManager->GetImageLibrary();
+		if (library.IsNull()) {
+			AddResultString("no image library loaded");
+			return false;
+		}
+		if (!*arg) {
+			AddResultString("usage: fi <atari filename>");
+			return false;
+		}
+		std::vector<ImageLibrary::Match> matches;
+		if (!library->FindByName(arg, matches, eMaxLibraryMatches)) {
+			AddResultString("file not found");
+			return false;
+		}
+		for (unsigned int i = 0; i < matches.size(); i++) {
+			char *sf = MiscUtils::ShortenFilename(matches[i].fImagePath, 25);
+			fResult->AppendString(matches[i].fFilePath);
+			fResult->AppendString(" ");
+			AddResultString(sf);
+			delete[] sf;
+		}
+		return true;
+	}
+
+	if (strncasecmp(cmd,"lf",2)==0) { // load image containing a file
+		RCPtr<ImageLibrary> library = fDeviceManager->GetImageLibrary();
+		if (library.IsNull()) {
+			AddResultString("no image library loaded");
+			return false;
+		}
+		if (!ValidDriveNo(*arg)) {
+			AddResultString("invalid drive number");
+			goto lf_usage;
+		}
+		driveno=GetDriveNo(*arg);
+		arg++; EatSpace(arg);
+		if (!*arg) {
+			goto lf_usage;
+		}
+		{
+			std::vector<ImageLibrary::Match> matches;
+			if (!library->FindByName(arg, matches, 1)) {
+				AddResultString("file not found");
+				return false;
+			}
+			ret = fDeviceManager->LoadDiskImage(driveno, matches[0].fImagePath, true, true);
+			if (!ret) {
+				AddResultString("loading disk image failed");
+			}
+		}
+		fCursesFrontend->DisplayDriveStatus(driveno);
+		fCursesFrontend->UpdateScreen();
+		return ret;
+lf_usage:
+		AddResultString("usage: lf <driveno> <atari filename>");
+		return false;
+	}
+
 	if (strncasecmp(cmd,"lv",2)==0) { // load virtual drive
 		if (!ValidDriveNo(*arg)) {
 			AddResultString("invalid drive number");
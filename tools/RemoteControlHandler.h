@@ -23,6 +23,8 @@
 
 
 #include <limits.h>
+#include <string>
+#include <vector>
 #include "AbstractSIOHandler.h"
 #include "SIOTracer.h"
 #include "DeviceManager.h"
@@ -36,7 +38,7 @@ public:
 	RemoteControlHandler(DeviceManager* manager, CursesFrontend* frontend);
 	virtual ~RemoteControlHandler();
 
-	virtual int ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper);
+	virtual int ProcessCommandFrame(SIO_command_frame& frame, const RCPtr<SIOWrapper>& wrapper, SIOScratchArena& scratch);
 
 	virtual bool IsRemoteControlHandler() const;
 
@@ -54,7 +56,15 @@ public:
 
 	void AddResultString(const char* string);
 
+	// execute NUL separated commands on behalf of the host (eg the
+	// control socket) and return the result strings. Like on the
+	// Atari processing stops at the first failed command.
+	bool ProcessHostCommands(const char* buf, int buflen, std::vector<std::string>& result);
+
 private:
+	// limit "fi" output to a few screen lines on the Atari
+	enum { eMaxLibraryMatches = 16 };
+
 	inline bool ValidDriveNo(const char);
 	inline DeviceManager::EDriveNumber GetDriveNo(const char);
 
@@ -20,6 +20,9 @@
 
 #include <signal.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
 
 #include "SIOManager.h"
 
@@ -29,12 +32,16 @@
 #include "DeviceManager.h"
 
 SIOManager::SIOManager(const RCPtr<SIOWrapper>& wrapper)
-	: fWrapper(wrapper)
+	: fWrapper(wrapper),
+	  fPollFd(-1)
 {
 }
 
 SIOManager::~SIOManager()
 {
+	if (fPollFd >= 0) {
+		close(fPollFd);
+	}
 }
 
 bool SIOManager::RegisterHandler(uint8_t device_id, const RCPtr<AbstractSIOHandler>& handler)
@@ -57,6 +64,11 @@ bool SIOManager::UnregisterHandler(uint8_t device_id)
 	}
 }
 
+void SIOManager::ReplaceHandler(uint8_t device_id, const RCPtr<AbstractSIOHandler>& handler)
+{
+	fHandlers[device_id] = handler;
+}
+
 int SIOManager::DoServing(int otherReadPollDevice)
 {
 	int ret;
@@ -71,7 +83,11 @@ int SIOManager::DoServing(int otherReadPollDevice)
 	sigdelset(&sigset,SIGALRM);
 
 	while (1) {
-		ret = fWrapper->WaitForCommandFrame(otherReadPollDevice);
+		int auxReadPollDevice = -1;
+		if (fPollHandlers.size()) {
+			auxReadPollDevice = fPollFd;
+		}
+		ret = fWrapper->WaitForCommandFrame(otherReadPollDevice, auxReadPollDevice);
 		switch (ret) {
 		case 0: {
 			sigprocmask(SIG_BLOCK, &sigset, &orig_sigset);
@@ -79,8 +95,10 @@ int SIOManager::DoServing(int otherReadPollDevice)
 			
 			ret=fWrapper->GetCommandFrame(frame);
 		        if (ret == 0 ) {
-				if (fHandlers[frame.device_id] && fHandlers[frame.device_id]->IsActive()) {
-					ret = fHandlers[frame.device_id]->ProcessCommandFrame(frame, fWrapper);
+				AbstractSIOHandler* handler = fHandlers[frame.device_id].GetRealPointer();
+				if (handler && handler->IsActive()) {
+					fScratchArena.Reset();
+					ret = handler->ProcessCommandFrame(frame, fWrapper, fScratchArena);
 				} else {
 					SIOTracer::GetInstance()->TraceUnhandeledCommandFrame(frame);
 				}
@@ -101,8 +119,72 @@ int SIOManager::DoServing(int otherReadPollDevice)
 			return 0;
 		case 2:
 			return 1;
+		case 3:
+			if (ProcessPollHandlers()) {
+				return 2;
+			}
+			break;
 		default:
 			return -1;
 		}
 	}
 }
+
+bool SIOManager::AddPollHandler(const RCPtr<AbstractPollHandler>& handler)
+{
+	int fd = handler->GetFileDescriptor();
+	if (fd < 0) {
+		return false;
+	}
+	if (fPollFd < 0) {
+		fPollFd = epoll_create1(EPOLL_CLOEXEC);
+		if (fPollFd < 0) {
+			AERROR("cannot create epoll descriptor");
+			return false;
+		}
+	}
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	if (epoll_ctl(fPollFd, EPOLL_CTL_ADD, fd, &ev)) {
+		AERROR("cannot add poll handler");
+		return false;
+	}
+	fPollHandlers.push_back(handler);
+	return true;
+}
+
+void SIOManager::RemovePollHandler(const RCPtr<AbstractPollHandler>& handler)
+{
+	for (unsigned int i = 0; i < fPollHandlers.size(); i++) {
+		if (fPollHandlers[i] == handler) {
+			epoll_ctl(fPollFd, EPOLL_CTL_DEL, handler->GetFileDescriptor(), NULL);
+			fPollHandlers.erase(fPollHandlers.begin() + i);
+			return;
+		}
+	}
+}
+
+bool SIOManager::ProcessPollHandlers()
+{
+	enum { eMaxEvents = 8 };
+	struct epoll_event ev[eMaxEvents];
+	bool ret = false;
+
+	int num = epoll_wait(fPollFd, ev, eMaxEvents, 0);
+	for (int e = 0; e < num; e++) {
+		// a handler might remove itself or others, look it up by fd
+		RCPtr<AbstractPollHandler> handler;
+		for (unsigned int i = 0; i < fPollHandlers.size(); i++) {
+			if (fPollHandlers[i]->GetFileDescriptor() == ev[e].data.fd) {
+				handler = fPollHandlers[i];
+				break;
+			}
+		}
+		if (handler.IsNotNull() && handler->ProcessPollEvent()) {
+			ret = true;
+		}
+	}
+	return ret;
+}
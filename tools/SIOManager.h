@@ -22,8 +22,11 @@
 */
 
 
+#include <vector>
+
 #include "AbstractSIOHandler.h"
 #include "SIOWrapper.h"
+#include "AbstractPollHandler.h"
 
 class SIOManager : public RefCounted {
 public:
@@ -36,17 +39,36 @@ public:
 
 	bool UnregisterHandler(uint8_t device_id);
 
+	// install handler (or remove the current one if it's NULL) in
+	// one step, the device doesn't go through an unregistered state
+	void ReplaceHandler(uint8_t device_id, const RCPtr<AbstractSIOHandler>& handler);
+
 	/*
 	 * return:
 	 * -1 = an error occurred
 	 *  0 = specified device has data available
 	 *  1 = error (or signal caught) during select
+	 *  2 = a poll handler requested to return
 	 */
 	int DoServing(int otherReadPollDevice=-1);
 
+	// poll additional file descriptors while serving
+	bool AddPollHandler(const RCPtr<AbstractPollHandler>& handler);
+	void RemovePollHandler(const RCPtr<AbstractPollHandler>& handler);
+
 private:
+	bool ProcessPollHandlers();
+
 	RCPtr<SIOWrapper> fWrapper;
 	RCPtr<AbstractSIOHandler> fHandlers[256];
+
+	// scratch buffers for the command currently being processed
+	SIOScratchArena fScratchArena;
+
+	// the descriptors of all poll handlers are combined in one
+	// epoll descriptor which is passed to the SIO wrapper
+	std::vector< RCPtr<AbstractPollHandler> > fPollHandlers;
+	int fPollFd;
 	
 	// debugging stuff (default = off)
 };
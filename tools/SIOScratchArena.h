@@ -0,0 +1,85 @@
+#ifndef SIOSCRATCHARENA_H
+#define SIOSCRATCHARENA_H
+
+/*
+   SIOScratchArena.h - per-bus scratch memory for processing SIO commands
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+
+// The SIOManager owns one arena per bus and resets it before each
+// command frame. Handlers take their data frame buffers from it
+// instead of using the heap, variable length arrays on the stack
+// or static buffers shared by all instances. Buffers are only valid
+// until the handler returns from ProcessCommandFrame.
+
+class SIOScratchArena {
+public:
+	// large enough for a 64k remote control command plus the
+	// largest sector buffer
+	enum { eArenaSize = 0x10000 + 0x2000 + 64 };
+
+	inline SIOScratchArena();
+
+	// release all buffers
+	inline void Reset();
+
+	// returns NULL if the arena is exhausted
+	inline uint8_t* Allocate(unsigned int length);
+
+	inline unsigned int GetUsed() const;
+
+private:
+	// no copying
+	SIOScratchArena(const SIOScratchArena&);
+	SIOScratchArena& operator=(const SIOScratchArena&);
+
+	unsigned int fUsed;
+	uint64_t fArena[eArenaSize / sizeof(uint64_t)];
+};
+
+inline SIOScratchArena::SIOScratchArena()
+	: fUsed(0)
+{
+}
+
+inline void SIOScratchArena::Reset()
+{
+	fUsed = 0;
+}
+
+inline uint8_t* SIOScratchArena::Allocate(unsigned int length)
+{
+	// keep buffers 8-byte aligned
+	unsigned int size = (length + 7) & ~7U;
+	if (size < length || size > sizeof(fArena) - fUsed) {
+		return NULL;
+	}
+	uint8_t* buf = (uint8_t*)fArena + fUsed;
+	fUsed += size;
+	return buf;
+}
+
+inline unsigned int SIOScratchArena::GetUsed() const
+{
+	return fUsed;
+}
+
+#endif
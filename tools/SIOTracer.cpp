@@ -301,10 +301,18 @@ void SIOTracer::TraceCommandError(int returncode, uint8_t FDC_status)
 			IterTraceErrorString(eTraceCommands, "ERROR:");
 			IterTraceString(eTraceCommands, " writing printer data failed");
 			break;
+		case AbstractSIOHandler::ePrinterBusy:
+			IterTraceWarningString(eTraceCommands, "busy:");
+			IterTraceString(eTraceCommands, " printer queue is full");
+			break;
 		case AbstractSIOHandler::eRemoteControlError:
 			IterTraceErrorString(eTraceCommands, "ERROR:");
 			IterTraceString(eTraceCommands, " illegal remote control frame");
 			break;
+		case AbstractSIOHandler::eScratchExhausted:
+			IterTraceErrorString(eTraceCommands, "ERROR:");
+			IterTraceString(eTraceCommands, " out of SIO scratch memory");
+			break;
 		default:
 			IterTraceErrorString(eTraceCommands, "ERROR:");
 			snprintf(fString, eMaxStringLength, " %d\n", returncode);
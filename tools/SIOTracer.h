@@ -35,7 +35,7 @@
 
 class SIOTracer {
 private:
-	class TracerEntry : public RefCounted {
+	class TracerEntry : public ThreadSafeRefCounted {
 	public:
 		TracerEntry(const RCPtr<AbstractTracer>& tracer)
 			: fTraceGroups(0),
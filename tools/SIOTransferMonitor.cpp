@@ -0,0 +1,102 @@
+/*
+   SIOTransferMonitor.cpp - count high speed transfers and their errors
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <string.h>
+
+#include "SIOTransferMonitor.h"
+
+SIOTransferMonitor::SIOTransferMonitor()
+	: fTransfers(0),
+	  fErrors(0),
+	  fCleanTransfers(0),
+	  fHaveLastFrame(false),
+	  fLastHighSpeed(false),
+	  fLastFailed(false),
+	  fLastTime(0),
+	  fSpeedQueried(false)
+{
+	memset(fLastFrame, 0, sizeof(fLastFrame));
+}
+
+SIOTransferMonitor::~SIOTransferMonitor()
+{
+}
+
+void SIOTransferMonitor::Record(const SIO_command_frame& frame, bool highspeed, int result)
+{
+	MiscUtils::TimestampType now = MiscUtils::GetCurrentTime();
+	uint8_t cmd[4];
+	cmd[0] = frame.device_id;
+	cmd[1] = frame.command;
+	cmd[2] = frame.aux1;
+	cmd[3] = frame.aux2;
+
+	// DOSes may query the status several times, only sector
+	// reads and writes are checked for retries
+	uint8_t command = frame.command & 0x7f;
+	bool sectorCommand = command == 0x50 || command == 0x52 || command == 0x57;
+
+	if (command == 0x3f) {
+		fSpeedQueried = true;
+	}
+
+	bool retry = sectorCommand && fHaveLastFrame && fLastHighSpeed
+		&& memcmp(cmd, fLastFrame, sizeof(cmd)) == 0
+		&& now - fLastTime < eRetryTimeout
+		&& (fLastFailed || fSpeedQueried);
+
+	if (retry) {
+		// the last try failed on the Atari side
+		fErrors++;
+		fCleanTransfers = 0;
+	}
+
+	bool error = highspeed &&
+		(result == EATARISIO_CHECKSUM_ERROR || result == EATARISIO_COMMAND_TIMEOUT);
+
+	if (sectorCommand) {
+		memcpy(fLastFrame, cmd, sizeof(cmd));
+		fLastTime = now;
+		fLastHighSpeed = highspeed;
+		fLastFailed = result != 0 && !error;
+		fHaveLastFrame = true;
+		fSpeedQueried = false;
+	}
+
+	if (!highspeed) {
+		return;
+	}
+	fTransfers++;
+	if (error) {
+		fErrors++;
+		fCleanTransfers = 0;
+	} else {
+		fCleanTransfers++;
+	}
+}
+
+void SIOTransferMonitor::Reset()
+{
+	fTransfers = 0;
+	fErrors = 0;
+	fCleanTransfers = 0;
+	fHaveLastFrame = false;
+	fSpeedQueried = false;
+}
@@ -0,0 +1,73 @@
+#ifndef SIOTRANSFERMONITOR_H
+#define SIOTRANSFERMONITOR_H
+
+/*
+   SIOTransferMonitor.h - count high speed transfers and their errors
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdint.h>
+#include "../driver/atarisio.h"
+#include "MiscUtils.h"
+#include "RefCounted.h"
+
+// Disk handlers report every processed command. Only commands received
+// at high speed are counted. Errors are data frames with checksum errors
+// or timeouts seen by the server and sector commands the Atari repeats
+// shortly after, because it didn't get the response of the last try.
+// DOSes re-read sectors on purpose (VTOC, directory, write verify), so
+// a repeat only counts if the last try wasn't completed or the Atari
+// queried the speed (0x3f) in between, which it does after falling
+// back to standard speed.
+
+class SIOTransferMonitor : public RefCounted {
+public:
+	SIOTransferMonitor();
+	virtual ~SIOTransferMonitor();
+
+	// result is the return value of ProcessCommandFrame
+	virtual void Record(const SIO_command_frame& frame, bool highspeed, int result);
+
+	unsigned int GetTransfers() const { return fTransfers; }
+	unsigned int GetErrors() const { return fErrors; }
+
+	// number of transfers since the last error
+	unsigned int GetCleanTransfers() const { return fCleanTransfers; }
+
+	void Reset();
+
+private:
+	enum { eRetryTimeout = 1000000 };
+
+	unsigned int fTransfers;
+	unsigned int fErrors;
+	unsigned int fCleanTransfers;
+
+	// last sector command
+	bool fHaveLastFrame;
+	bool fLastHighSpeed;
+	// not completed and not counted as an error yet
+	bool fLastFailed;
+	uint8_t fLastFrame[4];
+	MiscUtils::TimestampType fLastTime;
+
+	// speed query since the last sector command
+	bool fSpeedQueried;
+};
+
+#endif
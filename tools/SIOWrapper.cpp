@@ -43,6 +43,11 @@ static const char* defaultDeviceName = MY_STR2(DEFAULT_DEVICE);
 static const char* defaultDeviceName = "/dev/atarisio0";
 #endif
 
+const char* SIOWrapper::GetDefaultDeviceName()
+{
+	return defaultDeviceName;
+}
+
 SIOWrapper* SIOWrapper::CreateSIOWrapper(const char* devName)
 {
 	SIOWrapper* wrapper;
@@ -72,7 +77,8 @@ SIOWrapper* SIOWrapper::CreateSIOWrapper(const char* devName)
 }
 
 SIOWrapper::SIOWrapper(int fileno)
-	: fDeviceFileNo(fileno), fLastResult(0)
+	: fDeviceFileNo(fileno), fLastResult(0),
+	  fStandardBaudrate(0), fHighspeedBaudrate(0), fCommandFrameBaudrate(0)
 { }
 
 SIOWrapper::~SIOWrapper()
@@ -297,4 +303,5 @@ void SIOWrapper::InitializeBaudrates()
 	if (!fHighspeedBaudrate) {
 		fHighspeedBaudrate = fStandardBaudrate;
 	}
+	fCommandFrameBaudrate = fStandardBaudrate;
 }
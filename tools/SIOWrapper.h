@@ -34,6 +34,9 @@ class SIOWrapper : public RefCounted {
 public:
 	static SIOWrapper* CreateSIOWrapper(const char* devicename = 0);
 
+	// device used by CreateSIOWrapper if devicename is 0
+	static const char* GetDefaultDeviceName();
+
 	virtual ~SIOWrapper();
 
 	virtual bool IsKernelWrapper() const;
@@ -120,13 +123,14 @@ public:
 	 * SIO server methods
 	 */
 
-	virtual int WaitForCommandFrame(int otherReadPollDevice=-1) = 0;
+	virtual int WaitForCommandFrame(int otherReadPollDevice=-1, int auxReadPollDevice=-1) = 0;
 	/*
 	 * return values:
 	 * -1 = timeout
 	 *  0 = command frame is waiting
 	 *  1 = other device has data
 	 *  2 = error in select (or caught signal)
+	 *  3 = aux device has data
 	 */
 
 	virtual int GetCommandFrame(SIO_command_frame& frame) = 0;
@@ -191,6 +195,11 @@ public:
 		return fHighspeedBaudrate;
 	}
 
+	// baudrate the last command frame was received at
+	inline unsigned int GetCommandFrameBaudrate() const {
+		return fCommandFrameBaudrate;
+	}
+
 protected:
 	SIOWrapper(int fileno);
 
@@ -200,6 +209,7 @@ protected:
 	int fLastResult;
 	unsigned int fStandardBaudrate;
 	unsigned int fHighspeedBaudrate;
+	unsigned int fCommandFrameBaudrate;
 };
 
 inline int SIOWrapper::GetLastStatus()
@@ -0,0 +1,154 @@
+/*
+   SectorCache.cpp - LRU cache for decoded sectors
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include "SectorCache.h"
+#include "AtariDebug.h"
+
+SectorCache::SectorCache(unsigned int numberOfSectors, unsigned int maxSectorLength, unsigned int entries)
+	: fNumberOfSectors(numberOfSectors),
+	  fMaxSectorLength(maxSectorLength),
+	  fEntries(entries),
+	  fEntry(entries),
+	  fEntryOfSector(numberOfSectors + 1),
+	  fHits(0),
+	  fMisses(0)
+{
+	Assert(entries > 0);
+	fData = new uint8_t[fEntries * fMaxSectorLength];
+	Clear();
+}
+
+SectorCache::~SectorCache()
+{
+	delete[] fData;
+}
+
+void SectorCache::Clear()
+{
+	for (unsigned int i = 0; i <= fNumberOfSectors; i++) {
+		fEntryOfSector[i] = -1;
+	}
+	// put all entries in the list, they'll be reused from the tail
+	for (unsigned int i = 0; i < fEntries; i++) {
+		fEntry[i].fSector = 0;
+		fEntry[i].fPrev = i - 1;
+		fEntry[i].fNext = (i + 1 < fEntries) ? (int)(i + 1) : -1;
+	}
+	fHead = 0;
+	fTail = fEntries - 1;
+}
+
+void SectorCache::Unlink(int idx)
+{
+	Entry& e = fEntry[idx];
+	if (e.fPrev >= 0) {
+		fEntry[e.fPrev].fNext = e.fNext;
+	} else {
+		fHead = e.fNext;
+	}
+	if (e.fNext >= 0) {
+		fEntry[e.fNext].fPrev = e.fPrev;
+	} else {
+		fTail = e.fPrev;
+	}
+	e.fPrev = -1;
+	e.fNext = -1;
+}
+
+void SectorCache::LinkFront(int idx)
+{
+	Entry& e = fEntry[idx];
+	e.fPrev = -1;
+	e.fNext = fHead;
+	if (fHead >= 0) {
+		fEntry[fHead].fPrev = idx;
+	}
+	fHead = idx;
+	if (fTail < 0) {
+		fTail = idx;
+	}
+}
+
+const uint8_t* SectorCache::Lookup(unsigned int sector)
+{
+	if (sector == 0 || sector > fNumberOfSectors) {
+		return 0;
+	}
+	int idx = fEntryOfSector[sector];
+	if (idx < 0) {
+		fMisses++;
+		return 0;
+	}
+	fHits++;
+	if (idx != fHead) {
+		Unlink(idx);
+		LinkFront(idx);
+	}
+	return fData + idx * fMaxSectorLength;
+}
+
+uint8_t* SectorCache::Insert(unsigned int sector)
+{
+	if (sector == 0 || sector > fNumberOfSectors) {
+		Assert(false);
+		return 0;
+	}
+	int idx = fEntryOfSector[sector];
+	if (idx < 0) {
+		idx = fTail;
+		if (fEntry[idx].fSector) {
+			fEntryOfSector[fEntry[idx].fSector] = -1;
+		}
+		fEntry[idx].fSector = sector;
+		fEntryOfSector[sector] = idx;
+	}
+	if (idx != fHead) {
+		Unlink(idx);
+		LinkFront(idx);
+	}
+	return fData + idx * fMaxSectorLength;
+}
+
+void SectorCache::Remove(unsigned int sector)
+{
+	if (sector == 0 || sector > fNumberOfSectors) {
+		return;
+	}
+	int idx = fEntryOfSector[sector];
+	if (idx < 0) {
+		return;
+	}
+	fEntryOfSector[sector] = -1;
+	fEntry[idx].fSector = 0;
+	// make it the first entry to be reused
+	if (idx != fTail) {
+		Unlink(idx);
+		Entry& e = fEntry[idx];
+		e.fPrev = fTail;
+		e.fNext = -1;
+		if (fTail >= 0) {
+			fEntry[fTail].fNext = idx;
+		}
+		fTail = idx;
+		if (fHead < 0) {
+			fHead = idx;
+		}
+	}
+}
@@ -0,0 +1,79 @@
+#ifndef SECTORCACHE_H
+#define SECTORCACHE_H
+
+/*
+   SectorCache.h - LRU cache for decoded sectors
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdint.h>
+#include <vector>
+
+// Fixed size cache of sector data. All storage is allocated in the
+// constructor, when the cache is full the least recently used sector
+// is evicted.
+
+class SectorCache {
+public:
+	enum { eDefaultEntries = 128 };
+
+	SectorCache(unsigned int numberOfSectors, unsigned int maxSectorLength,
+		unsigned int entries = eDefaultEntries);
+	~SectorCache();
+
+	// returns a pointer to the cached data or NULL if the sector
+	// is not in the cache
+	const uint8_t* Lookup(unsigned int sector);
+
+	// allocate an entry for the sector (evicting the least
+	// recently used one if necessary) and return the data buffer
+	uint8_t* Insert(unsigned int sector);
+
+	void Remove(unsigned int sector);
+	void Clear();
+
+	unsigned int GetHits() const { return fHits; }
+	unsigned int GetMisses() const { return fMisses; }
+
+private:
+	struct Entry {
+		unsigned int fSector;	// 0 = unused
+		int fPrev;
+		int fNext;
+	};
+
+	void Unlink(int idx);
+	void LinkFront(int idx);
+
+	unsigned int fNumberOfSectors;
+	unsigned int fMaxSectorLength;
+	unsigned int fEntries;
+
+	std::vector<Entry> fEntry;
+	std::vector<int> fEntryOfSector;
+	uint8_t* fData;
+
+	// doubly linked list, most recently used entry first
+	int fHead;
+	int fTail;
+
+	unsigned int fHits;
+	unsigned int fMisses;
+};
+
+#endif
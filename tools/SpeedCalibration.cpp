@@ -0,0 +1,223 @@
+/*
+   SpeedCalibration.cpp - find the fastest reliable high speed setting
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+
+#include "SpeedCalibration.h"
+#include "DeviceManager.h"
+#include "AtariDebug.h"
+
+static const unsigned int candidateDivisors[] = { 16, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 };
+
+SpeedCalibration::SpeedCalibration(DeviceManager* manager, const std::string& adapter)
+	: fDeviceManager(manager),
+	  fAdapter(adapter),
+	  fCurrentStep(0),
+	  fRunning(false),
+	  fSpeedQueried(false),
+	  fStandardSpeedCommands(0),
+	  fOriginalPokeyDivisor(0),
+	  fOriginalBaudrate(0)
+{
+}
+
+SpeedCalibration::~SpeedCalibration()
+{
+}
+
+bool SpeedCalibration::Start()
+{
+	if (fRunning) {
+		AERROR("speed calibration is already running");
+		return false;
+	}
+	RCPtr<SIOWrapper> wrapper = fDeviceManager->GetSIOWrapper();
+
+	fSteps.clear();
+	for (unsigned int i = 0; i < sizeof(candidateDivisors) / sizeof(candidateDivisors[0]); i++) {
+		Step step;
+		step.fProfile.fPokeyDivisor = candidateDivisors[i];
+		step.fProfile.fBaudrate = wrapper->GetBaudrateForPokeyDivisor(candidateDivisors[i]);
+		step.fProfile.fTransfers = 0;
+		step.fProfile.fErrors = 0;
+		step.fProfile.fMargin = 0;
+		step.fPassed = false;
+		if (step.fProfile.fBaudrate) {
+			fSteps.push_back(step);
+		}
+	}
+	if (fSteps.empty()) {
+		AERROR("high speed SIO is not supported by the driver");
+		return false;
+	}
+
+	fOriginalPokeyDivisor = fDeviceManager->GetHighSpeedPokeyDivisor();
+	fOriginalBaudrate = fDeviceManager->GetHighSpeedBaudrate();
+	if (!fDeviceManager->GetHighSpeedMode()) {
+		fDeviceManager->SetHighSpeedMode(true);
+	}
+
+	ALOG("starting speed calibration of %s", fAdapter.c_str());
+	ALOG("copy some disks at high speed on the Atari");
+	fRunning = true;
+	fCurrentStep = 0;
+	if (!StartStep()) {
+		Finish();
+		return false;
+	}
+	return true;
+}
+
+void SpeedCalibration::Abort()
+{
+	if (!fRunning) {
+		return;
+	}
+	ALOG("speed calibration aborted");
+	fRunning = false;
+	fDeviceManager->SetTransferMonitor(RCPtr<SIOTransferMonitor>());
+	fDeviceManager->SetHighSpeedParameters(fOriginalPokeyDivisor, fOriginalBaudrate);
+}
+
+bool SpeedCalibration::StartStep()
+{
+	RCPtr<SIOWrapper> wrapper = fDeviceManager->GetSIOWrapper();
+
+	while (fCurrentStep < fSteps.size()) {
+		SpeedProfile::Profile& profile = fSteps[fCurrentStep].fProfile;
+
+		// the UART may not be able to hit the rate exactly
+		wrapper->FlushWriteBuffer();
+		wrapper->SetBaudrate(profile.fBaudrate);
+		profile.fMargin = SpeedProfile::GetTimingMargin(profile.fPokeyDivisor, wrapper->GetExactBaudrate());
+		wrapper->SetBaudrate(wrapper->GetStandardBaudrate());
+
+		if (profile.fMargin >= eMinMargin) {
+			break;
+		}
+		ALOG("skipping pokey divisor %d: timing margin %d.%d%% too small",
+			profile.fPokeyDivisor, profile.fMargin / 10, abs(profile.fMargin % 10));
+		fCurrentStep++;
+	}
+	if (fCurrentStep >= fSteps.size()) {
+		return false;
+	}
+
+	const SpeedProfile::Profile& profile = fSteps[fCurrentStep].fProfile;
+	ALOG("calibrating pokey divisor %d (%d baud)", profile.fPokeyDivisor, profile.fBaudrate);
+
+	Reset();
+	fSpeedQueried = false;
+	fStandardSpeedCommands = 0;
+	return fDeviceManager->SetHighSpeedParameters(profile.fPokeyDivisor, profile.fBaudrate);
+}
+
+void SpeedCalibration::FinishStep(bool passed)
+{
+	Step& step = fSteps[fCurrentStep];
+	step.fProfile.fTransfers = GetTransfers();
+	step.fProfile.fErrors = GetErrors();
+	step.fPassed = passed;
+
+	ALOG("pokey divisor %d: %s (%d transfers, %d errors)",
+		step.fProfile.fPokeyDivisor,
+		passed ? "OK" : "failed",
+		step.fProfile.fTransfers,
+		step.fProfile.fErrors);
+
+	fCurrentStep++;
+	// faster rates won't work better
+	if (!passed || !StartStep()) {
+		Finish();
+	}
+}
+
+void SpeedCalibration::Finish()
+{
+	fRunning = false;
+	// the device manager keeps a reference, it's safe to detach
+	// while a handler is reporting to us
+	fDeviceManager->SetTransferMonitor(RCPtr<SIOTransferMonitor>());
+
+	int best = -1;
+	for (unsigned int i = 0; i < fSteps.size(); i++) {
+		if (fSteps[i].fPassed) {
+			best = i;
+		}
+	}
+	if (best < 0) {
+		AWARN("speed calibration found no working high speed setting");
+		fDeviceManager->SetHighSpeedParameters(fOriginalPokeyDivisor, fOriginalBaudrate);
+		return;
+	}
+
+	const SpeedProfile::Profile& profile = fSteps[best].fProfile;
+	ALOG("using pokey divisor %d (%d baud), timing margin %d.%d%%",
+		profile.fPokeyDivisor, profile.fBaudrate,
+		profile.fMargin / 10, profile.fMargin % 10);
+	fDeviceManager->SetHighSpeedParameters(profile.fPokeyDivisor, profile.fBaudrate);
+
+	if (!SpeedProfile::Save(fAdapter, profile)) {
+		AERROR("cannot save speed profile of %s", fAdapter.c_str());
+	}
+}
+
+void SpeedCalibration::Record(const SIO_command_frame& frame, bool highspeed, int result)
+{
+	if (!fRunning) {
+		return;
+	}
+	if (frame.command == 0x3f) {
+		if (fSpeedQueried) {
+			// the Atari fell back to standard speed after an error
+			SIOTransferMonitor::Record(frame, true, EATARISIO_COMMAND_TIMEOUT);
+		} else {
+			fSpeedQueried = true;
+		}
+		fStandardSpeedCommands = 0;
+	} else {
+		SIOTransferMonitor::Record(frame, highspeed, result);
+		uint8_t command = frame.command & 0x7f;
+		if (!highspeed && (command == 0x50 || command == 0x52 || command == 0x57)) {
+			fStandardSpeedCommands++;
+		} else if (highspeed) {
+			fStandardSpeedCommands = 0;
+		}
+	}
+
+	if (fStandardSpeedCommands >= eMaxStandardSpeedCommands) {
+		if (fCurrentStep == 0 && GetTransfers() == 0) {
+			AWARN("speed calibration: no high speed transfers, "
+				"is high speed SIO enabled on the Atari?");
+			Abort();
+		} else {
+			FinishStep(false);
+		}
+		return;
+	}
+
+	unsigned int transfers = GetTransfers();
+	unsigned int errors = GetErrors();
+	if (errors * eErrorRatio > (transfers > eStepTransfers ? transfers : (unsigned int) eStepTransfers)) {
+		FinishStep(false);
+	} else if (transfers >= eStepTransfers) {
+		FinishStep(true);
+	}
+}
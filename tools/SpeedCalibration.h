@@ -0,0 +1,91 @@
+#ifndef SPEEDCALIBRATION_H
+#define SPEEDCALIBRATION_H
+
+/*
+   SpeedCalibration.h - find the fastest reliable high speed setting
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <string>
+#include <vector>
+
+#include "SIOTransferMonitor.h"
+#include "SpeedProfile.h"
+
+class DeviceManager;
+
+// Steps through the pokey divisors from slow to fast while the Atari
+// reads or writes disks at high speed. Every step is tested with a
+// number of transfers and fails if too many of them had to be retried.
+// The fastest step that passed is applied and saved as the profile
+// of the adapter.
+
+class SpeedCalibration : public SIOTransferMonitor {
+public:
+	SpeedCalibration(DeviceManager* manager, const std::string& adapter);
+	virtual ~SpeedCalibration();
+
+	bool Start();
+	void Abort();
+
+	inline bool IsRunning() const;
+
+	virtual void Record(const SIO_command_frame& frame, bool highspeed, int result);
+
+private:
+	enum {
+		// transfers needed to pass a step
+		eStepTransfers = 64,
+		// a step fails at the first error above 2 percent
+		eErrorRatio = 50,
+		// the Atari dropped to standard speed
+		eMaxStandardSpeedCommands = 32,
+		// minimum timing margin in 1/1000
+		eMinMargin = 5
+	};
+
+	struct Step {
+		SpeedProfile::Profile fProfile;
+		bool fPassed;
+	};
+
+	bool StartStep();
+	void FinishStep(bool passed);
+	void Finish();
+
+	DeviceManager* fDeviceManager;
+	std::string fAdapter;
+
+	std::vector<Step> fSteps;
+	unsigned int fCurrentStep;
+	bool fRunning;
+
+	// the Atari queried the pokey divisor of the current step
+	bool fSpeedQueried;
+	unsigned int fStandardSpeedCommands;
+
+	unsigned int fOriginalPokeyDivisor;
+	unsigned int fOriginalBaudrate;
+};
+
+inline bool SpeedCalibration::IsRunning() const
+{
+	return fRunning;
+}
+
+#endif
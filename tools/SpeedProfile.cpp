@@ -0,0 +1,190 @@
+/*
+   SpeedProfile.cpp - calibrated high speed settings per serial adapter
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <vector>
+
+#include "SpeedProfile.h"
+#include "SIOWrapper.h"
+#include "../driver/atarisio.h"
+
+// a 10 bit frame is sampled in the middle of the bits, the last bit
+// may drift by almost half a bit
+#define MAX_DEVIATION 40
+
+static std::string profile_filename()
+{
+	const char* name = getenv("ATARISIO_SPEED_PROFILES");
+	if (name && *name) {
+		return name;
+	}
+	const char* home = getenv("HOME");
+	if (!home) {
+		home = "";
+	}
+	return std::string(home) + "/.atarisio-speed-profiles";
+}
+
+static bool read_profiles(std::vector<std::string>& lines)
+{
+	FILE* f = fopen(profile_filename().c_str(), "r");
+	if (!f) {
+		return false;
+	}
+	char buf[PATH_MAX + 100];
+	while (fgets(buf, sizeof(buf), f)) {
+		buf[strcspn(buf, "\r\n")] = 0;
+		lines.push_back(buf);
+	}
+	fclose(f);
+	return true;
+}
+
+static bool parse_profile(const std::string& line, std::string& adapter, SpeedProfile::Profile& profile)
+{
+	char name[PATH_MAX];
+	if (sscanf(line.c_str(), "%4095s %u %u %u %u %d", name,
+		&profile.fPokeyDivisor, &profile.fBaudrate,
+		&profile.fTransfers, &profile.fErrors, &profile.fMargin) != 6) {
+		return false;
+	}
+	if (name[0] == '#' || profile.fPokeyDivisor > 63 || profile.fBaudrate == 0) {
+		return false;
+	}
+	adapter = name;
+	return true;
+}
+
+std::string SpeedProfile::GetAdapterName(const char* devname)
+{
+	if (!devname) {
+		devname = SIOWrapper::GetDefaultDeviceName();
+	}
+	char devpath[PATH_MAX];
+	if (!realpath(devname, devpath)) {
+		return devname;
+	}
+
+	// USB adapters may show up as another ttyUSB on the next run
+	const char* byIdDir = "/dev/serial/by-id";
+	DIR* dir = opendir(byIdDir);
+	if (dir) {
+		struct dirent* de;
+		while ((de = readdir(dir))) {
+			if (de->d_name[0] == '.') {
+				continue;
+			}
+			std::string link = std::string(byIdDir) + "/" + de->d_name;
+			char linkpath[PATH_MAX];
+			if (realpath(link.c_str(), linkpath) && strcmp(linkpath, devpath) == 0) {
+				closedir(dir);
+				return link;
+			}
+		}
+		closedir(dir);
+	}
+	return devpath;
+}
+
+bool SpeedProfile::Load(const std::string& adapter, Profile& profile)
+{
+	std::vector<std::string> lines;
+	if (!read_profiles(lines)) {
+		return false;
+	}
+	for (unsigned int i = 0; i < lines.size(); i++) {
+		std::string name;
+		Profile p;
+		if (parse_profile(lines[i], name, p) && name == adapter) {
+			profile = p;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool SpeedProfile::Save(const std::string& adapter, const Profile& profile)
+{
+	std::vector<std::string> lines;
+	read_profiles(lines);
+
+	char buf[PATH_MAX + 100];
+	snprintf(buf, sizeof(buf), "%s %u %u %u %u %d", adapter.c_str(),
+		profile.fPokeyDivisor, profile.fBaudrate,
+		profile.fTransfers, profile.fErrors, profile.fMargin);
+
+	bool replaced = false;
+	for (unsigned int i = 0; i < lines.size(); i++) {
+		std::string name;
+		Profile p;
+		if (parse_profile(lines[i], name, p) && name == adapter) {
+			lines[i] = buf;
+			replaced = true;
+		}
+	}
+	if (!replaced) {
+		if (lines.empty()) {
+			lines.push_back("# adapter pokey-divisor baudrate transfers errors margin");
+		}
+		lines.push_back(buf);
+	}
+
+	// replace the file in one step
+	std::string filename = profile_filename();
+	std::string tmpname = filename + ".tmp";
+	FILE* f = fopen(tmpname.c_str(), "w");
+	if (!f) {
+		return false;
+	}
+	for (unsigned int i = 0; i < lines.size(); i++) {
+		fprintf(f, "%s\n", lines[i].c_str());
+	}
+	if (fclose(f)) {
+		unlink(tmpname.c_str());
+		return false;
+	}
+	if (rename(tmpname.c_str(), filename.c_str())) {
+		unlink(tmpname.c_str());
+		return false;
+	}
+	return true;
+}
+
+unsigned int SpeedProfile::GetPokeyBaudrate(unsigned int pokeyDivisor)
+{
+	if (pokeyDivisor <= 4) {
+		// pokey samples late at these rates, 3 cycles per byte
+		return (ATARISIO_ATARI_FREQUENCY_PAL * 10) /
+			(10 * (2 * (pokeyDivisor + 7)) + 3);
+	}
+	return ATARISIO_ATARI_FREQUENCY_PAL / (2 * (pokeyDivisor + 7));
+}
+
+int SpeedProfile::GetTimingMargin(unsigned int pokeyDivisor, unsigned int baudrate)
+{
+	unsigned int pokey = GetPokeyBaudrate(pokeyDivisor);
+	unsigned int diff = (baudrate > pokey) ? baudrate - pokey : pokey - baudrate;
+	return MAX_DEVIATION - (int) ((unsigned long long) diff * 1000 / pokey);
+}
@@ -0,0 +1,58 @@
+#ifndef SPEEDPROFILE_H
+#define SPEEDPROFILE_H
+
+/*
+   SpeedProfile.h - calibrated high speed settings per serial adapter
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <string>
+
+// Profiles are stored in the file $ATARISIO_SPEED_PROFILES, default
+// is ~/.atarisio-speed-profiles, one line per adapter:
+// <adapter> <pokey divisor> <baudrate> <transfers> <errors> <margin>
+
+namespace SpeedProfile {
+
+	struct Profile {
+		unsigned int fPokeyDivisor;
+		unsigned int fBaudrate;
+		// result of the calibration
+		unsigned int fTransfers;
+		unsigned int fErrors;
+		int fMargin;
+	};
+
+	// a name that identifies the adapter behind devname (0 = default
+	// device) even if it's enumerated differently, preferably its
+	// /dev/serial/by-id link
+	std::string GetAdapterName(const char* devname);
+
+	bool Load(const std::string& adapter, Profile& profile);
+	bool Save(const std::string& adapter, const Profile& profile);
+
+	// transmission rate of a PAL Atari at the given pokey divisor
+	unsigned int GetPokeyBaudrate(unsigned int pokeyDivisor);
+
+	// remaining tolerance in 1/1000 when the UART sends at baudrate
+	// instead of the pokey rate, negative values won't work
+	int GetTimingMargin(unsigned int pokeyDivisor, unsigned int baudrate);
+
+};
+
+#endif
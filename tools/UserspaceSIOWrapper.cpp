@@ -103,16 +103,16 @@ bool UserspaceSIOWrapper::InitSerialDevice()
 		return false;
 	}
 
+	// pseudo terminals (used for testing) don't support serial info
 	struct serial_struct ss;
         if (ioctl(fDeviceFileNo, TIOCGSERIAL, &ss)) {
-                AERROR("get serial info failed");
-                return false;
-        }
-
-	ss.flags |= ASYNC_LOW_LATENCY;
-        if (ioctl(fDeviceFileNo, TIOCSSERIAL, &ss)) {
-                AWARN("enabling low latency mode failed");
-        }
+                AWARN("get serial info failed, cannot enable low latency mode");
+        } else {
+		ss.flags |= ASYNC_LOW_LATENCY;
+		if (ioctl(fDeviceFileNo, TIOCSSERIAL, &ss)) {
+			AWARN("enabling low latency mode failed");
+		}
+	}
 
 	struct termios tio;
 	if (ioctl(fDeviceFileNo, TCGETS, &tio)) {
@@ -141,6 +141,8 @@ UserspaceSIOWrapper::UserspaceSIOWrapper(int fileno)
 	  fDoAutobaud(false),
 	  fSioTiming(SIOWrapper::eRelaxedTiming),
 	  fRestoreOriginalTermiosOnExit(true),
+	  fCommandLineChannel(-1),
+	  fCommandLineChannelState(false),
 	  fLastCommandOK(true)
 {
 	if (ioctl(fDeviceFileNo, TCGETS, &fOriginalTermios)) {
@@ -221,6 +223,40 @@ bool UserspaceSIOWrapper::SetCommandLine(bool asserted)
 }
 
 
+bool UserspaceSIOWrapper::SetCommandLineChannel(int fd)
+{
+	if (fd >= 0) {
+		int flags = fcntl(fd, F_GETFL, 0);
+		if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+			return false;
+		}
+	}
+	fCommandLineChannel = fd;
+	fCommandLineChannelState = false;
+	return true;
+}
+
+bool UserspaceSIOWrapper::GetCommandLineState(bool& asserted)
+{
+	if (fCommandLineChannel >= 0) {
+		// only the latest state counts
+		uint8_t buf[16];
+		int cnt;
+		while ((cnt = read(fCommandLineChannel, buf, sizeof(buf))) > 0) {
+			fCommandLineChannelState = (buf[cnt - 1] != 0);
+		}
+		asserted = fCommandLineChannelState;
+		return true;
+	}
+
+	int flags;
+	if (ioctl(fDeviceFileNo, TIOCMGET, &flags)) {
+		return false;
+	}
+	asserted = (flags & fCommandLineMask) != 0;
+	return true;
+}
+
 int UserspaceSIOWrapper::Set1050CableType(E1050CableType type)
 {
 	fCommandLineMask = ~(TIOCM_RTS | TIOCM_DTR);
@@ -399,12 +435,12 @@ void UserspaceSIOWrapper::SetCommandHardErrorState()
 	fCommandReceiveState = eCommandHardError;
 }
 
-int UserspaceSIOWrapper::WaitForCommandFrame(int otherReadPollDevice)
+int UserspaceSIOWrapper::WaitForCommandFrame(int otherReadPollDevice, int auxReadPollDevice)
 {
 	fd_set read_set;
 	struct timeval tv;
 	int maxfd;
-	int flags;
+	bool asserted;
 	int sel;
 	int cnt;
 	MiscUtils::TimestampType printerTimeout = MiscUtils::GetCurrentTimePlusSec(15);
@@ -426,6 +462,18 @@ int UserspaceSIOWrapper::WaitForCommandFrame(int otherReadPollDevice)
 			}
 			FD_SET(otherReadPollDevice, &read_set);
 		}
+		if (auxReadPollDevice >= 0) {
+			if (auxReadPollDevice > maxfd) {
+				maxfd = auxReadPollDevice;
+			}
+			FD_SET(auxReadPollDevice, &read_set);
+		}
+		if (fHaveCommandLine && fCommandLineChannel >= 0) {
+			if (fCommandLineChannel > maxfd) {
+				maxfd = fCommandLineChannel;
+			}
+			FD_SET(fCommandLineChannel, &read_set);
+		}
 
 		switch (fCommandReceiveState) {
 		case eCommandSoftError:
@@ -446,11 +494,11 @@ int UserspaceSIOWrapper::WaitForCommandFrame(int otherReadPollDevice)
 			
 		case eWaitCommandIdle:
 			if (fHaveCommandLine) {
-				if (ioctl(fDeviceFileNo, TIOCMGET, &flags)) {
+				if (!GetCommandLineState(asserted)) {
 					AERROR("failed to read modem line status");
 					break;
 				}
-				if (!(flags & fCommandLineMask)) {
+				if (!asserted) {
 					SetWaitCommandAssertState();
 					continue;
 				}
@@ -464,12 +512,12 @@ int UserspaceSIOWrapper::WaitForCommandFrame(int otherReadPollDevice)
 
 		case eWaitCommandAssert:
 			if (fHaveCommandLine) {
-				if (ioctl(fDeviceFileNo, TIOCMGET, &flags)) {
+				if (!GetCommandLineState(asserted)) {
 					AERROR("failed to read modem line status");
 					break;
 				}
 
-				if (flags & fCommandLineMask) {
+				if (asserted) {
 					SetReceiveCommandState();
 					continue;
 				} else {
@@ -514,11 +562,11 @@ int UserspaceSIOWrapper::WaitForCommandFrame(int otherReadPollDevice)
 			break;
 		case eWaitCommandDeassert:
 			if (fHaveCommandLine) {
-				if (ioctl(fDeviceFileNo, TIOCMGET, &flags)) {
+				if (!GetCommandLineState(asserted)) {
 					AERROR("failed to read modem line status");
 					break;
 				}
-				if (!(flags & fCommandLineMask)) {
+				if (!asserted) {
 					SetCommandOKState();
 					return 0;
 				}
@@ -581,6 +629,9 @@ int UserspaceSIOWrapper::WaitForCommandFrame(int otherReadPollDevice)
 			if (otherReadPollDevice >= 0 && FD_ISSET(otherReadPollDevice, &read_set)) {
 				return 1;
 			}
+			if (auxReadPollDevice >= 0 && FD_ISSET(auxReadPollDevice, &read_set)) {
+				return 3;
+			}
 		}
 
 		if (printerTimeout && now > printerTimeout) {
@@ -598,6 +649,7 @@ int UserspaceSIOWrapper::GetCommandFrame(SIO_command_frame& frame)
 		frame.aux2 = fCmdBuf[3];
 		frame.reception_timestamp = fCommandFrameTimestamp;
 		frame.missed_count = 0;
+		fCommandFrameBaudrate = fBaudrate;
 		SetWaitCommandAssertState();
 		return 0;
 	} else {
@@ -41,6 +41,12 @@ public:
 	// true sets alternative type (command connected to DSR).
 	virtual int SetSIOServerMode(ESIOServerCommandLine cmdLine = eCommandLine_RI);
 
+	// read the command line state from fd instead of the modem
+	// lines, eg when testing with a pseudo terminal. Every byte
+	// written to fd sets the state: 0 = deasserted, else asserted.
+	// -1 switches back to the modem lines.
+	bool SetCommandLineChannel(int fd);
+
 	/*
 	 * generic SIO method (old)
 	 */
@@ -55,7 +61,7 @@ public:
 	 * SIO server methods
 	 */
 
-	virtual int WaitForCommandFrame(int otherReadPollDevice=-1);
+	virtual int WaitForCommandFrame(int otherReadPollDevice=-1, int auxReadPollDevice=-1);
 	/*
 	 * return values:
 	 * -1 = timeout
@@ -120,6 +126,7 @@ private:
 	bool ClearControlLines();
 
 	bool SetCommandLine(bool asserted);
+	bool GetCommandLineState(bool& asserted);
 
 	int SendCommandFrame(Ext_SIO_parameters& params);
 
@@ -172,6 +179,9 @@ private:
 	struct termios fOriginalTermios;
 	bool fRestoreOriginalTermiosOnExit;
 
+	int fCommandLineChannel;
+	bool fCommandLineChannelState;
+
 	enum {
 		eDelayT0 = 1000,
 		eDelayT1 = 850,
@@ -0,0 +1,268 @@
+/*
+   VirtualDriveWatcher.cpp - sync host directory changes into virtual drives
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+#include <sys/epoll.h>
+
+#include "VirtualDriveWatcher.h"
+#include "DeviceManager.h"
+#include "Dos2xUtils.h"
+#include "AtariDebug.h"
+
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB)
+
+VirtualDriveWatcher::VirtualDriveWatcher(DeviceManager* manager)
+	: fDeviceManager(manager),
+	  fEpollFd(-1),
+	  fInotifyFd(-1),
+	  fTimerFd(-1)
+{
+	fInotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fInotifyFd < 0) {
+		AWARN("cannot watch virtual drive directories: inotify_init failed");
+		return;
+	}
+	fTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fTimerFd < 0) {
+		AWARN("cannot watch virtual drive directories: timerfd_create failed");
+		return;
+	}
+	int fd = epoll_create1(EPOLL_CLOEXEC);
+	if (fd < 0) {
+		AWARN("cannot watch virtual drive directories: epoll_create failed");
+		return;
+	}
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = fInotifyFd;
+	if (epoll_ctl(fd, EPOLL_CTL_ADD, fInotifyFd, &ev)) {
+		close(fd);
+		return;
+	}
+	ev.data.fd = fTimerFd;
+	if (epoll_ctl(fd, EPOLL_CTL_ADD, fTimerFd, &ev)) {
+		close(fd);
+		return;
+	}
+	fEpollFd = fd;
+}
+
+VirtualDriveWatcher::~VirtualDriveWatcher()
+{
+	if (fEpollFd >= 0) {
+		close(fEpollFd);
+	}
+	if (fTimerFd >= 0) {
+		close(fTimerFd);
+	}
+	if (fInotifyFd >= 0) {
+		close(fInotifyFd);
+	}
+}
+
+int VirtualDriveWatcher::GetFileDescriptor() const
+{
+	return fEpollFd;
+}
+
+void VirtualDriveWatcher::Refresh()
+{
+	if (!IsOK()) {
+		return;
+	}
+	for (int d = DeviceManager::eMinDriveNumber; d <= DeviceManager::eMaxDriveNumber; d++) {
+		RCPtr<Dos2xUtils> root = fDeviceManager->GetVirtualDriveRoot(DeviceManager::EDriveNumber(d));
+		if (root.IsNull()) {
+			continue;
+		}
+		std::vector< RCPtr<Dos2xUtils> > tree;
+		root->GetDirectoryTree(tree);
+		for (unsigned int i = 0; i < tree.size(); i++) {
+			const char* dir = tree[i]->GetDirectory();
+			if (!dir) {
+				continue;
+			}
+			// adding an existing watch returns the same descriptor
+			int wd = inotify_add_watch(fInotifyFd, dir, WATCH_MASK);
+			if (wd < 0) {
+				AWARN("cannot watch directory \"%s\"", dir);
+				continue;
+			}
+			bool known = false;
+			for (unsigned int w = 0; w < fWatches.size(); w++) {
+				if (fWatches[w].fWd == wd) {
+					fWatches[w].fPath = dir;
+					known = true;
+					break;
+				}
+			}
+			if (!known) {
+				Watch watch;
+				watch.fWd = wd;
+				watch.fPath = dir;
+				fWatches.push_back(watch);
+			}
+		}
+	}
+}
+
+bool VirtualDriveWatcher::ProcessPollEvent()
+{
+	struct epoll_event ev[2];
+	int num = epoll_wait(fEpollFd, ev, 2, 0);
+	for (int i = 0; i < num; i++) {
+		if (ev[i].data.fd == fInotifyFd) {
+			ReadEvents();
+		} else if (ev[i].data.fd == fTimerFd) {
+			uint64_t expirations;
+			if (read(fTimerFd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+				ApplyChanges();
+			}
+		}
+	}
+	return false;
+}
+
+void VirtualDriveWatcher::ReadEvents()
+{
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	bool gotEvent = false;
+
+	while (1) {
+		ssize_t len = read(fInotifyFd, buf, sizeof(buf));
+		if (len <= 0) {
+			break;
+		}
+		const struct inotify_event* event;
+		for (char* p = buf; p < buf + len; p += sizeof(struct inotify_event) + event->len) {
+			event = (const struct inotify_event*) p;
+			if (event->mask & IN_IGNORED) {
+				// directory was removed or unwatched
+				for (unsigned int w = 0; w < fWatches.size(); w++) {
+					if (fWatches[w].fWd == event->wd) {
+						fWatches.erase(fWatches.begin() + w);
+						break;
+					}
+				}
+				continue;
+			}
+			for (unsigned int w = 0; w < fWatches.size(); w++) {
+				if (fWatches[w].fWd == event->wd) {
+					MarkDirty(fWatches[w].fPath);
+					gotEvent = true;
+					break;
+				}
+			}
+		}
+	}
+
+	if (gotEvent) {
+		// (re-)start the debounce period
+		StartTimer(eDebounceTime);
+	}
+}
+
+void VirtualDriveWatcher::MarkDirty(const std::string& path)
+{
+	for (unsigned int i = 0; i < fDirtyPaths.size(); i++) {
+		if (fDirtyPaths[i] == path) {
+			return;
+		}
+	}
+	fDirtyPaths.push_back(path);
+}
+
+void VirtualDriveWatcher::StartTimer(unsigned int msec)
+{
+	struct itimerspec spec;
+	memset(&spec, 0, sizeof(spec));
+	spec.it_value.tv_sec = msec / 1000;
+	spec.it_value.tv_nsec = (msec % 1000) * 1000000;
+	timerfd_settime(fTimerFd, 0, &spec, NULL);
+}
+
+void VirtualDriveWatcher::ApplyChanges()
+{
+	std::vector<std::string> pending;
+	bool retry = false;
+	bool changedAny = false;
+
+	for (int d = DeviceManager::eMinDriveNumber; d <= DeviceManager::eMaxDriveNumber; d++) {
+		DeviceManager::EDriveNumber driveno = DeviceManager::EDriveNumber(d);
+		RCPtr<Dos2xUtils> root = fDeviceManager->GetVirtualDriveRoot(driveno);
+		if (root.IsNull()) {
+			continue;
+		}
+		std::vector< RCPtr<Dos2xUtils> > tree;
+		root->GetDirectoryTree(tree);
+
+		bool busy = false;
+		for (unsigned int i = 0; i < tree.size(); i++) {
+			if (tree[i]->HasOpenFiles()) {
+				busy = true;
+				break;
+			}
+		}
+
+		for (unsigned int i = 0; i < tree.size(); i++) {
+			const char* dir = tree[i]->GetDirectory();
+			if (!dir) {
+				continue;
+			}
+			bool dirty = false;
+			for (unsigned int p = 0; p < fDirtyPaths.size(); p++) {
+				if (fDirtyPaths[p] == dir) {
+					dirty = true;
+					break;
+				}
+			}
+			if (!dirty) {
+				continue;
+			}
+			bool changed = false;
+			bool complete;
+			if (busy || !tree[i]->SyncWithHostDirectory(changed, complete)) {
+				pending.push_back(dir);
+				retry = true;
+				continue;
+			}
+			if (changed) {
+				ALOG("updated D%d: from \"%s\"", d, dir);
+				changedAny = true;
+			}
+		}
+	}
+	fDirtyPaths = pending;
+
+	if (changedAny) {
+		// there might be new subdirectories
+		Refresh();
+	}
+	if (retry) {
+		StartTimer(eRetryTime);
+	}
+}
@@ -0,0 +1,79 @@
+#ifndef VIRTUALDRIVEWATCHER_H
+#define VIRTUALDRIVEWATCHER_H
+
+/*
+   VirtualDriveWatcher.h - sync host directory changes into virtual drives
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <string>
+#include <vector>
+
+#include "AbstractPollHandler.h"
+
+class DeviceManager;
+
+// Watches the host directories of all virtual drives with inotify.
+// Changes are collected until the directory has been quiet for the
+// debounce time and then applied with Dos2xUtils::SyncWithHostDirectory.
+// Drives where the Atari has a file open for writing are retried later.
+//
+// inotify and the debounce timer are combined in one epoll descriptor
+// so SIOManager only has to poll a single file descriptor.
+
+class VirtualDriveWatcher : public AbstractPollHandler {
+public:
+	VirtualDriveWatcher(DeviceManager* manager);
+	virtual ~VirtualDriveWatcher();
+
+	bool IsOK() const { return fEpollFd >= 0; }
+
+	// add watches for the directories of all virtual drives,
+	// call after a virtual drive has been created
+	void Refresh();
+
+	virtual int GetFileDescriptor() const;
+	virtual bool ProcessPollEvent();
+
+private:
+	enum {
+		eDebounceTime = 500,	// msec
+		eRetryTime = 1000	// msec
+	};
+
+	struct Watch {
+		int fWd;
+		std::string fPath;
+	};
+
+	void ReadEvents();
+	void ApplyChanges();
+	void StartTimer(unsigned int msec);
+	void MarkDirty(const std::string& path);
+
+	DeviceManager* fDeviceManager;
+
+	int fEpollFd;
+	int fInotifyFd;
+	int fTimerFd;
+
+	std::vector<Watch> fWatches;
+	std::vector<std::string> fDirtyPaths;
+};
+
+#endif
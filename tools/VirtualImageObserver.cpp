@@ -34,10 +34,13 @@ VirtualImageObserver::VirtualImageObserver(RCPtr<AtrImage> image)
 	fNumberOfSectors = fImage->GetNumberOfSectors();
 	Assert(fNumberOfSectors >= 720);
 	fDirectoryObserver = new Dos2xUtils*[fNumberOfSectors];
+	fFileObserver = new Dos2xUtils*[fNumberOfSectors];
 	unsigned int i;
 	for (i=0;i<fNumberOfSectors;i++) {
 		fDirectoryObserver[i] = 0;
+		fFileObserver[i] = 0;
 	}
+	fBufferedSectorNumber = 0;
 }
 
 VirtualImageObserver::~VirtualImageObserver()
@@ -45,18 +48,19 @@ VirtualImageObserver::~VirtualImageObserver()
 	fRootDirObserver = 0;
 	unsigned int i;
 	for (i=0;i<fNumberOfSectors;i++) {
-		if (fDirectoryObserver[i] != 0) {
+		if (fDirectoryObserver[i] != 0 || fFileObserver[i] != 0) {
 			Assert(false);
 		}
 	}
 	delete[] fDirectoryObserver;
+	delete[] fFileObserver;
 }
 
 void VirtualImageObserver::SetDirectoryObserver(unsigned int dirsec, Dos2xUtils* utils)
 {
 	Assert((dirsec > 0) && (dirsec + 7 <= fNumberOfSectors));
 	unsigned int i;
-	for (i=0;i<7;i++) {
+	for (i=0;i<8;i++) {
 		if (fDirectoryObserver[dirsec+i-1]) {
 			Assert(false);
 		}
@@ -68,7 +72,7 @@ void VirtualImageObserver::RemoveDirectoryObserver(unsigned int dirsec, Dos2xUti
 {
 	Assert((dirsec > 0) && (dirsec + 7 <= fNumberOfSectors));
 	unsigned int i;
-	for (i=0;i<7;i++) {
+	for (i=0;i<8;i++) {
 		if (fDirectoryObserver[dirsec+i-1] != utils) {
 			Assert(false);
 		}
@@ -76,6 +80,26 @@ void VirtualImageObserver::RemoveDirectoryObserver(unsigned int dirsec, Dos2xUti
 	}
 }
 
+void VirtualImageObserver::SetFileObserver(unsigned int sector, Dos2xUtils* utils)
+{
+	if (sector < 1 || sector > fNumberOfSectors) {
+		Assert(false);
+		return;
+	}
+	fFileObserver[sector-1] = utils;
+}
+
+void VirtualImageObserver::RemoveFileObserver(unsigned int sector, Dos2xUtils* utils)
+{
+	if (sector < 1 || sector > fNumberOfSectors) {
+		Assert(false);
+		return;
+	}
+	if (fFileObserver[sector-1] == utils) {
+		fFileObserver[sector-1] = 0;
+	}
+}
+
 void VirtualImageObserver::SetRootDirectoryObserver(RCPtr<Dos2xUtils> root)
 {
 	fRootDirObserver = root;
@@ -86,6 +110,11 @@ RCPtr<const Dos2xUtils> VirtualImageObserver::GetRootDirectoryObserver() const
 	return fRootDirObserver;
 }
 
+RCPtr<Dos2xUtils> VirtualImageObserver::GetRootDirectoryObserver()
+{
+	return fRootDirObserver;
+}
+
 void VirtualImageObserver::IndicateBeforeSectorWrite(unsigned int sector)
 {
 	if (sector < 1 || sector > fNumberOfSectors) {
@@ -98,19 +127,29 @@ void VirtualImageObserver::IndicateBeforeSectorWrite(unsigned int sector)
 	}
 }
 
-void VirtualImageObserver::IndicateAfterSectorWrite(unsigned int sector)
+void VirtualImageObserver::IndicateAfterSectorWrite(unsigned int sector, const uint8_t* data)
 {
 	if (sector < 1 || sector > fNumberOfSectors) {
 		DPRINTF("illegal sector number in IndicateAfterSectorWrite: %d\n", sector);
-	} else {
-       		if (fDirectoryObserver[sector-1]) {
- 			if (sector != fBufferedSectorNumber) {
-				DPRINTF("sector number mismatch in IndicateAfterSectorWrite");
-				return;
+		return;
+	}
+	if (fDirectoryObserver[sector-1]) {
+		if (sector != fBufferedSectorNumber) {
+			DPRINTF("sector number mismatch in IndicateAfterSectorWrite");
+			return;
+		}
+		// only pass on the 16-byte directory entries that changed
+		unsigned int entries = fImage->GetSectorLength() >> 4;
+		if (entries > 8) {
+			entries = 8;
+		}
+		for (unsigned int i = 0; i < entries; i++) {
+			if (memcmp(fOldSectorBuffer + (i << 4), data + (i << 4), 16)) {
+				fDirectoryObserver[sector-1]->IndicateEntryWrite(sector, i,
+					fOldSectorBuffer + (i << 4), data + (i << 4));
 			}
-			fImage->ReadSector(sector, fNewSectorBuffer, fImage->GetSectorLength());
-			fDirectoryObserver[sector-1]->IndicateSectorWrite(sector);
 		}
+	} else if (fFileObserver[sector-1]) {
+		fFileObserver[sector-1]->IndicateFileSectorWrite(sector, data);
 	}
 }
-
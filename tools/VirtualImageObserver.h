@@ -33,24 +33,30 @@ public:
 
 	void SetRootDirectoryObserver(RCPtr<Dos2xUtils> root);
 	RCPtr<const Dos2xUtils> GetRootDirectoryObserver() const;
+	RCPtr<Dos2xUtils> GetRootDirectoryObserver();
 
 	void IndicateBeforeSectorWrite(unsigned int sector);
-	void IndicateAfterSectorWrite(unsigned int sector);
+	// data is the sector as written by the Atari
+	void IndicateAfterSectorWrite(unsigned int sector, const uint8_t* data);
 
 private:
 	friend class Dos2xUtils;
 	void SetDirectoryObserver(unsigned int dirsec, Dos2xUtils* utils);
 	void RemoveDirectoryObserver(unsigned int dirsec, Dos2xUtils* utils);
 
+	// data sectors of files the Atari is currently writing
+	void SetFileObserver(unsigned int sector, Dos2xUtils* utils);
+	void RemoveFileObserver(unsigned int sector, Dos2xUtils* utils);
+
 	AtrImage* fImage;
 
 	RCPtr<Dos2xUtils> fRootDirObserver;
 
 	Dos2xUtils** fDirectoryObserver;
+	Dos2xUtils** fFileObserver;
 	unsigned int fNumberOfSectors;
 
 	uint8_t fOldSectorBuffer[256];
-	uint8_t fNewSectorBuffer[256];
 	unsigned int fBufferedSectorNumber;
 };
 
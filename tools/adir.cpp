@@ -20,65 +20,89 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <unistd.h>
 #include <string.h>
+#include <string>
+#include <vector>
 
 #include "AtrMemoryImage.h"
 #include "SIOTracer.h"
 #include "FileTracer.h"
 #include "Dos2xUtils.h"
+#include "MiscUtils.h"
+#include "MyPicoDosCode.h"
+#include "JobPool.h"
 #include "Version.h"
 
-static void print_single_directory(RCPtr<Dos2xUtils> utils, unsigned int level, unsigned int dirsec)
+
+enum EListMode {
+	eListColumns,
+	eListTree,
+	eListRaw,
+	eListMachine
+};
+
+// images are listed into a string so they can be processed in
+// parallel and still be printed in the order given on the command line
+static void append(std::string& out, const char* format, ...)
 {
-	RCPtr<Dos2xUtils::Dos2Dir> dir = utils->GetDos2Directory(false, dirsec);
+	char buf[256];
+	va_list ap;
+	va_start(ap, format);
+	vsnprintf(buf, sizeof(buf), format, ap);
+	va_end(ap);
+	out += buf;
+}
+
+// the print functions return false if a directory couldn't be read
+static bool print_single_directory(std::string& out, RCPtr<Dos2xUtils> utils, unsigned int level, unsigned int dirsec)
+{
+	RCPtr<Dos2xUtils::Dos2Dir> dir = utils->GetDos2Directory(true, dirsec);
 	if (dir.IsNull()) {
-		printf("error reading directory\n");
-		return;
+		append(out, "error reading directory\n");
+		return false;
 	}
+	bool ok = true;
 	unsigned int i,j;
 	for (i=0;i<dir->GetNumberOfFiles();i++) {
 		for (j=0;j<level;j++) {
-			printf("    ");
+			out += "    ";
 		}
 
-		printf("%s\n", dir->GetFile(i));
+		append(out, "%s\n", dir->GetFile(i));
 		if ((dir->GetFileStatus(i) & 0xdf) == 0x10) {
-			print_single_directory(utils, level+1, dir->GetFileStartingSector(i));
+			if (!print_single_directory(out, utils, level+1, dir->GetFileStartingSector(i))) {
+				ok = false;
+			}
 		}
 	}
+	return ok;
 }
 
-static void print_directory_tree(const RCPtr<AtrImage>& image)
+static bool print_directory_tree(std::string& out, const RCPtr<AtrImage>& image)
 {
-	if (image.IsNull()) {
-		printf("error - disk image is NULL\n");
-		return;
-	}
 	RCPtr<Dos2xUtils> utils = new Dos2xUtils(image);
-	RCPtr<Dos2xUtils::Dos2Dir> dir = utils->GetDos2Directory();
+	RCPtr<Dos2xUtils::Dos2Dir> dir = utils->GetDos2Directory(true);
 	if (dir.IsNull()) {
-		printf("error reading directory\n");
-		return;
+		append(out, "error reading directory\n");
+		return false;
 	}
 
-	print_single_directory(utils, 0, 361);
+	bool ok = print_single_directory(out, utils, 0, 361);
 
-	printf("%d free sectors\n", dir->GetFreeSectors());
+	append(out, "%d free sectors\n", dir->GetFreeSectors());
+	return ok;
 }
 
 
-static void print_directory(const RCPtr<AtrImage>& image, unsigned int columns)
+static bool print_directory(std::string& out, const RCPtr<AtrImage>& image, unsigned int columns)
 {
-	if (image.IsNull()) {
-		printf("error - disk image is NULL\n");
-		return;
-	}
 	RCPtr<Dos2xUtils> utils = new Dos2xUtils(image);
-	RCPtr<Dos2xUtils::Dos2Dir> dir = utils->GetDos2Directory();
+	RCPtr<Dos2xUtils::Dos2Dir> dir = utils->GetDos2Directory(true);
 	if (dir.IsNull()) {
-		printf("error reading directory\n");
-		return;
+		append(out, "error reading directory\n");
+		return false;
 	}
 
 	if (columns < 1) {
@@ -86,42 +110,107 @@ static void print_directory(const RCPtr<AtrImage>& image, unsigned int columns)
 	}
 	unsigned int i;
 	for (i=0;i<dir->GetNumberOfFiles();i++) {
-		printf("%s", dir->GetFile(i));
+		out += dir->GetFile(i);
 		if ( i % columns == (columns - 1)) {
-			printf("\n");
+			out += '\n';
 		}
 	}
 	if (i % columns != 0) {
-		printf("\n");
+		out += '\n';
 	}
-	printf("%d free sectors\n", dir->GetFreeSectors());
+	append(out, "%d free sectors\n", dir->GetFreeSectors());
+	return true;
 }
 
-static void print_raw_directory(const RCPtr<AtrImage>& image)
+// one tab separated line per file: F, image, path, sectors, status, start sector
+static bool print_machine_directory(std::string& out, const char* filename,
+	const RCPtr<Dos2xUtils>& utils, unsigned int dirsec, const std::string& prefix, unsigned int level)
 {
-	if (image.IsNull()) {
-		printf("error - disk image is NULL\n");
-		return;
+	RCPtr<Dos2xUtils::Dos2Dir> dir = utils->GetDos2Directory(true, dirsec);
+	if (dir.IsNull()) {
+		append(out, "E\t%s\terror reading directory\n", filename);
+		return false;
 	}
-	RCPtr<Dos2xUtils> utils = new Dos2xUtils(image);
-	utils->DumpRawDirectory();
+	bool ok = true;
+	for (unsigned int i=0;i<dir->GetNumberOfFiles();i++) {
+		char name[13];
+		Dos2xUtils::BuildDisplayName(dir->GetRawFilename(i), name);
+		std::string path = prefix + name;
+		append(out, "F\t%s\t%s\t%d\t%02x\t%d\n", filename, path.c_str(),
+			dir->GetFileSectorLength(i), dir->GetFileStatus(i), dir->GetFileStartingSector(i));
+		if ((dir->GetFileStatus(i) & 0xdf) == 0x10 && level < 8) {
+			if (!print_machine_directory(out, filename, utils, dir->GetFileStartingSector(i), path + ">", level+1)) {
+				ok = false;
+			}
+		}
+	}
+	if (level == 0) {
+		append(out, "S\t%s\t%d\n", filename, dir->GetFreeSectors());
+	}
+	return ok;
 }
 
-#ifdef ALL_IN_ONE
-int adir_main(int argc, char**argv)
-#else
-int main(int argc, char**argv)
-#endif
+// returns false if the image or one of its directories couldn't be read
+static bool list_image(std::string& out, const char* filename, EListMode mode,
+	unsigned int columns, bool beQuiet)
 {
-	int columns=4;
-	char* filename;
-	RCPtr<AtrMemoryImage> image;
-	int idx=1;
-	bool dumpraw = false;
-	bool dumptree = false;
+	// only the boot, VTOC and directory sectors are read from the file
+	RCPtr<AtrMemoryImage> image = new AtrMemoryImage;
+	image->SetLazyLoading(true);
 
+	if (!image->ReadImageFromFile(filename, beQuiet)) {
+		if (mode == eListMachine) {
+			append(out, "E\t%s\treading image failed\n", filename);
+		} else {
+			append(out, "reading image '%s' failed\n", filename);
+		}
+		return false;
+	}
+	if (mode == eListMachine) {
+		RCPtr<Dos2xUtils> utils = new Dos2xUtils(image);
+		return print_machine_directory(out, filename, utils, 361, "", 0);
+	}
+	bool ok = true;
+	append(out, "\ndirectory of image '%s'\n\n", filename);
+	switch (mode) {
+	case eListRaw:
+		{
+			// the raw dump is printed through the tracer, raw mode
+			// is always run sequentially so flushing here keeps the order
+			fputs(out.c_str(), stdout);
+			fflush(stdout);
+			out.clear();
+			RCPtr<Dos2xUtils> utils = new Dos2xUtils(image);
+			utils->DumpRawDirectory();
+		}
+		break;
+	case eListTree:
+		ok = print_directory_tree(out, image);
+		break;
+	default:
+		ok = print_directory(out, image, columns);
+		break;
+	}
+	return ok;
+}
+
+struct ListArgs {
+	char** fFiles;
+	EListMode fMode;
+	unsigned int fColumns;
+};
+
+static int list_job(unsigned int idx, JobOutput& out, void* arg)
+{
+	ListArgs* args = (ListArgs*) arg;
+	return list_image(out.fText, args->fFiles[idx], args->fMode, args->fColumns, true) ? 0 : 1;
+}
+
+static void set_tracing(bool on)
+{
 	SIOTracer* sioTracer = SIOTracer::GetInstance();
-	{
+	sioTracer->RemoveAllTracers();
+	if (on) {
 		RCPtr<FileTracer> tracer(new FileTracer(stderr));
 		RCPtr<FileTracer> tracer_stdout(new FileTracer(stdout));
 		sioTracer->AddTracer(tracer);
@@ -131,7 +220,20 @@ int main(int argc, char**argv)
 		sioTracer->SetTraceGroup(SIOTracer::eTraceError, true, tracer);
 		sioTracer->SetTraceGroup(SIOTracer::eTraceDebug, true, tracer);
 	}
+}
 
+#ifdef ALL_IN_ONE
+int adir_main(int argc, char**argv)
+#else
+int main(int argc, char**argv)
+#endif
+{
+	int columns=4;
+	int idx=1;
+	EListMode mode = eListColumns;
+	int numThreads = 0;
+
+	set_tracing(true);
 
 	if (argc < 2) {
 		goto usage;
@@ -140,10 +242,23 @@ int main(int argc, char**argv)
 	for (idx = 1; idx < argc && argv[idx][0] == '-'; idx++) {
 		switch (argv[idx][1]) {
 		case 'r':
-			dumpraw = true;
+			mode = eListRaw;
 			break;
 		case 't':
-			dumptree = true;
+			mode = eListTree;
+			break;
+		case 'm':
+			mode = eListMachine;
+			break;
+		case 'j':
+			if (idx + 1 >= argc) {
+				goto usage;
+			}
+			numThreads = atoi(argv[++idx]);
+			if (numThreads < 1 || numThreads > 64) {
+				printf("illegal number of threads\n");
+				goto usage;
+			}
 			break;
 		case '1':
 		case '2':
@@ -166,23 +281,38 @@ int main(int argc, char**argv)
 		}
 	}
 
-	image = new AtrMemoryImage;
-	while (idx < argc) {
-		filename = argv[idx];
-		if (!image->ReadImageFromFile(filename)) {
-			printf("reading image '%s' failed\n",filename);
-		} else {
-			printf("\ndirectory of image '%s'\n\n",filename);
-			if (dumpraw) {
-				print_raw_directory(image);
-			} else {
-				if (dumptree) {
-					print_directory_tree(image);
-				} else {
-					print_directory(image, columns);
+	numThreads = JobPool::GetNumberOfThreads(numThreads, argc - idx);
+	// the raw dump goes through the tracer and can't be buffered
+	if (mode != eListRaw && numThreads > 1) {
+		// the tracer isn't thread safe. Workers run quiet and failed
+		// images are listed again with all messages enabled afterwards.
+		// Initialize the shared boot code used for COM files up front.
+		MyPicoDosCode::GetInstance();
+		ListArgs args;
+		args.fFiles = argv + idx;
+		args.fMode = mode;
+		args.fColumns = columns;
+		std::vector<int> results;
+		JobPool pool(list_job, &args);
+		set_tracing(false);
+		bool done = pool.Run(argc - idx, numThreads, results);
+		set_tracing(true);
+		if (done) {
+			for (unsigned int i = 0; i < results.size(); i++) {
+				if (results[i]) {
+					std::string out;
+					list_image(out, argv[idx + i], mode, columns, false);
+					fputs(out.c_str(), stdout);
 				}
 			}
+			idx = argc;
 		}
+	}
+
+	while (idx < argc) {
+		std::string out;
+		list_image(out, argv[idx], mode, columns, false);
+		fputs(out.c_str(), stdout);
 		idx++;
 	}
 
@@ -191,7 +321,7 @@ int main(int argc, char**argv)
 usage:
 	printf("adir %s\n", VERSION_STRING);
 	printf("(c) 2003-2020 Matthias Reichl <hias@horus.com>\n");
-	printf("usage: adir [-<columns>] [-r] [-t] filename...\n");
+	printf("usage: adir [-<columns>] [-r] [-t] [-m] [-j threads] filename...\n");
 	SIOTracer::GetInstance()->RemoveAllTracers();
 	return 1;
 }
@@ -23,15 +23,18 @@
 #include "CursesFrontendTracer.h"
 #include "SIOTracer.h"
 #include "FileTracer.h"
+#include "AsyncTracer.h"
 #include "History.h"
 #include "Error.h"
 #include "AtariDebug.h"
 #include "MiscUtils.h"
 #include "Version.h"
 #include "RemoteControlHandler.h"
+#include "ControlSocket.h"
 
 #include <iostream>
 #include <signal.h>
+#include <sched.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -79,6 +82,7 @@ static void process_args(RCPtr<DeviceManager>& manager, CursesFrontend* frontend
 
 	int drive = 1;
 	bool autoSectors;
+	bool calibrate = false;
 
 	for (int i=1;i<argc;i++) {
 		if (argv[i]) {
@@ -199,6 +203,12 @@ static void process_args(RCPtr<DeviceManager>& manager, CursesFrontend* frontend
 				case 'p':
 					write_protect_next = true;
 					break;
+				case 'b':
+					if (len != 2) {
+						goto illegal_option;
+					}
+					manager->SetPrinterQueueFullPolicy(PrinterHandler::eBusyWhenFull);
+					break;
 				case 'P':
 					i++;
 					if (i + 1 < argc) {
@@ -312,6 +322,20 @@ illegal_v:
 				case 'Q':
 					frontend->SetAskBeforeQuit(true);
 					break;
+				case 'A':
+					if (len != 2) {
+						goto illegal_option;
+					}
+					calibrate = true;
+					break;
+				case 'L':
+					i++;
+					if (i < argc) {
+						manager->OpenImageLibrary(argv[i]);
+					} else {
+						AERROR("invalid usage of -L");
+					}
+					break;
 				default:
 illegal_option:
 					AERROR("illegal option \"%s\"", argv[i]);
@@ -350,6 +374,10 @@ illegal_option:
 			}
 		}
 	}
+	// after -s and -S so the calibration starts from the final settings
+	if (calibrate) {
+		manager->StartSpeedCalibration();
+	}
 }
 
 static void SetDefaultTraceLevels(const RCPtr<AbstractTracer>& tracer)
@@ -372,8 +400,11 @@ void usage()
 	printf("-F            disable non-standard disk formats\n");
 	printf("-m            monochrome mode\n");
 	printf("-o file       save trace output to <file>\n");
+	printf("-R cpu        pin SIO thread to <cpu> and use SCHED_FIFO scheduling\n");
+	printf("-U socket     accept remote control commands on UNIX socket <socket>\n");
 	printf("-s mode       high speed mode: 0 = off, 1 = on (default)\n");
 	printf("-S div[,baud] high speed SIO pokey divisor (default 8) and optionally baudrate\n");
+	printf("-A            calibrate the high speed pokey divisor of the adapter\n");
 	printf("-T timing     SIO timing: s = strict, r = relaxed\n");
 	printf("-X            enable XF551 commands\n");
 	printf("-t            increase SIO trace level (default:0, max:3)\n");
@@ -381,7 +412,12 @@ void usage()
 	printf("-P mode file  install printer handler\n");
 	printf("              mode sets EOL conversion: r=raw/none, l=LF, c=CR, b=CR+LF\n");
 	printf("              path is either a filename or |print-command, eg |lpr\n");
+	printf("              filenames ending in .pdf or .png render the printout,\n");
+	printf("              eg print.pdf creates print-0001.pdf, print-0002.pdf, ...\n");
+	printf("-b            NAK printer writes while the print command is busy\n");
+	printf("              (default: wait for the print command)\n");
 	printf("-Q            ask before quitting atariserver\n");
+	printf("-L file       use image library index <file> created by atrindex\n");
 	printf("-p            write protect the next image\n");
 	printf("-1..-8        set drive number for next image / virtual drive\n"); 
 	printf("-V dens dir   create virtual drive of given density, the second parameter\n");
@@ -425,9 +461,11 @@ int main(int argc, char** argv)
 	bool wantHelp = false;
 	bool useColor = true;
 	const char* traceFile = 0;
+	int realtimeCpu = -1;
+	const char* controlSocketPath = 0;
 	struct sigaction sigact;
 
-	// scan argv for "-h", "-m", -"o file"
+	// scan argv for "-h", "-m", -"o file", "-R cpu", "-U socket"
 	{
 		for (int i=1; i<argc; i++) {
 			if ( argv[i] && (argv[i][0] == '-') && (argv[i][1] != 0) && (argv[i][2] == 0) ) {
@@ -453,6 +491,29 @@ int main(int argc, char** argv)
 						i++;
 					}
 					break;
+				case 'R':
+					if (i+1 < argc) {
+						char* end;
+						long cpu = strtol(argv[i+1], &end, 10);
+						if (end == argv[i+1] || *end || cpu < 0 || cpu >= CPU_SETSIZE) {
+							printf("invalid CPU \"%s\" for -R, must be 0..%d\n",
+								argv[i+1], CPU_SETSIZE - 1);
+							return 1;
+						}
+						realtimeCpu = cpu;
+						argv[i] = 0;
+						argv[i+1] = 0;
+						i++;
+					}
+					break;
+				case 'U':
+					if (i+1 < argc) {
+						controlSocketPath = argv[i+1];
+						argv[i] = 0;
+						argv[i+1] = 0;
+						i++;
+					}
+					break;
 				default:
 					break;
 				}
@@ -480,19 +541,6 @@ int main(int argc, char** argv)
 		sioTracer->AddTracer(cursesTracer);
 		SetDefaultTraceLevels(cursesTracer);
 		sioTracer->SetTraceGroup(SIOTracer::eTraceImageStatus, true, cursesTracer);
-
-		if (traceFile) {
-			RCPtr<FileTracer> tracer;
-			try {
-				tracer = new FileTracer(traceFile);
-				sioTracer->AddTracer(tracer);
-				SetDefaultTraceLevels(tracer);
-				sioTracer->SetTraceGroup(SIOTracer::eTraceDebug, true, tracer);
-			}
-			catch (ErrorObject& err) {
-				AERROR("%s", err.AsCString());
-			}
-		}
 	}
 	frontend->ShowCursor(false);
 
@@ -509,7 +557,7 @@ int main(int argc, char** argv)
 	sigaction(SIGPIPE, &sigact, NULL);
 	sigaction(SIGCHLD, &sigact, NULL);
 
-	if (MiscUtils:: set_realtime_scheduling(0)) {
+	if (MiscUtils:: set_realtime_scheduling(0, realtimeCpu, realtimeCpu >= 0, realtimeCpu >= 0)) {
 #if 0
 #ifdef ATARISIO_DEBUG
 		ALOG("the server will automatically terminate in 5 minutes!");
@@ -521,6 +569,22 @@ int main(int argc, char** argv)
 #endif
 	}
 
+	// the tracer thread is started after pinning the SIO thread so it
+	// runs on the remaining CPUs and its buffers are locked, too
+	if (traceFile) {
+		RCPtr<AbstractTracer> tracer;
+		try {
+			// keep file I/O off the SIO thread
+			tracer = new AsyncTracer(new FileTracer(traceFile));
+			sioTracer->AddTracer(tracer);
+			SetDefaultTraceLevels(tracer);
+			sioTracer->SetTraceGroup(SIOTracer::eTraceDebug, true, tracer);
+		}
+		catch (ErrorObject& err) {
+			AERROR("%s", err.AsCString());
+		}
+	}
+
 	process_args(manager, frontend, argc, argv);
 
 	RCPtr<RemoteControlHandler> remoteControl = new RemoteControlHandler(manager.GetRealPointer(), frontend);
@@ -528,6 +592,19 @@ int main(int argc, char** argv)
 		DPRINTF("registering remote control handler failed");
 	}
 
+	RCPtr<ControlSocket> controlSocket;
+	if (controlSocketPath) {
+		try {
+			controlSocket = new ControlSocket(manager.GetRealPointer(), frontend, controlSocketPath);
+			if (!manager->AddPollHandler(controlSocket)) {
+				AERROR("cannot poll control socket");
+			}
+		}
+		catch (ErrorObject& err) {
+			AERROR("%s", err.AsCString());
+		}
+	}
+
 	frontend->DisplayDriveStatus();
 	frontend->DisplayPrinterStatus();
 	frontend->UpdateScreen();
@@ -635,6 +712,10 @@ int main(int argc, char** argv)
 
 	} while (running);
 
+	if (controlSocket.IsNotNull()) {
+		manager->RemovePollHandler(controlSocket);
+		controlSocket = 0;
+	}
 	sioTracer->RemoveAllTracers();
 	{
 		CursesFrontend* fe = frontend;
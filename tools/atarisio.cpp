@@ -32,6 +32,7 @@ extern int atarixfer_main(int argc, char** argv);
 extern int adir_main(int argc, char** argv);
 extern int dir2atr_main(int argc, char** argv);
 extern int ataricom_main(int argc, char** argv);
+extern int atrindex_main(int argc, char** argv);
 
 #ifdef ENABLE_ATP
 extern int atpdump_main(int argc, char** argv);
@@ -59,6 +60,9 @@ static main_type find_main(char* name, bool& drop_root)
 	if (strcmp(name,"ataricom") == 0) {
 		return ataricom_main;
 	}
+	if (strcmp(name,"atrindex") == 0) {
+		return atrindex_main;
+	}
 #ifdef ENABLE_ATP
 	if (strcmp(name,"atpdump") == 0) {
 		return atpdump_main;
@@ -105,7 +109,7 @@ int main(int argc, char** argv)
 usage:
 	printf("AtariSIO %s all-in-one package\n", VERSION_STRING);
 	printf("(c) 2005-2014 Matthias Reichl <hias@horus.com>\n");
-	printf("usage: atarisio atariserver|atarixfer|adir|dir2atr|ataricom");
+	printf("usage: atarisio atariserver|atarixfer|adir|dir2atr|ataricom|atrindex");
 #ifdef ENABLE_ATP
 	printf("|atpdump|atr2atp");
 #endif
@@ -37,6 +37,7 @@
 #include "FileTracer.h"
 #include "Error.h"
 #include "MiscUtils.h"
+#include "SpeedProfile.h"
 
 #include "Version.h"
 
@@ -57,6 +58,9 @@ static bool usdoubler_format_detection = false;
 
 static bool continue_on_errors = false;
 
+static bool have_speed_profile = false;
+static SpeedProfile::Profile speed_profile;
+
 /*
 static void my_sig_handler(int sig)
 {
@@ -506,6 +510,23 @@ static bool set_and_check_highspeed_baudrate(unsigned int baud)
 	}
 }
 
+// check against the profile atariserver -A calibrated for the adapter
+static bool check_speed_profile(unsigned int pokey_div, unsigned int& baud)
+{
+	if (!have_speed_profile) {
+		return true;
+	}
+	if (pokey_div < speed_profile.fPokeyDivisor) {
+		printf("pokey divisor %d is faster than the calibrated divisor %d of the adapter\n",
+			pokey_div, speed_profile.fPokeyDivisor);
+		return false;
+	}
+	if (pokey_div == speed_profile.fPokeyDivisor) {
+		baud = speed_profile.fBaudrate;
+	}
+	return true;
+}
+
 static bool check_ultraspeed()
 {
 	unsigned int baud;
@@ -530,6 +551,9 @@ static bool check_ultraspeed()
 			printf("unsupported ultra speed pokey divisor %d\n", pokey_div);
 			return false;
 		}
+		if (!check_speed_profile(pokey_div, baud)) {
+			return false;
+		}
 		printf("detected ultra speed drive: pokey divisor %d (%d baud)\n", pokey_div, baud);
 		if (pokey_div == ATARISIO_POKEY_DIVISOR_HAPPY) {
 			printf("possibly Happy 1050: enabling fast writes\n");
@@ -559,6 +583,9 @@ static bool check_happy_1050()
 		printf("Happy warp speed baudrate is not supported in driver\n");
 		return false;
 	}
+	if (!check_speed_profile(ATARISIO_POKEY_DIVISOR_2XSIO_XF551, baud)) {
+		return false;
+	}
 	if (SIO->ImmediateCommand(drive_no, 0x48, 0x20, 0, 1) == 0) {
 		printf("detected Happy Warp Speed drive\n");
 		if (set_and_check_highspeed_baudrate(baud)) {
@@ -586,6 +613,9 @@ static bool check_turbo_1050()
 		printf("1050 Turbo speed baudrate is not supported in driver\n");
 		return false;
 	}
+	if (!check_speed_profile(ATARISIO_POKEY_DIVISOR_1050_TURBO, baud)) {
+		return false;
+	}
 	if (check_high_status(baud, ATARISIO_EXTSIO_SPEED_TURBO)) {
 		printf("detected 1050 Turbo\n");
 		if (set_and_check_highspeed_baudrate(baud)) {
@@ -603,6 +633,9 @@ static bool check_xf551()
 		printf("XF551 speed baudrate is not supported in driver\n");
 		return false;
 	}
+	if (!check_speed_profile(ATARISIO_POKEY_DIVISOR_2XSIO_XF551, baud)) {
+		return false;
+	}
 	if (check_high_status(baud, ATARISIO_EXTSIO_SPEED_XF551)) {
 		printf("detected XF551\n");
 		if (!xf551_format_detection) {
@@ -782,6 +815,8 @@ int main(int argc, char** argv)
 			std::cerr << err.AsString() << std::endl;
 			exit (1);
 		}
+		have_speed_profile = SpeedProfile::Load(
+			SpeedProfile::GetAdapterName(atarisioDevName), speed_profile);
         	if (MiscUtils:: set_realtime_scheduling(0)) {
 /*
 #ifdef ATARISIO_DEBUG
@@ -18,11 +18,191 @@
    Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <limits.h>
+#include <string>
+#include <vector>
+
 #include "AtrMemoryImage.h"
 #include "AtpImage.h"
 #include "AtpUtils.h"
 #include "SIOTracer.h"
 #include "FileTracer.h"
+#include "Crc32.h"
+#include "JobPool.h"
+
+struct ConvertJob {
+	std::string fInFile;
+	std::string fOutFile;
+};
+
+static int convert_image(const ConvertJob& job, JobOutput& out)
+{
+	RCPtr<AtrMemoryImage> atrImage(new AtrMemoryImage);
+
+	if (!atrImage->ReadImageFromFile(job.fInFile.c_str())) {
+		out.Printf("reading input file \"%s\" failed\n", job.fInFile.c_str());
+		return 1;
+	}
+
+	RCPtr<AtpImage> atpImage = AtpUtils::CreateAtpImageFromAtrImage(atrImage);
+
+	if (!atpImage) {
+		out.Printf("can not convert disk image \"%s\" into ATP format\n", job.fInFile.c_str());
+		return 1;
+	} 
+
+	if (!atpImage->WriteImageToFile(job.fOutFile.c_str())) {
+		out.Printf("error writing ATP image to \"%s\"\n", job.fOutFile.c_str());
+		return 1;
+	}
+	out.Printf("successfully wrote ATP image \"%s\"\n", job.fOutFile.c_str());
+	return 0;
+}
+
+// in-file with the extension (and .gz) replaced by .atp, in outdir
+// if given
+static std::string default_out_file(const std::string& infile, const char* outdir)
+{
+	std::string name(infile);
+	if (outdir) {
+		std::string::size_type slash = name.rfind('/');
+		if (slash != std::string::npos) {
+			name = name.substr(slash + 1);
+		}
+	}
+	if (name.size() > 3 && strcasecmp(name.c_str() + name.size() - 3, ".gz") == 0) {
+		name.resize(name.size() - 3);
+	}
+	std::string::size_type dot = name.rfind('.');
+	std::string::size_type slash = name.rfind('/');
+	if (dot != std::string::npos && (slash == std::string::npos || dot > slash)) {
+		name.resize(dot);
+	}
+	name += ".atp";
+	if (outdir) {
+		std::string dir(outdir);
+		if (!dir.empty() && dir[dir.size() - 1] != '/') {
+			dir += '/';
+		}
+		name = dir + name;
+	}
+	return name;
+}
+
+// one image per line: in-file and optional out-file, separated by a
+// tab. Lines without a tab are a single file name, so names may
+// contain blanks.
+static bool read_job_list(const char* listfile, const char* outdir, std::vector<ConvertJob>& jobs)
+{
+	FILE* f;
+	if (strcmp(listfile, "-") == 0) {
+		f = stdin;
+	} else {
+		f = fopen(listfile, "r");
+	}
+	if (!f) {
+		printf("error: cannot open file list \"%s\"\n", listfile);
+		return false;
+	}
+	char line[2 * PATH_MAX + 16];
+	while (fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "\r\n")] = 0;
+		if (!line[0] || line[0] == '#') {
+			continue;
+		}
+		ConvertJob job;
+		char* tab = strchr(line, '\t');
+		if (tab) {
+			*tab = 0;
+			job.fOutFile = tab + 1;
+		}
+		job.fInFile = line;
+		if (job.fOutFile.empty()) {
+			job.fOutFile = default_out_file(job.fInFile, outdir);
+		}
+		jobs.push_back(job);
+	}
+	if (f != stdin) {
+		fclose(f);
+	}
+	return true;
+}
+
+static int convert_job(unsigned int idx, JobOutput& out, void* arg)
+{
+	const std::vector<ConvertJob>* jobs = (const std::vector<ConvertJob>*) arg;
+	return convert_image((*jobs)[idx], out);
+}
+
+static void set_tracing(bool on)
+{
+	SIOTracer* sioTracer = SIOTracer::GetInstance();
+	sioTracer->SetTraceGroup(SIOTracer::eTraceInfo, on);
+	sioTracer->SetTraceGroup(SIOTracer::eTraceDebug, on);
+}
+
+static int run_jobs(const char* listfile, const char* outdir, int numThreads)
+{
+	std::vector<ConvertJob> jobs;
+	if (!read_job_list(listfile, outdir, jobs)) {
+		return 1;
+	}
+
+	std::vector<int> results;
+	bool done = false;
+
+	numThreads = JobPool::GetNumberOfThreads(numThreads, jobs.size());
+	if (numThreads > 1) {
+		// the tracer isn't thread safe. Workers run quiet and failed
+		// jobs are repeated with all messages enabled afterwards.
+		// Initialize the shared tables up front.
+		AtpUtils::InitTrackTemplates();
+		CRC32::CalcCRC32(0, 0, 0);
+		JobPool pool(convert_job, &jobs);
+		set_tracing(false);
+		done = pool.Run(jobs.size(), numThreads, results);
+		set_tracing(true);
+	}
+
+	unsigned int failed = 0;
+	for (unsigned int i = 0; i < jobs.size(); i++) {
+		if (!done) {
+			JobOutput out(false);
+			if (convert_image(jobs[i], out)) {
+				failed++;
+			}
+		} else if (results[i]) {
+			printf("repeating failed conversion of \"%s\"\n", jobs[i].fInFile.c_str());
+			JobOutput out(false);
+			if (convert_image(jobs[i], out)) {
+				failed++;
+			}
+		}
+	}
+	if (failed) {
+		printf("error: %d of %d conversions failed\n", failed, (int) jobs.size());
+		return 1;
+	}
+	printf("converted %d images\n", (int) jobs.size());
+	return 0;
+}
+
+static void usage()
+{
+	printf("usage: atr2atp in-file out-file\n");
+	printf("       atr2atp [-j threads] [-o dir] -J listfile\n");
+	printf("  -J <FILE> convert all images listed in <FILE> (\"-\" reads from stdin),\n");
+	printf("            one line per image with in-file and optionally a tab\n");
+	printf("            and out-file. Default out-file is in-file with extension .atp\n");
+	printf("  -o <DIR>  create default out-files in <DIR>\n");
+	printf("  -j <NUM>  number of images to convert in parallel with -J\n");
+}
 
 #ifdef ALL_IN_ONE
 int atr2atp_main(int argc, char** argv)
@@ -30,12 +210,39 @@ int atr2atp_main(int argc, char** argv)
 int main(int argc, char** argv)
 #endif
 {
-	if (argc != 3) {
-		printf("usage: atr2atp in-file out-file\n");
+	const char* listfile = 0;
+	const char* outdir = 0;
+	int numThreads = 0;
+	int c;
+	int ret;
+
+	optind = 1;
+	while ((c = getopt(argc, argv, "J:j:o:")) != -1) {
+		switch (c) {
+		case 'J':
+			listfile = optarg;
+			break;
+		case 'j':
+			numThreads = atoi(optarg);
+			if (numThreads < 1) {
+				numThreads = 1;
+			}
+			break;
+		case 'o':
+			outdir = optarg;
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+
+	if (listfile ? (optind != argc) : (optind + 2 != argc || outdir)) {
+		usage();
 		return 1;
 	}
 
-        SIOTracer* sioTracer = SIOTracer::GetInstance();
+	SIOTracer* sioTracer = SIOTracer::GetInstance();
 	{
 		RCPtr<FileTracer> tracer(new FileTracer(stderr));
 		sioTracer->AddTracer(tracer);
@@ -43,29 +250,17 @@ int main(int argc, char** argv)
 		sioTracer->SetTraceGroup(SIOTracer::eTraceDebug, true, tracer);
 	}
 
-	RCPtr<AtrMemoryImage> atrImage(new AtrMemoryImage);
-
-	if (!atrImage->ReadImageFromFile(argv[1])) {
-		printf("reading input file \"%s\" failed\n", argv[1]);
-		sioTracer->RemoveAllTracers();
-		return 1;
-	}
-
-	RCPtr<AtpImage> atpImage = AtpUtils::CreateAtpImageFromAtrImage(atrImage);
-
-	if (!atpImage) {
-		printf("can not convert disk image into ATP format\n");
-		sioTracer->RemoveAllTracers();
-		return 1;
-	} 
-
-	if (!atpImage->WriteImageToFile(argv[2])) {
-		printf("error writing ATP image to \"%s\"\n", argv[2]);
-		sioTracer->RemoveAllTracers();
-		return 1;
+	if (listfile) {
+		ret = run_jobs(listfile, outdir, numThreads);
+	} else {
+		ConvertJob job;
+		job.fInFile = argv[optind];
+		job.fOutFile = argv[optind + 1];
+		JobOutput out(false);
+		ret = convert_image(job, out);
 	}
-	printf("successfully wrote ATP image \"%s\"\n", argv[2]);
 
 	sioTracer->RemoveAllTracers();
-	return 0;
+	return ret;
+
 }
@@ -0,0 +1,155 @@
+/*
+   atrindex - build and query an index of the files in disk images
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "ImageLibrary.h"
+#include "SIOTracer.h"
+#include "FileTracer.h"
+#include "MiscUtils.h"
+#include "Version.h"
+
+static void print_matches(const std::vector<ImageLibrary::Match>& matches)
+{
+	for (unsigned int i = 0; i < matches.size(); i++) {
+		const ImageLibrary::Match& m = matches[i];
+		printf("%-16s %6d %08x  %s\n", m.fFilePath, m.fLength, m.fCrc, m.fImagePath);
+	}
+}
+
+static void usage()
+{
+	printf("atrindex %s\n", VERSION_STRING);
+	printf("(c) 2026 Matthias Reichl <hias@horus.com>\n");
+	printf("usage: atrindex [options] -u directory...\n");
+	printf("       atrindex [options] name...\n");
+	printf("       atrindex [options] -c file...\n");
+	printf("options:\n");
+	printf("  -f file   index file (default: %s)\n", ATRINDEX_DEFAULT_FILE);
+	printf("  -u        scan the directories and update the index\n");
+	printf("  -c        find copies of the given host files\n");
+	printf("  -v        verbose output\n");
+	printf("names are matched case-insensitive against the beginning of\n");
+	printf("the Atari filenames, eg \"pac\" finds PACMAN.COM\n");
+}
+
+#ifdef ALL_IN_ONE
+int atrindex_main(int argc, char** argv)
+#else
+int main(int argc, char** argv)
+#endif
+{
+	const char* indexfile = ATRINDEX_DEFAULT_FILE;
+	bool update = false;
+	bool findCopies = false;
+	bool verbose = false;
+	int c;
+
+	SIOTracer* sioTracer = SIOTracer::GetInstance();
+	{
+		RCPtr<FileTracer> tracer(new FileTracer(stderr));
+		sioTracer->AddTracer(tracer);
+		sioTracer->SetTraceGroup(SIOTracer::eTraceInfo, true, tracer);
+		sioTracer->SetTraceGroup(SIOTracer::eTraceWarning, true, tracer);
+		sioTracer->SetTraceGroup(SIOTracer::eTraceError, true, tracer);
+	}
+
+	while ((c = getopt(argc, argv, "f:ucvh")) != -1) {
+		switch (c) {
+		case 'f':
+			indexfile = optarg;
+			break;
+		case 'u':
+			update = true;
+			break;
+		case 'c':
+			findCopies = true;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		default:
+			usage();
+			SIOTracer::GetInstance()->RemoveAllTracers();
+			return 1;
+		}
+	}
+	if (optind >= argc || (update && findCopies)) {
+		usage();
+		SIOTracer::GetInstance()->RemoveAllTracers();
+		return 1;
+	}
+
+	int ret = 0;
+	RCPtr<ImageLibrary> library = new ImageLibrary;
+	bool haveIndex = library->Open(indexfile);
+
+	if (update) {
+		std::vector<std::string> directories;
+		for (int i = optind; i < argc; i++) {
+			directories.push_back(argv[i]);
+		}
+		MiscUtils::TimestampType start = MiscUtils::GetCurrentTime();
+		if (library->Update(indexfile, directories, verbose)) {
+			printf("indexed %d files in %d images (%.1f s)\n",
+				library->GetNumberOfFiles(), library->GetNumberOfImages(),
+				(MiscUtils::GetCurrentTime() - start) / 1000000.0);
+		} else {
+			ret = 1;
+		}
+	} else if (!haveIndex) {
+		printf("cannot open index file \"%s\"\n", indexfile);
+		ret = 1;
+	} else {
+		std::vector<ImageLibrary::Match> matches;
+		for (int i = optind; i < argc; i++) {
+			if (findCopies) {
+				uint32_t crc;
+				unsigned int length;
+				if (!ImageLibrary::CalculateFileCrc(argv[i], crc, length)) {
+					printf("cannot read \"%s\"\n", argv[i]);
+					ret = 1;
+					continue;
+				}
+				library->FindByCrc(crc, matches);
+				// CRC32 collisions are possible, the length weeds out most
+				for (unsigned int j = matches.size(); j > 0; j--) {
+					if (matches[j-1].fLength != length) {
+						matches.erase(matches.begin() + j - 1);
+					}
+				}
+			} else {
+				library->FindByName(argv[i], matches);
+			}
+			if (matches.empty()) {
+				printf("%s: not found\n", argv[i]);
+				ret = 1;
+			} else {
+				print_matches(matches);
+			}
+		}
+	}
+
+	SIOTracer::GetInstance()->RemoveAllTracers();
+	return ret;
+}
@@ -23,6 +23,8 @@
 #include <unistd.h>
 #include <string.h>
 #include <getopt.h>
+#include <string>
+#include <vector>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -32,6 +34,10 @@
 #include "FileTracer.h"
 #include "Dos2xUtils.h"
 #include "VirtualImageObserver.h"
+#include "ImageManifest.h"
+#include "MyPicoDosCode.h"
+#include "Crc32.h"
+#include "JobPool.h"
 #include "Version.h"
 
 struct BootEntry {
@@ -100,172 +106,282 @@ BOOT_ENTRY_A(MyPicoDos406S1)
 
 #undef BOOT_ENTRY
 
-#ifdef ALL_IN_ONE
-int dir2atr_main(int argc, char**argv)
-#else
-int main(int argc, char**argv)
-#endif
-{
-	RCPtr<AtrMemoryImage> image;
-	RCPtr<Dos2xUtils> dos2xutils;
-	RCPtr<VirtualImageObserver> observer;
-
-	SIOTracer* sioTracer = SIOTracer::GetInstance();
-	{
-		RCPtr<FileTracer> tracer(new FileTracer(stderr));
-		sioTracer->AddTracer(tracer);
-		sioTracer->SetTraceGroup(SIOTracer::eTraceInfo, true, tracer);
-		sioTracer->SetTraceGroup(SIOTracer::eTraceWarning, true, tracer);
-		sioTracer->SetTraceGroup(SIOTracer::eTraceError, true, tracer);
-		sioTracer->SetTraceGroup(SIOTracer::eTraceDebug, true, tracer);
-	}
-
+struct ImageJob {
+	ImageJob()
+		: fDoubleDensity(false),
+		  fMyDos(false),
+		  fAutorun(false),
+		  fPicoNameType(Dos2xUtils::eNoPicoName),
+		  fSectors(0),
+		  fBootEntry(0),
+		  fBootType(Dos2xUtils::eBootDefault),
+		  fUserDefBoot(false)
+	{ }
+
+	bool fDoubleDensity;
+	bool fMyDos;
+	bool fAutorun;
+	Dos2xUtils::EPicoNameType fPicoNameType;
+	int fSectors;
+	const BootEntry* fBootEntry;
+	Dos2xUtils::EBootType fBootType;
+	bool fUserDefBoot;
+	unsigned char fUserDefBootData[384];
+	std::string fAtrFilename;
+	std::string fDirectory;
+	std::string fManifestFile;
+};
 
-	bool dd = false;
-	bool mydos = false;
-	bool autorun = false;
-	Dos2xUtils::EPicoNameType piconametype = Dos2xUtils::eNoPicoName;
-	int sectors = 0;
-	char* directory;
-	char* atrfilename;
-	ESectorLength seclen;
+// parse the options of a job. jobfile and numThreads are only set
+// when parsing the dir2atr command line, jobs don't support bulk mode
+static bool parse_options(int argc, char** argv, ImageJob& job, JobOutput& out,
+	const char** jobfile = 0, int* numThreads = 0)
+{
 	unsigned int idx;
 	FILE* bootfile;
-
-	struct stat statbuf;
-
-	Dos2xUtils::EBootType bootType = Dos2xUtils::eBootDefault;
-	bool userDefBoot = false;
-	unsigned char userDefBootData[384];
-
-	int ret = 0;
-
 	int c;
-	while ( (c = getopt(argc, argv, "admpPb:B:SEDQ")) != -1) {
+
+	optind = 1;
+	while ( (c = getopt(argc, argv, jobfile ? "admpPb:B:SEDQi:J:j:" : "admpPb:B:SEDQi:")) != -1) {
 		switch(c) {
-		case 'a': autorun = true; break;
-		case 'd': dd = true; printf("using double density sectors\n"); break;
-		case 'm': mydos = true; printf("using mydos format\n"); break;
-		case 'p': piconametype = Dos2xUtils::ePicoName; printf("creating PICONAME.TXT\n"); break;
-		case 'P': piconametype = Dos2xUtils::ePicoNameWithoutExtension; printf("creating PICONAME.TXT (without file extensions)\n"); break;
+		case 'a': job.fAutorun = true; break;
+		case 'd': job.fDoubleDensity = true; out.Printf("using double density sectors\n"); break;
+		case 'm': job.fMyDos = true; out.Printf("using mydos format\n"); break;
+		case 'p': job.fPicoNameType = Dos2xUtils::ePicoName; out.Printf("creating PICONAME.TXT\n"); break;
+		case 'P': job.fPicoNameType = Dos2xUtils::ePicoNameWithoutExtension; out.Printf("creating PICONAME.TXT (without file extensions)\n"); break;
 		case 'b':
 			idx = 0;
 			while (BootTypeTable[idx].name && strcasecmp(optarg, BootTypeTable[idx].name)) {
 				idx++;
 			}
 			if (BootTypeTable[idx].name) {
-				bootType = BootTypeTable[idx].bootType;
+				job.fBootEntry = &BootTypeTable[idx];
+				job.fBootType = BootTypeTable[idx].bootType;
 			} else {
-				printf("error: unknown boot sector type \"%s\"\n", optarg);
-				goto usage;
+				out.Printf("error: unknown boot sector type \"%s\"\n", optarg);
+				return false;
 			}
 			break;
 		case 'B':
 			bootfile = fopen(optarg, "rb");
 			if (bootfile == NULL) {
-				printf("error: cannot open boot sector file \"%s\"\n", optarg);
-				goto usage;
+				out.Printf("error: cannot open boot sector file \"%s\"\n", optarg);
+				return false;
 			}
-			if (fread(userDefBootData, 1, 384, bootfile) != 384) {
-				printf("error reading boot sector data from \"%s\"\n", optarg);
+			if (fread(job.fUserDefBootData, 1, 384, bootfile) != 384) {
+				out.Printf("error reading boot sector data from \"%s\"\n", optarg);
 				fclose(bootfile);
-				goto usage;
+				return false;
 			} else {
-				printf("loaded boot sector data from \"%s\"\n", optarg);
+				out.Printf("loaded boot sector data from \"%s\"\n", optarg);
 			}
 			fclose(bootfile);
-			userDefBoot = true;
+			job.fUserDefBoot = true;
 			break;
 		case 'S':
-			dd = false;
-			sectors = 720;
-			printf("creating standard SD/90k image\n");
+			job.fDoubleDensity = false;
+			job.fSectors = 720;
+			out.Printf("creating standard SD/90k image\n");
 			break;
 		case 'E':
-			dd = false;
-			sectors = 1040;
-			printf("creating standard ED/130k image\n");
+			job.fDoubleDensity = false;
+			job.fSectors = 1040;
+			out.Printf("creating standard ED/130k image\n");
 			break;
 		case 'D':
-			dd = true;
-			sectors = 720;
-			printf("creating standard DD/180k image\n");
+			job.fDoubleDensity = true;
+			job.fSectors = 720;
+			out.Printf("creating standard DD/180k image\n");
 			break;
 		case 'Q':
-			dd = true;
-			sectors = 1440;
-			mydos = true;
-			printf("creating standard QD/360k image in MyDOS format\n");
+			job.fDoubleDensity = true;
+			job.fSectors = 1440;
+			job.fMyDos = true;
+			out.Printf("creating standard QD/360k image in MyDOS format\n");
+			break;
+		case 'i':
+			job.fManifestFile = optarg;
+			break;
+		case 'J':
+			*jobfile = optarg;
+			break;
+		case 'j':
+			*numThreads = atoi(optarg);
+			if (*numThreads < 1 || *numThreads > 64) {
+				out.Printf("error: illegal number of threads\n");
+				return false;
+			}
 			break;
 		}
 	}
 
-	if (autorun) {
-		if (BootTypeTable[idx].autorun == false) {
-			printf("autorun not supported for %s boot sectors\n",
-				BootTypeTable[idx].name);
-			goto usage;
-		} else {
-			printf("enabled MyPicoDos autorun mode\n");
-		}
+	if (jobfile && *jobfile) {
+		// options given on the command line are the defaults for all jobs
+		return argc == optind;
 	}
 
-	if (dd) {
-		seclen = e256BytesPerSector;
-	} else {
-		seclen = e128BytesPerSector;
+	if (job.fAutorun) {
+		if (!job.fBootEntry || job.fBootEntry->autorun == false) {
+			out.Printf("autorun not supported for %s boot sectors\n",
+				job.fBootEntry ? job.fBootEntry->name : "default");
+			return false;
+		} else {
+			out.Printf("enabled MyPicoDos autorun mode\n");
+		}
 	}
 
-	if ((sectors == 0) && (argc == optind+3)) {
-		sectors = atoi(argv[optind++]);
-		if (sectors < 720 || sectors > 65535) {
-			printf("error: illegal number of sectors - must be 720..65535\n");
-			return 1;
+	if ((job.fSectors == 0) && (argc == optind+3)) {
+		job.fSectors = atoi(argv[optind++]);
+		if (job.fSectors < 720 || job.fSectors > 65535) {
+			out.Printf("error: illegal number of sectors - must be 720..65535\n");
+			return false;
 		}
 	}
 
 	if (argc != optind+2) {
-		goto usage;
+		return false;
 	}
 
-	atrfilename=argv[optind++];
-	directory=argv[optind++];
+	job.fAtrFilename = argv[optind++];
+	job.fDirectory = argv[optind++];
+	return true;
+}
+
+// take over the image created by the previous run and only apply the
+// changes in the host directory since then, so unchanged files keep
+// their sectors
+static bool update_image(const ImageJob& job, ESectorLength seclen, int sectors, bool mydos,
+	const RCPtr<ImageManifest>& manifest, JobOutput& out,
+	RCPtr<AtrMemoryImage>& image, RCPtr<VirtualImageObserver>& observer,
+	RCPtr<Dos2xUtils>& dos2xutils)
+{
+	image = new AtrMemoryImage;
+	if (!image->ReadImageFromFile(job.fAtrFilename.c_str(), true)) {
+		return false;
+	}
+	if (image->GetSectorLength() != seclen ||
+	    (sectors && image->GetNumberOfSectors() != (unsigned int) sectors)) {
+		return false;
+	}
+
+	observer = new VirtualImageObserver(image);
+	dos2xutils = new Dos2xUtils(image, job.fDirectory.c_str(), observer.GetRealPointer());
+	observer->SetRootDirectoryObserver(dos2xutils);
+
+	if (!dos2xutils->SetDosFormat(mydos ? Dos2xUtils::eMyDos : Dos2xUtils::eDos2x)) {
+		return false;
+	}
+	if (!dos2xutils->AttachDirectory(job.fPicoNameType)) {
+		return false;
+	}
+	unsigned int unchanged;
+	if (!manifest->AttachImage(dos2xutils, unchanged)) {
+		return false;
+	}
+
+	std::vector< RCPtr<Dos2xUtils> > tree;
+	dos2xutils->GetDirectoryTree(tree);
+	for (unsigned int i = 0; i < tree.size(); i++) {
+		bool changed, complete;
+		if (!tree[i]->SyncWithHostDirectory(changed, complete) || !complete) {
+			return false;
+		}
+	}
+	out.Printf("updated image \"%s\", %d files unchanged\n", job.fAtrFilename.c_str(), unchanged);
+	return true;
+}
+
+static int build_image(const ImageJob& job, JobOutput& out)
+{
+	// dos2xutils must be released before the observer
+	RCPtr<AtrMemoryImage> image;
+	RCPtr<VirtualImageObserver> observer;
+	RCPtr<Dos2xUtils> dos2xutils;
+
+	bool mydos = job.fMyDos;
+	int sectors = job.fSectors;
+	bool autoSize;
+	const char* directory = job.fDirectory.c_str();
+	const char* atrfilename = job.fAtrFilename.c_str();
+	const char* manifestfile = job.fManifestFile.empty() ? 0 : job.fManifestFile.c_str();
+	ESectorLength seclen;
+
+	struct stat statbuf;
+
+	RCPtr<ImageManifest> oldManifest;
+	bool updated = false;
+	char options[128];
+
+	int ret = 0;
+
+	if (job.fDoubleDensity) {
+		seclen = e256BytesPerSector;
+	} else {
+		seclen = e128BytesPerSector;
+	}
 
 	// check if directory exists
 	if (stat(directory, &statbuf)) {
-		printf("error: cannot stat directory \"%s\"\n", directory);
+		out.Printf("error: cannot stat directory \"%s\"\n", directory);
 		return 1;
 	}
 	if (!S_ISDIR(statbuf.st_mode)) {
-		printf("error: \"%s\" is not a directory\n", directory);
+		out.Printf("error: \"%s\" is not a directory\n", directory);
 		return 1;
 	}
 
-	if (sectors == 0) {
+	autoSize = (sectors == 0);
+	if (autoSize) {
 		if (!mydos) {
-			printf("number of sectors not specified - using MyDOS format\n");
+			out.Printf("number of sectors not specified - using MyDOS format\n");
 			mydos = true;
 		}
+	} else if ( !((sectors == 720) || (sectors == 1040 && !job.fDoubleDensity) )) {
+		if (!mydos) {
+			out.Printf("non-standard disk size - using MyDOS format\n");
+			mydos = true;
+		}
+	}
 
-		sectors = Dos2xUtils::EstimateDiskSize(directory, seclen, piconametype, bootType, false);
-		if (sectors > 65535) {
-			printf("error: calculated disk size %d is larger than maximum of 65535\n",
-				sectors);
-			return 1;
+	// the image may only be updated if it was created with identical
+	// options, boot sectors are written in any case
+	snprintf(options, sizeof(options), "sectors=%d seclen=%d dos=%s boot=%d piconame=%d",
+		sectors, seclen, mydos ? "mydos" : "dos2x", job.fBootType, job.fPicoNameType);
+
+	if (manifestfile) {
+		oldManifest = new ImageManifest;
+		if (!oldManifest->ReadFromFile(manifestfile)) {
+			out.Printf("no manifest \"%s\" - creating new image\n", manifestfile);
+		} else if (oldManifest->GetOptions() != options) {
+			out.Printf("options changed since manifest \"%s\" was created - creating new image\n", manifestfile);
+		} else {
+			updated = update_image(job, seclen, sectors, mydos,
+				oldManifest, out, image, observer, dos2xutils);
+			if (!updated) {
+				out.Printf("cannot update image \"%s\" - creating new image\n", atrfilename);
+				dos2xutils = 0;
+				observer = 0;
+				image = 0;
+			}
 		}
-		printf("calculated disk size is %d sectors\n", sectors);
+	}
+	if (updated) {
+		goto write_boot_sectors;
 	}
 
-	if ( !((sectors == 720) || (sectors == 1040 && !dd) )) {
-		if (!mydos) {
-			printf("non-standard disk size - using MyDOS format\n");
-			mydos = true;
+	if (autoSize) {
+		sectors = Dos2xUtils::EstimateDiskSize(directory, seclen, job.fPicoNameType, job.fBootType, false);
+		if (sectors > 65535) {
+			out.Printf("error: calculated disk size %d is larger than maximum of 65535\n",
+				sectors);
+			return 1;
 		}
+		out.Printf("calculated disk size is %d sectors\n", sectors);
 	}
 
 	image = new AtrMemoryImage;
 	if (!image->CreateImage(seclen, sectors)) {
-		printf("error: cannot create atr image\n");
+		out.Printf("error: cannot create atr image\n");
 		return 1;
 	}
 
@@ -275,56 +391,242 @@ int main(int argc, char**argv)
 
 	if (mydos) {
 		if (!dos2xutils->SetDosFormat(Dos2xUtils::eMyDos)) {
-			printf("error: cannot set MyDos format\n");
+			out.Printf("error: cannot set MyDos format\n");
 			return 1;
 		}
 	} else {
 		if (!dos2xutils->SetDosFormat(Dos2xUtils::eDos2x)) {
-			printf("error: cannot set DOS 2.x format\n");
+			out.Printf("error: cannot set DOS 2.x format\n");
 			return 1;
 		}
 	}
 	if (!dos2xutils->InitVTOC()) {
-		printf("error: creating directory failed\n");
+		out.Printf("error: creating directory failed\n");
 		return 1;
 	}
 
-	if (!dos2xutils->AddBootFile(bootType)) {
-		printf("error: adding boot file failed\n");
+	if (!dos2xutils->AddBootFile(job.fBootType)) {
+		out.Printf("error: adding boot file failed\n");
 		return 1;
 	}
-	if (!dos2xutils->AddFiles(piconametype)) {
-		printf("error: failed to add all files\n");
+	if (!dos2xutils->AddFiles(job.fPicoNameType)) {
+		out.Printf("error: failed to add all files\n");
 		ret = 1;
 	}
 
-	if (userDefBoot) {
+write_boot_sectors:
+	if (job.fUserDefBoot) {
 		for (int i = 0; i < 3; i++) {
-			image->WriteSector(i+1, userDefBootData+i*128, 128);
+			image->WriteSector(i+1, job.fUserDefBootData+i*128, 128);
 		}
 	} else {
-		if (!dos2xutils->WriteBootSectors(bootType, autorun)) {
-			printf("error: writing boot sectors failed\n");
+		if (!dos2xutils->WriteBootSectors(job.fBootType, job.fAutorun)) {
+			out.Printf("error: writing boot sectors failed\n");
 			ret = 1;
 		}
 	}
 
+	// compressed and DCM output is chosen by the filename extension
 	if (image->WriteImageToFile(atrfilename)) {
-		printf("created image \"%s\"\n", atrfilename);
+		out.Printf("created image \"%s\"\n", atrfilename);
 	} else {
-		printf("error writing image to \"%s\"\n", atrfilename);
+		out.Printf("error writing image to \"%s\"\n", atrfilename);
 		ret = 1;
 	}
 
-	dos2xutils = 0;
-	observer = 0;
+	if (manifestfile && ret == 0) {
+		RCPtr<ImageManifest> manifest = new ImageManifest;
+		manifest->SetOptions(options);
+		manifest->Build(dos2xutils, oldManifest.GetRealPointer());
+		if (!manifest->WriteToFile(manifestfile)) {
+			out.Printf("error writing manifest to \"%s\"\n", manifestfile);
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
+
+// split a line of the job file into arguments, double quotes
+// group arguments containing blanks
+static void split_job_line(const char* line, std::vector<std::string>& args)
+{
+	args.clear();
+	const char* p = line;
+	while (*p) {
+		while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+			p++;
+		}
+		if (!*p) {
+			break;
+		}
+		std::string arg;
+		bool quoted = false;
+		while (*p && (quoted || (*p != ' ' && *p != '\t' && *p != '\r' && *p != '\n'))) {
+			if (*p == '"') {
+				quoted = !quoted;
+			} else {
+				arg += *p;
+			}
+			p++;
+		}
+		args.push_back(arg);
+	}
+}
+
+static bool read_job_file(const char* jobfile, const ImageJob& defaults,
+	std::vector<ImageJob>& jobs, std::vector<std::string>& messages)
+{
+	FILE* f = fopen(jobfile, "r");
+	if (!f) {
+		printf("error: cannot open job file \"%s\"\n", jobfile);
+		return false;
+	}
+	char line[4096];
+	unsigned int lineno = 0;
+	bool ok = true;
+	std::vector<std::string> args;
+
+	while (ok && fgets(line, sizeof(line), f)) {
+		lineno++;
+		split_job_line(line, args);
+		if (args.empty() || args[0][0] == '#') {
+			continue;
+		}
+		std::vector<char*> argv;
+		argv.push_back(const_cast<char*>("dir2atr"));
+		for (unsigned int i = 0; i < args.size(); i++) {
+			argv.push_back(const_cast<char*>(args[i].c_str()));
+		}
+		argv.push_back(0);
+
+		ImageJob job(defaults);
+		JobOutput out(true);
+		if (parse_options(argv.size() - 1, &argv[0], job, out)) {
+			jobs.push_back(job);
+			messages.push_back(out.fText);
+		} else {
+			printf("%serror: illegal job in line %d of \"%s\"\n", out.fText.c_str(), lineno, jobfile);
+			ok = false;
+		}
+	}
+	fclose(f);
+	return ok;
+}
+
+struct BulkArgs {
+	const std::vector<ImageJob>* fJobs;
+	const std::vector<std::string>* fMessages;
+};
+
+static int build_job(unsigned int idx, JobOutput& out, void* arg)
+{
+	BulkArgs* args = (BulkArgs*) arg;
+	// messages from parsing the job file come first
+	out.fText = (*args->fMessages)[idx];
+	return build_image((*args->fJobs)[idx], out);
+}
+
+static void set_tracing(bool on)
+{
+	SIOTracer* sioTracer = SIOTracer::GetInstance();
+	sioTracer->SetTraceGroup(SIOTracer::eTraceInfo, on);
+	sioTracer->SetTraceGroup(SIOTracer::eTraceWarning, on);
+	sioTracer->SetTraceGroup(SIOTracer::eTraceError, on);
+	sioTracer->SetTraceGroup(SIOTracer::eTraceDebug, on);
+}
+
+static int run_jobs(const char* jobfile, const ImageJob& defaults, int numThreads)
+{
+	std::vector<ImageJob> jobs;
+	std::vector<std::string> messages;
+	if (!read_job_file(jobfile, defaults, jobs, messages)) {
+		return 1;
+	}
+
+	std::vector<int> results;
+	bool done = false;
+
+	numThreads = JobPool::GetNumberOfThreads(numThreads, jobs.size());
+	if (numThreads > 1) {
+		// the tracer isn't thread safe. Workers run quiet and failed
+		// jobs are repeated with all messages enabled afterwards.
+		// Initialize the shared boot code and CRC tables up front.
+		MyPicoDosCode::GetInstance();
+		CRC32::CalcCRC32(0, 0, 0);
+		BulkArgs args;
+		args.fJobs = &jobs;
+		args.fMessages = &messages;
+		JobPool pool(build_job, &args);
+		set_tracing(false);
+		done = pool.Run(jobs.size(), numThreads, results);
+		set_tracing(true);
+	}
+
+	unsigned int failed = 0;
+	for (unsigned int i = 0; i < jobs.size(); i++) {
+		if (!done) {
+			JobOutput out(false);
+			fputs(messages[i].c_str(), stdout);
+			if (build_image(jobs[i], out)) {
+				failed++;
+			}
+		} else if (results[i]) {
+			printf("repeating failed job for \"%s\"\n", jobs[i].fAtrFilename.c_str());
+			JobOutput out(false);
+			fputs(messages[i].c_str(), stdout);
+			if (build_image(jobs[i], out)) {
+				failed++;
+			}
+		}
+	}
+	if (failed) {
+		printf("error: %d of %d jobs failed\n", failed, (int) jobs.size());
+		return 1;
+	}
+	printf("created %d images\n", (int) jobs.size());
+	return 0;
+}
+
+#ifdef ALL_IN_ONE
+int dir2atr_main(int argc, char**argv)
+#else
+int main(int argc, char**argv)
+#endif
+{
+	SIOTracer* sioTracer = SIOTracer::GetInstance();
+	{
+		RCPtr<FileTracer> tracer(new FileTracer(stderr));
+		sioTracer->AddTracer(tracer);
+		sioTracer->SetTraceGroup(SIOTracer::eTraceInfo, true, tracer);
+		sioTracer->SetTraceGroup(SIOTracer::eTraceWarning, true, tracer);
+		sioTracer->SetTraceGroup(SIOTracer::eTraceError, true, tracer);
+		sioTracer->SetTraceGroup(SIOTracer::eTraceDebug, true, tracer);
+	}
+
+	ImageJob job;
+	JobOutput out(false);
+	const char* jobfile = 0;
+	int numThreads = 0;
+	int ret;
+
+	if (!parse_options(argc, argv, job, out, &jobfile, &numThreads)) {
+		goto usage;
+	}
+
+	if (jobfile) {
+		ret = run_jobs(jobfile, job, numThreads);
+	} else {
+		ret = build_image(job, out);
+	}
 
 	SIOTracer::GetInstance()->RemoveAllTracers();
 	return ret;
 usage:
 	printf("dir2atr %s\n", VERSION_STRING);
 	printf("(c) 2004-2020 Matthias Reichl <hias@horus.com>\n");
-	printf("usage: dir2atr [-admpSDEPQ] [-b <DOS>] [-B file] [sectors] atrfile directory\n");
+	printf("usage: dir2atr [-admpSDEPQ] [-b <DOS>] [-B file] [-i file] [sectors] atrfile directory\n");
+	printf("       dir2atr [-admpSDEPQ] [-b <DOS>] [-B file] [-j threads] -J jobfile\n");
 	printf("  -d        create double density image (default: single density)\n");
 	printf("  -m        create MyDOS image (default: DOS 2.x)\n");
 	printf("  -S/E/D/Q  create standard SD/ED/DD/QD image\n");
@@ -345,6 +647,10 @@ usage:
 	printf("            MyPicoDos406R, MyPicoDos406RA, MyPicoDos406RN\n");
 	printf("            MyPicoDos406B, MyPicoDos406S0, MyPicoDos406S1, PicoBoot406\n");
 	printf("  -B <FILE> load boot sector data from <FILE>\n");
+	printf("  -i <FILE> only update changed files in atrfile, using manifest <FILE>\n");
+	printf("  -J <FILE> create all images listed in <FILE>, one line per image\n");
+	printf("            with options, atrfile and directory\n");
+	printf("  -j <NUM>  number of images to create in parallel with -J\n");
 
 	SIOTracer::GetInstance()->RemoveAllTracers();
 	return 1;
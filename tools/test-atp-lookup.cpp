@@ -0,0 +1,195 @@
+/*
+   test-atp-lookup: benchmark ATP sector lookups and compare them
+   with a linear scan of the track
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <list>
+#include <vector>
+
+#include "AtpImage.h"
+#include "MiscUtils.h"
+
+struct Query {
+	uint8_t fTrack;
+	uint8_t fID;
+	unsigned int fTime;
+};
+
+// the lookup used before the track index, on a list sorted by position
+typedef std::list<AtpSector*> SectorList;
+
+static AtpSector* linear_find(const SectorList& sectors, unsigned int id, unsigned int current_time)
+{
+	SectorList::const_iterator end(sectors.end());
+	SectorList::const_iterator current(sectors.begin());
+
+	if (sectors.empty()) {
+		return 0;
+	}
+	while (current != end && (*current)->GetPosition() < current_time) {
+		current++;
+	}
+	if (current == end) {
+		current = sectors.begin();
+	}
+	SectorList::const_iterator iter(current);
+	do {
+		if ((*iter)->GetID() == id) {
+			return *iter;
+		}
+		iter++;
+		if (iter == end) {
+			iter = sectors.begin();
+		}
+	} while (iter != current);
+	return 0;
+}
+
+// Standard SD format plus the kind of layout found on copy protected
+// disks: duplicate sectors with bad status and phantom sectors
+// interleaved on every track.
+static RCPtr<AtpImage> create_protected_image(unsigned int extra)
+{
+	RCPtr<AtpImage> image = new AtpImage;
+	image->InitBlankSD();
+
+	uint8_t data[128];
+	memset(data, 0, sizeof(data));
+	srand(1);
+	for (unsigned int track = 0; track < image->GetNumberOfTracks(); track++) {
+		for (unsigned int i = 0; i < extra; i++) {
+			unsigned int pos = rand() % Atari1050Model::eDiskRotationTime;
+			unsigned int id = 1 + rand() % 18;
+			uint8_t status = (i & 1) ? 0xf7 : 0xff;
+			image->AddSector(track, new AtpSector(id, 128, data, pos,
+				Atari1050Model::eSDSectorTimeLength, status));
+		}
+	}
+	return image;
+}
+
+static bool run_benchmark(const char* name, const RCPtr<AtpImage>& image, unsigned int count)
+{
+	unsigned int numTracks = image->GetNumberOfTracks();
+	std::vector<SectorList> lists(numTracks);
+	unsigned int numSectors = 0;
+
+	for (unsigned int track = 0; track < numTracks; track++) {
+		AtpTrack* t = image->GetTrack(track);
+		for (unsigned int i = 0; i < t->GetNumberOfSectors(); i++) {
+			RCPtr<AtpSector> sector;
+			t->InternalGetSector(i, sector);
+			lists[track].push_back(sector.GetRealPointer());
+		}
+		numSectors += t->GetNumberOfSectors();
+	}
+
+	std::vector<Query> queries(count);
+	srand(2);
+	for (unsigned int i = 0; i < count; i++) {
+		queries[i].fTrack = rand() % numTracks;
+		// includes some IDs that don't exist
+		queries[i].fID = 1 + rand() % 20;
+		queries[i].fTime = rand() % Atari1050Model::eDiskRotationTime;
+	}
+
+	std::vector<AtpSector*> linear(count);
+	MiscUtils::TimestampType start = MiscUtils::GetCurrentTime();
+	for (unsigned int i = 0; i < count; i++) {
+		linear[i] = linear_find(lists[queries[i].fTrack], queries[i].fID, queries[i].fTime);
+	}
+	MiscUtils::TimestampType end = MiscUtils::GetCurrentTime();
+	double linearTime = (end - start) / 1000.0;
+
+	std::vector<AtpSector*> indexed(count);
+	start = MiscUtils::GetCurrentTime();
+	for (unsigned int i = 0; i < count; i++) {
+		indexed[i] = image->FindSector(queries[i].fTrack, queries[i].fID, queries[i].fTime);
+	}
+	end = MiscUtils::GetCurrentTime();
+	double indexedTime = (end - start) / 1000.0;
+
+	bool ok = true;
+	for (unsigned int i = 0; i < count; i++) {
+		if (linear[i] != indexed[i]) {
+			ok = false;
+			break;
+		}
+	}
+
+	printf("%s: %u sectors on %u tracks, %u lookups\n", name, numSectors, numTracks, count);
+	printf("  linear: %10.1f ms  indexed: %10.1f ms  speedup: %.1fx%s\n",
+		linearTime, indexedTime,
+		indexedTime > 0 ? linearTime / indexedTime : 0,
+		ok ? "" : "  RESULT MISMATCH");
+	return ok;
+}
+
+static void usage(const char* progname)
+{
+	printf("usage: %s [options] [file.atp ...]\n", progname);
+	printf("options:\n");
+	printf("  -n count  number of lookups (default: 1000000)\n");
+	printf("  -p num    extra duplicate sectors per track of the generated\n");
+	printf("            image used when no files are given (default: 30)\n");
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int count = 1000000;
+	unsigned int extra = 30;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:p:h")) != -1) {
+		switch (c) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'p':
+			extra = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	bool ok = true;
+	if (optind == argc) {
+		char name[64];
+		snprintf(name, sizeof(name), "generated (%u extra sectors per track)", extra);
+		ok = run_benchmark(name, create_protected_image(extra), count);
+	}
+	for (int i = optind; i < argc; i++) {
+		RCPtr<AtpImage> image = new AtpImage;
+		if (!image->ReadImageFromFile(argv[i], true)) {
+			printf("cannot read %s\n", argv[i]);
+			ok = false;
+			continue;
+		}
+		if (!run_benchmark(argv[i], image, count)) {
+			ok = false;
+		}
+	}
+	return ok ? 0 : 1;
+}
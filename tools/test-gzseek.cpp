@@ -0,0 +1,238 @@
+/*
+   test-gzseek: compare random access performance of gzseek and
+   the indexed GZFileIO
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#ifdef USE_ZLIB
+
+#include <zlib.h>
+#include <vector>
+
+#include "FileIO.h"
+#include "MiscUtils.h"
+
+enum EPattern {
+	eSequential,
+	eRandom,
+	eBackward,
+	eSectorBrowse,
+	eNumPatterns
+};
+
+static const char* patternNames[eNumPatterns] = {
+	"sequential",
+	"random",
+	"backward",
+	"sector browse"
+};
+
+static void create_offsets(EPattern pattern, off_t length, unsigned int blocksize,
+	unsigned int count, std::vector<off_t>& offsets)
+{
+	offsets.clear();
+	off_t blocks = length / blocksize;
+	if (blocks == 0) {
+		return;
+	}
+	srand(1);
+	for (unsigned int i = 0; i < count; i++) {
+		off_t block = 0;
+		switch (pattern) {
+		case eSequential:
+			block = i % blocks;
+			break;
+		case eRandom:
+			block = ((off_t) rand() * RAND_MAX + rand()) % blocks;
+			break;
+		case eBackward:
+			block = blocks - 1 - (i % blocks);
+			break;
+		case eSectorBrowse:
+			// directory sectors at 360-368 with accesses to files
+			// all over the disk in between, like browsing an ATR
+			if (i % 4) {
+				block = ((off_t) rand() * RAND_MAX + rand()) % blocks;
+			} else {
+				block = (blocks / 2) + (i / 4) % 8;
+				if (block >= blocks) {
+					block = blocks - 1;
+				}
+			}
+			break;
+		default:
+			break;
+		}
+		offsets.push_back(block * blocksize);
+	}
+}
+
+static double run_zlib(const char* filename, const std::vector<off_t>& offsets,
+	unsigned int blocksize, uint32_t& checksum)
+{
+	gzFile f = gzopen(filename, "rb");
+	if (!f) {
+		printf("cannot open %s\n", filename);
+		exit(1);
+	}
+	uint8_t* buf = new uint8_t[blocksize];
+	checksum = crc32(0L, Z_NULL, 0);
+
+	MiscUtils::TimestampType start = MiscUtils::GetCurrentTime();
+	for (unsigned int i = 0; i < offsets.size(); i++) {
+		if (gzseek(f, offsets[i], SEEK_SET) != offsets[i]) {
+			printf("gzseek to %ld failed\n", (long) offsets[i]);
+			exit(1);
+		}
+		int len = gzread(f, buf, blocksize);
+		if (len > 0) {
+			checksum = crc32(checksum, buf, len);
+		}
+	}
+	MiscUtils::TimestampType end = MiscUtils::GetCurrentTime();
+
+	gzclose(f);
+	delete[] buf;
+	return (end - start) / 1000.0;
+}
+
+static double run_gzfileio(const char* filename, const std::vector<off_t>& offsets,
+	unsigned int blocksize, uint32_t& checksum, double& opentime, unsigned int& points)
+{
+	RCPtr<GZFileIO> fileio = new GZFileIO;
+	MiscUtils::TimestampType start = MiscUtils::GetCurrentTime();
+	if (!fileio->OpenRead(filename)) {
+		printf("cannot open %s\n", filename);
+		exit(1);
+	}
+	opentime = (MiscUtils::GetCurrentTime() - start) / 1000.0;
+
+	uint8_t* buf = new uint8_t[blocksize];
+	checksum = crc32(0L, Z_NULL, 0);
+
+	start = MiscUtils::GetCurrentTime();
+	for (unsigned int i = 0; i < offsets.size(); i++) {
+		if (!fileio->Seek(offsets[i])) {
+			printf("Seek to %ld failed\n", (long) offsets[i]);
+			exit(1);
+		}
+		unsigned int len = fileio->ReadBlock(buf, blocksize);
+		if (len > 0) {
+			checksum = crc32(checksum, buf, len);
+		}
+	}
+	MiscUtils::TimestampType end = MiscUtils::GetCurrentTime();
+
+	points = fileio->GetNumberOfAccessPoints();
+	fileio->Close();
+	delete[] buf;
+	return (end - start) / 1000.0;
+}
+
+static void usage(const char* progname)
+{
+	printf("usage: %s [options] file.gz\n", progname);
+	printf("options:\n");
+	printf("  -b size   block size (default: 128)\n");
+	printf("  -n count  number of accesses per pattern (default: 10000)\n");
+	printf("  -s span   index span in kB (default: %d)\n", GZFileIO::GetIndexSpan() / 1024);
+	printf("  -z        skip the (slow) plain zlib runs\n");
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int blocksize = 128;
+	unsigned int count = 10000;
+	bool runZlib = true;
+	int c;
+
+	while ((c = getopt(argc, argv, "b:n:s:zh")) != -1) {
+		switch (c) {
+		case 'b':
+			blocksize = atoi(optarg);
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 's':
+			GZFileIO::SetIndexSpan(atoi(optarg) * 1024);
+			break;
+		case 'z':
+			runZlib = false;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc - 1 || blocksize == 0 || GZFileIO::GetIndexSpan() == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+	const char* filename = argv[optind];
+
+	RCPtr<GZFileIO> fileio = new GZFileIO;
+	if (!fileio->OpenRead(filename)) {
+		printf("cannot open %s\n", filename);
+		return 1;
+	}
+	off_t length = fileio->GetFileLength();
+	fileio->Close();
+
+	printf("%s: %ld bytes uncompressed, block size %d, %d accesses, index span %dk\n",
+		filename, (long) length, blocksize, count, GZFileIO::GetIndexSpan() / 1024);
+
+	std::vector<off_t> offsets;
+	bool ok = true;
+	for (int p = 0; p < eNumPatterns; p++) {
+		create_offsets((EPattern) p, length, blocksize, count, offsets);
+
+		uint32_t crcIndexed, crcZlib = 0;
+		double opentime;
+		unsigned int points;
+		double indexed = run_gzfileio(filename, offsets, blocksize, crcIndexed, opentime, points);
+
+		printf("%-14s GZFileIO: %10.1f ms (open %.1f ms, %d access points)",
+			patternNames[p], indexed, opentime, points);
+		if (runZlib) {
+			double zlib = run_zlib(filename, offsets, blocksize, crcZlib);
+			printf("  gzseek: %10.1f ms  speedup: %.1fx", zlib, indexed > 0 ? zlib / indexed : 0);
+			if (crcZlib != crcIndexed) {
+				printf("  DATA MISMATCH");
+				ok = false;
+			}
+		}
+		printf("\n");
+	}
+	return ok ? 0 : 1;
+}
+
+#else
+
+int main(int, char**)
+{
+	printf("zlib support disabled at compiletime!\n");
+	return 1;
+}
+
+#endif
@@ -0,0 +1,611 @@
+/*
+   test-pty-sio: run a virtual Atari on a pseudo terminal against the
+   userspace SIO wrapper and measure throughput and latencies
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <getopt.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <vector>
+
+#include "UserspaceSIOWrapper.h"
+#include "SIOManager.h"
+#include "AtrSIOHandler.h"
+#include "AtrMemoryImage.h"
+#include "SIOTracer.h"
+#include "MiscUtils.h"
+#include "Termios2.h"
+#include "Error.h"
+
+// The server side runs the userspace SIO wrapper on the slave side of
+// the pseudo terminal in a child process. The parent emulates the SIO
+// routines of the Atari OS on the master side.
+//
+// PTYs have no modem lines, the Atari's command line is sent to the
+// server through a pipe instead. Data is paced to the transmission
+// time at the Atari's baudrate in both directions. The baudrate of
+// the slave side can be read from the master, if the server and the
+// virtual Atari don't use the same baudrate all data is garbled.
+
+class VirtualAtari {
+public:
+	enum {
+		eDelayT0 = 900,		// command asserted to command frame
+		eDelayT1 = 850,		// command frame to command deasserted
+		eDelayT3 = 1000,	// ACK to data frame
+		eMaxAckDelay = 20000,	// command deasserted to ACK
+		eMinCompleteDelay = 250,// ACK to complete
+		eCompleteTimeout = 1000000,
+		eDataTimeout = 20000,
+		eIdleTimeout = 5000,
+		eCommandRetries = 13
+	};
+
+	enum EResult {
+		eOK,
+		eNAK,
+		eError,
+		eTimeout,
+		eChecksumError,
+		eProtocolError
+	};
+
+	VirtualAtari(int masterFd, int commandLineFd, unsigned int baudrate);
+
+	// returns the result of the last attempt
+	EResult Execute(uint8_t device, uint8_t command, unsigned int aux,
+		uint8_t* buf, unsigned int length, bool isWrite);
+
+	struct Statistics {
+		Statistics();
+
+		unsigned int fCommands;
+		unsigned int fFailed;
+		unsigned int fRetries;
+		unsigned int fNAKs;
+		unsigned int fErrors;
+		unsigned int fTimeouts;
+		unsigned int fChecksumErrors;
+		unsigned int fProtocolErrors;
+		unsigned int fGarbled;
+		unsigned int fLateACKs;
+		unsigned int fEarlyCompletes;
+		unsigned long long fBytes;
+
+		// in usec
+		std::vector<unsigned int> fAckLatency;
+		std::vector<unsigned int> fCompleteLatency;
+		std::vector<unsigned int> fCommandTime;
+	};
+
+	const Statistics& GetStatistics() const { return fStats; }
+	void ResetStatistics() { fStats = Statistics(); }
+
+private:
+	EResult ExecuteOnce(uint8_t* frame, uint8_t* buf, unsigned int length, bool isWrite);
+
+	static uint8_t Checksum(const uint8_t* buf, unsigned int length);
+
+	MiscUtils::TimestampType TimeForBytes(unsigned int length) const;
+
+	bool ServerSpeedMatches();
+	void SetCommandLine(bool asserted);
+	void Transmit(const uint8_t* buf, unsigned int length, bool garble);
+	// start is set to the time the first byte arrived
+	int ReceiveByte(unsigned int timeout, MiscUtils::TimestampType& start);
+	bool ReceiveBuf(uint8_t* buf, unsigned int length, unsigned int timeout,
+		MiscUtils::TimestampType& start);
+	void WaitIdle();
+
+	int fMasterFd;
+	int fCommandLineFd;
+	unsigned int fBaudrate;
+	Statistics fStats;
+};
+
+VirtualAtari::Statistics::Statistics()
+	: fCommands(0), fFailed(0), fRetries(0), fNAKs(0), fErrors(0),
+	  fTimeouts(0), fChecksumErrors(0), fProtocolErrors(0), fGarbled(0),
+	  fLateACKs(0), fEarlyCompletes(0), fBytes(0)
+{ }
+
+VirtualAtari::VirtualAtari(int masterFd, int commandLineFd, unsigned int baudrate)
+	: fMasterFd(masterFd),
+	  fCommandLineFd(commandLineFd),
+	  fBaudrate(baudrate)
+{ }
+
+uint8_t VirtualAtari::Checksum(const uint8_t* buf, unsigned int length)
+{
+	unsigned int cksum = 0;
+	for (unsigned int i = 0; i < length; i++) {
+		cksum += buf[i];
+		if (cksum >= 0x100) {
+			cksum = (cksum & 0xff) + 1;
+		}
+	}
+	return cksum;
+}
+
+MiscUtils::TimestampType VirtualAtari::TimeForBytes(unsigned int length) const
+{
+	return ((MiscUtils::TimestampType) length * 10 * 1000000) / fBaudrate;
+}
+
+bool VirtualAtari::ServerSpeedMatches()
+{
+	// TCGETS2 on the master returns the settings of the slave side
+	struct termios2 tios2;
+	if (ioctl(fMasterFd, TCGETS2, &tios2)) {
+		return true;
+	}
+	// allow 3% deviation, like a UART
+	unsigned int diff = (tios2.c_ospeed > fBaudrate) ?
+		tios2.c_ospeed - fBaudrate : fBaudrate - tios2.c_ospeed;
+	return diff * 100 <= fBaudrate * 3;
+}
+
+void VirtualAtari::SetCommandLine(bool asserted)
+{
+	if (fCommandLineFd >= 0) {
+		uint8_t state = asserted;
+		if (write(fCommandLineFd, &state, 1) != 1) {
+			perror("writing command line state failed");
+		}
+	}
+}
+
+void VirtualAtari::Transmit(const uint8_t* buf, unsigned int length, bool garble)
+{
+	// the pty transfers data immediately, hand over every byte at
+	// the time a serial port would have received it
+	MiscUtils::TimestampType start = MiscUtils::GetCurrentTime();
+	for (unsigned int pos = 0; pos < length; pos++) {
+		uint8_t byte = buf[pos];
+		if (garble) {
+			// a receiver at the wrong baudrate only sees framing errors
+			byte ^= 0xa5 + pos;
+		}
+		MiscUtils::WaitUntil(start + TimeForBytes(pos + 1));
+		if (write(fMasterFd, &byte, 1) != 1) {
+			perror("write to pty failed");
+			return;
+		}
+	}
+}
+
+int VirtualAtari::ReceiveByte(unsigned int timeout, MiscUtils::TimestampType& start)
+{
+	uint8_t byte;
+	if (!ReceiveBuf(&byte, 1, timeout, start)) {
+		return -1;
+	}
+	return byte;
+}
+
+bool VirtualAtari::ReceiveBuf(uint8_t* buf, unsigned int length, unsigned int timeout,
+	MiscUtils::TimestampType& start)
+{
+	MiscUtils::TimestampType endTime = MiscUtils::GetCurrentTime() + TimeForBytes(length) + timeout;
+	unsigned int pos = 0;
+	while (pos < length) {
+		MiscUtils::TimestampType now = MiscUtils::GetCurrentTime();
+		if (now >= endTime) {
+			return false;
+		}
+		struct pollfd pfd;
+		pfd.fd = fMasterFd;
+		pfd.events = POLLIN;
+		int ms = (endTime - now + 999) / 1000;
+		if (poll(&pfd, 1, ms) <= 0) {
+			continue;
+		}
+		int cnt = read(fMasterFd, buf + pos, length - pos);
+		if (cnt <= 0) {
+			continue;
+		}
+		if (pos == 0) {
+			start = MiscUtils::GetCurrentTime();
+		}
+		pos += cnt;
+	}
+	// the sender wrote the whole frame at once, a serial port
+	// would still be busy receiving it
+	MiscUtils::WaitUntil(start + TimeForBytes(length));
+	return true;
+}
+
+void VirtualAtari::WaitIdle()
+{
+	uint8_t buf[256];
+	struct pollfd pfd;
+	pfd.fd = fMasterFd;
+	pfd.events = POLLIN;
+	while (poll(&pfd, 1, eIdleTimeout / 1000) > 0) {
+		if (read(fMasterFd, buf, sizeof(buf)) <= 0) {
+			break;
+		}
+	}
+}
+
+VirtualAtari::EResult VirtualAtari::ExecuteOnce(uint8_t* frame, uint8_t* buf, unsigned int length, bool isWrite)
+{
+	MiscUtils::TimestampType start = MiscUtils::GetCurrentTime();
+	MiscUtils::TimestampType ackStart, completeStart, dataStart;
+
+	bool garble = !ServerSpeedMatches();
+	if (garble) {
+		fStats.fGarbled++;
+	}
+
+	SetCommandLine(true);
+	MiscUtils::WaitUntil(start + eDelayT0);
+	Transmit(frame, 5, garble);
+	MiscUtils::WaitUntil(MiscUtils::GetCurrentTime() + eDelayT1);
+	SetCommandLine(false);
+	MiscUtils::TimestampType deassert = MiscUtils::GetCurrentTime();
+
+	// wait longer than the Atari would, to see how late the ACK is
+	int ack = ReceiveByte(2 * eMaxAckDelay, ackStart);
+	if (ack < 0) {
+		return eTimeout;
+	}
+	if (garble) {
+		return eProtocolError;
+	}
+	if (ack == 'N') {
+		return eNAK;
+	}
+	if (ack != 'A') {
+		return eProtocolError;
+	}
+	fStats.fAckLatency.push_back(ackStart - deassert);
+	if (ackStart - deassert > eMaxAckDelay) {
+		fStats.fLateACKs++;
+	}
+	MiscUtils::TimestampType ackEnd = MiscUtils::GetCurrentTime();
+
+	if (isWrite) {
+		uint8_t tmp[8200];
+		memcpy(tmp, buf, length);
+		tmp[length] = Checksum(buf, length);
+		MiscUtils::WaitUntil(ackEnd + eDelayT3);
+		Transmit(tmp, length + 1, false);
+		int dataAck = ReceiveByte(eMaxAckDelay, ackStart);
+		if (dataAck < 0) {
+			return eTimeout;
+		}
+		if (dataAck != 'A') {
+			return eProtocolError;
+		}
+		ackEnd = MiscUtils::GetCurrentTime();
+	}
+
+	int complete = ReceiveByte(eCompleteTimeout, completeStart);
+	if (complete < 0) {
+		return eTimeout;
+	}
+	if (complete != 'C' && complete != 'E') {
+		return eProtocolError;
+	}
+	if (completeStart < ackEnd + eMinCompleteDelay) {
+		fStats.fEarlyCompletes++;
+	}
+	fStats.fCompleteLatency.push_back(completeStart > ackEnd ? completeStart - ackEnd : 0);
+
+	if (!isWrite && length) {
+		uint8_t tmp[8200];
+		if (!ReceiveBuf(tmp, length + 1, eDataTimeout, dataStart)) {
+			return eTimeout;
+		}
+		if (!ServerSpeedMatches()) {
+			fStats.fGarbled++;
+			return eChecksumError;
+		}
+		if (tmp[length] != Checksum(tmp, length)) {
+			return eChecksumError;
+		}
+		memcpy(buf, tmp, length);
+	}
+
+	fStats.fCommandTime.push_back(MiscUtils::GetCurrentTime() - start);
+
+	if (complete == 'E') {
+		return eError;
+	}
+	fStats.fBytes += length;
+	return eOK;
+}
+
+VirtualAtari::EResult VirtualAtari::Execute(uint8_t device, uint8_t command, unsigned int aux,
+	uint8_t* buf, unsigned int length, bool isWrite)
+{
+	uint8_t frame[5];
+	frame[0] = device;
+	frame[1] = command;
+	frame[2] = aux & 0xff;
+	frame[3] = aux >> 8;
+	frame[4] = Checksum(frame, 4);
+
+	fStats.fCommands++;
+
+	EResult result = eOK;
+	for (unsigned int retry = 0; retry <= eCommandRetries; retry++) {
+		if (retry) {
+			fStats.fRetries++;
+		}
+		result = ExecuteOnce(frame, buf, length, isWrite);
+		switch (result) {
+		case eOK:
+			return result;
+		case eNAK: fStats.fNAKs++; break;
+		case eError: fStats.fErrors++; break;
+		case eTimeout: fStats.fTimeouts++; break;
+		case eChecksumError: fStats.fChecksumErrors++; break;
+		case eProtocolError: fStats.fProtocolErrors++; break;
+		}
+		// drop late responses before the next try
+		WaitIdle();
+	}
+	fStats.fFailed++;
+	return result;
+}
+
+static void print_percentiles(const char* name, std::vector<unsigned int> values)
+{
+	if (values.empty()) {
+		printf("%-18s -\n", name);
+		return;
+	}
+	std::sort(values.begin(), values.end());
+	unsigned int n = values.size();
+	printf("%-18s p50 %6u  p90 %6u  p99 %6u  max %6u\n", name,
+		values[n * 50 / 100], values[n * 90 / 100], values[n * 99 / 100], values[n - 1]);
+}
+
+static void run_server(int slaveFd, int commandLineFd, int readyFd,
+	RCPtr<AtrMemoryImage> image, bool autobaud, bool highspeed)
+{
+	try {
+		RCPtr<UserspaceSIOWrapper> wrapper = new UserspaceSIOWrapper(slaveFd);
+		if (commandLineFd >= 0) {
+			wrapper->SetCommandLineChannel(commandLineFd);
+			wrapper->SetSIOServerMode(SIOWrapper::eCommandLine_RI);
+		} else {
+			wrapper->SetSIOServerMode(SIOWrapper::eCommandLine_None);
+		}
+		wrapper->SetAutobaud(autobaud);
+
+		RCPtr<SIOManager> manager = new SIOManager(wrapper);
+		RCPtr<AtrSIOHandler> handler = new AtrSIOHandler(image);
+		handler->EnableHighSpeed(highspeed);
+		manager->RegisterHandler(0x31, handler);
+
+		uint8_t ready = 1;
+		if (write(readyFd, &ready, 1) != 1) {
+			_exit(1);
+		}
+		close(readyFd);
+
+		while (1) {
+			manager->DoServing();
+		}
+	}
+	catch (ErrorObject& err) {
+		fprintf(stderr, "server: %s\n", err.AsCString());
+	}
+	_exit(1);
+}
+
+static void usage(const char* progname)
+{
+	printf("usage: %s [options]\n", progname);
+	printf("options:\n");
+	printf("  -n count      number of commands (default: 1000)\n");
+	printf("  -w percent    percentage of write commands (default: 0)\n");
+	printf("  -d density    s, e or d: density of the test image (default: d)\n");
+	printf("  -b baudrate   baudrate of the virtual Atari (default: 19200)\n");
+	printf("  -a            enable autobaud in the server\n");
+	printf("  -s            enable high speed SIO in the server\n");
+	printf("  -p usec       idle time between commands (default: 0)\n");
+	printf("  -N            no command line, server detects command frames by\n");
+	printf("                idle time\n");
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int count = 1000;
+	unsigned int writePercent = 0;
+	unsigned int baudrate = 19200;
+	unsigned int pacing = 0;
+	bool autobaud = false;
+	bool highspeed = false;
+	bool useCommandLine = true;
+	EDiskFormat format = e180kDisk;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:w:d:b:asp:Nh")) != -1) {
+		switch (c) {
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'w':
+			writePercent = atoi(optarg);
+			if (writePercent > 100) {
+				writePercent = 100;
+			}
+			break;
+		case 'd':
+			switch (optarg[0]) {
+			case 's': format = e90kDisk; break;
+			case 'e': format = e130kDisk; break;
+			case 'd': format = e180kDisk; break;
+			default:
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'b':
+			baudrate = atoi(optarg);
+			if (baudrate < 300) {
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 'a':
+			autobaud = true;
+			break;
+		case 's':
+			highspeed = true;
+			break;
+		case 'p':
+			pacing = atoi(optarg);
+			break;
+		case 'N':
+			useCommandLine = false;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	RCPtr<AtrMemoryImage> image = new AtrMemoryImage;
+	if (!image->CreateImage(format)) {
+		printf("cannot create image\n");
+		return 1;
+	}
+
+	int masterFd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (masterFd < 0 || grantpt(masterFd) || unlockpt(masterFd)) {
+		perror("cannot create pty");
+		return 1;
+	}
+	int slaveFd = open(ptsname(masterFd), O_RDWR | O_NOCTTY | O_NDELAY);
+	if (slaveFd < 0) {
+		perror("cannot open pty slave");
+		return 1;
+	}
+
+	int commandLinePipe[2] = { -1, -1 };
+	int readyPipe[2];
+	if ((useCommandLine && pipe(commandLinePipe)) || pipe(readyPipe)) {
+		perror("cannot create pipe");
+		return 1;
+	}
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork failed");
+		return 1;
+	}
+	if (pid == 0) {
+		close(masterFd);
+		close(readyPipe[0]);
+		if (useCommandLine) {
+			close(commandLinePipe[1]);
+		}
+		run_server(slaveFd, commandLinePipe[0], readyPipe[1], image, autobaud, highspeed);
+	}
+	close(slaveFd);
+	close(readyPipe[1]);
+	if (useCommandLine) {
+		close(commandLinePipe[0]);
+	}
+
+	uint8_t ready;
+	if (read(readyPipe[0], &ready, 1) != 1) {
+		printf("server failed to start\n");
+		waitpid(pid, NULL, 0);
+		return 1;
+	}
+	close(readyPipe[0]);
+
+	VirtualAtari atari(masterFd, commandLinePipe[1], baudrate);
+	unsigned int sectors = image->GetNumberOfSectors();
+	uint8_t buf[8200];
+	unsigned int sector = 4;
+	unsigned int rnd = 1;
+	unsigned long long sectorCount = 0;
+
+	// the first command fails if the server doesn't use our baudrate,
+	// don't count the speed detection
+	atari.Execute(0x31, 0x53, 0, buf, 4, false);
+	atari.ResetStatistics();
+
+	MiscUtils::TimestampType start = MiscUtils::GetCurrentTime();
+	for (unsigned int i = 0; i < count; i++) {
+		rnd = rnd * 1103515245 + 12345;
+		bool isWrite = ((rnd >> 16) % 100) < writePercent;
+		unsigned int length = image->GetSectorLength(sector);
+		if (isWrite) {
+			memset(buf, i & 0xff, length);
+		}
+		if (atari.Execute(0x31, isWrite ? 0x50 : 0x52, sector, buf, length, isWrite) == VirtualAtari::eOK) {
+			sectorCount++;
+		}
+		if (++sector > sectors) {
+			sector = 4;
+		}
+		if (pacing) {
+			MiscUtils::WaitUntil(MiscUtils::GetCurrentTime() + pacing);
+		}
+	}
+	MiscUtils::TimestampType elapsed = MiscUtils::GetCurrentTime() - start;
+
+	kill(pid, SIGTERM);
+	waitpid(pid, NULL, 0);
+	close(masterFd);
+	if (useCommandLine) {
+		close(commandLinePipe[1]);
+	}
+
+	const VirtualAtari::Statistics& stats = atari.GetStatistics();
+	double secs = elapsed / 1e6;
+	printf("%u commands in %.3f sec, %u failed, %u retries\n",
+		stats.fCommands, secs, stats.fFailed, stats.fRetries);
+	printf("%.1f sectors/sec, %.0f bytes/sec\n",
+		secs > 0 ? sectorCount / secs : 0.0,
+		secs > 0 ? stats.fBytes / secs : 0.0);
+	printf("errors: %u NAK, %u error, %u timeout, %u checksum, %u protocol, %u garbled\n",
+		stats.fNAKs, stats.fErrors, stats.fTimeouts, stats.fChecksumErrors,
+		stats.fProtocolErrors, stats.fGarbled);
+	printf("timing: %u late ACK, %u early complete\n",
+		stats.fLateACKs, stats.fEarlyCompletes);
+	printf("latency in usec:\n");
+	print_percentiles("  ACK", stats.fAckLatency);
+	print_percentiles("  complete", stats.fCompleteLatency);
+	print_percentiles("  command", stats.fCommandTime);
+
+	SIOTracer::GetInstance()->RemoveAllTracers();
+	return stats.fFailed ? 1 : 0;
+}
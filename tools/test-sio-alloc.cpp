@@ -0,0 +1,177 @@
+/*
+   test-sio-alloc: verify that serving SIO commands doesn't allocate
+   memory on the heap
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <new>
+
+#include "LoopbackSIOWrapper.h"
+#include "SIOManager.h"
+#include "AtrSIOHandler.h"
+#include "AtrMemoryImage.h"
+#include "PrinterHandler.h"
+#include "SIOTracer.h"
+#include "AsyncTracer.h"
+#include "FileTracer.h"
+
+#ifdef ENABLE_ATP
+#include "AtpSIOHandler.h"
+#include "AtpUtils.h"
+#endif
+
+// count all heap allocations while enabled
+
+static bool countAllocations = false;
+static unsigned long numAllocations = 0;
+
+void* operator new(size_t size)
+{
+	if (countAllocations) {
+		numAllocations++;
+	}
+	void* p = malloc(size ? size : 1);
+	if (!p) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) throw()
+{
+	free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+	free(p);
+}
+
+#if __cplusplus >= 201402L
+void operator delete(void* p, size_t) throw()
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) throw()
+{
+	free(p);
+}
+#endif
+
+static void usage(const char* progname)
+{
+	printf("usage: %s [-n rounds] [-t]\n", progname);
+	printf("serves read, write, status and percom commands to an ATR and\n");
+	printf("an ATP drive plus printer commands and fails if this allocates\n");
+	printf("memory on the heap\n");
+	printf("-t : trace commands and data blocks to /dev/null\n");
+}
+
+int main(int argc, char** argv)
+{
+	unsigned int rounds = 10;
+	bool trace = false;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:th")) != -1) {
+		switch (c) {
+		case 'n':
+			rounds = atoi(optarg);
+			break;
+		case 't':
+			trace = true;
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	RCPtr<LoopbackSIOWrapper> wrapper = new LoopbackSIOWrapper;
+	// recording the responses would allocate memory
+	wrapper->SetRecording(false);
+
+	for (unsigned int sec = 1; sec <= 720; sec++) {
+		wrapper->AddFrame(0x31, 0x53, 0);
+		wrapper->AddFrame(0x31, 0x52, sec);
+		wrapper->AddFrame(0x31, 0x57, sec);
+		wrapper->AddFrame(0x31, 0x4e, 0);
+#ifdef ENABLE_ATP
+		wrapper->AddFrame(0x32, 0x53, 0);
+		wrapper->AddFrame(0x32, 0x52, sec);
+		wrapper->AddFrame(0x32, 0x50, sec);
+#endif
+		wrapper->AddFrame(0x40, 0x53, 0);
+		wrapper->AddFrame(0x40, 0x57, 0x4e);
+	}
+	// unhandled device
+	wrapper->AddFrame(0x38, 0x52, 1);
+
+	if (trace) {
+		SIOTracer* sioTracer = SIOTracer::GetInstance();
+		RCPtr<AbstractTracer> tracer = new AsyncTracer(new FileTracer("/dev/null"));
+		sioTracer->AddTracer(tracer);
+		sioTracer->SetTraceGroup(SIOTracer::eTraceCommands, true, tracer);
+		sioTracer->SetTraceGroup(SIOTracer::eTraceUnhandeledCommands, true, tracer);
+		sioTracer->SetTraceGroup(SIOTracer::eTraceDataBlocks, true, tracer);
+		sioTracer->SetTraceGroup(SIOTracer::eTraceAtpInfo, true, tracer);
+		sioTracer->SetTraceGroup(SIOTracer::eTracePrinter, true, tracer);
+	}
+
+	RCPtr<SIOManager> manager = new SIOManager(wrapper);
+
+	RCPtr<AtrMemoryImage> atrImage = new AtrMemoryImage;
+	atrImage->CreateImage(e256BytesPerSector, 720);
+	manager->RegisterHandler(0x31, new AtrSIOHandler(atrImage));
+
+#ifdef ENABLE_ATP
+	RCPtr<AtrMemoryImage> sdImage = new AtrMemoryImage;
+	sdImage->CreateImage(e128BytesPerSector, 720);
+	RCPtr<AtpImage> atpImage = AtpUtils::CreateAtpImageFromAtrImage(sdImage);
+	manager->RegisterHandler(0x32, new AtpSIOHandler(atpImage));
+#endif
+
+	// the writer thread doesn't allocate memory either
+	manager->RegisterHandler(0x40, new PrinterHandler("/dev/null", PrinterHandler::eRaw));
+
+	// first round initializes singletons and lazily allocated data
+	wrapper->Rewind();
+	manager->DoServing();
+
+	countAllocations = true;
+	for (unsigned int i = 0; i < rounds; i++) {
+		wrapper->Rewind();
+		manager->DoServing();
+	}
+	countAllocations = false;
+
+	printf("%u commands: %lu heap allocations\n",
+		wrapper->GetNumberOfFrames() * rounds, numAllocations);
+
+	return numAllocations ? 1 : 0;
+}
@@ -0,0 +1,364 @@
+/*
+   test-sio-replay: replay SIO command frames to the handlers, check
+   the responses against a golden trace and benchmark the handlers
+
+   Copyright (C) 2026 Matthias Reichl <hias@horus.com>
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <getopt.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "LoopbackSIOWrapper.h"
+#include "SIOManager.h"
+#include "AtrSIOHandler.h"
+#include "AtrMemoryImage.h"
+#include "PrinterHandler.h"
+#include "DeviceManager.h"
+#include "SIOTracer.h"
+
+#ifdef ENABLE_ATP
+#include "AtpSIOHandler.h"
+#include "AtpUtils.h"
+
+static bool has_suffix(const char* name, const char* suffix)
+{
+	size_t len = strlen(name);
+	size_t slen = strlen(suffix);
+	return len >= slen && strcasecmp(name + len - slen, suffix) == 0;
+}
+#endif
+
+static RCPtr<AbstractSIOHandler> load_drive(const char* filename, bool highspeed)
+{
+#ifdef ENABLE_ATP
+	if (has_suffix(filename, ".atp") || has_suffix(filename, ".atp.gz")) {
+		RCPtr<AtpImage> image = new AtpImage;
+		if (!image->ReadImageFromFile(filename)) {
+			return 0;
+		}
+		return new AtpSIOHandler(image);
+	}
+#endif
+	RCPtr<AtrMemoryImage> image = new AtrMemoryImage;
+	if (!image->ReadImageFromFile(filename)) {
+		return 0;
+	}
+	RCPtr<AtrSIOHandler> handler = new AtrSIOHandler(image);
+	handler->EnableHighSpeed(highspeed);
+	return handler;
+}
+
+// the same default drives every run, so traces can be compared
+static void setup_default_drives(const RCPtr<SIOManager>& manager, bool highspeed)
+{
+	RCPtr<AtrMemoryImage> ddImage = new AtrMemoryImage;
+	ddImage->CreateImage(e256BytesPerSector, 720);
+	RCPtr<AtrSIOHandler> handler = new AtrSIOHandler(ddImage);
+	handler->EnableHighSpeed(highspeed);
+	manager->RegisterHandler(DeviceManager::eSIODriveBase + 1, handler);
+
+#ifdef ENABLE_ATP
+	RCPtr<AtrMemoryImage> sdImage = new AtrMemoryImage;
+	sdImage->CreateImage(e128BytesPerSector, 720);
+	RCPtr<AtpImage> atpImage = AtpUtils::CreateAtpImageFromAtrImage(sdImage);
+	manager->RegisterHandler(DeviceManager::eSIODriveBase + 2, new AtpSIOHandler(atpImage));
+#endif
+}
+
+// status, write, read back and percom for every drive, a printer line
+// and an unhandled device
+static void generate_session(const RCPtr<LoopbackSIOWrapper>& wrapper, const RCPtr<SIOManager>& manager)
+{
+	for (unsigned int drive = 1; drive <= 8; drive++) {
+		RCPtr<AbstractSIOHandler> handler = manager->GetHandler(DeviceManager::eSIODriveBase + drive);
+		if (handler.IsNull()) {
+			continue;
+		}
+		RCPtr<DiskImage> image = handler->GetDiskImage();
+		uint8_t dev = DeviceManager::eSIODriveBase + drive;
+		unsigned int sectors = image->GetNumberOfSectors();
+		if (sectors > 720) {
+			sectors = 720;
+		}
+
+		wrapper->AddFrame(dev, 0x53, 0);
+		wrapper->AddFrame(dev, 0x4e, 0);
+		wrapper->AddFrame(dev, 0x3f, 0);
+		for (unsigned int sec = 1; sec <= sectors; sec++) {
+			LoopbackSIOWrapper::Frame frame;
+			memset(&frame.fFrame, 0, sizeof(frame.fFrame));
+			frame.fFrame.device_id = dev;
+			frame.fFrame.command = 0x50;
+			frame.fFrame.aux1 = sec & 0xff;
+			frame.fFrame.aux2 = sec >> 8;
+			frame.fBaudrate = 19200;
+			frame.fDelay = 1000;
+			// the rest of double density sectors is padded
+			frame.fData.resize(128);
+			for (unsigned int i = 0; i < frame.fData.size(); i++) {
+				frame.fData[i] = (sec * 7 + i) & 0xff;
+			}
+			wrapper->AddFrame(frame);
+		}
+		for (unsigned int sec = 1; sec <= sectors + 1; sec++) {
+			wrapper->AddFrame(dev, 0x52, sec, 19200, 1000);
+		}
+	}
+	if (manager->GetHandler(DeviceManager::eSIOPrinter + 1).IsNotNull()) {
+		LoopbackSIOWrapper::Frame frame;
+		memset(&frame.fFrame, 0, sizeof(frame.fFrame));
+		frame.fFrame.device_id = DeviceManager::eSIOPrinter + 1;
+		frame.fFrame.command = 0x57;
+		frame.fFrame.aux1 = 0x4e;
+		frame.fBaudrate = 19200;
+		frame.fDelay = 0;
+		const char* line = "HELLO WORLD";
+		frame.fData.assign(line, line + strlen(line));
+		frame.fData.resize(40, ' ');
+		frame.fData[39] = 155;
+		wrapper->AddFrame(frame);
+	}
+	wrapper->AddFrame(0x38, 0x52, 1);
+}
+
+static bool read_lines(const char* filename, std::vector<std::string>& lines)
+{
+	FILE* f = fopen(filename, "r");
+	if (!f) {
+		return false;
+	}
+	char buf[256];
+	while (fgets(buf, sizeof(buf), f)) {
+		buf[strcspn(buf, "\r\n")] = 0;
+		lines.push_back(buf);
+	}
+	fclose(f);
+	return true;
+}
+
+static bool compare_trace(const RCPtr<LoopbackSIOWrapper>& wrapper, const char* golden)
+{
+	std::vector<std::string> expected;
+	if (!read_lines(golden, expected)) {
+		printf("cannot read golden trace %s\n", golden);
+		return false;
+	}
+	std::vector<LoopbackSIOWrapper::Frame> frames;
+	for (unsigned int i = 0; i < wrapper->GetNumberOfFrames(); i++) {
+		frames.push_back(wrapper->GetFrame(i));
+	}
+	const std::vector<LoopbackSIOWrapper::Event>& events = wrapper->GetEvents();
+	for (unsigned int i = 0; i < events.size() || i < expected.size(); i++) {
+		std::string got;
+		if (i < events.size()) {
+			got = LoopbackSIOWrapper::FormatEvent(events[i], frames);
+		}
+		if (i >= expected.size() || got != expected[i]) {
+			printf("trace mismatch at event %u:\n", i + 1);
+			printf("  expected: %s\n", i < expected.size() ? expected[i].c_str() : "<end of trace>");
+			printf("  got:      %s\n", i < events.size() ? got.c_str() : "<end of trace>");
+			return false;
+		}
+	}
+	printf("trace matches %s (%u events)\n", golden, (unsigned int) events.size());
+	return true;
+}
+
+struct CommandStats {
+	unsigned int fCount;
+	unsigned long long fTotal;
+	unsigned long long fMax;
+};
+
+static void print_benchmark(const RCPtr<LoopbackSIOWrapper>& wrapper,
+	const std::vector<unsigned long long>& times, unsigned int rounds)
+{
+	std::map<unsigned int, CommandStats> stats;
+	unsigned long long total = 0;
+	for (unsigned int i = 0; i < times.size(); i++) {
+		const SIO_command_frame& f = wrapper->GetFrame(i % wrapper->GetNumberOfFrames()).fFrame;
+		CommandStats& s = stats[f.device_id << 8 | f.command];
+		s.fCount++;
+		s.fTotal += times[i];
+		if (times[i] > s.fMax) {
+			s.fMax = times[i];
+		}
+		total += times[i];
+	}
+	printf("%u rounds, %u commands, %.3f ms CPU time, %.0f commands/sec\n",
+		rounds, (unsigned int) times.size(), total / 1e6,
+		total ? times.size() * 1e9 / total : 0.0);
+	printf("device command   count     avg usec     max usec\n");
+	for (std::map<unsigned int, CommandStats>::const_iterator it = stats.begin(); it != stats.end(); ++it) {
+		printf("    %02x      %02x %7u %12.3f %12.3f\n", it->first >> 8, it->first & 0xff,
+			it->second.fCount, it->second.fTotal / 1e3 / it->second.fCount,
+			it->second.fMax / 1e3);
+	}
+}
+
+static void usage(const char* progname)
+{
+	printf("usage: %s [options]\n", progname);
+	printf("options:\n");
+	printf("  -d n:file     load image file into drive n (default: a DD ATR in D1:\n");
+	printf("                and an ATP in D2:)\n");
+	printf("  -p file       install a printer handler writing to file\n");
+	printf("  -s            enable high speed SIO on ATR drives\n");
+	printf("  -S session    replay session file (default: generated session)\n");
+	printf("  -W session    write the session to a file\n");
+	printf("  -t trace      write the trace of the first round to a file\n");
+	printf("  -g golden     compare the trace of the first round with a golden trace\n");
+	printf("  -n rounds     replay the session this many times and print the\n");
+	printf("                CPU time per command (default: 1)\n");
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::pair<int, const char*> > drives;
+	const char* printerFile = 0;
+	const char* sessionFile = 0;
+	const char* writeSessionFile = 0;
+	const char* traceFile = 0;
+	const char* goldenFile = 0;
+	unsigned int rounds = 1;
+	bool highspeed = false;
+	int c;
+
+	while ((c = getopt(argc, argv, "d:p:sS:W:t:g:n:h")) != -1) {
+		switch (c) {
+		case 'd':
+			if (optarg[0] < '1' || optarg[0] > '8' || optarg[1] != ':' || !optarg[2]) {
+				usage(argv[0]);
+				return 1;
+			}
+			drives.push_back(std::make_pair(optarg[0] - '0', optarg + 2));
+			break;
+		case 'p':
+			printerFile = optarg;
+			break;
+		case 's':
+			highspeed = true;
+			break;
+		case 'S':
+			sessionFile = optarg;
+			break;
+		case 'W':
+			writeSessionFile = optarg;
+			break;
+		case 't':
+			traceFile = optarg;
+			break;
+		case 'g':
+			goldenFile = optarg;
+			break;
+		case 'n':
+			rounds = atoi(optarg);
+			if (rounds < 1) {
+				rounds = 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (optind != argc) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	RCPtr<LoopbackSIOWrapper> wrapper = new LoopbackSIOWrapper;
+	RCPtr<SIOManager> manager = new SIOManager(wrapper);
+
+	if (drives.empty()) {
+		setup_default_drives(manager, highspeed);
+	}
+	for (unsigned int i = 0; i < drives.size(); i++) {
+		RCPtr<AbstractSIOHandler> handler = load_drive(drives[i].second, highspeed);
+		if (handler.IsNull()) {
+			printf("cannot load %s\n", drives[i].second);
+			return 1;
+		}
+		manager->UnregisterHandler(DeviceManager::eSIODriveBase + drives[i].first);
+		manager->RegisterHandler(DeviceManager::eSIODriveBase + drives[i].first, handler);
+	}
+	RCPtr<PrinterHandler> printer;
+	if (printerFile) {
+		printer = new PrinterHandler(printerFile, PrinterHandler::eLF);
+		manager->RegisterHandler(DeviceManager::eSIOPrinter + 1, printer);
+	}
+
+	if (sessionFile) {
+		if (!wrapper->ReadSession(sessionFile)) {
+			printf("error reading session %s\n", sessionFile);
+			return 1;
+		}
+	} else {
+		generate_session(wrapper, manager);
+	}
+	if (writeSessionFile && !wrapper->WriteSession(writeSessionFile)) {
+		printf("error writing session %s\n", writeSessionFile);
+		return 1;
+	}
+	if (wrapper->GetNumberOfFrames() == 0) {
+		printf("empty session\n");
+		return 1;
+	}
+
+	// first round records the trace
+	wrapper->Rewind();
+	manager->DoServing();
+
+	bool ok = true;
+	if (traceFile) {
+		FILE* f = fopen(traceFile, "w");
+		if (!f) {
+			printf("cannot create %s\n", traceFile);
+			return 1;
+		}
+		wrapper->WriteTrace(f);
+		fclose(f);
+	}
+	if (goldenFile && !compare_trace(wrapper, goldenFile)) {
+		ok = false;
+	}
+
+	if (rounds > 1) {
+		wrapper->SetRecording(false);
+		wrapper->SetTiming(true);
+		std::vector<unsigned long long> times;
+		for (unsigned int r = 0; r < rounds; r++) {
+			wrapper->Rewind();
+			manager->DoServing();
+			const std::vector<unsigned long long>& t = wrapper->GetCpuTimes();
+			times.insert(times.end(), t.begin(), t.end());
+		}
+		print_benchmark(wrapper, times, rounds);
+	}
+
+	if (printer.IsNotNull()) {
+		manager->UnregisterHandler(DeviceManager::eSIOPrinter + 1);
+	}
+	SIOTracer::GetInstance()->RemoveAllTracers();
+	return ok ? 0 : 1;
+}